@@ -0,0 +1,423 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <common/types.h>
+
+
+namespace RK
+{
+
+/** Spin for a while, then yield, then park on a condition variable.
+  *
+  * Producers only take the mutex to wake up parked threads, so a busy consumer costs no futex call.
+  * The spin limit adapts: it grows when a wait is satisfied by spinning and shrinks when it ends up
+  * parking, so idle threads stop burning CPU soon.
+  */
+class SpinThenParkWaiter
+{
+public:
+    static constexpr size_t MIN_SPINS = 16;
+    static constexpr size_t MAX_SPINS = 4096;
+    static constexpr size_t YIELDS = 8;
+
+    using Clock = std::chrono::steady_clock;
+
+    /// Wait until ready() returns true or deadline, return ready().
+    template <typename Ready>
+    bool wait(Ready && ready, std::optional<Clock::time_point> deadline)
+    {
+        size_t spins = spin_limit.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < spins; ++i)
+        {
+            if (ready())
+            {
+                if (spins < MAX_SPINS)
+                    spin_limit.store(spins * 2, std::memory_order_relaxed);
+                return true;
+            }
+            pause();
+        }
+
+        for (size_t i = 0; i < YIELDS; ++i)
+        {
+            if (ready())
+                return true;
+            std::this_thread::yield();
+        }
+
+        if (spins > MIN_SPINS)
+            spin_limit.store(spins / 2, std::memory_order_relaxed);
+
+        std::unique_lock lock(mutex);
+        /// Ordered with the RMW in notify, either ready() sees the new state or notify sees the waiter.
+        waiters.fetch_add(1, std::memory_order_acq_rel);
+
+        bool result;
+        if (deadline)
+            result = cv.wait_until(lock, *deadline, ready);
+        else
+        {
+            cv.wait(lock, ready);
+            result = true;
+        }
+
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    /// Wake up parked threads, must be called after the state ready() checks is published.
+    void notify()
+    {
+        /// RMW rather than load, it is ordered with the increment in wait and publishes the new state to it.
+        if (waiters.fetch_add(0, std::memory_order_acq_rel) == 0)
+            return;
+
+        std::lock_guard lock(mutex);
+        cv.notify_all();
+    }
+
+    static void pause()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+private:
+    std::atomic<size_t> spin_limit{MIN_SPINS};
+    std::atomic<size_t> waiters{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+
+enum class RingQueueMode
+{
+    SPSC,
+    MPSC,
+    MPMC,
+};
+
+/** Lock-free bounded queue on a ring buffer, a drop-in replacement of ConcurrentBoundedQueue on hot path.
+  *
+  * Every cell has a sequence number telling whether it is ready for the producer or the consumer of
+  * a lap (Dmitry Vyukov's bounded MPMC queue), producers and consumers claim cells by incrementing tail
+  * and head, with CAS if there may be several of them, otherwise with a plain store. Capacity is rounded
+  * up to a power of two, 2 at least.
+  *
+  * Pushing into a full queue or popping from an empty queue waits by SpinThenParkWaiter.
+  * After finish, push returns false and pop returns the remaining values until the queue is empty.
+  */
+template <typename T, RingQueueMode mode = RingQueueMode::MPMC>
+class BoundedRingQueue
+{
+    static constexpr bool multi_producer = mode != RingQueueMode::SPSC;
+    static constexpr bool multi_consumer = mode == RingQueueMode::MPMC;
+
+public:
+    explicit BoundedRingQueue(size_t capacity_)
+    {
+        /// With one cell, the sequence of a filled cell and of a free cell in next lap are the same.
+        size_t capacity = 2;
+        while (capacity < capacity_)
+            capacity <<= 1;
+
+        mask = capacity - 1;
+        cells = std::make_unique<Cell[]>(capacity);
+        for (size_t i = 0; i < capacity; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    ~BoundedRingQueue()
+    {
+        T x;
+        while (tryPopImpl(x))
+            ;
+    }
+
+    BoundedRingQueue(const BoundedRingQueue &) = delete;
+    BoundedRingQueue & operator=(const BoundedRingQueue &) = delete;
+
+    /// Returns false if queue is finished
+    template <typename U>
+    bool push(U && x)
+    {
+        return pushImpl(std::forward<U>(x), std::nullopt);
+    }
+
+    /// Returns false if queue is finished or value was not pushed during timeout
+    template <typename U>
+    bool tryPush(U && x, UInt64 milliseconds = 0)
+    {
+        return pushImpl(std::forward<U>(x), std::chrono::milliseconds(milliseconds));
+    }
+
+    /// Returns false if queue is finished and empty
+    bool pop(T & x) { return popImpl(x, std::nullopt); }
+
+    /// Pop and drop the front value, used after peek.
+    void pop()
+    {
+        T x;
+        popImpl(x, std::nullopt);
+    }
+
+    /// Returns false if queue is (finished and empty) or (value was not popped during timeout)
+    bool tryPop(T & x, UInt64 milliseconds = 0) { return popImpl(x, std::chrono::milliseconds(milliseconds)); }
+
+    /// The same as tryPop, but with finer timeout
+    bool tryPop(T & x, std::chrono::microseconds timeout) { return popImpl(x, timeout); }
+
+    /// Wait for a value during timeout and then pop up to max_count values without waiting,
+    /// return count of popped values appended to out.
+    size_t tryPopBatch(std::vector<T> & out, size_t max_count, UInt64 milliseconds = 0)
+    {
+        if (max_count == 0)
+            return 0;
+
+        T x;
+        if (!tryPop(x, milliseconds))
+            return 0;
+        out.push_back(std::move(x));
+
+        size_t count = 1;
+        while (count < max_count && tryPopImpl(x))
+        {
+            out.push_back(std::move(x));
+            ++count;
+        }
+        if (count > 1)
+            not_full.notify();
+        return count;
+    }
+
+    /// Copy the front value, only the consumer can peek.
+    bool peek(T & x)
+    {
+        static_assert(!multi_consumer, "peek is only supported with single consumer");
+
+        size_t pos = head.value.load(std::memory_order_relaxed);
+        Cell & cell = cells[pos & mask];
+        if (cell.sequence.load(std::memory_order_acquire) != pos + 1)
+            return false;
+        x = *cell.get();
+        return true;
+    }
+
+    /// Approximate size when there are concurrent producers or consumers
+    size_t size() const
+    {
+        size_t current_head = head.value.load(std::memory_order_acquire);
+        size_t current_tail = tail.value.load(std::memory_order_acquire);
+        return current_tail > current_head ? current_tail - current_head : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    size_t capacity() const { return mask + 1; }
+
+    /// Returns true if queue was already finished
+    bool finish()
+    {
+        bool was_finished = finished.exchange(true);
+        not_empty.notify();
+        not_full.notify();
+        return was_finished;
+    }
+
+    bool isFinished() const { return finished.load(); }
+
+    /// Pop all values
+    void clear()
+    {
+        T x;
+        while (tryPopImpl(x))
+            ;
+        not_full.notify();
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T * get() { return std::launder(reinterpret_cast<T *>(storage)); }
+    };
+
+    /// Head and tail are in their own cache lines to avoid false sharing of producers and consumers.
+    struct alignas(64) Position
+    {
+        std::atomic<size_t> value{0};
+    };
+
+    template <typename U>
+    bool tryPushImpl(U && x)
+    {
+        size_t pos = tail.value.load(std::memory_order_relaxed);
+        Cell * cell;
+        while (true)
+        {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<ssize_t>(sequence) - static_cast<ssize_t>(pos);
+            if (diff == 0)
+            {
+                if constexpr (multi_producer)
+                {
+                    if (tail.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else
+                {
+                    tail.value.store(pos + 1, std::memory_order_relaxed);
+                    break;
+                }
+            }
+            else if (diff < 0)
+                return false; /// full
+            else
+                pos = tail.value.load(std::memory_order_relaxed);
+        }
+
+        new (cell->storage) T(std::forward<U>(x));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPopImpl(T & x)
+    {
+        size_t pos = head.value.load(std::memory_order_relaxed);
+        Cell * cell;
+        while (true)
+        {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<ssize_t>(sequence) - static_cast<ssize_t>(pos + 1);
+            if (diff == 0)
+            {
+                if constexpr (multi_consumer)
+                {
+                    if (head.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else
+                {
+                    head.value.store(pos + 1, std::memory_order_relaxed);
+                    break;
+                }
+            }
+            else if (diff < 0)
+                return false; /// empty
+            else
+                pos = head.value.load(std::memory_order_relaxed);
+        }
+
+        T * value = cell->get();
+        x = std::move(*value);
+        value->~T();
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool hasValue() const
+    {
+        size_t pos = head.value.load(std::memory_order_relaxed);
+        return cells[pos & mask].sequence.load(std::memory_order_acquire) == pos + 1;
+    }
+
+    bool hasRoom() const
+    {
+        size_t pos = tail.value.load(std::memory_order_relaxed);
+        return cells[pos & mask].sequence.load(std::memory_order_acquire) == pos;
+    }
+
+    static std::optional<SpinThenParkWaiter::Clock::time_point> toDeadline(std::optional<std::chrono::microseconds> timeout)
+    {
+        if (!timeout)
+            return std::nullopt;
+        return SpinThenParkWaiter::Clock::now() + *timeout;
+    }
+
+    template <typename U>
+    bool pushImpl(U && x, std::optional<std::chrono::microseconds> timeout)
+    {
+        auto deadline = toDeadline(timeout);
+        while (true)
+        {
+            if (finished.load(std::memory_order_relaxed))
+                return false;
+
+            if (tryPushImpl(std::forward<U>(x)))
+            {
+                not_empty.notify();
+                return true;
+            }
+
+            if (deadline && SpinThenParkWaiter::Clock::now() >= *deadline)
+                return false;
+
+            auto ready = [this] { return hasRoom() || finished.load(std::memory_order_relaxed); };
+            /// Room may be taken by other producers, then wait again until the same deadline.
+            if (!not_full.wait(ready, deadline))
+                return false;
+        }
+    }
+
+    bool popImpl(T & x, std::optional<std::chrono::microseconds> timeout)
+    {
+        auto deadline = toDeadline(timeout);
+        while (true)
+        {
+            if (tryPopImpl(x))
+            {
+                not_full.notify();
+                return true;
+            }
+
+            if (finished.load(std::memory_order_relaxed))
+                return tryPopImpl(x);
+
+            if (timeout && timeout->count() == 0)
+                return false;
+
+            auto ready = [this] { return hasValue() || finished.load(std::memory_order_relaxed); };
+            if (!not_empty.wait(ready, deadline))
+                return false;
+        }
+    }
+
+    Position head;
+    Position tail;
+
+    size_t mask;
+    std::unique_ptr<Cell[]> cells;
+
+    std::atomic<bool> finished{false};
+
+    SpinThenParkWaiter not_empty;
+    SpinThenParkWaiter not_full;
+};
+
+template <typename T>
+using SPSCRingQueue = BoundedRingQueue<T, RingQueueMode::SPSC>;
+
+template <typename T>
+using MPSCRingQueue = BoundedRingQueue<T, RingQueueMode::MPSC>;
+
+template <typename T>
+using MPMCRingQueue = BoundedRingQueue<T, RingQueueMode::MPMC>;
+
+}
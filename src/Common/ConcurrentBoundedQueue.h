@@ -4,6 +4,7 @@
 #include <mutex>
 #include <type_traits>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <optional>
 
@@ -91,16 +92,16 @@ private:
         return true;
     }
 
-    bool popImpl(T & x, std::optional<UInt64> timeout_milliseconds)
+    bool popImpl(T & x, std::optional<std::chrono::microseconds> timeout)
     {
         {
             std::unique_lock<std::mutex> queue_lock(queue_mutex);
 
             auto predicate = [&]() { return is_finished || !queue.empty(); };
 
-            if (timeout_milliseconds.has_value())
+            if (timeout.has_value())
             {
-                bool wait_result = pop_condition.wait_for(queue_lock, std::chrono::milliseconds(timeout_milliseconds.value()), predicate);
+                bool wait_result = pop_condition.wait_for(queue_lock, timeout.value(), predicate);
 
                 if (!wait_result)
                     return false;
@@ -150,13 +151,13 @@ public:
     /// Returns false if queue is finished and empty
     bool pop(T & x)
     {
-        return popImpl(x, std::nullopt /*timeout in milliseconds*/);
+        return popImpl(x, std::nullopt /*timeout*/);
     }
 
     void pop()
     {
         T x;
-        popImpl(x, std::nullopt /*timeout in milliseconds*/);
+        popImpl(x, std::nullopt /*timeout*/);
     }
 
     bool peek(T & x)
@@ -190,7 +191,13 @@ public:
     /// Returns false if queue is (finished and empty) or (object was not popped during timeout)
     bool tryPop(T & x, UInt64 milliseconds = 0)
     {
-        return popImpl(x, milliseconds);
+        return popImpl(x, std::chrono::milliseconds(milliseconds));
+    }
+
+    /// The same as tryPop, but with finer timeout
+    bool tryPop(T & x, std::chrono::microseconds timeout)
+    {
+        return popImpl(x, timeout);
     }
 
     /// Returns size of queue
@@ -0,0 +1,380 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+#include <Common/BitHelpers.h>
+#include <common/defines.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+namespace RK
+{
+
+/** Open-addressing hash map in the spirit of SwissTable.
+  *
+  * Slots are stored inline in one array and are grouped by 16. Each slot has a control byte,
+  * which is either EMPTY, DELETED, or the 7 low bits of the hash of the key. A lookup finds the
+  * candidate slots of a whole group with one SIMD compare of the control bytes, so that most
+  * lookups touch one control group and one slot.
+  *
+  * The table is resized incrementally: when it is full, a new table is allocated and every
+  * following insert or erase moves a few slots from the old table, so that the rehash cost is
+  * spread across operations instead of stalling the caller. During the migration a key lives
+  * in exactly one of the two tables.
+  *
+  * Not thread-safe.
+  */
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class FlatHashMap : private boost::noncopyable
+{
+public:
+    using Slot = std::pair<Key, Value>;
+
+    static constexpr size_t GROUP_WIDTH = 16;
+    /// How many old slots are moved for each insert or erase while resizing.
+    static constexpr size_t MIGRATE_STEP = 32;
+
+    FlatHashMap() = default;
+
+    explicit FlatHashMap(size_t expected_size) { reserve(expected_size); }
+
+    /// Return nullptr if not found.
+    Value * find(const Key & key)
+    {
+        size_t hash_value = hash(key);
+        if (size_t pos = findIndex(current, key, hash_value); pos != NOT_FOUND)
+            return &current.slots[pos].second;
+        if (size_t pos = findIndex(old, key, hash_value); pos != NOT_FOUND)
+            return &old.slots[pos].second;
+        return nullptr;
+    }
+
+    /// Return true if key is inserted, false if value of an existing key is replaced.
+    template <typename K, typename V>
+    bool insertOrAssign(K && key, V && value)
+    {
+        migrateStep();
+
+        size_t hash_value = hash(key);
+        if (size_t pos = findIndex(current, key, hash_value); pos != NOT_FOUND)
+        {
+            current.slots[pos].second = std::forward<V>(value);
+            return false;
+        }
+        if (size_t pos = findIndex(old, key, hash_value); pos != NOT_FOUND)
+        {
+            old.slots[pos].second = std::forward<V>(value);
+            return false;
+        }
+
+        if (unlikely(current.growth_left == 0))
+            grow();
+
+        insertUnique(current, hash_value, Slot(std::forward<K>(key), std::forward<V>(value)));
+        ++count;
+        return true;
+    }
+
+    bool erase(const Key & key)
+    {
+        migrateStep();
+
+        size_t hash_value = hash(key);
+        if (size_t pos = findIndex(current, key, hash_value); pos != NOT_FOUND)
+        {
+            eraseAt(current, pos);
+            --count;
+            return true;
+        }
+        if (size_t pos = findIndex(old, key, hash_value); pos != NOT_FOUND)
+        {
+            eraseAt(old, pos);
+            --count;
+            return true;
+        }
+        return false;
+    }
+
+    /// Make room for expected_size keys without further resizing.
+    void reserve(size_t expected_size)
+    {
+        size_t required = capacityFor(std::max(expected_size, count));
+        if (required <= current.capacity)
+            return;
+
+        finishMigration();
+        Table table(required);
+        moveAll(current, table);
+        current = std::move(table);
+    }
+
+    /// Func is void(const Key &, const Value &)
+    template <typename Func>
+    void forEach(Func && func) const
+    {
+        forEachIn(old, func);
+        forEachIn(current, func);
+    }
+
+    void clear()
+    {
+        current = Table();
+        old = Table();
+        migrate_pos = 0;
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    /// Slots allocated in both tables.
+    size_t capacity() const { return current.capacity + old.capacity; }
+    bool isResizing() const { return old.capacity != 0; }
+
+    size_t allocatedBytes() const { return current.allocatedBytes() + old.allocatedBytes(); }
+
+private:
+    static constexpr size_t NOT_FOUND = static_cast<size_t>(-1);
+
+    static constexpr int8_t EMPTY = -128;
+    static constexpr int8_t DELETED = -2;
+
+    /// Slots are constructed only when they are filled, so that allocating a big table does
+    /// not touch all of its memory and does not stall the caller.
+    struct Table
+    {
+        /// Power of two and multiple of GROUP_WIDTH, or zero.
+        size_t capacity = 0;
+        /// How many slots can be filled before resizing, including deleted ones.
+        size_t growth_left = 0;
+        std::unique_ptr<int8_t[]> ctrl;
+        Slot * slots = nullptr;
+
+        Table() = default;
+
+        explicit Table(size_t capacity_)
+            : capacity(capacity_)
+            , growth_left(maxLoad(capacity_))
+            , ctrl(new int8_t[capacity_])
+            , slots(std::allocator<Slot>().allocate(capacity_))
+        {
+            memset(ctrl.get(), EMPTY, capacity);
+        }
+
+        Table(Table && other) noexcept { swap(other); }
+
+        Table & operator=(Table && other) noexcept
+        {
+            Table tmp(std::move(other));
+            swap(tmp);
+            return *this;
+        }
+
+        ~Table()
+        {
+            if (!slots)
+                return;
+            for (size_t pos = 0; pos < capacity; ++pos)
+                if (ctrl[pos] >= 0)
+                    std::destroy_at(&slots[pos]);
+            std::allocator<Slot>().deallocate(slots, capacity);
+        }
+
+        void swap(Table & other) noexcept
+        {
+            std::swap(capacity, other.capacity);
+            std::swap(growth_left, other.growth_left);
+            std::swap(ctrl, other.ctrl);
+            std::swap(slots, other.slots);
+        }
+
+        size_t allocatedBytes() const { return capacity * (sizeof(int8_t) + sizeof(Slot)); }
+    };
+
+    static size_t maxLoad(size_t capacity) { return capacity - capacity / 8; }
+
+    static size_t capacityFor(size_t expected_size)
+    {
+        if (expected_size == 0)
+            return 0;
+        return std::max(GROUP_WIDTH, roundUpToPowerOfTwoOrZero(expected_size + expected_size / 7 + 1));
+    }
+
+    static size_t h1(size_t hash_value) { return hash_value >> 7; }
+    static int8_t h2(size_t hash_value) { return static_cast<int8_t>(hash_value & 0x7F); }
+
+    /// Bit i of result is set if control byte i of group equals to value.
+    static uint32_t match(const int8_t * group, int8_t value)
+    {
+#if defined(__SSE2__)
+        auto ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value)));
+#else
+        uint32_t res = 0;
+        for (size_t i = 0; i < GROUP_WIDTH; ++i)
+            res |= static_cast<uint32_t>(group[i] == value) << i;
+        return res;
+#endif
+    }
+
+    /// Bit i of result is set if control byte i of group is EMPTY or DELETED.
+    static uint32_t matchEmptyOrDeleted(const int8_t * group)
+    {
+#if defined(__SSE2__)
+        return _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(group)));
+#else
+        uint32_t res = 0;
+        for (size_t i = 0; i < GROUP_WIDTH; ++i)
+            res |= static_cast<uint32_t>(group[i] < 0) << i;
+        return res;
+#endif
+    }
+
+    /// Groups are visited by triangular numbers, which covers all groups when group count is power of two.
+    size_t findIndex(const Table & table, const Key & key, size_t hash_value) const
+    {
+        if (table.capacity == 0)
+            return NOT_FOUND;
+
+        size_t groups_mask = table.capacity / GROUP_WIDTH - 1;
+        size_t group = h1(hash_value) & groups_mask;
+        int8_t fingerprint = h2(hash_value);
+
+        for (size_t step = 0; step <= groups_mask; ++step)
+        {
+            const int8_t * ctrl = table.ctrl.get() + group * GROUP_WIDTH;
+            for (uint32_t mask = match(ctrl, fingerprint); mask; mask &= mask - 1)
+            {
+                size_t pos = group * GROUP_WIDTH + getTrailingZeroBitsUnsafe(mask);
+                if (likely(table.slots[pos].first == key))
+                    return pos;
+            }
+
+            if (match(ctrl, EMPTY))
+                return NOT_FOUND;
+
+            group = (group + step + 1) & groups_mask;
+        }
+        return NOT_FOUND;
+    }
+
+    /// Key must not exist in table and table must have growth left.
+    static void insertUnique(Table & table, size_t hash_value, Slot && slot)
+    {
+        size_t groups_mask = table.capacity / GROUP_WIDTH - 1;
+        size_t group = h1(hash_value) & groups_mask;
+
+        /// Same probing sequence as findIndex
+        for (size_t step = 0;; ++step)
+        {
+            int8_t * ctrl = table.ctrl.get() + group * GROUP_WIDTH;
+            if (uint32_t mask = matchEmptyOrDeleted(ctrl))
+            {
+                size_t index = getTrailingZeroBitsUnsafe(mask);
+                if (ctrl[index] == EMPTY)
+                    --table.growth_left;
+
+                ctrl[index] = h2(hash_value);
+                std::construct_at(&table.slots[group * GROUP_WIDTH + index], std::move(slot));
+                return;
+            }
+            group = (group + step + 1) & groups_mask;
+        }
+    }
+
+    /// Deleted slots are kept as tombstones, so that probing sequences of other keys are not broken.
+    static void eraseAt(Table & table, size_t pos)
+    {
+        table.ctrl[pos] = DELETED;
+        std::destroy_at(&table.slots[pos]);
+    }
+
+    void moveAll(Table & from, Table & to)
+    {
+        for (size_t pos = 0; pos < from.capacity; ++pos)
+        {
+            if (from.ctrl[pos] >= 0)
+                insertUnique(to, hash(from.slots[pos].first), std::move(from.slots[pos]));
+        }
+        from = Table();
+    }
+
+    /// Allocate a new table and start moving slots into it. If most of used slots
+    /// are tombstones, the new table has the same capacity, otherwise it is doubled.
+    void grow()
+    {
+        finishMigration();
+
+        size_t new_capacity = count >= current.capacity / 2 - current.capacity / 16
+            ? std::max(GROUP_WIDTH, current.capacity * 2)
+            : std::max(capacityFor(count * 2), current.capacity);
+
+        old = std::move(current);
+        current = Table(new_capacity);
+        migrate_pos = 0;
+
+        if (old.capacity == 0)
+            return;
+
+        /// The new table must not fill up before the old one is drained.
+        if (maxLoad(new_capacity) < count + old.capacity / MIGRATE_STEP + 1)
+            finishMigration();
+    }
+
+    void migrateStep()
+    {
+        if (likely(old.capacity == 0))
+            return;
+
+        size_t end = std::min(migrate_pos + MIGRATE_STEP, old.capacity);
+        for (; migrate_pos < end; ++migrate_pos)
+        {
+            if (old.ctrl[migrate_pos] >= 0)
+            {
+                insertUnique(current, hash(old.slots[migrate_pos].first), std::move(old.slots[migrate_pos]));
+                eraseAt(old, migrate_pos);
+            }
+        }
+
+        if (migrate_pos == old.capacity)
+        {
+            old = Table();
+            migrate_pos = 0;
+        }
+    }
+
+    void finishMigration()
+    {
+        while (old.capacity != 0)
+            migrateStep();
+    }
+
+    template <typename Func>
+    static void forEachIn(const Table & table, Func & func)
+    {
+        for (size_t pos = 0; pos < table.capacity; ++pos)
+        {
+            if (table.ctrl[pos] >= 0)
+                func(table.slots[pos].first, table.slots[pos].second);
+        }
+    }
+
+    Table current;
+    /// Not empty while resizing.
+    Table old;
+    size_t migrate_pos = 0;
+
+    size_t count = 0;
+    Hash hash;
+};
+
+}
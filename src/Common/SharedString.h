@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+#include <common/types.h>
+
+
+namespace RK
+{
+
+/**
+ * Immutable string shared by reference counting, copying it only copies a pointer. Empty string holds no memory.
+ * Used for node data, so that responses and snapshots can reference node data instead of copying it.
+ */
+class SharedString
+{
+public:
+    SharedString() = default;
+    SharedString(String str) : holder(str.empty() ? nullptr : std::make_shared<const String>(std::move(str))) { } /// NOLINT
+    SharedString(const char * str) : SharedString(String(str)) { } /// NOLINT
+
+    const char * data() const { return holder ? holder->data() : ""; }
+    size_t size() const { return holder ? holder->size() : 0; }
+    size_t length() const { return size(); }
+    bool empty() const { return !holder; }
+
+    std::string_view view() const { return holder ? std::string_view(*holder) : std::string_view(); }
+
+    const String & str() const
+    {
+        static const String empty_string;
+        return holder ? *holder : empty_string;
+    }
+
+    bool operator==(const SharedString & rhs) const { return holder == rhs.holder || view() == rhs.view(); }
+    bool operator==(std::string_view rhs) const { return view() == rhs; }
+    bool operator==(const String & rhs) const { return view() == rhs; }
+    bool operator==(const char * rhs) const { return view() == rhs; }
+
+private:
+    std::shared_ptr<const String> holder;
+};
+
+}
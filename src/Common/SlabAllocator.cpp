@@ -0,0 +1,208 @@
+#include <Common/SlabAllocator.h>
+
+#include <cassert>
+
+
+namespace RK
+{
+
+struct alignas(64) SlabPool::Slab
+{
+    Slab * prev = nullptr;
+    Slab * next = nullptr;
+
+    /// Freed objects, linked through their first bytes.
+    void * free_list = nullptr;
+    /// Objects after it are never used.
+    char * bump = nullptr;
+    char * end = nullptr;
+
+    UInt32 used = 0;
+    UInt32 capacity = 0;
+    UInt32 class_index = 0;
+
+    char * begin() { return reinterpret_cast<char *>(this) + sizeof(Slab); }
+    bool full() const { return used == capacity; }
+};
+
+SlabPool::Stats & SlabPool::Stats::operator+=(const Stats & rhs)
+{
+    slab_count += rhs.slab_count;
+    allocated_bytes += rhs.allocated_bytes;
+    used_bytes += rhs.used_bytes;
+    object_count += rhs.object_count;
+    return *this;
+}
+
+double SlabPool::Stats::fragmentation() const
+{
+    if (allocated_bytes == 0)
+        return 0;
+    return 1.0 - static_cast<double>(used_bytes) / allocated_bytes;
+}
+
+SlabPool::~SlabPool()
+{
+    /// All objects are freed now, so only the slabs kept as the last partial slab are left.
+    for (auto & size_class : size_classes)
+    {
+        assert(size_class.object_count == 0);
+        while (size_class.partial)
+        {
+            Slab * slab = size_class.partial;
+            unlinkPartial(size_class, slab);
+            freeSlab(slab);
+        }
+    }
+}
+
+void * SlabPool::alloc(size_t size)
+{
+    if (unlikely(size == 0))
+        size = 1;
+
+    if (unlikely(size > MAX_OBJECT_SIZE))
+    {
+        {
+            std::lock_guard lock(mutex);
+            large_bytes += size;
+            ++large_count;
+        }
+        return Allocator<false>::alloc(size);
+    }
+
+    size_t class_index = sizeClassIndex(size);
+
+    std::lock_guard lock(mutex);
+    auto & size_class = size_classes[class_index];
+
+    Slab * slab = size_class.partial;
+    if (!slab)
+    {
+        slab = allocSlab(class_index);
+        linkPartial(size_class, slab);
+        ++size_class.slab_count;
+    }
+
+    void * ptr;
+    if (slab->free_list)
+    {
+        ptr = slab->free_list;
+        slab->free_list = *reinterpret_cast<void **>(ptr);
+    }
+    else
+    {
+        assert(slab->bump < slab->end);
+        ptr = slab->bump;
+        slab->bump += sizeClassBytes(class_index);
+    }
+
+    ++slab->used;
+    ++size_class.object_count;
+
+    if (slab->full())
+        unlinkPartial(size_class, slab);
+
+    return ptr;
+}
+
+void SlabPool::free(void * ptr, size_t size)
+{
+    if (unlikely(size == 0))
+        size = 1;
+
+    if (unlikely(size > MAX_OBJECT_SIZE))
+    {
+        Allocator<false>::free(ptr, size);
+        std::lock_guard lock(mutex);
+        large_bytes -= size;
+        --large_count;
+        return;
+    }
+
+    Slab * slab = reinterpret_cast<Slab *>(reinterpret_cast<uintptr_t>(ptr) & ~(SLAB_SIZE - 1));
+
+    std::lock_guard lock(mutex);
+    auto & size_class = size_classes[slab->class_index];
+    assert(slab->class_index == sizeClassIndex(size));
+
+    bool was_full = slab->full();
+
+    *reinterpret_cast<void **>(ptr) = slab->free_list;
+    slab->free_list = ptr;
+    --slab->used;
+    --size_class.object_count;
+
+    if (was_full)
+        linkPartial(size_class, slab);
+
+    /// Return empty slab to the system, but keep the last one to avoid
+    /// allocating and freeing a slab repeatedly for one object.
+    if (slab->used == 0 && size_class.slab_count > 1)
+    {
+        unlinkPartial(size_class, slab);
+        --size_class.slab_count;
+        freeSlab(slab);
+    }
+}
+
+SlabPool::Stats SlabPool::getStats() const
+{
+    Stats stats;
+
+    std::lock_guard lock(mutex);
+    for (size_t i = 0; i < SIZE_CLASS_NUM; ++i)
+    {
+        stats.slab_count += size_classes[i].slab_count;
+        stats.object_count += size_classes[i].object_count;
+        stats.used_bytes += size_classes[i].object_count * sizeClassBytes(i);
+    }
+
+    stats.allocated_bytes = stats.slab_count * SLAB_SIZE + large_bytes;
+    stats.used_bytes += large_bytes;
+    stats.object_count += large_count;
+    return stats;
+}
+
+SlabPool::Slab * SlabPool::allocSlab(size_t class_index)
+{
+    void * buf = Allocator<false>::alloc(SLAB_SIZE, SLAB_SIZE);
+
+    Slab * slab = new (buf) Slab;
+    slab->bump = slab->begin();
+    slab->capacity = (SLAB_SIZE - sizeof(Slab)) / sizeClassBytes(class_index);
+    slab->end = slab->bump + slab->capacity * sizeClassBytes(class_index);
+    slab->class_index = class_index;
+    return slab;
+}
+
+void SlabPool::freeSlab(Slab * slab)
+{
+    slab->~Slab();
+    Allocator<false>::free(slab, SLAB_SIZE);
+}
+
+void SlabPool::linkPartial(SizeClass & size_class, Slab * slab)
+{
+    slab->prev = nullptr;
+    slab->next = size_class.partial;
+    if (size_class.partial)
+        size_class.partial->prev = slab;
+    size_class.partial = slab;
+}
+
+void SlabPool::unlinkPartial(SizeClass & size_class, Slab * slab)
+{
+    if (slab->prev)
+        slab->prev->next = slab->next;
+    else
+        size_class.partial = slab->next;
+
+    if (slab->next)
+        slab->next->prev = slab->prev;
+
+    slab->prev = nullptr;
+    slab->next = nullptr;
+}
+
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <mutex>
+
+#include <boost/noncopyable.hpp>
+#include <Common/Allocator.h>
+#include <common/types.h>
+
+
+namespace RK
+{
+
+/** Pool of small objects of many fixed sizes.
+  *
+  * Memory is taken from the system by slabs of SLAB_SIZE bytes aligned by SLAB_SIZE, each slab
+  * serves one size class. An object is freed into the free list of its slab, which is found by
+  * masking the address of the object, and a slab is returned to the system as soon as all objects
+  * in it are freed. So unlike Arena, memory of deleted objects is reused and a long living pool
+  * does not keep memory of objects deleted long ago.
+  *
+  * Objects bigger than MAX_OBJECT_SIZE are allocated from the system directly.
+  *
+  * Thread-safe.
+  */
+class SlabPool : private boost::noncopyable, private Allocator<false>
+{
+public:
+    static constexpr size_t SLAB_SIZE = 64 * 1024;
+    static constexpr size_t SIZE_CLASS_STEP = 16;
+    static constexpr size_t MAX_OBJECT_SIZE = 512;
+    static constexpr size_t SIZE_CLASS_NUM = MAX_OBJECT_SIZE / SIZE_CLASS_STEP;
+
+    struct Stats
+    {
+        size_t slab_count = 0;
+        /// Bytes of slabs and objects bigger than MAX_OBJECT_SIZE.
+        size_t allocated_bytes = 0;
+        /// Bytes of live objects, rounded up to their size class.
+        size_t used_bytes = 0;
+        size_t object_count = 0;
+
+        Stats & operator+=(const Stats & rhs);
+
+        /// Ratio of memory which is allocated but not used, 0 if nothing is allocated.
+        double fragmentation() const;
+    };
+
+    SlabPool() = default;
+    ~SlabPool();
+
+    void * alloc(size_t size);
+    void free(void * ptr, size_t size);
+
+    Stats getStats() const;
+
+private:
+    struct Slab;
+
+    struct SizeClass
+    {
+        /// Slabs with free space, doubly linked.
+        Slab * partial = nullptr;
+        size_t slab_count = 0;
+        size_t object_count = 0;
+    };
+
+    static size_t sizeClassIndex(size_t size) { return (size - 1) / SIZE_CLASS_STEP; }
+    static size_t sizeClassBytes(size_t index) { return (index + 1) * SIZE_CLASS_STEP; }
+
+    Slab * allocSlab(size_t class_index);
+    void freeSlab(Slab * slab);
+
+    static void linkPartial(SizeClass & size_class, Slab * slab);
+    static void unlinkPartial(SizeClass & size_class, Slab * slab);
+
+    mutable std::mutex mutex;
+    std::array<SizeClass, SIZE_CLASS_NUM> size_classes;
+    size_t large_bytes = 0;
+    size_t large_count = 0;
+};
+
+/// STL allocator on top of SlabPool, for example for std::allocate_shared.
+/// It holds a raw pointer to keep allocated objects small, the pool must outlive all objects allocated from it.
+template <typename T>
+class SlabAllocator
+{
+public:
+    using value_type = T;
+
+    explicit SlabAllocator(SlabPool * pool_) : pool(pool_) { }
+
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U> & other) : pool(other.getPool()) /// NOLINT
+    {
+    }
+
+    T * allocate(size_t n) { return static_cast<T *>(pool->alloc(n * sizeof(T))); }
+    void deallocate(T * ptr, size_t n) { pool->free(ptr, n * sizeof(T)); }
+
+    SlabPool * getPool() const { return pool; }
+
+    template <typename U>
+    bool operator==(const SlabAllocator<U> & rhs) const { return pool == rhs.getPool(); }
+    template <typename U>
+    bool operator!=(const SlabAllocator<U> & rhs) const { return pool != rhs.getPool(); }
+
+private:
+    SlabPool * pool;
+};
+
+}
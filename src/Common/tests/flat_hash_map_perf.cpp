@@ -0,0 +1,131 @@
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Common/FlatHashMap.h>
+#include <Common/Stopwatch.h>
+
+
+/** Compare FlatHashMap with std::unordered_map which is used by the hash_map data tree engine.
+  * Keys look like znode paths of ClickHouse replication log.
+  *
+  * Test this way:
+  *
+  * ./flat_hash_map_perf 10000000
+  * ./flat_hash_map_perf 50000000
+  * ./flat_hash_map_perf 50000000 flat
+  *
+  * The second argument is one of std, flat, all (default). Run maps one by one to keep the
+  * memory freed by the previous map from affecting the latency of the next one.
+  *
+  * Besides the throughput, the max latency of a single insert is printed,
+  * which shows the stall of rehashing the whole table.
+  */
+
+namespace
+{
+
+struct Node
+{
+    std::string data;
+};
+
+using NodePtr = std::shared_ptr<Node>;
+
+std::vector<std::string> generateKeys(size_t n)
+{
+    std::vector<std::string> keys;
+    keys.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+        keys.emplace_back("/clickhouse/tables/db_" + std::to_string(i % 97) + "/table_" + std::to_string(i % 1031) + "/log/log-"
+                          + std::to_string(i));
+    return keys;
+}
+
+void report(const char * map_name, const char * operation, size_t n, double seconds, UInt64 max_latency_ns = 0)
+{
+    std::cerr << std::setw(20) << map_name << std::setw(10) << operation << ": " << n << " ops in " << seconds << " sec., "
+              << (n / seconds) << " ops/sec.";
+    if (max_latency_ns)
+        std::cerr << ", max latency " << (max_latency_ns / 1000000.0) << " ms";
+    std::cerr << "\n";
+}
+
+template <typename Insert, typename Find, typename Erase>
+void bench(const char * map_name, const std::vector<std::string> & keys, Insert && insert, Find && find, Erase && erase)
+{
+    const size_t n = keys.size();
+
+    {
+        Stopwatch watch;
+        Stopwatch op_watch;
+        UInt64 max_latency_ns = 0;
+        for (const auto & key : keys)
+        {
+            op_watch.restart();
+            insert(key);
+            max_latency_ns = std::max(max_latency_ns, op_watch.elapsedNanoseconds());
+        }
+        report(map_name, "insert", n, watch.elapsedSeconds(), max_latency_ns);
+    }
+
+    {
+        Stopwatch watch;
+        size_t found = 0;
+        for (size_t i = 0; i < n; ++i)
+            found += find(keys[(i * 7919) % n]);
+        report(map_name, "find", n, watch.elapsedSeconds());
+        if (found != n)
+            std::cerr << "Found only " << found << " keys\n";
+    }
+
+    {
+        Stopwatch watch;
+        for (size_t i = 0; i < n; i += 2)
+            erase(keys[i]);
+        report(map_name, "erase", n / 2, watch.elapsedSeconds());
+    }
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    size_t n = argc > 1 ? std::stoull(argv[1]) : 10000000;
+    std::string which = argc > 2 ? argv[2] : "all";
+
+    std::cerr << std::fixed << std::setprecision(3);
+
+    Stopwatch watch;
+    auto keys = generateKeys(n);
+    std::cerr << "Generated " << n << " keys in " << watch.elapsedSeconds() << " sec.\n";
+
+    auto value = std::make_shared<Node>();
+
+    if (which == "std" || which == "all")
+    {
+        std::unordered_map<std::string, NodePtr> map;
+        bench(
+            "std::unordered_map",
+            keys,
+            [&](const std::string & key) { map.insert_or_assign(key, value); },
+            [&](const std::string & key) { return map.find(key) != map.end(); },
+            [&](const std::string & key) { map.erase(key); });
+    }
+
+    if (which == "flat" || which == "all")
+    {
+        RK::FlatHashMap<std::string, NodePtr> map;
+        bench(
+            "FlatHashMap",
+            keys,
+            [&](const std::string & key) { map.insertOrAssign(key, value); },
+            [&](const std::string & key) { return map.find(key) != nullptr; },
+            [&](const std::string & key) { map.erase(key); });
+    }
+
+    return 0;
+}
@@ -0,0 +1,194 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <Common/BoundedRingQueue.h>
+
+#include <gtest/gtest.h>
+
+
+using namespace RK;
+
+namespace
+{
+
+/// Every producer pushes values producer_id * n + i, consumers check that values of every producer are in order.
+template <typename Queue>
+void checkConcurrent(size_t producers, size_t consumers, size_t n)
+{
+    Queue queue(64);
+    std::vector<std::vector<size_t>> popped(consumers);
+
+    std::vector<std::thread> consumer_threads;
+    for (size_t c = 0; c < consumers; ++c)
+        consumer_threads.emplace_back(
+            [&, c]
+            {
+                size_t x;
+                while (queue.pop(x))
+                    popped[c].push_back(x);
+            });
+
+    std::vector<std::thread> producer_threads;
+    for (size_t p = 0; p < producers; ++p)
+        producer_threads.emplace_back(
+            [&, p]
+            {
+                for (size_t i = 0; i < n; ++i)
+                    ASSERT_TRUE(queue.push(p * n + i));
+            });
+
+    for (auto & thread : producer_threads)
+        thread.join();
+    queue.finish();
+    for (auto & thread : consumer_threads)
+        thread.join();
+
+    std::vector<size_t> counts(producers * n, 0);
+    for (const auto & values : popped)
+    {
+        std::vector<size_t> last(producers, 0);
+        std::vector<bool> seen(producers, false);
+        for (auto x : values)
+        {
+            size_t p = x / n;
+            if (seen[p])
+            {
+                ASSERT_GT(x, last[p]);
+            }
+            seen[p] = true;
+            last[p] = x;
+            ++counts[x];
+        }
+    }
+
+    for (auto count : counts)
+        ASSERT_EQ(count, 1);
+}
+
+}
+
+TEST(BoundedRingQueue, Basic)
+{
+    MPMCRingQueue<std::unique_ptr<int>> queue(3);
+    ASSERT_EQ(queue.capacity(), 4);
+    ASSERT_TRUE(queue.empty());
+
+    for (int i = 0; i < 4; ++i)
+        ASSERT_TRUE(queue.tryPush(std::make_unique<int>(i)));
+    ASSERT_FALSE(queue.tryPush(std::make_unique<int>(4)));
+    ASSERT_FALSE(queue.tryPush(std::make_unique<int>(4), 1));
+    ASSERT_EQ(queue.size(), 4);
+
+    std::unique_ptr<int> x;
+    ASSERT_TRUE(queue.tryPop(x));
+    ASSERT_EQ(*x, 0);
+
+    std::vector<std::unique_ptr<int>> batch;
+    ASSERT_EQ(queue.tryPopBatch(batch, 2), 2);
+    ASSERT_EQ(*batch[0], 1);
+    ASSERT_EQ(*batch[1], 2);
+
+    ASSERT_TRUE(queue.tryPop(x, std::chrono::microseconds(100)));
+    ASSERT_EQ(*x, 3);
+    ASSERT_FALSE(queue.tryPop(x, 1));
+    ASSERT_EQ(queue.tryPopBatch(batch, 10), 0);
+
+    /// Values left are popped after finish, and nothing can be pushed.
+    ASSERT_TRUE(queue.push(std::make_unique<int>(5)));
+    ASSERT_FALSE(queue.finish());
+    ASSERT_TRUE(queue.finish());
+    ASSERT_FALSE(queue.push(std::make_unique<int>(6)));
+    ASSERT_TRUE(queue.pop(x));
+    ASSERT_EQ(*x, 5);
+    ASSERT_FALSE(queue.pop(x));
+}
+
+TEST(BoundedRingQueue, Peek)
+{
+    SPSCRingQueue<int> queue(2);
+    int x = 0;
+    ASSERT_FALSE(queue.peek(x));
+
+    queue.push(1);
+    queue.push(2);
+    ASSERT_TRUE(queue.peek(x));
+    ASSERT_EQ(x, 1);
+    queue.pop();
+    ASSERT_TRUE(queue.peek(x));
+    ASSERT_EQ(x, 2);
+    queue.clear();
+    ASSERT_TRUE(queue.empty());
+}
+
+TEST(BoundedRingQueue, WakeUp)
+{
+    MPSCRingQueue<int> queue(1);
+
+    /// Consumer parks on empty queue and is woken up by push.
+    std::thread consumer(
+        [&]
+        {
+            int x;
+            ASSERT_TRUE(queue.pop(x));
+            ASSERT_EQ(x, 1);
+            ASSERT_FALSE(queue.pop(x));
+        });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    queue.push(1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    queue.finish();
+    consumer.join();
+
+    /// Producer parks on full queue and is woken up by finish.
+    MPSCRingQueue<int> full_queue(1);
+    ASSERT_EQ(full_queue.capacity(), 2);
+    full_queue.push(1);
+    full_queue.push(2);
+    std::thread producer([&] { ASSERT_FALSE(full_queue.push(3)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    full_queue.finish();
+    producer.join();
+}
+
+TEST(BoundedRingQueue, Concurrent)
+{
+    checkConcurrent<SPSCRingQueue<size_t>>(1, 1, 100000);
+    checkConcurrent<MPSCRingQueue<size_t>>(4, 1, 50000);
+    checkConcurrent<MPMCRingQueue<size_t>>(4, 4, 50000);
+}
+
+TEST(BoundedRingQueue, PushTimeoutUnderContention)
+{
+    MPMCRingQueue<int> queue(2);
+    queue.push(0);
+    queue.push(0);
+
+    /// A consumer frees a cell now and then, and a busy producer takes it at once,
+    /// tryPush of another producer keeps losing the race but must give up at its deadline.
+    std::atomic<bool> stop{false};
+    std::thread consumer(
+        [&]
+        {
+            int x;
+            while (!stop)
+                queue.tryPop(x, 10);
+        });
+    std::thread busy_producer(
+        [&]
+        {
+            while (!stop)
+                queue.tryPush(0, 1);
+        });
+
+    auto start = std::chrono::steady_clock::now();
+    queue.tryPush(1, 100);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    ASSERT_LT(elapsed, std::chrono::milliseconds(1000));
+
+    stop = true;
+    queue.finish();
+    consumer.join();
+    busy_producer.join();
+}
@@ -0,0 +1,66 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Common/SlabAllocator.h>
+
+using namespace RK;
+
+namespace
+{
+
+struct Object
+{
+    std::string data;
+    char padding[100];
+};
+
+}
+
+TEST(Common, SlabPoolReuseAndRelease)
+{
+    /// Declared before objects, so that it is destroyed after them.
+    SlabPool pool;
+    std::vector<std::shared_ptr<Object>> objects;
+
+    for (size_t i = 0; i < 10000; ++i)
+    {
+        objects.emplace_back(std::allocate_shared<Object>(SlabAllocator<Object>(&pool)));
+        objects.back()->data = std::to_string(i);
+    }
+
+    auto stats = pool.getStats();
+    ASSERT_EQ(stats.object_count, 10000);
+    ASSERT_GT(stats.slab_count, 1);
+    ASSERT_LE(stats.used_bytes, stats.allocated_bytes);
+
+    for (size_t i = 0; i < objects.size(); ++i)
+        ASSERT_EQ(objects[i]->data, std::to_string(i));
+
+    /// Freed objects are reused before new slabs are allocated.
+    for (size_t i = 0; i < objects.size(); i += 2)
+        objects[i].reset();
+    for (size_t i = 0; i < objects.size(); i += 2)
+        objects[i] = std::allocate_shared<Object>(SlabAllocator<Object>(&pool));
+    ASSERT_EQ(pool.getStats().slab_count, stats.slab_count);
+
+    /// Empty slabs are returned except the last one.
+    objects.clear();
+    stats = pool.getStats();
+    ASSERT_EQ(stats.object_count, 0);
+    ASSERT_EQ(stats.slab_count, 1);
+}
+
+TEST(Common, SlabPoolLargeObject)
+{
+    SlabPool pool;
+
+    void * ptr = pool.alloc(SlabPool::MAX_OBJECT_SIZE + 1);
+    ASSERT_EQ(pool.getStats().slab_count, 0);
+    ASSERT_EQ(pool.getStats().allocated_bytes, SlabPool::MAX_OBJECT_SIZE + 1);
+
+    pool.free(ptr, SlabPool::MAX_OBJECT_SIZE + 1);
+    ASSERT_EQ(pool.getStats().allocated_bytes, 0);
+}
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Common/BoundedRingQueue.h>
+#include <Common/ConcurrentBoundedQueue.h>
+#include <Common/Stopwatch.h>
+#include <Service/ThreadSafeQueue.h>
+
+
+/** Compare BoundedRingQueue with ConcurrentBoundedQueue and ThreadSafeQueue which were used on the
+  * request pipeline, in the shapes of the pipeline:
+  *   spsc -- committed queue of RequestProcessor
+  *   mpsc -- requests queue of RequestAccumulator and child queues of RequestsQueue
+  *   mpmc -- several producers and consumers
+  *
+  * Test this way:
+  *
+  * ./ring_queue_perf 10000000
+  * ./ring_queue_perf 10000000 8
+  *
+  * The second argument is producer count of mpsc and mpmc, default 4. Besides the throughput,
+  * p99 and max latency from push to pop are printed.
+  */
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct Value
+{
+    Clock::time_point push_time;
+    std::shared_ptr<int> payload; /// as RequestForSession holds a request ptr
+};
+
+void report(const char * queue_name, const char * shape, size_t n, double seconds, std::vector<UInt64> & latencies)
+{
+    std::sort(latencies.begin(), latencies.end());
+    std::cerr << std::setw(24) << queue_name << std::setw(6) << shape << ": " << n << " ops in " << seconds << " sec., "
+              << static_cast<UInt64>(n / seconds) << " ops/sec., p99 latency " << latencies[latencies.size() * 99 / 100] / 1000.0
+              << " us, max latency " << latencies.back() / 1000.0 << " us\n";
+}
+
+template <typename Push, typename Pop>
+void bench(const char * queue_name, const char * shape, size_t n, size_t producers, size_t consumers, Push && push, Pop && pop)
+{
+    const size_t per_producer = n / producers;
+    const size_t total = per_producer * producers;
+    const size_t per_consumer = total / consumers;
+    auto payload = std::make_shared<int>(0);
+
+    std::vector<std::vector<UInt64>> latencies(consumers);
+    std::vector<std::thread> threads;
+
+    Stopwatch watch;
+    for (size_t c = 0; c < consumers; ++c)
+        threads.emplace_back(
+            [&, c]
+            {
+                /// The last consumer pops the remainder.
+                size_t count = c + 1 == consumers ? total - per_consumer * c : per_consumer;
+                latencies[c].reserve(count / 64 + 1);
+                Value value;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    pop(value);
+                    if (i % 64 == 0)
+                        latencies[c].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - value.push_time).count());
+                }
+            });
+
+    for (size_t p = 0; p < producers; ++p)
+        threads.emplace_back(
+            [&]
+            {
+                for (size_t i = 0; i < per_producer; ++i)
+                    push(Value{Clock::now(), payload});
+            });
+
+    for (auto & thread : threads)
+        thread.join();
+
+    std::vector<UInt64> all_latencies;
+    for (auto & consumer_latencies : latencies)
+        all_latencies.insert(all_latencies.end(), consumer_latencies.begin(), consumer_latencies.end());
+    report(queue_name, shape, total, watch.elapsedSeconds(), all_latencies);
+}
+
+template <typename RingQueue>
+void benchRing(const char * shape, size_t n, size_t producers, size_t consumers)
+{
+    RingQueue queue(20000);
+    bench(
+        "BoundedRingQueue", shape, n, producers, consumers,
+        [&](Value && value) { queue.push(std::move(value)); },
+        [&](Value & value) { queue.pop(value); });
+}
+
+void benchConcurrentBounded(const char * shape, size_t n, size_t producers, size_t consumers)
+{
+    ConcurrentBoundedQueue<Value> queue(20000);
+    bench(
+        "ConcurrentBoundedQueue", shape, n, producers, consumers,
+        [&](Value && value) { queue.push(std::move(value)); },
+        [&](Value & value) { queue.pop(value); });
+}
+
+void benchThreadSafe(const char * shape, size_t n, size_t producers, size_t consumers)
+{
+    RK::ThreadSafeQueue<Value> queue;
+    bench(
+        "ThreadSafeQueue", shape, n, producers, consumers,
+        [&](Value && value) { queue.push(std::move(value)); },
+        [&](Value & value) { while (!queue.tryPop(value, 1000)); });
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    size_t n = argc > 1 ? std::stoull(argv[1]) : 10000000;
+    size_t producers = argc > 2 ? std::stoull(argv[2]) : 4;
+
+    benchConcurrentBounded("spsc", n, 1, 1);
+    benchThreadSafe("spsc", n, 1, 1);
+    benchRing<RK::SPSCRingQueue<Value>>("spsc", n, 1, 1);
+
+    benchConcurrentBounded("mpsc", n, producers, 1);
+    benchThreadSafe("mpsc", n, producers, 1);
+    benchRing<RK::MPSCRingQueue<Value>>("mpsc", n, producers, 1);
+
+    benchConcurrentBounded("mpmc", n, producers, producers);
+    benchThreadSafe("mpmc", n, producers, producers);
+    benchRing<RK::MPMCRingQueue<Value>>("mpmc", n, producers, producers);
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include <Service/ACLMap.h>
+#include <algorithm>
 #include <Common/SipHash.h>
 
 namespace RK
@@ -71,6 +72,7 @@ uint64_t ACLMap::convertACLs(const Coordination::ACLs & acls)
 
     acl_to_num[acls] = index;
     num_to_acl[index] = acls;
+    num_to_compiled_acls[index] = compile(acls);
 
     return index;
 }
@@ -95,7 +97,9 @@ void ACLMap::addMapping(uint64_t acls_id, const Coordination::ACLs & acls)
     std::lock_guard lock(acl_mutex);
     num_to_acl[acls_id] = acls;
     acl_to_num[acls] = acls_id;
+    num_to_compiled_acls[acls_id] = compile(acls);
     max_acl_id = std::max(acls_id + 1, max_acl_id); /// max_acl_id pointer next slot
+    ++version;
 }
 
 void ACLMap::addUsage(uint64_t acl_id, uint64_t count)
@@ -118,10 +122,53 @@ void ACLMap::removeUsage(uint64_t acl_id)
     {
         auto acls = num_to_acl[acl_id];
         num_to_acl.erase(acl_id);
+        num_to_compiled_acls.erase(acl_id);
         acl_to_num.erase(acls);
         usage_counter.erase(acl_id);
     }
 }
+
+ACLMap::CompiledACLs ACLMap::compile(const Coordination::ACLs & acls)
+{
+    CompiledACLs compiled;
+    for (const auto & acl : acls)
+    {
+        if (acl.scheme == "world" && acl.id == "anyone")
+            compiled.world_permissions |= acl.permissions;
+        else
+            compiled.token_permissions.emplace_back(getAuthToken(acl.scheme, acl.id), acl.permissions);
+    }
+    return compiled;
+}
+
+UInt32 ACLMap::getAuthToken(const String & scheme, const String & id)
+{
+    String key;
+    key.reserve(scheme.size() + 1 + id.size());
+    key.append(scheme).push_back('\0');
+    key.append(id);
+
+    std::lock_guard lock(acl_mutex);
+    return auth_tokens.try_emplace(std::move(key), auth_tokens.size()).first->second;
+}
+
+int32_t ACLMap::getPermissions(uint64_t acls_id, const std::vector<UInt32> & tokens) const
+{
+    if (acls_id == 0)
+        return Coordination::ACL::All;
+
+    std::lock_guard lock(acl_mutex);
+
+    auto it = num_to_compiled_acls.find(acls_id);
+    if (it == num_to_compiled_acls.end())
+        throw Exception(ErrorCodes::LOGICAL_ERROR, "Unknown ACL id {}. It's a bug", acls_id);
+
+    int32_t permissions = it->second.world_permissions;
+    for (const auto & [token, token_permissions] : it->second.token_permissions)
+        if (std::find(tokens.begin(), tokens.end(), token) != tokens.end())
+            permissions |= token_permissions;
+    return permissions;
+}
 bool ACLMap::operator==(const ACLMap & rhs) const
 {
     if (acl_to_num.size() != rhs.acl_to_num.size())
@@ -148,8 +195,44 @@ void ACLMap::reset()
     std::lock_guard lock(acl_mutex);
     acl_to_num.clear();
     num_to_acl.clear();
+    num_to_compiled_acls.clear();
     usage_counter.clear();
     max_acl_id = 1;
+    ++version;
+}
+
+SessionPermissions::SessionPermissions(ACLMap & acl_map_, const Coordination::AuthIDs & auth_ids)
+    : acl_map(acl_map_), acl_map_version(acl_map_.getVersion())
+{
+    for (const auto & auth_id : auth_ids)
+    {
+        if (auth_id.scheme == "super")
+            is_super = true;
+        auth_tokens.push_back(acl_map_.getAuthToken(auth_id.scheme, auth_id.id));
+    }
+}
+
+int32_t SessionPermissions::get(uint64_t acl_id) const
+{
+    if (acl_id == 0 || is_super)
+        return Coordination::ACL::All;
+
+    auto version = acl_map.getVersion();
+    if (version != acl_map_version.load(std::memory_order_acquire))
+    {
+        for (auto & slot : slots)
+            slot.store(0, std::memory_order_relaxed);
+        acl_map_version.store(version, std::memory_order_release);
+    }
+
+    auto & slot = slots[acl_id % SLOT_NUM];
+    UInt64 value = slot.load(std::memory_order_acquire);
+    if ((value & 1) && (value >> PERMISSIONS_BITS) == acl_id)
+        return static_cast<int32_t>((value >> 1) & Coordination::ACL::All);
+
+    int32_t permissions = acl_map.getPermissions(acl_id, auth_tokens) & Coordination::ACL::All;
+    slot.store(acl_id << PERMISSIONS_BITS | static_cast<UInt64>(permissions) << 1 | 1, std::memory_order_release);
+    return permissions;
 }
 
 }
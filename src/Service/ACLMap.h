@@ -1,4 +1,6 @@
 #pragma once
+#include <array>
+#include <atomic>
 #include <unordered_map>
 #include <ZooKeeper/IKeeper.h>
 #include <ZooKeeper/ZooKeeperCommon.h>
@@ -28,12 +30,33 @@ private:
 
     using UsageCounter = std::unordered_map<uint64_t, uint64_t>;
 
+    /// ACLs compiled for checking permissions, scheme and id of ACLs are interned into tokens.
+    struct CompiledACLs
+    {
+        /// Permissions granted to anyone by 'world:anyone'.
+        int32_t world_permissions = 0;
+        /// Permissions granted to auth identities.
+        std::vector<std::pair<UInt32, int32_t>> token_permissions;
+    };
+
+    using NumToCompiledACLsMap = std::unordered_map<uint64_t, CompiledACLs>;
+
     ACLToNumMap acl_to_num;
     NumToACLMap num_to_acl;
+    NumToCompiledACLsMap num_to_compiled_acls;
     UsageCounter usage_counter;
     mutable std::recursive_mutex acl_mutex;
     uint64_t max_acl_id{1};
 
+    /// Tokens of auth identities, keyed by scheme and id separated by '\0'. Never cleared, so that
+    /// tokens held by sessions are always valid.
+    std::unordered_map<String, UInt32> auth_tokens;
+
+    /// Increased when an existing ACL id may be mapped to other ACLs.
+    std::atomic<UInt64> version{0};
+
+    CompiledACLs compile(const Coordination::ACLs & acls);
+
 public:
     /// Convert ACL to number. If it's new ACL than adds it to map
     /// with new id.
@@ -62,10 +85,49 @@ public:
     void addUsage(uint64_t acl_id, uint64_t count = 1);
     void removeUsage(uint64_t acl_id);
 
+    /// Intern auth identity into a token, the same identity always gets the same token.
+    UInt32 getAuthToken(const String & scheme, const String & id);
+
+    /// Permissions granted on ACL id to the auth identities of the tokens. If id is unknown for map
+    /// than throws LOGICAL ERROR
+    int32_t getPermissions(uint64_t acls_id, const std::vector<UInt32> & tokens) const;
+
+    /// Permissions got by ids are valid until version changes, ids are never remapped when new ACLs are added.
+    UInt64 getVersion() const { return version.load(std::memory_order_acquire); }
+
     bool operator==(const ACLMap & rhs) const;
     bool operator!=(const ACLMap & rhs) const;
 
     void reset();
 };
 
+/** Permissions granted to a session with its auth identities, cached by ACL id so that checking
+  * permissions does not copy ACLs or compare strings. The cache is direct-mapped and lock-free.
+  *
+  * Must be recreated when auth identities of the session change. Cached permissions are dropped
+  * when version of ACL map changes, which should not happen at the same time with checking.
+  */
+class SessionPermissions
+{
+public:
+    SessionPermissions(ACLMap & acl_map_, const Coordination::AuthIDs & auth_ids);
+
+    /// Permissions granted on nodes with the ACL id.
+    int32_t get(uint64_t acl_id) const;
+
+    bool check(uint64_t acl_id, int32_t permission) const { return get(acl_id) & permission; }
+
+private:
+    static constexpr size_t SLOT_NUM = 64;
+    /// A slot holds acl_id << PERMISSIONS_BITS | permissions << 1 | 1, 0 means empty.
+    static constexpr size_t PERMISSIONS_BITS = 6;
+
+    const ACLMap & acl_map;
+    bool is_super = false;
+    std::vector<UInt32> auth_tokens;
+
+    mutable std::atomic<UInt64> acl_map_version;
+    mutable std::array<std::atomic<UInt64>, SLOT_NUM> slots{};
+};
+
 }
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <Service/AdaptiveBatchPolicy.h>
+
+namespace RK
+{
+
+AdaptiveBatchPolicy::AdaptiveBatchPolicy(UInt64 max_batch_size_, UInt64 max_batch_bytes_, UInt64 target_latency_ms_)
+    : max_batch_size(std::max(max_batch_size_, static_cast<UInt64>(1)))
+    , max_batch_bytes(max_batch_bytes_ ? max_batch_bytes_ : std::numeric_limits<UInt64>::max())
+    , target_latency_ms(target_latency_ms_)
+    , min_batch_size(std::min(max_batch_size, MIN_BATCH_SIZE))
+    , batch_size_limit(max_batch_size)
+{
+}
+
+void AdaptiveBatchPolicy::onBatchFlushed(size_t batch_size, bool full, size_t lingered, size_t queue_depth)
+{
+    if (!target_latency_ms || !batch_size)
+        return;
+
+    ++flushes;
+    full_flushes += full;
+    lingered_requests += lingered;
+
+    if (flushes >= ADJUST_INTERVAL)
+        adjust(queue_depth);
+}
+
+void AdaptiveBatchPolicy::onBatchCommitted(UInt64 latency_ms)
+{
+    std::lock_guard lock(latency_mutex);
+    latencies[latency_count % LATENCY_SAMPLES] = latency_ms;
+    ++latency_count;
+}
+
+UInt64 AdaptiveBatchPolicy::getLatencyP99() const
+{
+    std::vector<UInt64> samples;
+    {
+        std::lock_guard lock(latency_mutex);
+        samples.assign(latencies.begin(), latencies.begin() + std::min(latency_count, LATENCY_SAMPLES));
+    }
+
+    if (samples.empty())
+        return 0;
+
+    auto p99 = samples.begin() + samples.size() * 99 / 100;
+    std::nth_element(samples.begin(), p99, samples.end());
+    return *p99;
+}
+
+void AdaptiveBatchPolicy::adjust(size_t queue_depth)
+{
+    UInt64 latency = getLatencyP99();
+    bool backlogged = full_flushes * 2 >= flushes || queue_depth >= batch_size_limit;
+
+    if (backlogged)
+        batch_size_limit = std::min(batch_size_limit * 2, max_batch_size);
+    else if (latency > target_latency_ms)
+        batch_size_limit = std::max(batch_size_limit * 3 / 4, min_batch_size);
+
+    if (latency > target_latency_ms)
+    {
+        linger_time_us /= 2;
+    }
+    else if (!backlogged)
+    {
+        /// Start lingering, or keep it up if it collected requests for at least half of batches.
+        if (linger_time_us == 0 || lingered_requests * 2 >= flushes)
+            linger_time_us += LINGER_STEP_US;
+        else
+            linger_time_us /= 2;
+
+        /// Lingering may take half of the latency headroom at most.
+        linger_time_us = std::min(linger_time_us, (target_latency_ms - latency) * 1000 / 2);
+    }
+
+    if (linger_time_us < LINGER_STEP_US / 4)
+        linger_time_us = 0;
+
+    flushes = 0;
+    full_flushes = 0;
+    lingered_requests = 0;
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+
+#include <common/types.h>
+
+namespace RK
+{
+
+/** Decides when RequestAccumulator flushes a batch to Raft.
+  *
+  * A batch is flushed when it reaches batch size limit or max_batch_bytes, or when the requests queue is
+  * empty and the batch has lingered for linger time. The limit and linger time are adjusted every
+  * ADJUST_INTERVAL flushed batches, from p99 of recent commit latencies (append to commit) and queue depth:
+  *  - when requests are backlogged, batch size limit is doubled, larger batches amortize Raft round and fsync;
+  *  - when latency is above target and requests are not backlogged, batches themselves are too expensive,
+  *    batch size limit is decreased and lingering is backed off;
+  *  - otherwise linger time grows by LINGER_STEP_US within latency headroom while lingering does collect
+  *    more requests, which merges the tiny batches of moderate load, and backs off when it does not.
+  *
+  * target_latency_ms 0 disables adjusting, batches are flushed at max_batch_size without lingering.
+  */
+class AdaptiveBatchPolicy
+{
+public:
+    static constexpr size_t ADJUST_INTERVAL = 32;
+    static constexpr size_t LATENCY_SAMPLES = 128;
+    static constexpr UInt64 MIN_BATCH_SIZE = 16;
+    static constexpr UInt64 LINGER_STEP_US = 100;
+
+    AdaptiveBatchPolicy(UInt64 max_batch_size_, UInt64 max_batch_bytes_, UInt64 target_latency_ms_);
+
+    bool isFull(size_t batch_size, size_t batch_bytes) const
+    {
+        return batch_size >= batch_size_limit || batch_bytes >= max_batch_bytes;
+    }
+
+    UInt64 getBatchSizeLimit() const { return batch_size_limit; }
+    UInt64 getLingerTimeUs() const { return linger_time_us; }
+
+    /// Called by accumulator thread when a batch is flushed.
+    /// lingered -- requests got while lingering, queue_depth -- requests left in queue
+    void onBatchFlushed(size_t batch_size, bool full, size_t lingered, size_t queue_depth);
+
+    /// Called by Raft threads when an appended batch gets result.
+    void onBatchCommitted(UInt64 latency_ms);
+
+    /// p99 of recent commit latencies, 0 if there is none
+    UInt64 getLatencyP99() const;
+
+private:
+    void adjust(size_t queue_depth);
+
+    const UInt64 max_batch_size;
+    const UInt64 max_batch_bytes;
+    const UInt64 target_latency_ms;
+    const UInt64 min_batch_size;
+
+    UInt64 batch_size_limit;
+    UInt64 linger_time_us = 0;
+
+    /// Statistics since last adjusting
+    size_t flushes = 0;
+    size_t full_flushes = 0;
+    size_t lingered_requests = 0;
+
+    mutable std::mutex latency_mutex;
+    std::array<UInt64, LATENCY_SAMPLES> latencies{};
+    size_t latency_count = 0;
+};
+
+}
@@ -0,0 +1,77 @@
+#include <Service/AppendEntriesWindow.h>
+
+namespace RK
+{
+
+AppendEntriesWindow::AppendEntriesWindow(size_t max_inflight_, ResultHandler handler_)
+    : max_inflight(std::max(max_inflight_, static_cast<size_t>(1))), handler(std::move(handler_))
+{
+}
+
+bool AppendEntriesWindow::waitForRoom(UInt64 timeout_ms)
+{
+    std::unique_lock lock(mutex);
+    return cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return batches.size() < max_inflight; });
+}
+
+AppendEntriesWindow::BatchPtr AppendEntriesWindow::add(RequestsForSessions && requests, UInt64 now_ms)
+{
+    auto batch = std::make_shared<Batch>();
+    batch->requests = std::move(requests);
+    batch->append_time_ms = now_ms;
+
+    std::lock_guard lock(mutex);
+    batches.push_back(batch);
+    return batch;
+}
+
+void AppendEntriesWindow::finish(const BatchPtr & batch, bool accepted, nuraft::cmd_result_code code)
+{
+    {
+        std::lock_guard lock(mutex);
+        if (batch->finished)
+            return;
+        batch->finished = true;
+        batches.remove(batch);
+    }
+    cv.notify_all();
+
+    handler(batch->requests, accepted, code);
+}
+
+void AppendEntriesWindow::expire(UInt64 now_ms, UInt64 timeout_ms)
+{
+    std::vector<BatchPtr> expired;
+    {
+        std::lock_guard lock(mutex);
+        for (const auto & batch : batches)
+        {
+            if (batch->append_time_ms + timeout_ms > now_ms)
+                break;
+            expired.push_back(batch);
+        }
+    }
+
+    for (const auto & batch : expired)
+        finish(batch, true, nuraft::cmd_result_code::TIMEOUT);
+}
+
+void AppendEntriesWindow::cancelAll()
+{
+    std::vector<BatchPtr> cancelled;
+    {
+        std::lock_guard lock(mutex);
+        cancelled.assign(batches.begin(), batches.end());
+    }
+
+    for (const auto & batch : cancelled)
+        finish(batch, false, nuraft::cmd_result_code::CANCELLED);
+}
+
+size_t AppendEntriesWindow::size() const
+{
+    std::lock_guard lock(mutex);
+    return batches.size();
+}
+
+}
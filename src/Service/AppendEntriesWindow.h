@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+
+#include <libnuraft/nuraft.hxx>
+
+#include <Service/KeeperCommon.h>
+
+namespace RK
+{
+
+/** Batches of write requests appended to Raft and not committed yet.
+  *
+  * RequestAccumulator appends a new batch without waiting for the previous ones to be committed,
+  * as long as there are less than max_inflight batches in the window. So batches are replicated in
+  * pipeline, and the order of requests is still the order of Raft log.
+  *
+  * Results of batches arrive out of band from Raft threads, the result handler is invoked exactly
+  * once for every batch, with the first result of it.
+  */
+class AppendEntriesWindow
+{
+public:
+    using ResultHandler = std::function<void(const RequestsForSessions & batch, bool accepted, nuraft::cmd_result_code code)>;
+
+    struct Batch
+    {
+        RequestsForSessions requests;
+        UInt64 append_time_ms;
+        bool finished = false;
+    };
+    using BatchPtr = std::shared_ptr<Batch>;
+
+    AppendEntriesWindow(size_t max_inflight_, ResultHandler handler_);
+
+    /// Wait until the window has room for a new batch, return false if timeout.
+    bool waitForRoom(UInt64 timeout_ms);
+
+    BatchPtr add(RequestsForSessions && requests, UInt64 now_ms);
+
+    /// Remove the batch from window and invoke result handler, only the first result of a batch counts.
+    void finish(const BatchPtr & batch, bool accepted, nuraft::cmd_result_code code);
+
+    /// Finish batches appended before now_ms - timeout_ms with TIMEOUT, they may never be committed,
+    /// for example leader lost quorum.
+    void expire(UInt64 now_ms, UInt64 timeout_ms);
+
+    /// Finish all batches with CANCELLED.
+    void cancelAll();
+
+    size_t size() const;
+
+private:
+    size_t max_inflight;
+    ResultHandler handler;
+
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    /// In append order
+    std::list<BatchPtr> batches;
+};
+
+}
@@ -1,4 +1,7 @@
 #include <algorithm>
+#include <array>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <Poco/Net/NetException.h>
 #include <Common/Stopwatch.h>
@@ -17,6 +20,7 @@ namespace ErrorCodes
     extern const int UNEXPECTED_PACKET_FROM_CLIENT;
     extern const int TIMEOUT_EXCEEDED;
     extern const int LOGICAL_ERROR;
+    extern const int CANNOT_WRITE_TO_SOCKET;
 }
 
 std::mutex ConnectionHandler::conns_mutex;
@@ -256,12 +260,12 @@ void ConnectionHandler::onSocketWritable(const Notification &)
     auto remove_event_handler_if_needed = [this]
     {
         /// Double check to avoid dead lock
-        if (responses->empty() && send_buf.isEmpty() && !out_buffer)
+        if (responses->empty() && send_buf.isEmpty() && !out_response)
         {
             std::lock_guard lock(send_response_mutex);
             {
                 /// If all sent, unregister writable event.
-                if (responses->empty() && send_buf.isEmpty() && !out_buffer)
+                if (responses->empty() && send_buf.isEmpty() && !out_response)
                 {
                     LOG_TRACE(log, "Remove socket writable event handler for peer {}", peer);
                     socket_writable_event_registered = false;
@@ -272,28 +276,13 @@ void ConnectionHandler::onSocketWritable(const Notification &)
         }
     };
 
-    auto copy_buffer_to_send = [this]
-    {
-        auto used = send_buf.used();
-        if (used + out_buffer->available() <= SENT_BUFFER_SIZE)
-        {
-            send_buf.write(out_buffer->position(), out_buffer->available());
-            out_buffer.reset();
-        }
-        else
-        {
-            send_buf.write(out_buffer->position(), SENT_BUFFER_SIZE - used);
-            out_buffer->seek(SENT_BUFFER_SIZE - used, SEEK_CUR);
-        }
-    };
-
     try
     {
-        /// If the buffer was not completely sent last time, continue sending.
-        if (out_buffer)
-            copy_buffer_to_send();
+        /// If the response was not completely sent last time, continue sending.
+        if (out_response)
+            copyResponseToSendBuffer();
 
-        while (!responses->empty() && send_buf.available())
+        while (!out_response && !responses->empty() && send_buf.available())
         {
             Coordination::ZooKeeperResponsePtr response;
 
@@ -314,24 +303,31 @@ void ConnectionHandler::onSocketWritable(const Notification &)
                     LOG_ERROR(log, "Failed to establish session, close connection.");
                     sock.setBlocking(true);
                     sock.sendBytes(send_buf);
-                    sock.sendBytes(out_buffer->position(), out_buffer->available());
+                    sock.sendBytes(out_response->head.data(), out_response->head.size());
 
                     destroyMe();
                     return;
                 }
-                copy_buffer_to_send();
+                copyResponseToSendBuffer();
             }
             else
             {
-                WriteBufferFromOwnString buf;
-                response->writeNoCopy(buf);
-                out_buffer = std::make_shared<ReadBufferFromOwnString>(std::move(buf.str()));
-                copy_buffer_to_send();
+                out_response.emplace();
+                out_offset = 0;
+                response->writeNoCopy(*out_response);
+                copyResponseToSendBuffer();
+            }
+
+            size_t packets = 1;
+            if (response->xid == Coordination::WATCH_XID)
+            {
+                if (const auto * watch_responses = dynamic_cast<const Coordination::ZooKeeperWatchResponses *>(response.get()))
+                    packets = watch_responses->responses.size();
             }
-            packageSent();
+            packageSent(packets);
         }
 
-        size_t sent = sock.sendBytes(send_buf);
+        size_t sent = out_response && !out_response->payload.empty() ? sendWithPayload() : sock.sendBytes(send_buf);
         Metrics::getMetrics().response_socket_send_size->add(sent);
 
         remove_event_handler_if_needed();
@@ -343,6 +339,75 @@ void ConnectionHandler::onSocketWritable(const Notification &)
     }
 }
 
+void ConnectionHandler::copyResponseToSendBuffer()
+{
+    const auto & head = out_response->head;
+    if (out_offset < head.size())
+    {
+        size_t size = std::min(head.size() - out_offset, send_buf.available());
+        send_buf.write(head.data() + out_offset, size);
+        out_offset += size;
+        if (out_offset < head.size())
+            return;
+    }
+
+    /// Payload and tail are sent by sendWithPayload.
+    if (!out_response->payload.empty())
+        return;
+
+    out_response.reset();
+}
+
+size_t ConnectionHandler::sendWithPayload()
+{
+    std::array<iovec, 4> iov{};
+    size_t iov_num = 0;
+    auto add_iov = [&](const char * data, size_t size)
+    {
+        if (size)
+            iov[iov_num++] = {const_cast<char *>(data), size};
+    };
+
+    add_iov(send_buf.begin(), send_buf.used());
+
+    size_t offset = out_offset;
+    for (std::string_view part : {std::string_view(out_response->head), out_response->payload.view(), std::string_view(out_response->tail)})
+    {
+        if (offset < part.size())
+            add_iov(part.data() + offset, part.size() - offset);
+        offset -= std::min(offset, part.size());
+    }
+
+    msghdr msg{};
+    msg.msg_iov = iov.data();
+    msg.msg_iovlen = iov_num;
+
+#if defined(MSG_NOSIGNAL)
+    ssize_t res = ::sendmsg(sock.impl()->sockfd(), &msg, MSG_NOSIGNAL);
+#else
+    ssize_t res = ::sendmsg(sock.impl()->sockfd(), &msg, 0);
+#endif
+
+    if (res < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return 0;
+        throwFromErrno("Cannot send response to " + peer, ErrorCodes::CANNOT_WRITE_TO_SOCKET);
+    }
+
+    size_t sent = res;
+    size_t sent_from_buf = std::min(sent, send_buf.used());
+    /// Note that drain(0) empties the buffer.
+    if (sent_from_buf)
+        send_buf.drain(sent_from_buf);
+
+    out_offset += sent - sent_from_buf;
+    if (out_offset == out_response->size())
+        out_response.reset();
+
+    return sent;
+}
+
 void ConnectionHandler::onReactorShutdown(const Notification &)
 {
     LOG_INFO(log, "Reactor of peer {} shutdown!", peer);
@@ -523,7 +588,9 @@ bool ConnectionHandler::sendHandshake(const Coordination::ZooKeeperResponsePtr &
     std::array<char, Coordination::PASSWORD_LENGTH> passwd{};
     Coordination::write(passwd, buf);
 
-    out_buffer = std::make_shared<ReadBufferFromOwnString>(std::move(buf.str()));
+    out_response.emplace();
+    out_response->head = std::move(buf.str());
+    out_offset = 0;
 
     return success;
 }
@@ -629,7 +696,7 @@ void ConnectionHandler::sendSessionResponseToClient(const Coordination::ZooKeepe
         auto response_callback = [this](const Coordination::ZooKeeperResponsePtr & response_) { pushUserResponseToSendingQueue(response_); };
 
         bool is_reconnected = response->getOpNum() == Coordination::OpNum::UpdateSession;
-        keeper_dispatcher->registerUserResponseCallBackWithoutLock(sid, response_callback, is_reconnected);
+        keeper_dispatcher->registerUserResponseCallBack(sid, response_callback, is_reconnected);
     }
 
     // Send response to client
@@ -671,10 +738,10 @@ void ConnectionHandler::pushUserResponseToSendingQueue(const Coordination::ZooKe
     }
 }
 
-void ConnectionHandler::packageSent()
+void ConnectionHandler::packageSent(size_t count)
 {
-    conn_stats.incrementPacketsSent();
-    keeper_dispatcher->incrementPacketsSent();
+    conn_stats.incrementPacketsSent(count);
+    keeper_dispatcher->incrementPacketsSent(count);
 }
 
 void ConnectionHandler::packageReceived()
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <optional>
 #include <unordered_set>
 
 #include <Poco/Delegate.h>
@@ -83,7 +84,7 @@ private:
     void sendSessionResponseToClient(const Coordination::ZooKeeperResponsePtr & response);
 
     /// do some statistics
-    void packageSent();
+    void packageSent(size_t count = 1);
     void packageReceived();
 
     /// do some statistics
@@ -92,6 +93,11 @@ private:
     /// destroy connection
     void destroyMe();
 
+    /// Copy out_response into send_buf as much as possible, except its payload.
+    void copyResponseToSendBuffer();
+    /// Send send_buf followed by the rest of out_response, whose payload is sent without copying.
+    size_t sendWithPayload();
+
     // Todo Add configuration sent_buffer_size
     static constexpr size_t SENT_BUFFER_SIZE = 16384;
     FIFOBuffer send_buf = FIFOBuffer(SENT_BUFFER_SIZE);
@@ -99,7 +105,10 @@ private:
     /// Storing the result of the response serialization temporarily,
     /// We cannot directly serialize it onto send_buf，
     /// because `send_buf` maybe too small to hold a large size response.
-    std::shared_ptr<ReadBufferFromOwnString> out_buffer;
+    /// Large payload such as node data is never copied, but sent by scatter-gather IO.
+    std::optional<Coordination::ZooKeeperResponseBuffers> out_response;
+    /// Bytes of out_response which are copied into send_buf or sent.
+    size_t out_offset = 0;
 
     Logger * log;
 
@@ -42,9 +42,9 @@ void ConnectionStats::incrementPacketsReceived()
     packets_received++;
 }
 
-void ConnectionStats::incrementPacketsSent()
+void ConnectionStats::incrementPacketsSent(uint64_t count)
 {
-    packets_sent++;
+    packets_sent += count;
 }
 
 void ConnectionStats::updateLatency(uint64_t latency_ms)
@@ -24,7 +24,7 @@ public:
     uint64_t getPacketsSent() const;
 
     void incrementPacketsReceived();
-    void incrementPacketsSent();
+    void incrementPacketsSent(uint64_t count = 1);
 
     void updateLatency(uint64_t latency_ms);
     void reset();
@@ -0,0 +1,153 @@
+#include <Service/DataTreeMemoryTracker.h>
+
+#include <algorithm>
+
+namespace RK
+{
+
+DataTreeMemoryUsage & DataTreeMemoryUsage::operator+=(const DataTreeMemoryUsage & rhs)
+{
+    node_count += rhs.node_count;
+    key_bytes += rhs.key_bytes;
+    data_bytes += rhs.data_bytes;
+    children_bytes += rhs.children_bytes;
+    acl_references += rhs.acl_references;
+    return *this;
+}
+
+DataTreeMemoryUsage & DataTreeMemoryUsage::operator-=(const DataTreeMemoryUsage & rhs)
+{
+    node_count -= rhs.node_count;
+    key_bytes -= rhs.key_bytes;
+    data_bytes -= rhs.data_bytes;
+    children_bytes -= rhs.children_bytes;
+    acl_references -= rhs.acl_references;
+    return *this;
+}
+
+DataTreeMemoryTracker::DataTreeMemoryTracker(size_t subtree_depth_) : subtree_depth(std::max<size_t>(subtree_depth_, 1))
+{
+}
+
+DataTreeMemoryUsage DataTreeMemoryTracker::measure(std::string_view path, KeeperNode & node)
+{
+    node.accounted_data_bytes = node.data.size();
+    node.accounted_children_bytes = node.children.allocatedBytes();
+    return accounted(path, node);
+}
+
+DataTreeMemoryUsage DataTreeMemoryTracker::accounted(std::string_view path, const KeeperNode & node)
+{
+    DataTreeMemoryUsage usage;
+    usage.node_count = 1;
+    usage.key_bytes = path.size();
+    usage.data_bytes = node.accounted_data_bytes;
+    usage.children_bytes = node.accounted_children_bytes;
+    usage.acl_references = node.acl_id != 0;
+    return usage;
+}
+
+void DataTreeMemoryTracker::add(std::string_view path, KeeperNode & node)
+{
+    applyDelta(path, measure(path, node), true);
+}
+
+void DataTreeMemoryTracker::remove(std::string_view path, const KeeperNode & node)
+{
+    applyDelta(path, accounted(path, node), false);
+}
+
+void DataTreeMemoryTracker::update(std::string_view path, KeeperNode & node)
+{
+    DataTreeMemoryUsage delta;
+    delta.data_bytes = static_cast<Int64>(node.data.size()) - node.accounted_data_bytes;
+    delta.children_bytes = static_cast<Int64>(node.children.allocatedBytes()) - node.accounted_children_bytes;
+
+    if (delta.data_bytes == 0 && delta.children_bytes == 0)
+        return;
+
+    node.accounted_data_bytes = node.data.size();
+    node.accounted_children_bytes = node.children.allocatedBytes();
+    applyDelta(path, delta, true);
+}
+
+void DataTreeMemoryTracker::updateACL(std::string_view path, uint64_t prev_acl_id, uint64_t acl_id)
+{
+    DataTreeMemoryUsage delta;
+    delta.acl_references = static_cast<Int64>(acl_id != 0) - static_cast<Int64>(prev_acl_id != 0);
+    if (delta.acl_references != 0)
+        applyDelta(path, delta, true);
+}
+
+void DataTreeMemoryTracker::applyDelta(std::string_view path, const DataTreeMemoryUsage & delta, bool add)
+{
+    auto subtree = getSubtree(path);
+
+    std::lock_guard lock(mutex);
+    auto it = subtrees.find(subtree);
+    if (it == subtrees.end())
+        it = subtrees.emplace(String(subtree), DataTreeMemoryUsage{}).first;
+
+    if (add)
+    {
+        total += delta;
+        it->second += delta;
+    }
+    else
+    {
+        total -= delta;
+        it->second -= delta;
+    }
+
+    if (it->second.node_count == 0)
+        subtrees.erase(it);
+}
+
+void DataTreeMemoryTracker::reset()
+{
+    std::lock_guard lock(mutex);
+    total = {};
+    subtrees.clear();
+}
+
+void DataTreeMemoryTracker::rebuild(const IDataTree & data_tree)
+{
+    reset();
+    for (UInt32 bucket_id = 0; bucket_id < data_tree.getBucketNum(); ++bucket_id)
+        data_tree.forEach(bucket_id, [this](const String & path, const KeeperNodePtr & node) { add(path, *node); });
+}
+
+DataTreeMemoryUsage DataTreeMemoryTracker::getTotal() const
+{
+    std::lock_guard lock(mutex);
+    return total;
+}
+
+DataTreeMemoryTracker::SubtreeUsages DataTreeMemoryTracker::getTopSubtrees(size_t n) const
+{
+    SubtreeUsages result;
+    {
+        std::lock_guard lock(mutex);
+        result.assign(subtrees.begin(), subtrees.end());
+    }
+
+    auto greater = [](const auto & lhs, const auto & rhs) { return lhs.second.totalBytes() > rhs.second.totalBytes(); };
+    n = std::min(n, result.size());
+    std::partial_sort(result.begin(), result.begin() + n, result.end(), greater);
+    result.resize(n);
+    return result;
+}
+
+std::string_view DataTreeMemoryTracker::getSubtree(std::string_view path) const
+{
+    size_t end = 0;
+    for (size_t i = 0; i < subtree_depth; ++i)
+    {
+        end = path.find('/', end + 1);
+        if (end == std::string_view::npos)
+            return path;
+    }
+    return path.substr(0, end);
+}
+
+}
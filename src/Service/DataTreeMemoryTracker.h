@@ -0,0 +1,91 @@
+#pragma once
+
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <Service/KeeperDataTree.h>
+#include <common/types.h>
+
+namespace RK
+{
+
+/// Memory used by the nodes of data tree, or of a subtree of it.
+struct DataTreeMemoryUsage
+{
+    Int64 node_count = 0;
+    /// Full paths of nodes.
+    Int64 key_bytes = 0;
+    Int64 data_bytes = 0;
+    /// Buffers of children sets.
+    Int64 children_bytes = 0;
+    /// Nodes referencing an ACL in ACL map, nodes with default ACL are not counted.
+    Int64 acl_references = 0;
+
+    /// Node objects, which include ACL ids and stats, plus keys, data and children.
+    Int64 totalBytes() const { return node_count * static_cast<Int64>(sizeof(KeeperNode)) + key_bytes + data_bytes + children_bytes; }
+
+    DataTreeMemoryUsage & operator+=(const DataTreeMemoryUsage & rhs);
+    DataTreeMemoryUsage & operator-=(const DataTreeMemoryUsage & rhs);
+};
+
+/** Keep memory usage of data tree up to date, both in total and rolled up by subtrees.
+  *
+  * A subtree is identified by the first subtree_depth components of paths, for example with depth 3
+  * all nodes under /clickhouse/tables/db1 are accounted to "/clickhouse/tables/db1", and nodes
+  * shallower than that are accounted to themselves.
+  *
+  * What is accounted for a node is remembered in the node, so removing it subtracts exactly what was
+  * added, and a modified node must be updated to account the difference. Overheads of allocators and
+  * of the data tree engine are not included, see KeeperNodeArena for the former.
+  *
+  * Thread-safe.
+  */
+class DataTreeMemoryTracker
+{
+public:
+    using SubtreeUsages = std::vector<std::pair<String, DataTreeMemoryUsage>>;
+
+    explicit DataTreeMemoryTracker(size_t subtree_depth_);
+
+    /// A node is added into data tree, or replaces another one which must be removed first.
+    void add(std::string_view path, KeeperNode & node);
+    void remove(std::string_view path, const KeeperNode & node);
+    /// Data or children of a node in data tree are modified.
+    void update(std::string_view path, KeeperNode & node);
+    /// ACL of a node in data tree is changed.
+    void updateACL(std::string_view path, uint64_t prev_acl_id, uint64_t acl_id);
+
+    void reset();
+    /// Account all nodes from scratch, used after loading snapshot.
+    void rebuild(const IDataTree & data_tree);
+
+    DataTreeMemoryUsage getTotal() const;
+    /// Subtrees in descending order of total bytes.
+    SubtreeUsages getTopSubtrees(size_t n) const;
+
+    std::string_view getSubtree(std::string_view path) const;
+
+private:
+    struct StringHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view str) const { return std::hash<std::string_view>()(str); }
+    };
+
+    /// What should be accounted for a node now, also saved into the node.
+    static DataTreeMemoryUsage measure(std::string_view path, KeeperNode & node);
+    /// What was accounted for a node.
+    static DataTreeMemoryUsage accounted(std::string_view path, const KeeperNode & node);
+
+    void applyDelta(std::string_view path, const DataTreeMemoryUsage & delta, bool add);
+
+    const size_t subtree_depth;
+
+    mutable std::mutex mutex;
+    DataTreeMemoryUsage total;
+    std::unordered_map<String, DataTreeMemoryUsage, StringHash, std::equal_to<>> subtrees;
+};
+
+}
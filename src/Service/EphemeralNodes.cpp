@@ -0,0 +1,92 @@
+#include <Service/EphemeralNodes.h>
+
+namespace RK
+{
+
+void EphemeralNodes::add(int64_t session_id, const String & path, KeeperNode & node)
+{
+    std::lock_guard lock(mutex);
+    auto & session = sessions[session_id];
+
+    if (session.free_slots.empty())
+    {
+        node.ephemeral_slot = session.paths.size();
+        session.paths.push_back(path);
+    }
+    else
+    {
+        node.ephemeral_slot = session.free_slots.back();
+        session.free_slots.pop_back();
+        session.paths[node.ephemeral_slot] = path;
+    }
+    ++total_count;
+}
+
+void EphemeralNodes::remove(int64_t session_id, const KeeperNode & node)
+{
+    std::lock_guard lock(mutex);
+    auto it = sessions.find(session_id);
+    if (it == sessions.end() || node.ephemeral_slot >= it->second.paths.size() || it->second.paths[node.ephemeral_slot].empty())
+        return;
+
+    auto & session = it->second;
+    String().swap(session.paths[node.ephemeral_slot]);
+    session.free_slots.push_back(node.ephemeral_slot);
+    --total_count;
+
+    if (session.size() == 0)
+        sessions.erase(it);
+}
+
+Strings EphemeralNodes::extract(int64_t session_id)
+{
+    Strings paths;
+    {
+        std::lock_guard lock(mutex);
+        auto it = sessions.find(session_id);
+        if (it == sessions.end())
+            return paths;
+
+        total_count -= it->second.size();
+        paths = std::move(it->second.paths);
+        sessions.erase(it);
+    }
+
+    std::erase_if(paths, [](const String & path) { return path.empty(); });
+    return paths;
+}
+
+size_t EphemeralNodes::getSessionCount() const
+{
+    std::lock_guard lock(mutex);
+    return sessions.size();
+}
+
+size_t EphemeralNodes::getTotalCount() const
+{
+    std::lock_guard lock(mutex);
+    return total_count;
+}
+
+EphemeralNodes::Ephemerals EphemeralNodes::getAll() const
+{
+    Ephemerals result;
+    std::lock_guard lock(mutex);
+    for (const auto & [session_id, session] : sessions)
+    {
+        auto & paths = result[session_id];
+        for (const auto & path : session.paths)
+            if (!path.empty())
+                paths.insert(path);
+    }
+    return result;
+}
+
+void EphemeralNodes::clear()
+{
+    std::lock_guard lock(mutex);
+    sessions.clear();
+    total_count = 0;
+}
+
+}
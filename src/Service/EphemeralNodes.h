@@ -0,0 +1,58 @@
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <Service/KeeperDataTree.h>
+#include <common/types.h>
+
+namespace RK
+{
+
+/** Ephemeral nodes of sessions.
+  *
+  * Paths of a session are kept in slots of a vector and a node remembers its slot in
+  * KeeperNode::ephemeral_slot, so removing an ephemeral node does not hash its path, and closing
+  * a session takes all paths it owns at once. Slots of removed nodes are reused by new ones.
+  *
+  * Thread-safe.
+  */
+class EphemeralNodes
+{
+public:
+    using Ephemerals = std::unordered_map<int64_t, std::unordered_set<String>>;
+
+    void add(int64_t session_id, const String & path, KeeperNode & node);
+    /// Node must be added before, or be a copy of an added one. Does nothing if it is not found.
+    void remove(int64_t session_id, const KeeperNode & node);
+
+    /// Remove all ephemeral nodes of the session from the index, return their paths.
+    Strings extract(int64_t session_id);
+
+    /// Sessions which have ephemeral nodes.
+    size_t getSessionCount() const;
+    size_t getTotalCount() const;
+
+    /// Paths by session, used by introspection and tests.
+    Ephemerals getAll() const;
+
+    void clear();
+
+private:
+    struct SessionEphemerals
+    {
+        /// Empty path means a free slot.
+        Strings paths;
+        std::vector<UInt32> free_slots;
+
+        size_t size() const { return paths.size() - free_slots.size(); }
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<int64_t, SessionEphemerals> sessions;
+    size_t total_count = 0;
+};
+
+}
@@ -222,11 +222,8 @@ void ForwardConnectionHandler::processSyncSessionsRequest(ForwardRequestPtr requ
     auto * sync_sessions_req = dynamic_cast<ForwardSyncSessionsRequest *>(request.get());
     LOG_TRACE(log, "Receive {} remote sessions", sync_sessions_req->session_expiration_time.size());
 
-    for (auto [session_id, expiration_time] : sync_sessions_req->session_expiration_time)
-    {
-        LOG_TRACE(log, "Receive remote session {}, expiration time {}", toHexString(session_id), expiration_time);
-        keeper_dispatcher->handleRemoteSession(session_id, expiration_time);
-    }
+    /// Followers only send sessions changed since last sync, unchanged ones keep their expiration time.
+    keeper_dispatcher->handleRemoteSessions(sync_sessions_req->session_expiration_time);
 
     auto response = request->makeResponse();
     keeper_dispatcher->invokeForwardResponseCallBack({server_id, client_id}, response);
@@ -59,6 +59,9 @@ struct ForwardSyncSessionsRequest : public ForwardRequest
 {
     std::unordered_map<int64_t, int64_t> session_expiration_time;
 
+    /// Leader the sessions are sent to, not serialized.
+    int32_t leader{-1};
+
     ForwardSyncSessionsRequest() = default;
 
     explicit ForwardSyncSessionsRequest(std::unordered_map<int64_t, int64_t> && session_expiration_time_)
@@ -46,6 +46,17 @@ void ForwardSyncSessionsResponse::writeImpl(WriteBuffer &) const
 {
 }
 
+void ForwardSyncSessionsResponse::onError(RequestForwarder & request_forwarder) const
+{
+    request_forwarder.resyncSessions();
+}
+
+void ForwardSyncSessionsResponse::onSuccess(RequestForwarder & request_forwarder, const ForwardRequest & request) const
+{
+    const auto & sync_request = dynamic_cast<const ForwardSyncSessionsRequest &>(request);
+    request_forwarder.onSessionsSynced(sync_request.leader, sync_request.session_expiration_time);
+}
+
 bool ForwardSyncSessionsResponse::match(const ForwardRequestPtr & forward_request) const
 {
     return forward_request->forwardType() == forwardType();
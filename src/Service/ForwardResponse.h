@@ -16,7 +16,7 @@ enum class ForwardType : int8_t
 {
     Unknown = -1,
     Handshake = 1,         /// Forwarder handshake
-    SyncSessions = 2,      /// Follower will send all local sessions to leader periodically
+    SyncSessions = 2,      /// Follower will send local sessions changed since last sync to leader periodically
     NewSession = 3,        /// New session request
     UpdateSession = 4,     /// Update session request when client reconnecting
     User = 5,              /// All write requests after the connection is established
@@ -45,6 +45,8 @@ struct ForwardResponse
     virtual void writeImpl(WriteBuffer &) const = 0;
 
     virtual void onError(RequestForwarder & request_forwarder) const = 0;
+    /// Invoked when the response is accepted, request is the one it matches.
+    virtual void onSuccess(RequestForwarder &, const ForwardRequest &) const {}
     virtual bool match(const ForwardRequestPtr & forward_request) const = 0;
 
     void setAppendEntryResult(bool raft_accept, nuraft::cmd_result_code code)
@@ -88,7 +90,8 @@ struct ForwardSyncSessionsResponse : public ForwardResponse
     void readImpl(ReadBuffer &) override;
     void writeImpl(WriteBuffer &) const override;
 
-    void onError(RequestForwarder &) const override {}
+    void onError(RequestForwarder & request_forwarder) const override;
+    void onSuccess(RequestForwarder & request_forwarder, const ForwardRequest & request) const override;
     bool match(const ForwardRequestPtr & forward_request) const override;
 
     String toString() const override
@@ -150,6 +150,9 @@ void FourLetterCommandFactory::registerCommands(KeeperDispatcher & keeper_dispat
         FourLetterCommandPtr uptime_command = std::make_shared<UpTimeCommand>(keeper_dispatcher);
         factory.registerCommand(uptime_command);
 
+        FourLetterCommandPtr memory_by_subtree_command = std::make_shared<MemoryBySubtreeCommand>(keeper_dispatcher);
+        factory.registerCommand(memory_by_subtree_command);
+
 #if USE_JEMALLOC
         FourLetterCommandPtr jemalloc_dump_stats = std::make_shared<JemallocDumpStats>(keeper_dispatcher);
         factory.registerCommand(jemalloc_dump_stats);
@@ -272,6 +275,8 @@ String MonitorCommand::run()
 
     print(ret, "num_alive_connections", keeper_info.alive_connections_count);
     print(ret, "outstanding_requests", keeper_info.outstanding_requests_count);
+    for (size_t i = 0; i < keeper_info.response_queue_sizes.size(); ++i)
+        print(ret, "response_queue_size_" + std::to_string(i), keeper_info.response_queue_sizes[i]);
 
     print(ret, "server_state", keeper_info.getRole());
     print(ret, "is_leader", keeper_info.is_leader);
@@ -279,7 +284,26 @@ String MonitorCommand::run()
     print(ret, "znode_count", state_machine.getNodesCount());
     print(ret, "watch_count", state_machine.getTotalWatchesCount());
     print(ret, "ephemerals_count", state_machine.getTotalEphemeralNodesCount());
+    print(ret, "local_sessions", state_machine.getLocalSessionCount());
     print(ret, "approximate_data_size", state_machine.getApproximateDataSize());
+
+    auto memory_usage = state_machine.getDataTreeMemoryUsage();
+    print(ret, "data_tree_key_bytes", memory_usage.key_bytes);
+    print(ret, "data_tree_data_bytes", memory_usage.data_bytes);
+    print(ret, "data_tree_children_bytes", memory_usage.children_bytes);
+    print(ret, "data_tree_acl_references", memory_usage.acl_references);
+
+    const auto & response_cache = state_machine.getResponseCache();
+    print(ret, "response_cache_hits", response_cache.getHits());
+    print(ret, "response_cache_misses", response_cache.getMisses());
+    print(ret, "response_cache_entries", response_cache.getEntriesCount());
+    print(ret, "response_cache_size", response_cache.getSize());
+
+    auto arena_stats = state_machine.getNodeArenaStats();
+    print(ret, "node_arena_allocated_bytes", arena_stats.allocated_bytes);
+    print(ret, "node_arena_used_bytes", arena_stats.used_bytes);
+    print(ret, "node_arena_slab_count", arena_stats.slab_count);
+    print(ret, "node_arena_fragmentation_percent", static_cast<uint64_t>(arena_stats.fragmentation() * 100));
     print(ret, "in_snapshot", state_machine.isCreatingSnapshot());
 
 #if defined(__linux__) || defined(__APPLE__)
@@ -519,6 +543,24 @@ String UpTimeCommand::run()
     return std::to_string(keeper_dispatcher.uptimeFromStartup() / 1000 / 1000);
 }
 
+String MemoryBySubtreeCommand::run()
+{
+    StringBuffer buf;
+    const auto & state_machine = keeper_dispatcher.getStateMachine();
+
+    auto total = state_machine.getDataTreeMemoryUsage();
+    buf << "total_bytes " << total.totalBytes() << " node_count " << total.node_count << " key_bytes " << total.key_bytes
+        << " data_bytes " << total.data_bytes << " children_bytes " << total.children_bytes << " acl_references "
+        << total.acl_references << '\n';
+
+    for (const auto & [subtree, usage] : state_machine.getTopSubtreesByMemory(TOP_SUBTREE_NUM))
+    {
+        buf << subtree << '\t' << usage.totalBytes() << ' ' << usage.node_count << ' ' << usage.key_bytes << ' ' << usage.data_bytes
+            << ' ' << usage.children_bytes << ' ' << usage.acl_references << '\n';
+    }
+    return buf.str();
+}
+
 #if USE_JEMALLOC
 
 void printToString(void * output, const char * data)
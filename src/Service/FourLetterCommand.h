@@ -363,6 +363,28 @@ struct UpTimeCommand : public IFourLetterCommand
     ~UpTimeCommand() override = default;
 };
 
+/** Lists subtrees of data tree using the most memory, see 'memory_subtree_depth' setting. For example:
+ *
+ *  total_bytes 3145728 node_count 12000 key_bytes 720000 data_bytes 1200000 children_bytes 96000 acl_references 0
+ *  /clickhouse/tables/db1  2097152 8000 480000 800000 64000 0
+ *  /clickhouse/tables/db2  1048576 4000 240000 400000 32000 0
+ *
+ *  Columns of subtrees are path, total bytes, node count, key bytes, data bytes, children bytes and ACL references.
+ */
+struct MemoryBySubtreeCommand : public IFourLetterCommand
+{
+    static constexpr size_t TOP_SUBTREE_NUM = 50;
+
+    explicit MemoryBySubtreeCommand(KeeperDispatcher & keeper_dispatcher_)
+        : IFourLetterCommand(keeper_dispatcher_)
+    {
+    }
+
+    String name() override { return "mems"; }
+    String run() override;
+    ~MemoryBySubtreeCommand() override = default;
+};
+
 
 #if USE_JEMALLOC
 struct JemallocDumpStats : public IFourLetterCommand
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <Common/Exception.h>
 #include <common/types.h>
 
@@ -24,6 +25,8 @@ struct Keeper4LWInfo
 
     uint64_t alive_connections_count;
     uint64_t outstanding_requests_count;
+    /// Responses waiting in every child queue of responses queue
+    std::vector<uint64_t> response_queue_sizes;
 
     uint64_t follower_count;
     uint64_t synced_follower_count;
@@ -0,0 +1,216 @@
+#include <Service/KeeperChildren.h>
+
+#include <functional>
+#include <Common/BitHelpers.h>
+#include <Common/Exception.h>
+
+namespace RK
+{
+
+namespace ErrorCodes
+{
+    extern const int LOGICAL_ERROR;
+}
+
+CompactChildrenSet::CompactChildrenSet(std::initializer_list<std::string_view> names)
+{
+    reserve(names.size());
+    for (const auto & name : names)
+        insert(name);
+}
+
+CompactChildrenSet::CompactChildrenSet(const CompactChildrenSet & other)
+    : chars(other.chars)
+    , ends(other.ends)
+    , live_count(other.live_count)
+    , index(other.index ? std::make_unique<Index>(*other.index) : nullptr)
+{
+}
+
+CompactChildrenSet & CompactChildrenSet::operator=(const CompactChildrenSet & other)
+{
+    if (this != &other)
+    {
+        chars = other.chars;
+        ends = other.ends;
+        live_count = other.live_count;
+        index = other.index ? std::make_unique<Index>(*other.index) : nullptr;
+    }
+    return *this;
+}
+
+bool CompactChildrenSet::insert(std::string_view name)
+{
+    if (contains(name))
+        return false;
+
+    if (unlikely(chars.size() + name.size() >= DEAD_FLAG))
+        throw Exception(ErrorCodes::LOGICAL_ERROR, "Too large total size of children names");
+
+    chars.insert(chars.end(), name.begin(), name.end());
+    ends.push_back(chars.size());
+    ++live_count;
+
+    if (index)
+    {
+        if ((index->used + 1) * 4 > index->slots.size() * 3)
+            rebuildIndex(live_count);
+        else
+            indexInsert(ends.size() - 1);
+    }
+    else if (live_count > INDEX_THRESHOLD)
+    {
+        rebuildIndex(live_count);
+    }
+
+    return true;
+}
+
+bool CompactChildrenSet::erase(std::string_view name)
+{
+    size_t pos = find(name);
+    if (pos == NOT_FOUND)
+        return false;
+
+    ends[pos] |= DEAD_FLAG;
+    --live_count;
+
+    if (index)
+    {
+        /// Mark the slot as deleted, so that probing of other names is not broken.
+        auto & slots = index->slots;
+        size_t mask = slots.size() - 1;
+        for (size_t slot = std::hash<std::string_view>()(name) & mask;; slot = (slot + 1) & mask)
+        {
+            if (slots[slot] == pos + 1)
+            {
+                slots[slot] = DELETED_SLOT;
+                break;
+            }
+        }
+    }
+
+    if (live_count == 0)
+        clear();
+    else if (ends.size() - live_count > live_count)
+        compact();
+
+    return true;
+}
+
+void CompactChildrenSet::reserve(size_t n)
+{
+    ends.reserve(n);
+    if (n > INDEX_THRESHOLD && (!index || index->slots.size() < n * 2))
+        rebuildIndex(std::max<size_t>(n, live_count));
+}
+
+void CompactChildrenSet::clear()
+{
+    chars.clear();
+    ends.clear();
+    live_count = 0;
+    index.reset();
+}
+
+size_t CompactChildrenSet::allocatedBytes() const
+{
+    size_t bytes = chars.capacity() + ends.capacity() * sizeof(UInt32);
+    if (index)
+        bytes += sizeof(Index) + index->slots.capacity() * sizeof(UInt32);
+    return bytes;
+}
+
+void CompactChildrenSet::appendTo(CompactStrings & out) const
+{
+    if (live_count == ends.size())
+    {
+        out.append(chars.data(), chars.size(), ends.data(), ends.size());
+        return;
+    }
+
+    out.reserve(live_count);
+    for (auto name : *this)
+        out.push_back(name);
+}
+
+bool CompactChildrenSet::operator==(const CompactChildrenSet & rhs) const
+{
+    if (size() != rhs.size())
+        return false;
+
+    for (auto name : rhs)
+        if (!contains(name))
+            return false;
+    return true;
+}
+
+size_t CompactChildrenSet::find(std::string_view name) const
+{
+    if (!index)
+    {
+        for (size_t pos = 0; pos < ends.size(); ++pos)
+            if (!isDead(pos) && nameAt(pos) == name)
+                return pos;
+        return NOT_FOUND;
+    }
+
+    const auto & slots = index->slots;
+    size_t mask = slots.size() - 1;
+    for (size_t slot = std::hash<std::string_view>()(name) & mask; slots[slot] != EMPTY_SLOT; slot = (slot + 1) & mask)
+    {
+        if (slots[slot] != DELETED_SLOT && nameAt(slots[slot] - 1) == name)
+            return slots[slot] - 1;
+    }
+    return NOT_FOUND;
+}
+
+void CompactChildrenSet::compact()
+{
+    std::vector<char> new_chars;
+    std::vector<UInt32> new_ends;
+    new_chars.reserve(chars.size());
+    new_ends.reserve(live_count);
+
+    for (auto name : *this)
+    {
+        new_chars.insert(new_chars.end(), name.begin(), name.end());
+        new_ends.push_back(new_chars.size());
+    }
+
+    chars.swap(new_chars);
+    ends.swap(new_ends);
+
+    if (live_count > INDEX_THRESHOLD)
+        rebuildIndex(live_count);
+    else
+        index.reset();
+}
+
+void CompactChildrenSet::rebuildIndex(size_t min_capacity)
+{
+    if (!index)
+        index = std::make_unique<Index>();
+
+    /// Keep load factor below 1/2 after rebuilding.
+    index->slots.assign(std::max<size_t>(roundUpToPowerOfTwoOrZero(min_capacity * 2), INDEX_THRESHOLD * 2), EMPTY_SLOT);
+    index->used = 0;
+
+    for (size_t pos = 0; pos < ends.size(); ++pos)
+        if (!isDead(pos))
+            indexInsert(pos);
+}
+
+void CompactChildrenSet::indexInsert(size_t pos)
+{
+    auto & slots = index->slots;
+    size_t mask = slots.size() - 1;
+    size_t slot = std::hash<std::string_view>()(nameAt(pos)) & mask;
+    while (slots[slot] != EMPTY_SLOT)
+        slot = (slot + 1) & mask;
+
+    slots[slot] = pos + 1;
+    ++index->used;
+}
+
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <initializer_list>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <Common/CompactStrings.h>
+#include <common/types.h>
+
+namespace RK
+{
+
+/** Children names of a node.
+  *
+  * All names are stored one after another in one buffer, and their end offsets in another one,
+  * so a node with many children costs two allocations instead of one hash node per child, and
+  * listing children is mostly a memcpy into the response.
+  *
+  * A removed name is marked as dead and its bytes are reclaimed when dead names are more than
+  * live ones. Lookups scan the names linearly while there are only a few of them, above
+  * INDEX_THRESHOLD an open-addressing index of name positions is built, so insert, erase and
+  * contains are O(1) amortized.
+  *
+  * Names are iterated in insertion order. Not thread-safe.
+  */
+class CompactChildrenSet
+{
+public:
+    static constexpr size_t INDEX_THRESHOLD = 16;
+
+    class Iterator
+    {
+    public:
+        Iterator(const CompactChildrenSet & set_, size_t pos_) : set(&set_), pos(pos_) { skipDead(); }
+
+        std::string_view operator*() const { return set->nameAt(pos); }
+
+        Iterator & operator++()
+        {
+            ++pos;
+            skipDead();
+            return *this;
+        }
+
+        bool operator==(const Iterator & rhs) const { return pos == rhs.pos; }
+        bool operator!=(const Iterator & rhs) const { return pos != rhs.pos; }
+
+    private:
+        void skipDead()
+        {
+            while (pos < set->ends.size() && set->isDead(pos))
+                ++pos;
+        }
+
+        const CompactChildrenSet * set;
+        size_t pos;
+    };
+
+    CompactChildrenSet() = default;
+    CompactChildrenSet(std::initializer_list<std::string_view> names);
+
+    CompactChildrenSet(const CompactChildrenSet & other);
+    CompactChildrenSet & operator=(const CompactChildrenSet & other);
+    CompactChildrenSet(CompactChildrenSet &&) noexcept = default;
+    CompactChildrenSet & operator=(CompactChildrenSet &&) noexcept = default;
+
+    /// Return false if name already exists.
+    bool insert(std::string_view name);
+    /// Return false if name does not exist.
+    bool erase(std::string_view name);
+
+    bool contains(std::string_view name) const { return find(name) != NOT_FOUND; }
+    size_t count(std::string_view name) const { return contains(name) ? 1 : 0; }
+
+    size_t size() const { return live_count; }
+    bool empty() const { return live_count == 0; }
+
+    void reserve(size_t n);
+    void clear();
+
+    Iterator begin() const { return Iterator(*this, 0); }
+    Iterator end() const { return Iterator(*this, ends.size()); }
+
+    /// Heap memory held by the set.
+    size_t allocatedBytes() const;
+
+    /// Append all names to a response.
+    void appendTo(CompactStrings & out) const;
+
+    /// Same names regardless of order.
+    bool operator==(const CompactChildrenSet & rhs) const;
+    bool operator!=(const CompactChildrenSet & rhs) const { return !(*this == rhs); }
+
+private:
+    static constexpr size_t NOT_FOUND = static_cast<size_t>(-1);
+    static constexpr UInt32 DEAD_FLAG = 1U << 31;
+
+    /// Index slots hold position + 1 of names, 0 means empty.
+    static constexpr UInt32 EMPTY_SLOT = 0;
+    static constexpr UInt32 DELETED_SLOT = static_cast<UInt32>(-1);
+
+    bool isDead(size_t pos) const { return ends[pos] & DEAD_FLAG; }
+    size_t endOf(size_t pos) const { return ends[pos] & ~DEAD_FLAG; }
+    size_t beginOf(size_t pos) const { return pos == 0 ? 0 : endOf(pos - 1); }
+    std::string_view nameAt(size_t pos) const { return {chars.data() + beginOf(pos), endOf(pos) - beginOf(pos)}; }
+
+    size_t find(std::string_view name) const;
+
+    /// Remove dead names and rebuild index.
+    void compact();
+    void rebuildIndex(size_t min_capacity);
+    void indexInsert(size_t pos);
+
+    struct Index
+    {
+        /// Power of two size.
+        std::vector<UInt32> slots;
+        /// Not empty slots, including deleted ones.
+        size_t used = 0;
+    };
+
+    std::vector<char> chars;
+    /// End offsets of names in chars, with DEAD_FLAG for removed names.
+    std::vector<UInt32> ends;
+    UInt32 live_count = 0;
+
+    /// Null if names are few, most nodes have no or a few children.
+    std::unique_ptr<Index> index;
+};
+
+}
@@ -1,4 +1,5 @@
 #include <Service/KeeperCommon.h>
+#include <Service/KeeperUtils.h>
 #include <Service/formatHex.h>
 
 namespace RK
@@ -69,7 +70,7 @@ RequestId RequestForSession::getRequestId() const
 bool isSessionRequest(Coordination::OpNum opnum)
 {
     return opnum == Coordination::OpNum::NewSession || opnum == Coordination::OpNum::OldNewSession
-        || opnum == Coordination::OpNum::UpdateSession;
+        || opnum == Coordination::OpNum::UpdateSession || opnum == Coordination::OpNum::UpgradeSession;
 }
 
 bool isSessionRequest(const Coordination::ZooKeeperRequestPtr & request)
@@ -82,4 +83,13 @@ bool isNewSessionRequest(Coordination::OpNum opnum)
     return opnum == Coordination::OpNum::NewSession || opnum == Coordination::OpNum::OldNewSession;
 }
 
+int64_t initLocalSessionID(int32_t server_id)
+{
+    /// flag(1 bit) | server id(8 bits) | start time in milliseconds and a sequence(54 bits),
+    /// the start time makes ids of different runs of the server unlikely to collide.
+    constexpr int64_t low_bits_mask = (1LL << 54) - 1;
+    auto start_time = static_cast<int64_t>(getCurrentWallTimeMilliseconds());
+    return LOCAL_SESSION_ID_FLAG | (static_cast<int64_t>(server_id & 0xFF) << 54) | ((start_time << 14) & low_bits_mask);
+}
+
 }
@@ -147,6 +147,18 @@ bool isSessionRequest(const Coordination::ZooKeeperRequestPtr & request);
 
 bool isNewSessionRequest(Coordination::OpNum opnum);
 
+/// Local sessions are created by a server without Raft, see 'local_session_enabled'. Their ids carry
+/// LOCAL_SESSION_ID_FLAG and the server id, so they never collide with ids allocated by Raft or other servers.
+static constexpr int64_t LOCAL_SESSION_ID_FLAG = 1LL << 62;
+
+/// The first local session id of a server, following ids are got by incrementing it.
+int64_t initLocalSessionID(int32_t server_id);
+
+inline bool isLocalSessionID(int64_t session_id)
+{
+    return session_id & LOCAL_SESSION_ID_FLAG;
+}
+
 using nuraft::log_val_type;
 inline std::string toString(const log_val_type & log_type)
 {
@@ -0,0 +1,250 @@
+#include <Service/KeeperDataTree.h>
+#include <Common/BitHelpers.h>
+#include <Common/Exception.h>
+#include <common/defines.h>
+
+namespace RK
+{
+
+namespace ErrorCodes
+{
+    extern const int LOGICAL_ERROR;
+}
+
+KeeperNodePtr KeeperNodeArena::makeNode(const String & path)
+{
+    return std::allocate_shared<KeeperNode>(SlabAllocator<KeeperNode>(&pools[hash(path) % SHARD_NUM]));
+}
+
+SlabPool::Stats KeeperNodeArena::getStats() const
+{
+    SlabPool::Stats stats;
+    for (const auto & pool : pools)
+        stats += pool.getStats();
+    return stats;
+}
+
+FlatHashMapDataTree::FlatHashMapDataTree(UInt32 bucket_num_) : auto_bucket_num(bucket_num_ == 0)
+{
+    initBuckets(auto_bucket_num ? DEFAULT_BUCKET_NUM : bucket_num_);
+}
+
+void FlatHashMapDataTree::initBuckets(UInt32 bucket_num)
+{
+    buckets.clear();
+    buckets.reserve(bucket_num);
+    for (UInt32 i = 0; i < bucket_num; i++)
+        buckets.emplace_back(std::make_unique<Map>());
+}
+
+bool FlatHashMapDataTree::emplace(const String & key, KeeperNodePtr value, UInt32 bucket_id)
+{
+    if (buckets[bucket_id]->insertOrAssign(key, std::move(value)))
+    {
+        node_count++;
+        return true;
+    }
+    return false;
+}
+
+bool FlatHashMapDataTree::erase(const String & key)
+{
+    if (buckets[getBucketIndex(key)]->erase(key))
+    {
+        node_count--;
+        return true;
+    }
+    return false;
+}
+
+void FlatHashMapDataTree::clear()
+{
+    for (auto & bucket : buckets)
+        bucket->clear();
+    node_count.store(0);
+}
+
+void FlatHashMapDataTree::reserve(size_t expected_nodes)
+{
+    /// Bucket count can only be changed when the tree is almost empty, for
+    /// it must be fixed before snapshot objects are parsed into buckets.
+    if (auto_bucket_num && node_count.load() <= 1)
+    {
+        auto bucket_num = static_cast<UInt32>(std::clamp(
+            roundUpToPowerOfTwoOrZero(expected_nodes / NODES_PER_BUCKET),
+            static_cast<size_t>(DEFAULT_BUCKET_NUM),
+            static_cast<size_t>(MAX_BUCKET_NUM)));
+
+        if (bucket_num != buckets.size())
+        {
+            std::vector<std::pair<String, KeeperNodePtr>> nodes;
+            for (const auto & bucket : buckets)
+                bucket->forEach([&nodes](const String & path, const KeeperNodePtr & node) { nodes.emplace_back(path, node); });
+
+            initBuckets(bucket_num);
+            for (auto & [path, node] : nodes)
+                buckets[getBucketIndex(path)]->insertOrAssign(std::move(path), std::move(node));
+        }
+    }
+
+    for (auto & bucket : buckets)
+        bucket->reserve(expected_nodes / buckets.size());
+}
+
+DataTreePtr createDataTree(DataTreeEngine engine, UInt32 bucket_num)
+{
+    if (engine == DataTreeEngine::HASH_MAP)
+        return std::make_unique<HashMapDataTree>();
+    else if (engine == DataTreeEngine::FLAT_HASH_MAP)
+        return std::make_unique<FlatHashMapDataTree>(bucket_num);
+    else
+        throw Exception(ErrorCodes::LOGICAL_ERROR, "Unknown data tree engine {}", static_cast<int>(engine));
+}
+
+CopyOnWriteDataTree::CopyOnWriteDataTree(DataTreeEngine engine_, UInt32 bucket_num_, KeeperNodeArena * arena_)
+    : engine_type(engine_), bucket_num(bucket_num_), arena(arena_), base(createDataTree(engine_, bucket_num_))
+{
+}
+
+KeeperNodePtr CopyOnWriteDataTree::get(const String & key)
+{
+    if (frozen)
+    {
+        if (auto it = delta.find(key); it != delta.end())
+            return it->second;
+    }
+    return base->get(key);
+}
+
+KeeperNodePtr CopyOnWriteDataTree::getForUpdate(const String & key)
+{
+    mergeIfReleased();
+
+    if (!frozen)
+        return base->get(key);
+
+    if (auto it = delta.find(key); it != delta.end())
+        return it->second;
+
+    auto node = base->get(key);
+    if (!node)
+        return nullptr;
+
+    /// The snapshot may be reading the original one.
+    auto copy = node->clone(arena, key);
+    delta.emplace(key, copy);
+    return copy;
+}
+
+bool CopyOnWriteDataTree::emplace(const String & key, KeeperNodePtr value)
+{
+    mergeIfReleased();
+
+    if (!frozen)
+        return base->emplace(key, std::move(value));
+
+    bool inserted = get(key) == nullptr;
+    delta.insert_or_assign(key, std::move(value));
+    if (inserted)
+        ++frozen_size;
+    return inserted;
+}
+
+bool CopyOnWriteDataTree::emplace(const String & key, KeeperNodePtr value, UInt32 bucket_id)
+{
+    if (frozen)
+        return emplace(key, std::move(value));
+    return base->emplace(key, std::move(value), bucket_id);
+}
+
+bool CopyOnWriteDataTree::erase(const String & key)
+{
+    mergeIfReleased();
+
+    if (!frozen)
+        return base->erase(key);
+
+    if (get(key) == nullptr)
+        return false;
+
+    delta.insert_or_assign(key, nullptr);
+    --frozen_size;
+    return true;
+}
+
+void CopyOnWriteDataTree::forEach(UInt32 bucket_id, const Action & fn) const
+{
+    if (!frozen)
+    {
+        base->forEach(bucket_id, fn);
+        return;
+    }
+
+    base->forEach(
+        bucket_id,
+        [this, &fn](const String & path, const KeeperNodePtr & node)
+        {
+            if (!delta.contains(path))
+                fn(path, node);
+        });
+
+    for (const auto & [path, node] : delta)
+    {
+        if (node && base->getBucketIndex(path) == bucket_id)
+            fn(path, node);
+    }
+}
+
+void CopyOnWriteDataTree::clear()
+{
+    if (frozen)
+    {
+        /// The snapshot owns the underlying tree now.
+        base = createDataTree(engine_type, bucket_num);
+        delta.clear();
+        frozen = false;
+        return;
+    }
+    base->clear();
+}
+
+void CopyOnWriteDataTree::reserve(size_t expected_nodes)
+{
+    if (!frozen)
+        base->reserve(expected_nodes);
+}
+
+DataTreeSnapshotPtr CopyOnWriteDataTree::freeze()
+{
+    if (frozen)
+    {
+        if (!released->load())
+            throw Exception(ErrorCodes::LOGICAL_ERROR, "Data tree is already frozen by another snapshot");
+        mergeIfReleased();
+    }
+
+    released = std::make_shared<std::atomic<bool>>(false);
+    frozen_size = base->size();
+    frozen = true;
+
+    return std::make_unique<DataTreeSnapshot>(base, released);
+}
+
+void CopyOnWriteDataTree::mergeIfReleased()
+{
+    if (likely(!frozen) || !released->load())
+        return;
+
+    for (auto & [path, node] : delta)
+    {
+        if (node)
+            base->emplace(path, std::move(node));
+        else
+            base->erase(path);
+    }
+
+    delta.clear();
+    frozen = false;
+}
+
+}
@@ -0,0 +1,435 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <Service/KeeperChildren.h>
+#include <Service/Settings.h>
+#include <Common/FlatHashMap.h>
+#include <Common/SharedString.h>
+#include <Common/SlabAllocator.h>
+#include <ZooKeeper/IKeeper.h>
+#include <common/defines.h>
+#include <common/types.h>
+
+namespace RK
+{
+
+class KeeperNodeArena;
+
+/**
+ * Represent an entry in data tree.
+ */
+struct KeeperNode
+{
+    using ChildrenSet = CompactChildrenSet;
+
+    /// Shared with responses of get requests and snapshots being created, so it must be replaced instead of modified.
+    SharedString data;
+    uint64_t acl_id = 0;
+
+    bool is_ephemeral = false;
+    bool is_sequential = false;
+
+    /// Bytes of data and children accounted by DataTreeMemoryTracker.
+    UInt32 accounted_data_bytes = 0;
+    UInt32 accounted_children_bytes = 0;
+
+    /// Slot in the ephemeral nodes of owner session, see EphemeralNodes.
+    UInt32 ephemeral_slot = 0;
+
+    Coordination::Stat stat{};
+    ChildrenSet children;
+
+    /// Copy is allocated from arena if it is not null, path is the path of the node.
+    std::shared_ptr<KeeperNode> clone(KeeperNodeArena * arena = nullptr, const String & path = {}) const;
+    std::shared_ptr<KeeperNode> cloneWithoutChildren(KeeperNodeArena * arena = nullptr, const String & path = {}) const;
+
+    /// All stat for client should be generated by this function.
+    /// This method will remove numChildren from persisted stat.
+    Coordination::Stat statForResponse() const;
+
+    bool operator==(const KeeperNode & rhs) const
+    {
+        return data == rhs.data && acl_id == rhs.acl_id && is_ephemeral == rhs.is_ephemeral && is_sequential == rhs.is_sequential
+            && children == rhs.children;
+    }
+    bool operator!=(const KeeperNode & rhs) const { return !(rhs == *this); }
+};
+
+using KeeperNodePtr = std::shared_ptr<KeeperNode>;
+
+struct KeeperNodeWithPath
+{
+    String path;
+    KeeperNodePtr node;
+};
+
+/// Allocates nodes of data tree from slab pools. A node and the control block of its shared_ptr
+/// are one slab object, so creating a node is one pool allocation instead of one malloc, and the
+/// memory of deleted nodes is returned to the system by whole slabs.
+///
+/// Pools are sharded by path, because nodes are created concurrently when loading snapshot.
+/// Nodes only keep a raw pointer to their pool, so the arena must outlive all nodes made from it,
+/// including copies of nodes and nodes held by snapshots being created.
+class KeeperNodeArena : private boost::noncopyable
+{
+public:
+    static constexpr size_t SHARD_NUM = 16;
+
+    KeeperNodePtr makeNode(const String & path);
+
+    SlabPool::Stats getStats() const;
+
+private:
+    std::array<SlabPool, SHARD_NUM> pools;
+    std::hash<String> hash;
+};
+
+/// KeeperNodeMap is a two-level unordered_map which is designed to reduce latency for unordered_map scaling.
+/// It is not a thread-safe map. But it is accessed only in the request processor thread.
+template <typename Value, unsigned NumBuckets>
+class KeeperNodeMap
+{
+public:
+    using Key = String;
+    using ValuePtr = std::shared_ptr<Value>;
+    using NestedMap = std::unordered_map<String, ValuePtr>;
+    using Action = std::function<void(const String &, const ValuePtr &)>;
+
+    class InnerMap
+    {
+    public:
+        ValuePtr get(const String & key)
+        {
+            auto i = map.find(key);
+            return (i != map.end()) ? i->second : nullptr;
+        }
+
+        template <typename T>
+        bool emplace(const String & key, T && value)
+        {
+            return map.insert_or_assign(key, value).second;
+        }
+
+        bool erase(const String & key)
+        {
+            return map.erase(key);
+        }
+
+        size_t size() const
+        {
+            return map.size();
+        }
+
+        void clear()
+        {
+            map.clear();
+        }
+
+        void forEach(const Action & fn)
+        {
+            for (const auto & [key, value] : map)
+                fn(key, value);
+        }
+
+        /// This method will destroy InnerMap thread safety property.
+        /// Deprecated, please use forEach instead.
+        NestedMap & getMap() { return map; }
+
+    private:
+        NestedMap map;
+    };
+
+private:
+    inline InnerMap & mapFor(const String & key) { return buckets[hash(key) % NumBuckets]; }
+
+    std::array<InnerMap, NumBuckets> buckets;
+    std::hash<String> hash;
+    std::atomic<size_t> node_count{0};
+
+public:
+    ValuePtr get(const String & key) { return mapFor(key).get(key); }
+    ValuePtr at(const String & key) { return mapFor(key).get(key); }
+
+    template <typename T>
+    bool emplace(const String & key, T && value)
+    {
+        if (mapFor(key).emplace(key, std::forward<T>(value)))
+        {
+            node_count++;
+            return true;
+        }
+        return false;
+    }
+
+    template <typename T>
+    bool emplace(const String & key, T && value, UInt32 bucket_id)
+    {
+        if (buckets[bucket_id].emplace(key, std::forward<T>(value)))
+        {
+            node_count++;
+            return true;
+        }
+        return false;
+    }
+
+    bool erase(String const & key)
+    {
+        if (mapFor(key).erase(key))
+        {
+            node_count--;
+            return true;
+        }
+        return false;
+    }
+
+    size_t count(const String & key) { return get(key) != nullptr ? 1 : 0; }
+
+    UInt32 getBucketIndex(const String & key) const { return hash(key) % NumBuckets; }
+    UInt32 getBucketNum() const { return NumBuckets; }
+
+    InnerMap & getMap(const UInt32 & bucket_id) { return buckets[bucket_id]; }
+
+    void clear()
+    {
+        for (auto & bucket : buckets)
+            bucket.clear();
+        node_count.store(0);
+    }
+
+    size_t size() const
+    {
+        return node_count.load();
+    }
+};
+
+/// Interface of data tree engines. Like KeeperNodeMap, a data tree is not thread-safe and is accessed
+/// only in the request processor thread, except snapshot loading which fills different buckets in parallel.
+class IDataTree
+{
+public:
+    using Action = std::function<void(const String &, const KeeperNodePtr &)>;
+
+    virtual ~IDataTree() = default;
+
+    virtual KeeperNodePtr get(const String & key) = 0;
+    KeeperNodePtr at(const String & key) { return get(key); }
+
+    /// Return a node which can be modified in place, nodes returned by get must not be modified.
+    virtual KeeperNodePtr getForUpdate(const String & key) { return get(key); }
+
+    /// Insert or replace value, return true if key is inserted.
+    virtual bool emplace(const String & key, KeeperNodePtr value) = 0;
+    /// Used when loading snapshot, bucket_id must be getBucketIndex(key).
+    virtual bool emplace(const String & key, KeeperNodePtr value, UInt32 bucket_id) = 0;
+
+    virtual bool erase(const String & key) = 0;
+
+    size_t count(const String & key) { return get(key) != nullptr ? 1 : 0; }
+
+    /// Nodes are partitioned into buckets, different buckets can be filled or iterated in parallel.
+    virtual UInt32 getBucketIndex(const String & key) const = 0;
+    virtual UInt32 getBucketNum() const = 0;
+    virtual size_t bucketSize(UInt32 bucket_id) const = 0;
+    virtual void forEach(UInt32 bucket_id, const Action & fn) const = 0;
+
+    virtual void clear() = 0;
+    virtual size_t size() const = 0;
+
+    /// Hint of node count, invoked before loading snapshot.
+    virtual void reserve(size_t /*expected_nodes*/) { }
+
+    virtual DataTreeEngine engine() const = 0;
+};
+
+using DataTreePtr = std::unique_ptr<IDataTree>;
+
+/// Data tree engine keyed by the full path of nodes.
+class HashMapDataTree final : public IDataTree
+{
+public:
+    static constexpr unsigned BUCKET_NUM = 16;
+    using Map = KeeperNodeMap<KeeperNode, BUCKET_NUM>;
+
+    KeeperNodePtr get(const String & key) override { return map.get(key); }
+
+    bool emplace(const String & key, KeeperNodePtr value) override { return map.emplace(key, std::move(value)); }
+    bool emplace(const String & key, KeeperNodePtr value, UInt32 bucket_id) override { return map.emplace(key, std::move(value), bucket_id); }
+
+    bool erase(const String & key) override { return map.erase(key); }
+
+    UInt32 getBucketIndex(const String & key) const override { return map.getBucketIndex(key); }
+    UInt32 getBucketNum() const override { return map.getBucketNum(); }
+    size_t bucketSize(UInt32 bucket_id) const override { return map.getMap(bucket_id).size(); }
+
+    void forEach(UInt32 bucket_id, const Action & fn) const override
+    {
+        auto & bucket = map.getMap(bucket_id).getMap();
+        for (auto it = bucket.begin(); it != bucket.end(); ++it)
+        {
+            fn(it->first, it->second);
+
+            /// Prefetch the next element, may slightly improve performance when iterating large bucket.
+            auto next_it = std::next(it);
+            if (likely(next_it != bucket.end()))
+            {
+                __builtin_prefetch(next_it->first.data(), 0, 3);
+                __builtin_prefetch(next_it->second.get(), 0, 3);
+            }
+        }
+    }
+
+    void clear() override { map.clear(); }
+    size_t size() const override { return map.size(); }
+
+    DataTreeEngine engine() const override { return DataTreeEngine::HASH_MAP; }
+
+private:
+    /// KeeperNodeMap methods are not const-qualified
+    mutable Map map;
+};
+
+/// Data tree engine keyed by the full path of nodes in open-addressing hash maps.
+///
+/// Nodes are stored inline in the slot arrays of FlatHashMap, which are resized incrementally,
+/// so there is no stop-the-world rehash. Bucket count is decided at runtime: if it is not
+/// configured, it is chosen by the expected node count when loading snapshot.
+class FlatHashMapDataTree final : public IDataTree
+{
+public:
+    using Map = FlatHashMap<String, KeeperNodePtr>;
+
+    static constexpr UInt32 DEFAULT_BUCKET_NUM = 16;
+    static constexpr UInt32 MAX_BUCKET_NUM = 1024;
+    /// Expected node count of a bucket when choosing bucket count automatically.
+    static constexpr size_t NODES_PER_BUCKET = 1 << 20;
+
+    /// bucket_num_ is 0 means choosing it automatically.
+    explicit FlatHashMapDataTree(UInt32 bucket_num_);
+
+    KeeperNodePtr get(const String & key) override
+    {
+        auto * value = buckets[getBucketIndex(key)]->find(key);
+        return value ? *value : nullptr;
+    }
+
+    bool emplace(const String & key, KeeperNodePtr value) override { return emplace(key, std::move(value), getBucketIndex(key)); }
+    bool emplace(const String & key, KeeperNodePtr value, UInt32 bucket_id) override;
+
+    bool erase(const String & key) override;
+
+    /// Use high bits of hash, because low bits are used for probing inside FlatHashMap.
+    UInt32 getBucketIndex(const String & key) const override { return (hash(key) >> 32) % buckets.size(); }
+    UInt32 getBucketNum() const override { return buckets.size(); }
+    size_t bucketSize(UInt32 bucket_id) const override { return buckets[bucket_id]->size(); }
+
+    void forEach(UInt32 bucket_id, const Action & fn) const override { buckets[bucket_id]->forEach(fn); }
+
+    void clear() override;
+    size_t size() const override { return node_count.load(); }
+
+    void reserve(size_t expected_nodes) override;
+
+    DataTreeEngine engine() const override { return DataTreeEngine::FLAT_HASH_MAP; }
+
+private:
+    void initBuckets(UInt32 bucket_num);
+
+    const bool auto_bucket_num;
+    std::vector<std::unique_ptr<Map>> buckets;
+    std::hash<String> hash;
+    std::atomic<size_t> node_count{0};
+};
+
+DataTreePtr createDataTree(DataTreeEngine engine, UInt32 bucket_num = 0);
+
+/// Immutable view of data tree for creating snapshot, see CopyOnWriteDataTree.
+/// It can be iterated in another thread while the data tree is being modified.
+class DataTreeSnapshot : private boost::noncopyable
+{
+public:
+    DataTreeSnapshot(std::shared_ptr<const IDataTree> tree_, std::shared_ptr<std::atomic<bool>> released_)
+        : tree(std::move(tree_)), released(std::move(released_)), tree_size(tree->size())
+    {
+    }
+
+    /// Let the data tree merge the nodes written after freezing.
+    ~DataTreeSnapshot() { released->store(true); }
+
+    UInt32 getBucketNum() const { return tree->getBucketNum(); }
+    size_t bucketSize(UInt32 bucket_id) const { return tree->bucketSize(bucket_id); }
+    void forEach(UInt32 bucket_id, const IDataTree::Action & fn) const { tree->forEach(bucket_id, fn); }
+    size_t size() const { return tree_size; }
+
+private:
+    std::shared_ptr<const IDataTree> tree;
+    std::shared_ptr<std::atomic<bool>> released;
+    const size_t tree_size;
+};
+
+using DataTreeSnapshotPtr = std::unique_ptr<DataTreeSnapshot>;
+
+/// Data tree which can be frozen in O(1) for creating snapshot without pausing writers.
+///
+/// While frozen, the underlying tree is shared with a DataTreeSnapshot and is not modified:
+/// inserted and removed nodes go to a delta map, and a node is copied into the delta map
+/// before it is modified for the first time, that is why writers must use getForUpdate.
+/// After the snapshot is released, the delta is merged into the underlying tree by the next
+/// writer, so the extra memory is bounded by the nodes written while creating snapshot.
+class CopyOnWriteDataTree final : public IDataTree
+{
+public:
+    /// Copies of nodes are allocated from arena if it is not null.
+    CopyOnWriteDataTree(DataTreeEngine engine_, UInt32 bucket_num_, KeeperNodeArena * arena_ = nullptr);
+
+    KeeperNodePtr get(const String & key) override;
+    KeeperNodePtr getForUpdate(const String & key) override;
+
+    bool emplace(const String & key, KeeperNodePtr value) override;
+    bool emplace(const String & key, KeeperNodePtr value, UInt32 bucket_id) override;
+
+    bool erase(const String & key) override;
+
+    UInt32 getBucketIndex(const String & key) const override { return base->getBucketIndex(key); }
+    UInt32 getBucketNum() const override { return base->getBucketNum(); }
+    size_t bucketSize(UInt32 bucket_id) const override { return base->bucketSize(bucket_id); }
+
+    void forEach(UInt32 bucket_id, const Action & fn) const override;
+
+    void clear() override;
+    size_t size() const override { return frozen ? frozen_size.load() : base->size(); }
+
+    void reserve(size_t expected_nodes) override;
+
+    DataTreeEngine engine() const override { return engine_type; }
+
+    /// Must be invoked when there is neither concurrent writer nor reader, for the previous snapshot
+    /// is merged here if it is released. Only one snapshot can exist at a time.
+    DataTreeSnapshotPtr freeze();
+
+    bool isFrozen() const { return frozen; }
+
+private:
+    void mergeIfReleased();
+
+    const DataTreeEngine engine_type;
+    const UInt32 bucket_num;
+    KeeperNodeArena * const arena;
+
+    std::shared_ptr<IDataTree> base;
+
+    std::atomic<bool> frozen{false};
+    /// Set by the snapshot of current freezing when it is destroyed.
+    std::shared_ptr<std::atomic<bool>> released;
+
+    /// Nodes written while frozen, null value means the node is removed.
+    std::unordered_map<String, KeeperNodePtr> delta;
+    std::atomic<size_t> frozen_size{0};
+};
+
+}
@@ -26,6 +26,7 @@ KeeperDispatcher::KeeperDispatcher()
     , request_accumulator(request_processor)
     , request_forwarder(request_processor)
 {
+    user_response_callbacks.push_back(std::make_unique<UserResponseCallbacksShard>());
 }
 
 void KeeperDispatcher::requestThread(RunnerId runner_id)
@@ -49,12 +50,17 @@ void KeeperDispatcher::requestThread(RunnerId runner_id)
 
             try
             {
+                /// Local session is closed by request processor without Raft.
+                bool close_local_session = request_for_session.request->getOpNum() == Coordination::OpNum::Close
+                    && getStore().isLocalSession(request_for_session.session_id);
+
                 if (unlikely(isSessionRequest(request_for_session.request)
-                             || request_for_session.request->getOpNum() == Coordination::OpNum::Auth))
+                             || request_for_session.request->getOpNum() == Coordination::OpNum::Auth
+                             || request_for_session.request->getOpNum() == Coordination::OpNum::CloseSessions))
                 {
                     LOG_TRACE(log, "Skip to push {} to request processor", request_for_session.toSimpleString());
                 }
-                else if (isLocalSession(request_for_session.session_id))
+                else if (isLocalSession(request_for_session.session_id) || close_local_session)
                 {
                     LOG_TRACE(log, "Push {} to request processor", request_for_session.toSimpleString());
                     request_processor->push(request_for_session);
@@ -69,12 +75,19 @@ void KeeperDispatcher::requestThread(RunnerId runner_id)
                         toHexString(request_for_session.session_id));
                 }
 
-                if (!request_for_session.request->isReadRequest() && server->isLeaderAlive())
+                if (close_local_session)
+                {
+                    LOG_TRACE(log, "Skip to push {} to Raft, it is a local session", request_for_session.toSimpleString());
+                }
+                else if (!request_for_session.request->isReadRequest() && server->isLeaderAlive())
                 {
                     LOG_TRACE(log, "Leader is {}", server->getLeader());
 
                     if (server->isLeader())
                         request_accumulator.push(request_for_session);
+                    /// The new leader finds dead sessions by itself.
+                    else if (request_for_session.request->getOpNum() == Coordination::OpNum::CloseSessions)
+                        LOG_INFO(log, "Leader changed, skip {}", request_for_session.toSimpleString());
                     else
                         request_forwarder.push(request_for_session);
                 }
@@ -91,16 +104,16 @@ void KeeperDispatcher::requestThread(RunnerId runner_id)
     }
 }
 
-void KeeperDispatcher::responseThread()
+void KeeperDispatcher::responseThread(RunnerId runner_id)
 {
-    setThreadName("RspDispatcher");
+    setThreadName(("RspDspchr#" + std::to_string(runner_id)).c_str());
 
     ResponseForSession response_for_session;
     UInt64 max_wait = configuration_and_settings->raft_settings->operation_timeout_ms;
 
     while (!shutdown_called)
     {
-        if (responses_queue.tryPop(response_for_session, std::min(max_wait, static_cast<UInt64>(1000))))
+        if (responses_queue.tryPop(runner_id, response_for_session, std::min(max_wait, static_cast<UInt64>(1000))))
         {
             if (shutdown_called)
                 break;
@@ -125,8 +138,8 @@ void KeeperDispatcher::invokeResponseCallBack(int64_t session_id, const Coordina
     /// session request
     if (unlikely(isSessionRequest(response->getOpNum())))
     {
-        /// We should use write-lock here for the callback will modify session_response_callbacks
-        std::unique_lock<std::shared_mutex> write_lock(response_callbacks_mutex);
+        /// Lock during the callback for it will modify session_response_callbacks
+        std::lock_guard lock(session_response_callbacks_mutex);
         auto session_writer = session_response_callbacks.find(session_id); /// TODO session id == internal id?
         if (session_writer == session_response_callbacks.end())
             return;
@@ -135,9 +148,10 @@ void KeeperDispatcher::invokeResponseCallBack(int64_t session_id, const Coordina
     /// user request
     else
     {
-        std::shared_lock<std::shared_mutex> read_lock(response_callbacks_mutex);
-        auto session_writer = user_response_callbacks.find(session_id);
-        if (session_writer == user_response_callbacks.end())
+        auto & shard = getUserResponseCallbacks(session_id);
+        std::shared_lock<std::shared_mutex> read_lock(shard.mutex);
+        auto session_writer = shard.callbacks.find(session_id);
+        if (session_writer == shard.callbacks.end())
             return;
 
         session_writer->second(response);
@@ -179,17 +193,88 @@ bool KeeperDispatcher::pushSessionRequest(const Coordination::ZooKeeperRequestPt
         request->xid,
         Coordination::toString(request->getOpNum()));
 
+    if (configuration_and_settings->raft_settings->local_session_enabled && processLocalSessionRequest(request, internal_id))
+        return true;
+
     if (!requests_queue->tryPush(std::move(request_info), configuration_and_settings->raft_settings->operation_timeout_ms))
         throw Exception(ErrorCodes::TIMEOUT_EXCEEDED, "Cannot push session request to queue within operation timeout");
     return true;
 }
 
+bool KeeperDispatcher::processLocalSessionRequest(const Coordination::ZooKeeperRequestPtr & request, int64_t id)
+{
+    auto & store = getStore();
+    Coordination::ZooKeeperResponsePtr response;
+
+    if (isNewSessionRequest(request->getOpNum()))
+    {
+        const auto & new_session_req = dynamic_cast<const Coordination::ZooKeeperNewSessionRequest &>(*request);
+        auto session_id = local_session_id_counter++;
+        store.addLocalSession(session_id, new_session_req.session_timeout_ms);
+
+        response = new_session_req.makeResponse();
+        auto & new_session_resp = dynamic_cast<Coordination::ZooKeeperNewSessionResponse &>(*response);
+        new_session_resp.session_id = session_id;
+        new_session_resp.success = true;
+        LOG_DEBUG(log, "New local session {} created", toHexString(session_id));
+    }
+    /// Reconnect to the server which owns the local session, otherwise the session is unknown and expired.
+    else if (request->getOpNum() == Coordination::OpNum::UpdateSession && store.isLocalSession(id))
+    {
+        store.updateLocalSessionExpirationTime(id);
+
+        response = request->makeResponse();
+        dynamic_cast<Coordination::ZooKeeperUpdateSessionResponse &>(*response).success = true;
+        LOG_DEBUG(log, "Local session {} reconnected", toHexString(id));
+    }
+    else
+    {
+        return false;
+    }
+
+    response->zxid = store.getZxid();
+    response->request_created_time_ms = getCurrentTimeMilliseconds();
+    responses_queue.push(ResponseForSession{id, response});
+    return true;
+}
+
+void KeeperDispatcher::upgradeLocalSessionIfNeeded(const Coordination::ZooKeeperRequestPtr & request, int64_t session_id)
+{
+    if (request->isReadRequest() || request->getOpNum() == Coordination::OpNum::Close)
+        return;
+
+    auto session_timeout_ms = getStore().startUpgradingLocalSession(session_id);
+    if (session_timeout_ms < 0)
+        return;
+
+    auto upgrade_request = std::make_shared<Coordination::ZooKeeperUpgradeSessionRequest>();
+    upgrade_request->xid = Coordination::UPGRADE_SESSION_XID;
+    upgrade_request->session_id = session_id;
+    upgrade_request->session_timeout_ms = session_timeout_ms;
+    upgrade_request->server_id = myId();
+
+    RequestForSession request_info;
+    request_info.request = upgrade_request;
+    request_info.session_id = session_id;
+    request_info.create_time = getCurrentTimeMilliseconds();
+
+    LOG_DEBUG(log, "Upgrade local session {} before {}", toHexString(session_id), Coordination::toString(request->getOpNum()));
+
+    /// Same runner with the write request, so the upgrade is committed before it.
+    if (!requests_queue->tryPush(std::move(request_info), configuration_and_settings->raft_settings->operation_timeout_ms))
+    {
+        getStore().cancelUpgradingLocalSession(session_id);
+        throw Exception("Cannot push upgrade session request to queue within operation timeout", ErrorCodes::TIMEOUT_EXCEEDED);
+    }
+}
+
 bool KeeperDispatcher::pushRequest(const Coordination::ZooKeeperRequestPtr & request, int64_t session_id)
 {
     {
-        std::shared_lock<std::shared_mutex> read_lock(response_callbacks_mutex);
+        auto & shard = getUserResponseCallbacks(session_id);
+        std::shared_lock<std::shared_mutex> read_lock(shard.mutex);
         /// session is expired by server
-        if (!user_response_callbacks.contains(session_id))
+        if (!shard.callbacks.contains(session_id))
             return false;
     }
 
@@ -200,6 +285,9 @@ bool KeeperDispatcher::pushRequest(const Coordination::ZooKeeperRequestPtr & req
     using namespace std::chrono;
     request_info.create_time = getCurrentTimeMilliseconds();
 
+    if (configuration_and_settings->raft_settings->local_session_enabled)
+        upgradeLocalSessionIfNeeded(request, session_id);
+
     LOG_TRACE(log, "Push user request #{}#{}#{}", toHexString(session_id), request->xid, Coordination::toString(request->getOpNum()));
     /// Put close requests without timeouts
     Stopwatch watch;
@@ -253,10 +341,20 @@ void KeeperDispatcher::initialize(const Poco::Util::AbstractConfiguration & conf
     size_t parallel = configuration_and_settings->parallel;
     UInt64 operation_timeout_ms = configuration_and_settings->raft_settings->operation_timeout_ms;
 
+    /// Shard responses before they are pushed by Raft server.
+    size_t response_thread_num = configuration_and_settings->response_thread_num;
+    responses_queue.resize(response_thread_num);
+    user_response_callbacks.resize(response_thread_num);
+    for (auto & shard : user_response_callbacks)
+        if (!shard)
+            shard = std::make_unique<UserResponseCallbacksShard>();
+
     server = std::make_shared<KeeperServer>(configuration_and_settings, config, responses_queue, request_processor);
     new_session_internal_id_counter = server->myId();
+    local_session_id_counter = initLocalSessionID(server->myId());
     /// Raft server needs to be able to handle commit when startup.
-    request_processor->initialize(parallel, server, shared_from_this(), operation_timeout_ms);
+    request_processor->initialize(
+        parallel, server, shared_from_this(), operation_timeout_ms, configuration_and_settings->raft_settings->apply_thread_num);
 
     try
     {
@@ -275,17 +373,27 @@ void KeeperDispatcher::initialize(const Poco::Util::AbstractConfiguration & conf
 
     UInt64 session_sync_period_ms = configuration_and_settings->raft_settings->dead_session_check_period_ms * 2;
     request_forwarder.initialize(parallel, server, shared_from_this(), session_sync_period_ms, operation_timeout_ms);
-    request_accumulator.initialize(shared_from_this(), server, operation_timeout_ms, configuration_and_settings->raft_settings->max_batch_size);
+    request_accumulator.initialize(
+        shared_from_this(),
+        server,
+        operation_timeout_ms,
+        configuration_and_settings->raft_settings->max_batch_size,
+        configuration_and_settings->raft_settings->max_batch_bytes,
+        configuration_and_settings->raft_settings->batch_target_latency_ms,
+        configuration_and_settings->raft_settings->max_inflight_batches);
     requests_queue = std::make_shared<RequestsQueue>(parallel, 20000);
 
     request_thread = std::make_shared<ThreadPool>(parallel);
-    responses_thread = std::make_shared<ThreadPool>(1);
+    responses_thread = std::make_shared<ThreadPool>(response_thread_num);
 
     for (size_t i = 0; i < parallel; i++)
     {
         request_thread->trySchedule([this, i] { requestThread(i); });
     }
-    responses_thread->trySchedule([this] { responseThread(); });
+    for (size_t i = 0; i < response_thread_num; i++)
+    {
+        responses_thread->trySchedule([this, i] { responseThread(i); });
+    }
 
     session_cleaner_thread = ThreadFromGlobalPool([this] { deadSessionCleanThread(); });
     update_configuration_thread = ThreadFromGlobalPool([this] { updateConfigurationThread(); });
@@ -341,9 +449,15 @@ void KeeperDispatcher::shutdown()
             response->error = Coordination::Error::ZSESSIONEXPIRED;
             invokeResponseCallBack(request_for_session.session_id, response);
         }
-        std::unique_lock<std::shared_mutex> write_lock(response_callbacks_mutex);
-        user_response_callbacks.clear();
-        session_response_callbacks.clear();
+        {
+            std::lock_guard lock(session_response_callbacks_mutex);
+            session_response_callbacks.clear();
+        }
+        for (auto & shard : user_response_callbacks)
+        {
+            std::unique_lock<std::shared_mutex> write_lock(shard->mutex);
+            shard->callbacks.clear();
+        }
     }
     catch (...)
     {
@@ -356,14 +470,14 @@ void KeeperDispatcher::shutdown()
 void KeeperDispatcher::registerSessionResponseCallback(int64_t id, ZooKeeperResponseCallback callback)
 {
     LOG_DEBUG(log, "Register session response callback {}", toHexString(id));
-    std::unique_lock<std::shared_mutex> write_lock(response_callbacks_mutex);
+    std::lock_guard lock(session_response_callbacks_mutex);
     if (!session_response_callbacks.try_emplace(id, callback).second)
         throw Exception(RK::ErrorCodes::LOGICAL_ERROR, "Session response callback with id {} has already registered", toHexString(id));
 }
 
 void KeeperDispatcher::unRegisterSessionResponseCallback(int64_t id)
 {
-    std::unique_lock<std::shared_mutex> write_lock(response_callbacks_mutex);
+    std::lock_guard lock(session_response_callbacks_mutex);
     unRegisterSessionResponseCallbackWithoutLock(id);
 }
 
@@ -375,27 +489,25 @@ void KeeperDispatcher::unRegisterSessionResponseCallbackWithoutLock(int64_t id)
         session_response_callbacks.erase(it);
 }
 
-void KeeperDispatcher::registerUserResponseCallBackWithoutLock(int64_t session_id, ZooKeeperResponseCallback callback, bool is_reconnected)
+void KeeperDispatcher::registerUserResponseCallBack(int64_t session_id, ZooKeeperResponseCallback callback, bool is_reconnected)
 {
     if (session_id == 0)
         throw Exception(ErrorCodes::LOGICAL_ERROR, "Session id cannot be 0");
 
-    if (!user_response_callbacks.try_emplace(session_id, callback).second && !is_reconnected)
+    auto & shard = getUserResponseCallbacks(session_id);
+    std::unique_lock<std::shared_mutex> write_lock(shard.mutex);
+    if (!shard.callbacks.try_emplace(session_id, callback).second && !is_reconnected)
         throw Exception(RK::ErrorCodes::LOGICAL_ERROR, "Session with id {} already registered in dispatcher", toHexString(session_id));
 }
 
 void KeeperDispatcher::unregisterUserResponseCallBack(int64_t session_id)
-{
-    std::unique_lock<std::shared_mutex> write_lock(response_callbacks_mutex);
-    unregisterUserResponseCallBackWithoutLock(session_id);
-}
-
-void KeeperDispatcher::unregisterUserResponseCallBackWithoutLock(int64_t session_id)
 {
     LOG_DEBUG(log, "Unregister user response callback {}", toHexString(session_id));
-    auto it = user_response_callbacks.find(session_id);
-    if (it != user_response_callbacks.end())
-        user_response_callbacks.erase(it);
+    auto & shard = getUserResponseCallbacks(session_id);
+    std::unique_lock<std::shared_mutex> write_lock(shard.mutex);
+    auto it = shard.callbacks.find(session_id);
+    if (it != shard.callbacks.end())
+        shard.callbacks.erase(it);
 }
 
 void KeeperDispatcher::registerForwarderResponseCallBack(ForwardClientId client_id, ForwardResponseCallback callback)
@@ -428,11 +540,64 @@ void KeeperDispatcher::unRegisterForwarderResponseCallBack(ForwardClientId clien
     forward_response_callbacks.erase(forward_response_writer);
 }
 
+std::vector<int64_t> KeeperDispatcher::filterClosingSessions(
+    const std::vector<int64_t> & dead_sessions, std::unordered_map<int64_t, int64_t> & closing_sessions, int64_t now) const
+{
+    auto operation_timeout_ms = static_cast<int64_t>(configuration_and_settings->raft_settings->operation_timeout_ms);
+
+    std::vector<int64_t> sessions_to_close;
+    std::unordered_map<int64_t, int64_t> still_closing;
+    for (int64_t dead_session : dead_sessions)
+    {
+        auto it = closing_sessions.find(dead_session);
+        if (it != closing_sessions.end() && now - it->second < operation_timeout_ms)
+        {
+            still_closing.emplace(*it);
+            continue;
+        }
+        sessions_to_close.push_back(dead_session);
+        still_closing.emplace(dead_session, now);
+    }
+    closing_sessions.swap(still_closing);
+    return sessions_to_close;
+}
+
+void KeeperDispatcher::closeDeadLocalSessions(std::unordered_map<int64_t, int64_t> & closing_sessions)
+{
+    auto now = static_cast<int64_t>(getCurrentTimeMilliseconds());
+    auto sessions_to_close = filterClosingSessions(getStore().getDeadLocalSessions(), closing_sessions, now);
+
+    for (auto session_id : sessions_to_close)
+    {
+        LOG_DEBUG(log, "Found dead local session {}, will try to close it", toHexString(session_id));
+
+        auto request = std::make_shared<Coordination::ZooKeeperCloseRequest>();
+        request->xid = Coordination::CLOSE_XID;
+
+        RequestForSession request_info;
+        request_info.request = request;
+        request_info.session_id = session_id;
+        request_info.create_time = now;
+        {
+            std::lock_guard lock(push_request_mutex);
+            if (!requests_queue->push(std::move(request_info)))
+                throw Exception("Cannot push request to queue", ErrorCodes::SYSTEM_ERROR);
+        }
+    }
+}
+
 void KeeperDispatcher::deadSessionCleanThread()
 {
     setThreadName("DeadSessnClean");
 
     LOG_INFO(log, "Start dead session clean thread");
+
+    /// Dead sessions whose close request is pushed -> push time. They are found again until the
+    /// request is applied, and pushed again only if it is not applied within operation timeout.
+    std::unordered_map<int64_t, int64_t> closing_sessions;
+    /// Same as closing_sessions, but for local sessions which are closed by every server itself.
+    std::unordered_map<int64_t, int64_t> closing_local_sessions;
+
     while (true)
     {
         if (shutdown_called)
@@ -445,36 +610,46 @@ void KeeperDispatcher::deadSessionCleanThread()
                 std::this_thread::sleep_for(
                     std::chrono::milliseconds(configuration_and_settings->raft_settings->dead_session_check_period_ms));
 
-                auto dead_sessions = server->getDeadSessions();
-                if (!dead_sessions.empty())
-                    LOG_INFO(log, "Found dead sessions {}", dead_sessions.size());
+                auto now = static_cast<int64_t>(getCurrentTimeMilliseconds());
+                auto sessions_to_close = filterClosingSessions(server->getDeadSessions(), closing_sessions, now);
 
-                for (int64_t dead_session : dead_sessions)
+                if (!sessions_to_close.empty())
+                    LOG_INFO(log, "Found dead sessions {}, will try to close them", sessions_to_close.size());
+
+                /// Close dead sessions in batch, every batch is one Raft log entry.
+                for (size_t begin = 0; begin < sessions_to_close.size(); begin += MAX_CLOSE_SESSIONS_BATCH_SIZE)
                 {
-                    LOG_INFO(log, "Found dead session {}, will try to close it", toHexString(dead_session));
-                    Coordination::ZooKeeperRequestPtr request
-                        = Coordination::ZooKeeperRequestFactory::instance().get(Coordination::OpNum::Close);
+                    size_t end = std::min(begin + MAX_CLOSE_SESSIONS_BATCH_SIZE, sessions_to_close.size());
+                    auto request = std::make_shared<Coordination::ZooKeeperCloseSessionsRequest>();
                     request->xid = Coordination::CLOSE_XID;
+                    request->session_ids.assign(sessions_to_close.begin() + begin, sessions_to_close.begin() + end);
+
+                    for (auto session_id : request->session_ids)
+                        LOG_DEBUG(log, "Found dead session {}, will try to close it", toHexString(session_id));
+
                     RequestForSession request_info;
                     request_info.request = request;
-                    request_info.session_id = dead_session;
-                    // request_info.is_internal = true;
-                    using namespace std::chrono;
-                    request_info.create_time = getCurrentTimeMilliseconds();
+                    /// Not a real session, sessions are carried by the request.
+                    request_info.session_id = 0;
+                    request_info.create_time = now;
                     {
                         std::lock_guard lock(push_request_mutex);
                         if (!requests_queue->push(std::move(request_info)))
                             throw Exception("Cannot push request to queue", ErrorCodes::SYSTEM_ERROR);
                     }
-                    // unregisterUserResponseCallBack(dead_session);
-                    LOG_DEBUG(log, "Dead session close request pushed");
+                    Metrics::getMetrics().dead_session_close_batch_size->add(end - begin);
+                    LOG_DEBUG(log, "Close request of {} dead sessions pushed", end - begin);
                 }
             }
             else
             {
+                closing_sessions.clear();
                 std::this_thread::sleep_for(
                     std::chrono::milliseconds(configuration_and_settings->raft_settings->dead_session_check_period_ms));
             }
+
+            if (configuration_and_settings->raft_settings->local_session_enabled)
+                closeDeadLocalSessions(closing_local_sessions);
         }
         catch (...)
         {
@@ -541,17 +716,16 @@ void KeeperDispatcher::updateConfigurationThread()
 
 bool KeeperDispatcher::isLocalSession(int64_t session_id)
 {
-    std::shared_lock<std::shared_mutex> read_lock(response_callbacks_mutex);
-    auto it = user_response_callbacks.find(session_id);
-    return it != user_response_callbacks.end();
+    auto & shard = getUserResponseCallbacks(session_id);
+    std::shared_lock<std::shared_mutex> read_lock(shard.mutex);
+    return shard.callbacks.contains(session_id);
 }
 
 void KeeperDispatcher::filterLocalSessions(std::unordered_map<int64_t, int64_t> & session_to_expiration_time)
 {
-    std::shared_lock<std::shared_mutex> read_lock(response_callbacks_mutex);
     for (auto it = session_to_expiration_time.begin(); it != session_to_expiration_time.end();)
     {
-        if (!user_response_callbacks.contains(it->first))
+        if (!isLocalSession(it->first))
         {
             LOG_TRACE(log, "Not local session {}", toHexString(it->first));
             it = session_to_expiration_time.erase(it);
@@ -632,10 +806,14 @@ Keeper4LWInfo KeeperDispatcher::getKeeper4LWInfo()
         std::lock_guard lock(push_request_mutex);
         result.outstanding_requests_count = requests_queue->size();
     }
+    result.alive_connections_count = 0;
+    for (auto & shard : user_response_callbacks)
     {
-        std::shared_lock<std::shared_mutex> read_lock(response_callbacks_mutex);
-        result.alive_connections_count = user_response_callbacks.size();
+        std::shared_lock<std::shared_mutex> read_lock(shard->mutex);
+        result.alive_connections_count += shard->callbacks.size();
     }
+    for (size_t i = 0; i < responses_queue.childQueueSize(); ++i)
+        result.response_queue_sizes.push_back(responses_queue.size(i));
     if (result.is_leader)
     {
         result.follower_count = server->getFollowerCount();
@@ -22,6 +22,7 @@
 #include <Service/RequestForwarder.h>
 #include <Service/RequestProcessor.h>
 #include <Service/RequestsQueue.h>
+#include <Service/ResponsesQueue.h>
 #include <Service/Settings.h>
 
 namespace RK
@@ -34,19 +35,35 @@ class KeeperDispatcher : public std::enable_shared_from_this<KeeperDispatcher>
 private:
     std::mutex push_request_mutex;
     ptr<RequestsQueue> requests_queue;
-    ThreadSafeQueue<ResponseForSession> responses_queue;
+    /// Sharded by session id, every child queue is consumed by a response thread.
+    ResponsesQueue responses_queue;
     std::atomic<bool> shutdown_called{false};
 
     /// Response callback which will send response to IO handler. Key is session_id
     /// which are local session which are directly connected to the node.
     using UserResponseCallbacks = std::unordered_map<int64_t, ZooKeeperResponseCallback>;
-    UserResponseCallbacks user_response_callbacks;
-    std::shared_mutex response_callbacks_mutex;
+
+    /// User response callbacks are sharded in the same way as responses_queue, so a response thread
+    /// only locks the shard of its own, and response threads do not contend with each other.
+    struct UserResponseCallbacksShard
+    {
+        UserResponseCallbacks callbacks;
+        std::shared_mutex mutex;
+    };
+    std::vector<std::unique_ptr<UserResponseCallbacksShard>> user_response_callbacks;
+
+    UserResponseCallbacksShard & getUserResponseCallbacks(int64_t session_id)
+    {
+        return *user_response_callbacks[responses_queue.getQueueId(session_id)];
+    }
 
     /// Just like user_response_callbacks, but only concerns new session or update session requests.
     /// For new session request the key is internal_id, for update session request the key is session id.
+    /// Session callbacks register user callbacks, so session_response_callbacks_mutex is always locked
+    /// before the mutex of a user response callbacks shard.
     using SessionResponseCallbacks = std::unordered_map<int64_t, ZooKeeperResponseCallback>;
     SessionResponseCallbacks session_response_callbacks;
+    std::mutex session_response_callbacks_mutex;
 
     struct PairHash
     {
@@ -99,8 +116,30 @@ private:
     /// Used as new session request internal id counter
     std::atomic<int64_t> new_session_internal_id_counter;
 
+    /// Used as local session id counter, see local_session_enabled
+    std::atomic<int64_t> local_session_id_counter;
+
     void requestThread(RunnerId runner_id);
-    void responseThread();
+    void responseThread(RunnerId runner_id);
+
+    /// Max sessions closed by one CloseSessions request, which is one Raft log entry.
+    static constexpr size_t MAX_CLOSE_SESSIONS_BATCH_SIZE = 10000;
+
+    /// Create or renew a local session without Raft, return false if the request should go through Raft.
+    bool processLocalSessionRequest(const Coordination::ZooKeeperRequestPtr & request, int64_t id);
+
+    /// Push an UpgradeSession request before the first write request of a local session.
+    void upgradeLocalSessionIfNeeded(const Coordination::ZooKeeperRequestPtr & request, int64_t session_id);
+
+    /// Pick dead sessions whose close request is not pushed or not applied within operation timeout,
+    /// closing_sessions is updated to dead sessions being closed.
+    std::vector<int64_t> filterClosingSessions(
+        const std::vector<int64_t> & dead_sessions, std::unordered_map<int64_t, int64_t> & closing_sessions, int64_t now) const;
+
+    /// Push close requests for local sessions expired in this server.
+    void closeDeadLocalSessions(std::unordered_map<int64_t, int64_t> & closing_sessions);
+
+    KeeperStore & getStore() { return server->getKeeperStateMachine()->getStore(); }
 
     /// Clean dead sessions
     void deadSessionCleanThread();
@@ -129,9 +168,8 @@ public:
     void unRegisterForwarderResponseCallBack(ForwardClientId client_id);
 
     /// Register response callback for user request
-    void registerUserResponseCallBackWithoutLock(int64_t session_id, ZooKeeperResponseCallback callback, bool is_reconnected = false);
+    void registerUserResponseCallBack(int64_t session_id, ZooKeeperResponseCallback callback, bool is_reconnected = false);
     void unregisterUserResponseCallBack(int64_t session_id);
-    void unregisterUserResponseCallBackWithoutLock(int64_t session_id);
 
     /// Register response callback for new session or update session request
     void registerSessionResponseCallback(int64_t id, ZooKeeperResponseCallback callback);
@@ -143,7 +181,10 @@ public:
     void filterLocalSessions(std::unordered_map<int64_t, int64_t> & session_to_expiration_time);
 
     /// from follower
-    void handleRemoteSession(int64_t session_id, int64_t expiration_time) { server->handleRemoteSession(session_id, expiration_time); }
+    void handleRemoteSessions(const std::unordered_map<int64_t, int64_t> & session_to_expiration_time)
+    {
+        server->handleRemoteSessions(session_to_expiration_time);
+    }
 
     /// Thread apply or wait configuration changes from leader
     void updateConfigurationThread();
@@ -180,9 +221,9 @@ public:
 
     const SettingsPtr & getKeeperConfigurationAndSettings() const { return configuration_and_settings; }
 
-    void incrementPacketsSent()
+    void incrementPacketsSent(uint64_t count = 1)
     {
-        keeper_stats.incrementPacketsSent();
+        keeper_stats.incrementPacketsSent(count);
     }
 
     void incrementPacketsReceived()
@@ -57,7 +57,10 @@ KeeperServer::KeeperServer(
         data += fmt::format("server.{}={}:participant\n", s->get_id(), s->get_endpoint());
     }
     data += "version=0";
-    state_machine->getStore().getNode(ZOOKEEPER_CONFIG_NODE)->data = data;
+    auto & store = state_machine->getStore();
+    auto config_node = store.getNodeForUpdate(ZOOKEEPER_CONFIG_NODE);
+    config_node->data = data;
+    store.updateNodeMemory(ZOOKEEPER_CONFIG_NODE, *config_node);
 #endif
 
 }
@@ -71,7 +74,8 @@ namespace
         params.election_timeout_upper_bound_ = raft_settings->election_timeout_upper_bound_ms;
         params.reserved_log_items_ = raft_settings->reserved_log_items;
         params.snapshot_distance_ = raft_settings->snapshot_distance;
-        params.return_method_ = nuraft::raft_params::blocking;
+        /// Results of appended batches are handled by RequestAccumulator asynchronously.
+        params.return_method_ = nuraft::raft_params::async_handler;
         params.parallel_log_appending_ = raft_settings->log_fsync_mode == FsyncMode::FSYNC_PARALLEL;
         params.auto_forwarding_ = false;
     }
@@ -134,20 +138,35 @@ void KeeperServer::shutdown()
 ptr<nuraft::cmd_result<ptr<buffer>>> KeeperServer::pushRequestBatch(const std::vector<RequestForSession> & request_batch)
 {
     LOG_DEBUG(log, "Push batch requests of size {}", request_batch.size());
+    /// Pack requests into log entries to save log and replication overhead of each entry.
+    size_t max_requests_per_entry = std::max(settings->raft_settings->max_requests_per_log_entry, static_cast<UInt64>(1));
     std::vector<ptr<buffer>> entries;
-    for (const auto & request : request_batch)
+    entries.reserve((request_batch.size() + max_requests_per_entry - 1) / max_requests_per_entry);
+
+    for (size_t begin = 0; begin < request_batch.size(); begin += max_requests_per_entry)
     {
-        LOG_TRACE(log, "Push request {}", request.toSimpleString());
-        entries.push_back(serializeKeeperRequest(request));
+        size_t end = std::min(begin + max_requests_per_entry, request_batch.size());
+        for (size_t i = begin; i < end; ++i)
+            LOG_TRACE(log, "Push request {}", request_batch[i].toSimpleString());
+
+        if (end - begin == 1)
+            entries.push_back(serializeKeeperRequest(request_batch[begin]));
+        else
+            entries.push_back(serializeKeeperRequests(request_batch.begin() + begin, request_batch.begin() + end));
     }
+    /// Requests are handed to state machine to save deserializing them when committed.
+    state_machine->addLocalRequests(request_batch, raft_instance->get_last_log_idx());
+
     /// append_entries write request
     ptr<nuraft::cmd_result<ptr<buffer>>> result = raft_instance->append_entries(entries);
+    if (!result->get_accepted())
+        state_machine->removeLocalRequests(request_batch);
     return result;
 }
 
-void KeeperServer::handleRemoteSession(int64_t session_id, int64_t expiration_time)
+void KeeperServer::handleRemoteSessions(const std::unordered_map<int64_t, int64_t> & session_to_expiration_time)
 {
-    state_machine->getStore().handleRemoteSession(session_id, expiration_time);
+    state_machine->getStore().handleRemoteSessions(session_to_expiration_time);
 }
 
 bool KeeperServer::isLeader() const
@@ -209,6 +228,11 @@ nuraft::cb_func::ReturnCode KeeperServer::callbackFunc(nuraft::cb_func::Type typ
         if (update_forward_listener)
             update_forward_listener();
     }
+
+    /// Entries appended by this node may be overwritten by the new leader.
+    if (type == nuraft::cb_func::BecomeLeader || type == nuraft::cb_func::BecomeFollower)
+        state_machine->clearLocalRequests();
+
     return nuraft::cb_func::ReturnCode::Ok;
 }
 
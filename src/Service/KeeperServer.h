@@ -38,7 +38,7 @@ public:
 
     /// When leader receive session expiration infos from others,
     /// it will update the snapshot itself.
-    void handleRemoteSession(int64_t session_id, int64_t expiration_time);
+    void handleRemoteSessions(const std::unordered_map<int64_t, int64_t> & session_to_expiration_time);
 
     /// will invoke waitInit
     void startup();
@@ -1,6 +1,6 @@
+#include <algorithm>
 #include <functional>
 #include <iomanip>
-#include <Service/memcopy.h>
 #include <Service/KeeperStore.h>
 #include <Service/KeeperUtils.h>
 #include <ZooKeeper/IKeeper.h>
@@ -14,7 +14,7 @@ namespace ErrorCodes
 }
 
 static inline void set_response(
-    ThreadSafeQueue<ResponseForSession> & responses_queue,
+    KeeperStore::KeeperResponsesQueue & responses_queue,
     const ResponsesForSessions & responses,
     bool ignore_response)
 {
@@ -26,7 +26,7 @@ static inline void set_response(
 }
 
 static inline void set_response(
-    ThreadSafeQueue<ResponseForSession> & responses_queue,
+    KeeperStore::KeeperResponsesQueue & responses_queue,
     const ResponseForSession & response,
     bool ignore_response)
 {
@@ -35,31 +35,37 @@ static inline void set_response(
     set_response(responses_queue, responses, ignore_response);
 }
 
-static bool checkACL(int32_t permission, const Coordination::ACLs & node_acls, const std::vector<Coordination::AuthID> & session_auths)
+/// Group watch responses of the same session into one response, so that a burst of watch events, for example
+/// of a multi request or a closed session removing many nodes, is pushed into responses queue and written to
+/// the connection at once. Responses of a session keep their order.
+static ResponsesForSessions groupWatchResponses(const ResponsesForSessions & watch_responses)
 {
-    if (node_acls.empty())
-        return true;
+    if (watch_responses.size() <= 1)
+        return watch_responses;
 
-    for (const auto & session_auth : session_auths)
-        if (session_auth.scheme == "super")
-            return true;
+    ResponsesForSessions result;
+    std::unordered_map<int64_t, std::shared_ptr<Coordination::ZooKeeperWatchResponses>> batches;
+    std::unordered_map<int64_t, size_t> session_positions;
 
-    for (const auto & node_acl : node_acls)
+    for (const auto & watch_response : watch_responses)
     {
-        if (node_acl.permissions & permission)
+        auto [position, inserted] = session_positions.try_emplace(watch_response.session_id, result.size());
+        if (inserted)
         {
-            if (node_acl.scheme == "world" && node_acl.id == "anyone")
-                return true;
+            result.push_back(watch_response);
+            continue;
+        }
 
-            for (const auto & session_auth : session_auths)
-            {
-                if (node_acl.scheme == session_auth.scheme && node_acl.id == session_auth.id)
-                    return true;
-            }
+        auto & batch = batches[watch_response.session_id];
+        if (!batch)
+        {
+            batch = std::make_shared<Coordination::ZooKeeperWatchResponses>();
+            batch->responses.push_back(result[position->second].response);
+            result[position->second].response = batch;
         }
+        batch->responses.push_back(watch_response.response);
     }
-
-    return false;
+    return result;
 }
 
 static bool fixupACL(
@@ -115,6 +121,8 @@ static bool shouldIncreaseZxid(const Coordination::ZooKeeperRequestPtr & zk_requ
 {
     return !(dynamic_cast<Coordination::ZooKeeperGetRequest *>(zk_request.get())
         || dynamic_cast<Coordination::ZooKeeperSetWatchesRequest *>(zk_request.get())
+        || dynamic_cast<Coordination::ZooKeeperAddWatchRequest *>(zk_request.get())
+        || dynamic_cast<Coordination::ZooKeeperWatchesRequest *>(zk_request.get())
         || dynamic_cast<Coordination::ZooKeeperExistsRequest *>(zk_request.get())
         || dynamic_cast<Coordination::ZooKeeperAuthRequest *>(zk_request.get())
         || dynamic_cast<Coordination::ZooKeeperHeartbeatRequest *>(zk_request.get())
@@ -122,29 +130,29 @@ static bool shouldIncreaseZxid(const Coordination::ZooKeeperRequestPtr & zk_requ
         || dynamic_cast<Coordination::ZooKeeperSimpleListRequest *>(zk_request.get()));
 }
 
-KeeperNodePtr KeeperNode::clone() const
+KeeperNodePtr KeeperNode::clone(KeeperNodeArena * arena, const String & path) const
 {
-    auto node = std::make_shared<KeeperNode>();
-    auto data_size = data.size();
-    node->data.resize(data_size);
-    memcopy(node->data.data(), data.data(), data_size);
+    auto node = arena ? arena->makeNode(path) : std::make_shared<KeeperNode>();
+    node->data = data;
     node->acl_id = acl_id;
     node->is_ephemeral = is_ephemeral;
     node->is_sequential = is_sequential;
+    node->ephemeral_slot = ephemeral_slot;
     node->stat = stat;
     node->children = children;
+    node->accounted_data_bytes = accounted_data_bytes;
+    node->accounted_children_bytes = accounted_children_bytes;
     return node;
 }
 
-KeeperNodePtr KeeperNode::cloneWithoutChildren() const
+KeeperNodePtr KeeperNode::cloneWithoutChildren(KeeperNodeArena * arena, const String & path) const
 {
-    auto node = std::make_shared<KeeperNode>();
-    auto data_size = data.size();
-    node->data.resize(data_size);
-    memcopy(node->data.data(), data.data(), data_size);
+    auto node = arena ? arena->makeNode(path) : std::make_shared<KeeperNode>();
+    node->data = data;
     node->acl_id = acl_id;
     node->is_ephemeral = is_ephemeral;
     node->is_sequential = is_sequential;
+    node->ephemeral_slot = ephemeral_slot;
     node->stat = stat;
     return node;
 }
@@ -160,11 +168,36 @@ Coordination::Stat KeeperNode::statForResponse() const
     return stat_view;
 }
 
-KeeperStore::KeeperStore(int64_t dead_session_check_period_ms, const String & super_digest_)
-    : session_manager(dead_session_check_period_ms), super_digest(super_digest_)
+namespace
+{
+
+/// Shared by all stores, so that a version cached by a thread never matches another store.
+UInt64 nextSessionPermissionsVersion()
+{
+    static std::atomic<UInt64> version{0};
+    return ++version;
+}
+
+}
+
+KeeperStore::KeeperStore(
+    int64_t dead_session_check_period_ms,
+    const String & super_digest_,
+    DataTreeEngine data_tree_engine,
+    UInt32 data_tree_bucket_num,
+    UInt32 memory_subtree_depth,
+    UInt64 response_cache_size)
+    : data_tree(std::make_unique<CopyOnWriteDataTree>(data_tree_engine, data_tree_bucket_num, &node_arena))
+    , memory_tracker(memory_subtree_depth)
+    , response_cache(response_cache_size)
+    , anonymous_permissions(acl_map, {})
+    , session_permissions_version(nextSessionPermissionsVersion())
+    , session_manager(dead_session_check_period_ms)
+    , super_digest(super_digest_)
 {
     log = &(Poco::Logger::get("KeeperStore"));
-    data_tree.emplace("/", std::make_shared<KeeperNode>());
+    LOG_INFO(log, "Data tree engine is {}", DataTreeEngineNS::toString(data_tree_engine));
+    addNode("/", makeNode("/"));
 }
 
 using Undo = std::function<void()>;
@@ -208,6 +241,40 @@ struct StoreRequestSetWatches final : public StoreRequest
 
 };
 
+struct StoreRequestAddWatch final : public StoreRequest
+{
+    using StoreRequest::StoreRequest;
+
+    std::pair<Coordination::ZooKeeperResponsePtr, Undo>
+    process(KeeperStore & store, int64_t /* zxid */, int64_t session_id, int64_t /* time */) const override
+    {
+        auto & request = dynamic_cast<Coordination::ZooKeeperAddWatchRequest &>(*zk_request);
+        store.addWatch(request.path, session_id, request.mode);
+        return {zk_request->makeResponse(), {}};
+    }
+};
+
+/// For CheckWatches and RemoveWatches requests
+struct StoreRequestWatches final : public StoreRequest
+{
+    using StoreRequest::StoreRequest;
+
+    std::pair<Coordination::ZooKeeperResponsePtr, Undo>
+    process(KeeperStore & store, int64_t /* zxid */, int64_t session_id, int64_t /* time */) const override
+    {
+        auto response = zk_request->makeResponse();
+        auto & request = dynamic_cast<Coordination::ZooKeeperWatchesRequest &>(*zk_request);
+
+        bool found = request.getOpNum() == Coordination::OpNum::RemoveWatches
+            ? store.removeWatches(request.path, session_id, request.type)
+            : store.containsWatches(request.path, session_id, request.type);
+
+        if (!found)
+            response->error = Coordination::Error::ZNOWATCHER;
+        return {response, {}};
+    }
+};
+
 struct StoreRequestSync final : public StoreRequest
 {
     using StoreRequest::StoreRequest;
@@ -234,23 +301,7 @@ struct StoreRequestCreate final : public StoreRequest
         if (parent == nullptr)
             return true;
 
-        const auto & node_acls = store.getACLMap().convertNumber(parent->acl_id);
-        if (node_acls.empty())
-            return true;
-
-        std::shared_lock r_lock(store.auth_mutex);
-        auto it = store.session_and_auth.find(session_id);
-        if (it != store.session_and_auth.end())
-        {
-            const auto & session_auths = it->second;
-            /// LOL, GetACL require more permissions, then SetACL...
-            return checkACL(Coordination::ACL::Create, node_acls, session_auths);
-        }
-        else
-        {
-            std::vector<Coordination::AuthID> empty_auth_ids;
-            return checkACL(Coordination::ACL::Create, node_acls, empty_auth_ids);
-        }
+        return store.checkPermission(session_id, parent->acl_id, Coordination::ACL::Create);
     }
 
     std::pair<Coordination::ZooKeeperResponsePtr, Undo>
@@ -263,7 +314,7 @@ struct StoreRequestCreate final : public StoreRequest
         Coordination::ZooKeeperCreateResponse & response = dynamic_cast<Coordination::ZooKeeperCreateResponse &>(*response_ptr);
         Coordination::ZooKeeperCreateRequest & request = dynamic_cast<Coordination::ZooKeeperCreateRequest &>(*zk_request);
 
-        auto parent = store.getNode(getParentPath(request.path));
+        auto parent = store.getNodeForUpdate(getParentPath(request.path));
         if (parent == nullptr)
         {
             LOG_TRACE(log, "Create no parent {}, path {}", getParentPath(request.path), request.path);
@@ -299,7 +350,7 @@ struct StoreRequestCreate final : public StoreRequest
             response.error = Coordination::Error::ZBADARGUMENTS;
             return {response_ptr, undo};
         }
-        std::shared_ptr<KeeperNode> created_node = std::make_shared<KeeperNode>();
+        std::shared_ptr<KeeperNode> created_node = store.makeNode(path_created);
 
         Coordination::ACLs node_acls;
         uint64_t acl_id{};
@@ -348,10 +399,11 @@ struct StoreRequestCreate final : public StoreRequest
             parent->stat.pzxid = zxid;
         }
 
-        store.addNode(path_created, std::move(created_node));
-
+        store.updateNodeMemory(getParentPath(request.path), *parent);
         if (request.is_ephemeral)
-            store.addEphemeralNode(session_id, path_created);
+            store.addEphemeralNode(session_id, path_created, *created_node);
+
+        store.addNode(path_created, std::move(created_node));
 
         undo = [&store,
                 session_id,
@@ -361,20 +413,24 @@ struct StoreRequestCreate final : public StoreRequest
                 parent_path = getParentPath(request.path),
                 child_path,
                 acl_id] {
+            if (is_ephemeral)
+            {
+                if (auto created = store.getNode(path_created))
+                    store.removeEphemeralNode(session_id, *created);
+            }
             {
                 store.removeNode(path_created);
                 store.getACLMap().removeUsage(acl_id);
             }
-            if (is_ephemeral)
-                store.removeEphemeralNode(session_id, path_created);
 
-            auto undo_parent = store.getNode(parent_path);
+            auto undo_parent = store.getNodeForUpdate(parent_path);
             {
                 --undo_parent->stat.cversion;
                 --undo_parent->stat.numChildren;
                 undo_parent->stat.pzxid = pzxid;
                 undo_parent->children.erase(child_path);
             }
+            store.updateNodeMemory(parent_path, *undo_parent);
         };
 
         response.error = Coordination::Error::ZOK;
@@ -382,35 +438,46 @@ struct StoreRequestCreate final : public StoreRequest
     }
 };
 
+/// Set body of a read response of node from response cache, or fill the response by fill_response and cache its body.
+template <typename FillResponse>
+static void fillReadResponse(
+    KeeperStore & store,
+    const String & path,
+    const KeeperNode & node,
+    ResponseCache::Kind kind,
+    Coordination::ZooKeeperResponse & response,
+    FillResponse && fill_response)
+{
+    auto & cache = store.getResponseCache();
+    if (!cache.enabled())
+    {
+        fill_response();
+        return;
+    }
+
+    if (auto body = cache.get(path, kind, node.stat.mzxid, node.stat.pzxid); !body.empty())
+    {
+        response.serialized_body = std::move(body);
+        return;
+    }
+
+    fill_response();
+    WriteBufferFromOwnString buf;
+    response.writeImpl(buf);
+    cache.set(path, kind, node.stat.mzxid, node.stat.pzxid, std::move(buf.str()));
+}
+
 struct StoreRequestGet final : public StoreRequest
 {
     using StoreRequest::StoreRequest;
 
     bool checkAuth(KeeperStore & store, int64_t session_id) const override
     {
-        Poco::Logger * log = &(Poco::Logger::get("StoreRequestGet"));
         auto node = store.getNode(zk_request->getPath());
         if (node == nullptr)
             return true;
 
-        const auto & node_acls = store.acl_map.convertNumber(node->acl_id);
-        LOG_TRACE(log, "path {}, acl_id {}, node_acls {}", zk_request->getPath(), node->acl_id, toString(node_acls));
-        if (node_acls.empty())
-            return true;
-
-        std::shared_lock r_lock(store.auth_mutex);
-        auto it = store.session_and_auth.find(session_id);
-        if (it != store.session_and_auth.end())
-        {
-            const auto & session_auths = it->second;
-            /// LOL, GetACL require more permissions, then SetACL...
-            return checkACL(Coordination::ACL::Read, node_acls, session_auths);
-        }
-        else
-        {
-            std::vector<Coordination::AuthID> empty_auth_ids;
-            return checkACL(Coordination::ACL::Read, node_acls, empty_auth_ids);
-        }
+        return store.checkPermission(session_id, node->acl_id, Coordination::ACL::Read);
     }
 
     std::pair<Coordination::ZooKeeperResponsePtr, Undo>
@@ -427,10 +494,17 @@ struct StoreRequestGet final : public StoreRequest
         }
         else
         {
+            auto fill_response = [&]
             {
                 response.stat = node->statForResponse();
-                response.data = node->data;
-            }
+                response.node_data = node->data;
+            };
+
+            /// Large data is referenced by response instead of serialized, caching it saves nothing.
+            if (node->data.size() < Coordination::ZooKeeperGetResponse::MIN_REFERENCED_DATA_SIZE)
+                fillReadResponse(store, request.path, *node, ResponseCache::Kind::Get, response, fill_response);
+            else
+                fill_response();
             response.error = Coordination::Error::ZOK;
         }
 
@@ -448,23 +522,7 @@ struct StoreRequestRemove final : public StoreRequest
         if (parent == nullptr)
             return true;
 
-        const auto & node_acls = store.acl_map.convertNumber(parent->acl_id);
-        if (node_acls.empty())
-            return true;
-
-        std::shared_lock r_lock(store.auth_mutex);
-        auto it = store.session_and_auth.find(session_id);
-        if (it != store.session_and_auth.end())
-        {
-            const auto & session_auths = it->second;
-            /// LOL, GetACL require more permissions, then SetACL...
-            return checkACL(Coordination::ACL::Delete, node_acls, session_auths);
-        }
-        else
-        {
-            std::vector<Coordination::AuthID> empty_auth_ids;
-            return checkACL(Coordination::ACL::Delete, node_acls, empty_auth_ids);
-        }
+        return store.checkPermission(session_id, parent->acl_id, Coordination::ACL::Delete);
     }
 
 
@@ -496,16 +554,18 @@ struct StoreRequestRemove final : public StoreRequest
             response.error = Coordination::Error::ZOK;
 
             int64_t pzxid;
-            auto prev_node = node->clone();
+            auto prev_node = node->clone(&store.getNodeArena(), request.path);
             auto child_basename = getBaseName(request.path);
 
-            auto parent = store.getNode(getParentPath(request.path));
+            auto parent_path = getParentPath(request.path);
+            auto parent = store.getNodeForUpdate(parent_path);
             {
                 --parent->stat.numChildren;
                 pzxid = parent->stat.pzxid;
                 parent->stat.pzxid = zxid;
                 parent->children.erase(child_basename);
             }
+            store.updateNodeMemory(parent_path, *parent);
 
             store.acl_map.removeUsage(prev_node->acl_id);
             store.removeNode(request.path);
@@ -515,21 +575,23 @@ struct StoreRequestRemove final : public StoreRequest
             if (prev_node->is_ephemeral)
             {
                 ephemeral_owner = prev_node->stat.ephemeralOwner;
-                store.removeEphemeralNode(ephemeral_owner, request.path);
+                store.removeEphemeralNode(ephemeral_owner, *prev_node);
             }
 
             undo = [prev_node, &store, ephemeral_owner, path = request.path, pzxid, child_basename] {
                 if (prev_node->is_ephemeral)
-                    store.addEphemeralNode(ephemeral_owner, path);
+                    store.addEphemeralNode(ephemeral_owner, path, *prev_node);
                 store.acl_map.addUsage(prev_node->acl_id);
 
                 store.addNode(path, prev_node);
-                auto undo_parent = store.getNode(getParentPath(path));
+                auto undo_parent_path = getParentPath(path);
+                auto undo_parent = store.getNodeForUpdate(undo_parent_path);
                 {
                     ++(undo_parent->stat.numChildren);
                     undo_parent->stat.pzxid = pzxid;
                     undo_parent->children.insert(child_basename);
                 }
+                store.updateNodeMemory(undo_parent_path, *undo_parent);
             };
         }
 
@@ -551,7 +613,9 @@ struct StoreRequestExists final : public StoreRequest
         auto node = store.getNode(request_typed.path);
         if (node != nullptr)
         {
-            response_typed.stat = node->statForResponse();
+            fillReadResponse(
+                store, request_typed.path, *node, ResponseCache::Kind::Exists, response_typed,
+                [&] { response_typed.stat = node->statForResponse(); });
             response_typed.error = Coordination::Error::ZOK;
         }
         else
@@ -573,23 +637,7 @@ struct StoreRequestSet final : public StoreRequest
         if (node == nullptr)
             return true;
 
-        const auto & node_acls = store.acl_map.convertNumber(node->acl_id);
-        if (node_acls.empty())
-            return true;
-
-        std::shared_lock r_lock(store.auth_mutex);
-        auto it = store.session_and_auth.find(session_id);
-        if (it != store.session_and_auth.end())
-        {
-            const auto & session_auths = it->second;
-            /// LOL, GetACL require more permissions, then SetACL...
-            return checkACL(Coordination::ACL::Write, node_acls, session_auths);
-        }
-        else
-        {
-            std::vector<Coordination::AuthID> empty_auth_ids;
-            return checkACL(Coordination::ACL::Write, node_acls, empty_auth_ids);
-        }
+        return store.checkPermission(session_id, node->acl_id, Coordination::ACL::Write);
     }
 
     std::pair<Coordination::ZooKeeperResponsePtr, Undo>
@@ -600,14 +648,14 @@ struct StoreRequestSet final : public StoreRequest
         auto & request_typed = dynamic_cast<Coordination::ZooKeeperSetRequest &>(*zk_request);
         Undo undo;
 
-        auto node = store.getNode(request_typed.path);
+        auto node = store.getNodeForUpdate(request_typed.path);
         if (node == nullptr)
         {
             response_typed.error = Coordination::Error::ZNONODE;
         }
         else if (request_typed.version == -1 || request_typed.version == node->stat.version)
         {
-            auto prev_node = node->clone();
+            auto prev_node = node->clone(&store.getNodeArena(), request_typed.path);
             {
                 ++node->stat.version;
                 node->stat.mzxid = zxid;
@@ -615,6 +663,7 @@ struct StoreRequestSet final : public StoreRequest
                 node->stat.dataLength = request_typed.data.length();
                 node->data = request_typed.data;
             }
+            store.updateNodeMemory(request_typed.path, *node);
 
             auto parent = store.getNode(getParentPath(request_typed.path));
             response_typed.stat = node->statForResponse();
@@ -641,23 +690,7 @@ struct StoreRequestList final : public StoreRequest
         if (node == nullptr)
             return true;
 
-        const auto & node_acls = store.acl_map.convertNumber(node->acl_id);
-        if (node_acls.empty())
-            return true;
-
-        std::shared_lock r_lock(store.auth_mutex);
-        auto it = store.session_and_auth.find(session_id);
-        if (it != store.session_and_auth.end())
-        {
-            const auto & session_auths = it->second;
-            /// LOL, GetACL require more permissions, then SetACL...
-            return checkACL(Coordination::ACL::Read, node_acls, session_auths);
-        }
-        else
-        {
-            std::vector<Coordination::AuthID> empty_auth_ids;
-            return checkACL(Coordination::ACL::Read, node_acls, empty_auth_ids);
-        }
+        return store.checkPermission(session_id, node->acl_id, Coordination::ACL::Read);
     }
 
     std::pair<Coordination::ZooKeeperResponsePtr, Undo>
@@ -688,18 +721,23 @@ struct StoreRequestList final : public StoreRequest
 
             auto & response_typed = dynamic_cast<Coordination::ZooKeeperListResponse &>(*response);
 
-            response_typed.stat = node->statForResponse();
-
             if (list_request_type == ALL)
             {
-                response_typed.names.reserve(node->children.size());
-                response_typed.names.push_back(node->children.begin(), node->children.end());
+                fillReadResponse(
+                    store, request_typed.path, *node, ResponseCache::Kind::List, response_typed,
+                    [&]
+                    {
+                        response_typed.stat = node->statForResponse();
+                        node->children.appendTo(response_typed.names);
+                    });
                 return {response, {}};
             }
 
+            response_typed.stat = node->statForResponse();
+
             auto add_child = [&](const auto & child)
             {
-                auto child_node = store.getNode(request_typed.path + "/" + child);
+                auto child_node = store.getNode(request_typed.path + "/" + String(child));
                 if (node == nullptr)
                 {
                     LOG_ERROR(
@@ -723,8 +761,9 @@ struct StoreRequestList final : public StoreRequest
         else
         {
             auto & response_typed = dynamic_cast<Coordination::ZooKeeperSimpleListResponse &>(*response);
-            response_typed.names.reserve(node->children.size());
-            response_typed.names.push_back(node->children.begin(), node->children.end());
+            fillReadResponse(
+                store, request_typed.path, *node, ResponseCache::Kind::SimpleList, response_typed,
+                [&] { node->children.appendTo(response_typed.names); });
         }
 
         response->error = Coordination::Error::ZOK;
@@ -743,23 +782,7 @@ struct StoreRequestCheck final : public StoreRequest
         if (node == nullptr)
             return true;
 
-        const auto & node_acls = store.acl_map.convertNumber(node->acl_id);
-        if (node_acls.empty())
-            return true;
-
-        std::shared_lock r_lock(store.auth_mutex);
-        auto it = store.session_and_auth.find(session_id);
-        if (it != store.session_and_auth.end())
-        {
-            const auto & session_auths = it->second;
-            /// LOL, GetACL require more permissions, then SetACL...
-            return checkACL(Coordination::ACL::Read, node_acls, session_auths);
-        }
-        else
-        {
-            std::vector<Coordination::AuthID> empty_auth_ids;
-            return checkACL(Coordination::ACL::Read, node_acls, empty_auth_ids);
-        }
+        return store.checkPermission(session_id, node->acl_id, Coordination::ACL::Read);
     }
 
     std::pair<Coordination::ZooKeeperResponsePtr, Undo>
@@ -796,22 +819,7 @@ struct StoreRequestSetACL final : public StoreRequest
         if (node == nullptr)
             return true;
 
-        const auto & node_acls = store.acl_map.convertNumber(node->acl_id);
-        if (node_acls.empty())
-            return true;
-
-        std::shared_lock r_lock(store.auth_mutex);
-        auto it = store.session_and_auth.find(session_id);
-        if (it != store.session_and_auth.end())
-        {
-            const auto & session_auths = it->second;
-            return checkACL(Coordination::ACL::Admin, node_acls, session_auths);
-        }
-        else
-        {
-            std::vector<Coordination::AuthID> empty_auth_ids;
-            return checkACL(Coordination::ACL::Admin, node_acls, empty_auth_ids);
-        }
+        return store.checkPermission(session_id, node->acl_id, Coordination::ACL::Admin);
     }
 
     std::pair<Coordination::ZooKeeperResponsePtr, Undo>
@@ -821,7 +829,7 @@ struct StoreRequestSetACL final : public StoreRequest
         auto & response_typed = dynamic_cast<Coordination::ZooKeeperSetACLResponse &>(*response);
         auto & request_typed = dynamic_cast<Coordination::ZooKeeperSetACLRequest &>(*zk_request);
 
-        auto node = store.getNode(request_typed.path);
+        auto node = store.getNodeForUpdate(request_typed.path);
         if (node == nullptr)
         {
             response_typed.error = Coordination::Error::ZNONODE;
@@ -847,7 +855,7 @@ struct StoreRequestSetACL final : public StoreRequest
             uint64_t acl_id = store.acl_map.convertACLs(node_acls);
             store.acl_map.addUsage(acl_id);
 
-            node->acl_id = acl_id;
+            store.updateNodeACL(request_typed.path, *node, acl_id);
             ++node->stat.aversion;
 
             response_typed.stat = node->stat;
@@ -869,23 +877,7 @@ struct StoreRequestGetACL final : public StoreRequest
         if (node == nullptr)
             return true;
 
-        const auto & node_acls = store.acl_map.convertNumber(node->acl_id);
-        if (node_acls.empty())
-            return true;
-
-        std::shared_lock r_lock(store.auth_mutex);
-        auto it = store.session_and_auth.find(session_id);
-        if (it != store.session_and_auth.end())
-        {
-            const auto & session_auths = it->second;
-            /// LOL, GetACL require more permissions, then SetACL...
-            return checkACL(Coordination::ACL::Admin | Coordination::ACL::Read, node_acls, session_auths);
-        }
-        else
-        {
-            std::vector<Coordination::AuthID> empty_auth_ids;
-            return checkACL(Coordination::ACL::Admin | Coordination::ACL::Read, node_acls, empty_auth_ids);
-        }
+        return store.checkPermission(session_id, node->acl_id, Coordination::ACL::Admin | Coordination::ACL::Read);
     }
 
     std::pair<Coordination::ZooKeeperResponsePtr, Undo>
@@ -936,6 +928,7 @@ struct StoreRequestAuth final : public StoreRequest
 
                 std::lock_guard w_lock(store.auth_mutex);
                 sessions_and_auth[session_id].emplace_back(auth);
+                store.updateSessionPermissions(session_id);
             }
             else
             {
@@ -944,7 +937,10 @@ struct StoreRequestAuth final : public StoreRequest
                 std::lock_guard w_lock(store.auth_mutex);
                 auto & session_ids = sessions_and_auth[session_id];
                 if (std::find(session_ids.begin(), session_ids.end(), auth) == session_ids.end())
+                {
                     sessions_and_auth[session_id].emplace_back(auth);
+                    store.updateSessionPermissions(session_id);
+                }
             }
         }
 
@@ -1105,20 +1101,10 @@ void KeeperStore::finalize()
 
     finalized = true;
 
-    for (const auto & [session_id, ephemerals_paths] : ephemerals)
-        for (const String & ephemeral_path : ephemerals_paths)
-        {
-            auto parent = data_tree.at(getParentPath(ephemeral_path));
-            {
-                --parent->stat.numChildren;
-                parent->children.erase(getBaseName(ephemeral_path));
-            }
-            data_tree.erase(ephemeral_path);
-        }
-
+    for (const auto & [session_id, _] : ephemerals.getAll())
     {
-        std::lock_guard lock(ephemerals_mutex);
-        ephemerals.clear();
+        auto paths = ephemerals.extract(session_id);
+        removeEphemeralNodes(paths);
     }
 
     session_manager.reset();
@@ -1127,6 +1113,8 @@ void KeeperStore::finalize()
     {
         std::lock_guard auth_lock(auth_mutex);
         session_and_auth.clear();
+        session_permissions.clear();
+        onSessionPermissionsChanged();
     }
 }
 
@@ -1174,6 +1162,9 @@ StoreRequestFactory::StoreRequestFactory()
 {
     registerNuKeeperRequestWrapper<Coordination::OpNum::Heartbeat, StoreRequestHeartbeat>(*this);
     registerNuKeeperRequestWrapper<Coordination::OpNum::SetWatches, StoreRequestSetWatches>(*this);
+    registerNuKeeperRequestWrapper<Coordination::OpNum::AddWatch, StoreRequestAddWatch>(*this);
+    registerNuKeeperRequestWrapper<Coordination::OpNum::CheckWatches, StoreRequestWatches>(*this);
+    registerNuKeeperRequestWrapper<Coordination::OpNum::RemoveWatches, StoreRequestWatches>(*this);
     registerNuKeeperRequestWrapper<Coordination::OpNum::Sync, StoreRequestSync>(*this);
     registerNuKeeperRequestWrapper<Coordination::OpNum::Auth, StoreRequestAuth>(*this);
     registerNuKeeperRequestWrapper<Coordination::OpNum::Close, StoreRequestClose>(*this);
@@ -1194,7 +1185,7 @@ StoreRequestFactory::StoreRequestFactory()
 
 
 void KeeperStore::processRequest(
-    ThreadSafeQueue<ResponseForSession> & responses_queue,
+    KeeperResponsesQueue & responses_queue,
     const RequestForSession & request_for_session,
     std::optional<int64_t> new_last_zxid,
     bool check_acl,
@@ -1213,29 +1204,40 @@ void KeeperStore::processRequest(
     const auto & zk_request = request_for_session.request;
     const auto session_id = request_for_session.session_id;
 
-    if (zk_request->getOpNum() == Coordination::OpNum::Close)
+    if (zk_request->getOpNum() == Coordination::OpNum::Close && !new_last_zxid && session_manager.isLocalSession(session_id))
     {
-        LOG_DEBUG(log, "Clean ephemeral nodes and watches for {}", toHexString(session_id));
-        cleanEphemeralNodes(session_id, responses_queue, ignore_response);
+        /// Local session is closed by its owner without Raft, it has no ephemeral nodes and auth.
         watch_manager.cleanDeadWatches(session_id);
-
-        LOG_DEBUG(log, "Clean auth for {}", toHexString(session_id));
-        /// clean auth for session
-        {
-            std::lock_guard lock(auth_mutex);
-            session_and_auth.erase(session_id);
-        }
-
-        LOG_INFO(log, "Expire session {}", toHexString(session_id));
-        session_manager.expireSession(session_id);
+        session_manager.removeLocalSession(session_id);
+        LOG_DEBUG(log, "Local session {} closed", toHexString(session_id));
 
         auto response = std::make_shared<Coordination::ZooKeeperCloseResponse>();
         response->xid = zk_request->xid;
-        response->zxid = new_last_zxid ? zxid.load() : fetchAndGetZxid();
-
+        response->zxid = zxid;
         set_response(responses_queue, ResponseForSession{session_id, response}, ignore_response);
         return;
     }
+    else if (zk_request->getOpNum() == Coordination::OpNum::Close || zk_request->getOpNum() == Coordination::OpNum::CloseSessions)
+    {
+        std::vector<int64_t> session_ids;
+        if (zk_request->getOpNum() == Coordination::OpNum::Close)
+            session_ids.push_back(session_id);
+        else
+            session_ids = dynamic_cast<const Coordination::ZooKeeperCloseSessionsRequest &>(*zk_request).session_ids;
+
+        closeSessions(session_ids, responses_queue, ignore_response);
+
+        /// Sessions closed in batch share the zxid of the request.
+        auto response_zxid = new_last_zxid ? zxid.load() : fetchAndGetZxid();
+        for (auto closed_session_id : session_ids)
+        {
+            auto response = std::make_shared<Coordination::ZooKeeperCloseResponse>();
+            response->xid = zk_request->xid;
+            response->zxid = response_zxid;
+            set_response(responses_queue, ResponseForSession{closed_session_id, response}, ignore_response);
+        }
+        return;
+    }
     else if (isNewSessionRequest(zk_request->getOpNum()))
     {
         auto * new_session_req = dynamic_cast<Coordination::ZooKeeperNewSessionRequest *>(zk_request.get());
@@ -1274,8 +1276,27 @@ void KeeperStore::processRequest(
         set_response(responses_queue, ResponseForSession{session_id, response}, ignore_response);
         return;
     }
+    else if (zk_request->getOpNum() == Coordination::OpNum::UpgradeSession)
+    {
+        auto * upgrade_session_req = dynamic_cast<Coordination::ZooKeeperUpgradeSessionRequest *>(zk_request.get());
+        assert(upgrade_session_req != nullptr);
+
+        auto response = upgrade_session_req->makeResponse();
+        auto * upgrade_session_resp = dynamic_cast<Coordination::ZooKeeperUpgradeSessionResponse *>(response.get());
+
+        upgrade_session_resp->zxid = new_last_zxid ? zxid.load() : fetchAndGetZxid();
+        session_manager.upgradeSession(upgrade_session_req->session_id, upgrade_session_req->session_timeout_ms);
+        upgrade_session_resp->success = true;
+
+        set_response(responses_queue, ResponseForSession{session_id, response}, ignore_response);
+        return;
+    }
 
-    if (!session_manager.contains(session_id) && !new_last_zxid)
+    /// Local sessions are only allowed to read, they are upgraded before writing.
+    bool valid_session = session_manager.contains(session_id)
+        || (zk_request->isReadRequest() && session_manager.containsLocalSession(session_id));
+
+    if (!valid_session && !new_last_zxid)
     {
         LOG_WARNING(
             log,
@@ -1310,120 +1331,149 @@ void KeeperStore::processRequest(
         std::unordered_map<String, std::pair<int64_t, int64_t>> watch_nodes_info;
         for (String & path : request->data_watches)
         {
-            if (auto node = data_tree.get(path))
+            if (auto node = data_tree->get(path))
                 watch_nodes_info.emplace(path, std::make_pair(node->stat.mzxid, node->stat.pzxid));
         }
 
         auto watch_responses = watch_manager.processRequestSetWatch(request_for_session, watch_nodes_info);
-        set_response(responses_queue, watch_responses, ignore_response);
+        set_response(responses_queue, groupWatchResponses(watch_responses), ignore_response);
 
         /// no response for SetWatches request
         set_response(responses_queue, ResponseForSession{session_id, response}, ignore_response);
     }
     else
     {
-        StoreRequestPtr store_request = StoreRequestFactory::instance().get(zk_request);
-        Coordination::ZooKeeperResponsePtr response;
+        /// Transaction zxid, it is consumed after processing if the request is a write request
+        int64_t txn_zxid = zxid;
+        processRequestWithZxid(responses_queue, request_for_session, txn_zxid, check_acl, ignore_response);
+        if (!new_last_zxid && shouldIncreaseZxid(zk_request))
+            fetchAndGetZxid();
+    }
+}
 
-        if (check_acl && !store_request->checkAuth(*this, session_id))
-        {
-            response = zk_request->makeResponse();
-            /// Original ZooKeeper always throws no auth, even when user provided some credentials
-            response->error = Coordination::Error::ZNOAUTH;
-        }
-        else
-        {
-            response = store_request->process(*this, zxid, session_id, request_for_session.process_time).first;
-        }
+void KeeperStore::processWriteRequest(
+    KeeperResponsesQueue & responses_queue, const RequestForSession & request_for_session, int64_t txn_zxid)
+{
+    LOG_TRACE(log, "Processing request {} with zxid {}", request_for_session.toSimpleString(), txn_zxid);
+    session_manager.updateSessionExpirationTime(request_for_session.session_id);
+    processRequestWithZxid(responses_queue, request_for_session, txn_zxid, true, false);
+}
 
-        response->request_created_time_ms = request_for_session.create_time;
-        response->xid = zk_request->xid;
-        response->zxid = new_last_zxid ? zxid.load() : (shouldIncreaseZxid(zk_request) ? fetchAndGetZxid() : zxid.load());
+void KeeperStore::processRequestWithZxid(
+    KeeperResponsesQueue & responses_queue,
+    const RequestForSession & request_for_session,
+    int64_t txn_zxid,
+    bool check_acl,
+    bool ignore_response)
+{
+    const auto & zk_request = request_for_session.request;
+    const auto session_id = request_for_session.session_id;
 
-        if (response->error != Coordination::Error::ZOK)
-            LOG_DEBUG(
-                log,
-                "Error when processing request {} with error no {}",
-                request_for_session.toSimpleString(),
-                Coordination::errorMessage(response->error));
+    StoreRequestPtr store_request = StoreRequestFactory::instance().get(zk_request);
+    Coordination::ZooKeeperResponsePtr response;
 
-        if (zk_request->isReadRequest())
+    if (check_acl && !store_request->checkAuth(*this, session_id))
+    {
+        response = zk_request->makeResponse();
+        /// Original ZooKeeper always throws no auth, even when user provided some credentials
+        response->error = Coordination::Error::ZNOAUTH;
+    }
+    else
+    {
+        response = store_request->process(*this, txn_zxid, session_id, request_for_session.process_time).first;
+    }
+
+    response->request_created_time_ms = request_for_session.create_time;
+    response->xid = zk_request->xid;
+    response->zxid = txn_zxid;
+
+    if (response->error != Coordination::Error::ZOK)
+        LOG_DEBUG(
+            log,
+            "Error when processing request {} with error no {}",
+            request_for_session.toSimpleString(),
+            Coordination::errorMessage(response->error));
+
+    if (zk_request->isReadRequest())
+    {
+        /// register watch
+        if (zk_request->has_watch && (response->error == Coordination::Error::ZOK
+            || (response->error == Coordination::Error::ZNONODE && zk_request->getOpNum() == Coordination::OpNum::Exists)))
         {
-            /// register watch
-            if (zk_request->has_watch && (response->error == Coordination::Error::ZOK
-                || (response->error == Coordination::Error::ZNONODE && zk_request->getOpNum() == Coordination::OpNum::Exists)))
-            {
-                LOG_TRACE(log, "Register watch for {}, path {}", request_for_session.toSimpleString(), zk_request->getPath());
-                watch_manager.registerWatches(zk_request->getPath(), session_id, zk_request->getOpNum());
-            }
-            /// push response to queue
-            set_response(responses_queue, ResponseForSession{session_id, response}, ignore_response);
+            LOG_TRACE(log, "Register watch for {}, path {}", request_for_session.toSimpleString(), zk_request->getPath());
+            watch_manager.registerWatches(zk_request->getPath(), session_id, zk_request->getOpNum());
         }
-        else
+        /// push response to queue
+        set_response(responses_queue, ResponseForSession{session_id, response}, ignore_response);
+    }
+    else
+    {
+        /// Trigger watches
+        if (response->error == Coordination::Error::ZOK)
         {
-            /// Trigger watches
-            if (response->error == Coordination::Error::ZOK)
+            /// Trigger watches for all requests
+            if (zk_request->getOpNum() == Coordination::OpNum::Multi)
             {
-                /// Trigger watches for all requests
-                if (zk_request->getOpNum() == Coordination::OpNum::Multi)
+                auto multi_response = std::dynamic_pointer_cast<Coordination::ZooKeeperMultiWriteResponse>(response);
+                /// An multi request allows you to execute multiple operations within a single transaction.
+                /// If any one of these operations fails, the before transaction will be rolled back, and rest operations will set to an error code
+                /// So we only check last response code to determine if we need to trigger watches
+                if (!multi_response->responses.empty() && multi_response->responses.back()->error == Coordination::Error::ZOK)
                 {
-                    auto multi_response = std::dynamic_pointer_cast<Coordination::ZooKeeperMultiWriteResponse>(response);
-                    /// An multi request allows you to execute multiple operations within a single transaction.
-                    /// If any one of these operations fails, the before transaction will be rolled back, and rest operations will set to an error code
-                    /// So we only check last response code to determine if we need to trigger watches
-                    if (!multi_response->responses.empty() && multi_response->responses.back()->error == Coordination::Error::ZOK)
+                    auto * multi_request = dynamic_cast<Coordination::ZooKeeperMultiRequest *>(zk_request.get());
+                    ResponsesForSessions watch_responses;
+                    for (auto & concrete_request : multi_request->requests)
                     {
-                        auto * multi_request = dynamic_cast<Coordination::ZooKeeperMultiRequest *>(zk_request.get());
-                        for (auto & concrete_request : multi_request->requests)
-                        {
-                            const auto * sub_zk_request = dynamic_cast<Coordination::ZooKeeperRequest *>(concrete_request.get());
-                            auto watch_responses = watch_manager.processWatches(sub_zk_request->getPath(), sub_zk_request->getOpNum());
-                            if (!watch_responses.empty())
-                            {
-                                LOG_TRACE(log, "{} triggered {} watches", request_for_session.toSimpleString(), watch_responses.size());
-                                set_response(responses_queue, watch_responses, ignore_response);
-                            }
-                        }
+                        const auto * sub_zk_request = dynamic_cast<Coordination::ZooKeeperRequest *>(concrete_request.get());
+                        auto sub_watch_responses = watch_manager.processWatches(sub_zk_request->getPath(), sub_zk_request->getOpNum());
+                        watch_responses.insert(watch_responses.end(), sub_watch_responses.begin(), sub_watch_responses.end());
                     }
-                }
-                else
-                {
-                    auto watch_responses = watch_manager.processWatches(zk_request->getPath(), zk_request->getOpNum());
                     if (!watch_responses.empty())
                     {
                         LOG_TRACE(log, "{} triggered {} watches", request_for_session.toSimpleString(), watch_responses.size());
-                        set_response(responses_queue, watch_responses, ignore_response);
+                        set_response(responses_queue, groupWatchResponses(watch_responses), ignore_response);
                     }
                 }
             }
-
-            /// push response to queue
-            set_response(responses_queue, ResponseForSession{session_id, response}, ignore_response);
+            else
+            {
+                auto watch_responses = watch_manager.processWatches(zk_request->getPath(), zk_request->getOpNum());
+                if (!watch_responses.empty())
+                {
+                    LOG_TRACE(log, "{} triggered {} watches", request_for_session.toSimpleString(), watch_responses.size());
+                    set_response(responses_queue, groupWatchResponses(watch_responses), ignore_response);
+                }
+            }
         }
+
+        /// push response to queue
+        set_response(responses_queue, ResponseForSession{session_id, response}, ignore_response);
     }
 }
 
 void KeeperStore::buildChildrenSet(bool from_zk_snapshot)
 {
-    for (UInt32 bucket_id = 0; bucket_id < data_tree.getBucketNum(); bucket_id++)
+    for (UInt32 bucket_id = 0; bucket_id < data_tree->getBucketNum(); bucket_id++)
     {
-        for (const auto & it : data_tree.getMap(bucket_id).getMap())
+        data_tree->forEach(bucket_id, [this, from_zk_snapshot](const String & path, const KeeperNodePtr &)
         {
-            if (it.first == "/")
-                continue;
+            if (path == "/")
+                return;
 
-            auto parent_path = getParentPath(it.first);
-            auto child_path = getBaseName(it.first);
-            auto parent = data_tree.get(parent_path);
+            auto parent_path = getParentPath(path);
+            auto child_path = getBaseName(path);
+            auto parent = data_tree->get(parent_path);
 
             if (parent == nullptr)
-                throw RK::Exception(ErrorCodes::LOGICAL_ERROR, "Error when building children set, can not find parent for node {}", it.first);
+                throw RK::Exception(ErrorCodes::LOGICAL_ERROR, "Error when building children set, can not find parent for node {}", path);
 
             parent->children.insert(child_path);
             if (from_zk_snapshot)
                 parent->stat.numChildren++;
-        }
+        });
     }
+
+    recalculateDataTreeMemory();
 }
 
 void KeeperStore::fillDataTreeBucket(const std::vector<BucketNodes> & all_objects_nodes, UInt32 bucket_id)
@@ -1432,7 +1482,7 @@ void KeeperStore::fillDataTreeBucket(const std::vector<BucketNodes> & all_object
     {
         for (auto && [path, node] : object_nodes[bucket_id])
         {
-            if (!data_tree.emplace(path, std::move(node), bucket_id) && path != "/")
+            if (!data_tree->emplace(path, std::move(node), bucket_id) && path != "/")
                 throw RK::Exception(RK::ErrorCodes::LOGICAL_ERROR, "Error when filling data tree bucket {}, duplicated node {}", bucket_id, path);
         }
     }
@@ -1444,53 +1494,85 @@ void KeeperStore::buildBucketChildren(const std::vector<BucketEdges> & all_objec
     {
         for (const auto & [parent_path, path] : object_edges[bucket_id])
         {
-            auto parent = data_tree.get(parent_path);
+            auto parent = data_tree->get(parent_path);
 
             if (unlikely(parent == nullptr))
                 throw RK::Exception(RK::ErrorCodes::LOGICAL_ERROR, "Can not find parent for node {}", path);
 
-            parent->children.emplace(std::move(path));
+            parent->children.insert(path);
         }
     }
 }
 
-void KeeperStore::cleanEphemeralNodes(int64_t session_id, ThreadSafeQueue<ResponseForSession> & responses_queue, bool ignore_response)
+void KeeperStore::closeSessions(
+    const std::vector<int64_t> & session_ids, KeeperResponsesQueue & responses_queue, bool ignore_response)
 {
-    LOG_DEBUG(log, "Clean ephemeral nodes for session {}", toHexString(session_id));
+    Strings paths;
+    for (auto session_id : session_ids)
+    {
+        auto session_paths = ephemerals.extract(session_id);
+        LOG_DEBUG(log, "Clean {} ephemeral nodes and watches for session {}", session_paths.size(), toHexString(session_id));
+        paths.insert(paths.end(), std::make_move_iterator(session_paths.begin()), std::make_move_iterator(session_paths.end()));
+    }
 
-    std::lock_guard lock(ephemerals_mutex);
-    auto it = ephemerals.find(session_id);
+    if (!paths.empty())
+    {
+        removeEphemeralNodes(paths);
+        auto responses = watch_manager.processWatches(paths, Coordination::Event::DELETED);
+        set_response(responses_queue, groupWatchResponses(responses), ignore_response);
+    }
+
+    watch_manager.cleanDeadWatches(session_ids);
 
-    if (it != ephemerals.end())
+    /// clean auth for sessions
     {
-        for (const auto & ephemeral_path : it->second)
+        std::lock_guard lock(auth_mutex);
+        size_t erased_permissions = 0;
+        for (auto session_id : session_ids)
         {
-            LOG_TRACE(log, "Disconnect session {}, deleting its ephemeral node {}", toHexString(session_id), ephemeral_path);
-            auto parent = data_tree.at(getParentPath(ephemeral_path));
-            if (!parent)
-            {
-                LOG_ERROR(
-                    log,
-                    "Logical error, disconnect session {}, ephemeral znode parent not exist {}",
-                    toHexString(session_id),
-                    ephemeral_path);
-            }
-            else
-            {
-                --parent->stat.numChildren;
-                parent->children.erase(getBaseName(ephemeral_path));
-            }
-            data_tree.erase(ephemeral_path);
-
-            auto responses = watch_manager.processWatches(ephemeral_path, Coordination::Event::DELETED);
-            set_response(responses_queue, responses, ignore_response);
+            session_and_auth.erase(session_id);
+            erased_permissions += session_permissions.erase(session_id);
         }
-        ephemerals.erase(it);
+        if (erased_permissions)
+            onSessionPermissionsChanged();
     }
+
+    if (session_ids.size() == 1)
+        LOG_INFO(log, "Expire session {}", toHexString(session_ids.front()));
     else
+        LOG_INFO(log, "Expire {} sessions, removed {} ephemeral nodes", session_ids.size(), paths.size());
+    session_manager.expireSessions(session_ids);
+}
+
+void KeeperStore::removeEphemeralNodes(Strings & paths)
+{
+    auto parent_of = [](const String & path) { return std::string_view(path).substr(0, std::max<size_t>(path.rfind('/'), 1)); };
+    std::sort(paths.begin(), paths.end(), [&](const String & lhs, const String & rhs) { return parent_of(lhs) < parent_of(rhs); });
+
+    for (size_t begin = 0, end = 0; begin < paths.size(); begin = end)
     {
-        LOG_DEBUG(log, "Session {} has no ephemeral nodes", toHexString(session_id));
+        auto parent_view = parent_of(paths[begin]);
+        for (end = begin + 1; end < paths.size() && parent_of(paths[end]) == parent_view;)
+            ++end;
+
+        String parent_path(parent_view);
+        auto parent = getNodeForUpdate(parent_path);
+        if (!parent)
+        {
+            LOG_ERROR(log, "Logical error, parent {} of {} ephemeral nodes not exist", parent_path, end - begin);
+            continue;
+        }
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            --parent->stat.numChildren;
+            parent->children.erase(getBaseName(paths[i]));
+        }
+        updateNodeMemory(parent_path, *parent);
     }
+
+    for (const auto & path : paths)
+        removeNode(path);
 }
 
 void KeeperStore::dumpSessionsAndEphemerals(WriteBufferFromOwnString & buf) const
@@ -1506,28 +1588,19 @@ void KeeperStore::dumpSessionsAndEphemerals(WriteBufferFromOwnString & buf) cons
     session_manager.dumpSessionIDs(buf);
 
     buf << "Sessions with Ephemerals (" << getSessionWithEphemeralNodesCount() << "):\n";
-    std::lock_guard lock(ephemerals_mutex);
-    for (const auto & [session_id, ephemeral_paths] : ephemerals)
+    for (const auto & [session_id, ephemeral_paths] : ephemerals.getAll())
     {
         buf << toHexString(session_id) << "\n";
         write_str_set(ephemeral_paths);
     }
 }
 
-uint64_t KeeperStore::getTotalEphemeralNodesCount() const
-{
-    std::lock_guard lock(ephemerals_mutex);
-    uint64_t ret = 0;
-    for (const auto & [session_id, nodes] : ephemerals)
-        ret += nodes.size();
-
-    return ret;
-}
-
 
 void KeeperStore::reset()
 {
-    data_tree.clear();
+    data_tree->clear();
+    memory_tracker.reset();
+    response_cache.clear();
     zxid = 0;
 
     acl_map.reset();
@@ -1537,82 +1610,76 @@ void KeeperStore::reset()
     {
         std::lock_guard lock(auth_mutex);
         session_and_auth.clear();
+        session_permissions.clear();
+        onSessionPermissionsChanged();
     }
 
     {
-        std::lock_guard lock(ephemerals_mutex);
         ephemerals.clear();
     }
 }
 
-std::shared_ptr<KeeperStore::BucketNodes> KeeperStore::dumpDataTree()
+void KeeperStore::updateSessionPermissions(int64_t session_id)
 {
-    auto result = std::make_shared<KeeperStore::BucketNodes>();
-    ThreadPool object_thread_pool(DATA_TREE_BUCKET_NUM);
+    auto it = session_and_auth.find(session_id);
+    if (it == session_and_auth.end() || it->second.empty())
+        session_permissions.erase(session_id);
+    else
+        session_permissions[session_id] = std::make_shared<SessionPermissions>(acl_map, it->second);
+    onSessionPermissionsChanged();
+}
 
-    for (UInt32 thread_idx = 0; thread_idx < DATA_TREE_BUCKET_NUM; thread_idx++)
-    {
-        object_thread_pool.trySchedule(
-            [thread_idx, this, &result]
-            {
-                for (UInt32 bucket_idx = 0; bucket_idx < DATA_TREE_BUCKET_NUM; bucket_idx++)
-                {
-                    if (bucket_idx % DATA_TREE_BUCKET_NUM != thread_idx)
-                        continue;
+void KeeperStore::onSessionPermissionsChanged()
+{
+    session_permissions_version.store(nextSessionPermissionsVersion(), std::memory_order_release);
+}
 
-                    LOG_INFO(log, "Dump data tree for bucket {}", bucket_idx);
+bool KeeperStore::checkPermission(int64_t session_id, uint64_t acl_id, int32_t permission) const
+{
+    if (acl_id == 0)
+        return true;
 
-                    auto && bucket = this->data_tree.getMap(bucket_idx).getMap();
-                    auto & bucket_in_result = (*result)[bucket_idx];
-                    bucket_in_result.reserve(bucket.size());
+    struct CachedPermissions
+    {
+        UInt64 version = 0;
+        std::shared_ptr<const SessionPermissionsMap> permissions;
+    };
+    thread_local CachedPermissions cached;
 
-                    size_t key_size = 0;
-                    for (auto it = bucket.begin(); it != bucket.end(); ++it)
-                    {
-                        auto data_size = it->first.size();
-                        key_size += data_size;
-
-                        String path_copied;
-                        path_copied.resize(data_size);
-                        memcopy(path_copied.data(), it->first.data(), data_size);
-
-                        bucket_in_result.emplace_back(std::move(path_copied), it->second->cloneWithoutChildren());
-
-                        /// Prefetch the next element, may slightly improve performance in this case.
-                        auto next_it = std::next(it);
-                        if (likely(next_it != bucket.end()))
-                        {
-                            __builtin_prefetch(next_it->first.data(), 0, 3);
-                            __builtin_prefetch(next_it->second.get(), 0, 3);
-                        }
-                    }
-                    LOG_INFO(log, "Dump data tree for bucket {} done, key_size {}, result size {}", bucket_idx, key_size, bucket_in_result.size());
-                }
-            });
+    if (cached.version != session_permissions_version.load(std::memory_order_acquire))
+    {
+        /// Exclusive lock, the copy is published at most once for a version and shared by all threads.
+        std::lock_guard lock(auth_mutex);
+        auto version = session_permissions_version.load(std::memory_order_relaxed);
+        if (published_permissions_version != version)
+        {
+            published_permissions = std::make_shared<const SessionPermissionsMap>(session_permissions);
+            published_permissions_version = version;
+        }
+        cached = {version, published_permissions};
     }
 
-    object_thread_pool.wait();
-    return result;
+    auto it = cached.permissions->find(session_id);
+    const auto & permissions = it == cached.permissions->end() ? anonymous_permissions : *it->second;
+    return permissions.check(acl_id, permission);
 }
 
 uint64_t KeeperStore::getApproximateDataSize() const
 {
-    UInt64 node_count = data_tree.size();
-    UInt64 size_bytes = data_tree.getBucketNum() * sizeof(DataTree::InnerMap) /* Inner map size */
-        + node_count * 8 / 0.75 /*hash map array size*/
-        + node_count * sizeof(KeeperNode) /*node size*/
-        + node_count * 100; /*path and child of node size*/
-    return size_bytes;
+    return memory_tracker.getTotal().totalBytes();
 }
 
 void KeeperStore::initializeSystemNodes()
 {
     auto add_node = [&](const String & path)
     {
-        if (!data_tree.count(path))
+        if (!data_tree->count(path))
         {
-            data_tree.emplace(path, std::make_shared<KeeperNode>());
-            getNode(getParentPath(path))->children.insert(getBaseName(path));
+            addNode(path, makeNode(path));
+            auto parent_path = getParentPath(path);
+            auto parent = getNodeForUpdate(parent_path);
+            parent->children.insert(getBaseName(path));
+            updateNodeMemory(parent_path, *parent);
         }
     };
 
@@ -1624,7 +1691,9 @@ void KeeperStore::initializeSystemNodes()
     add_node(CLICKHOUSE_KEEPER_SYSTEM_PATH);
     add_node(CLICKHOUSE_KEEPER_API_VERSION_PATH);
 
-    data_tree.get(CLICKHOUSE_KEEPER_API_VERSION_PATH)->data = toString(static_cast<uint8_t>(CURRENT_KEEPER_API_VERSION));
+    auto api_version_node = getNodeForUpdate(CLICKHOUSE_KEEPER_API_VERSION_PATH);
+    api_version_node->data = toString(static_cast<uint8_t>(CURRENT_KEEPER_API_VERSION));
+    updateNodeMemory(CLICKHOUSE_KEEPER_API_VERSION_PATH, *api_version_node);
 #endif
 }
 
@@ -5,9 +5,13 @@
 #include <unordered_set>
 #include <vector>
 #include <Service/ACLMap.h>
+#include <Service/DataTreeMemoryTracker.h>
+#include <Service/EphemeralNodes.h>
+#include <Service/KeeperDataTree.h>
+#include <Service/ResponseCache.h>
 #include <Service/SessionManager.h>
 #include <Service/WatchManager.h>
-#include <Service/ThreadSafeQueue.h>
+#include <Service/ResponsesQueue.h>
 #include <Service/KeeperCommon.h>
 #include <Service/formatHex.h>
 #include <ZooKeeper/IKeeper.h>
@@ -22,193 +26,52 @@
 namespace RK
 {
 
-/**
- * Represent an entry in data tree.
- */
-struct KeeperNode
-{
-    using ChildrenSet = std::unordered_set<String>;
-
-    String data;
-    uint64_t acl_id = 0;
-
-    bool is_ephemeral = false;
-    bool is_sequential = false;
-
-    Coordination::Stat stat{};
-    ChildrenSet children;
-
-    std::shared_ptr<KeeperNode> clone() const;
-    std::shared_ptr<KeeperNode> cloneWithoutChildren() const;
-
-    /// All stat for client should be generated by this function.
-    /// This method will remove numChildren from persisted stat.
-    Coordination::Stat statForResponse() const;
-
-    bool operator==(const KeeperNode & rhs) const
-    {
-        return data == rhs.data && acl_id == rhs.acl_id && is_ephemeral == rhs.is_ephemeral && is_sequential == rhs.is_sequential
-            && children == rhs.children;
-    }
-    bool operator!=(const KeeperNode & rhs) const { return !(rhs == *this); }
-};
-
-using KeeperNodePtr = std::shared_ptr<KeeperNode>;
-
-struct KeeperNodeWithPath
-{
-    String path;
-    KeeperNodePtr node;
-};
-
-/// KeeperNodeMap is a two-level unordered_map which is designed to reduce latency for unordered_map scaling.
-/// It is not a thread-safe map. But it is accessed only in the request processor thread.
-template <typename Value, unsigned NumBuckets>
-class KeeperNodeMap
-{
-public:
-    using Key = String;
-    using ValuePtr = std::shared_ptr<Value>;
-    using NestedMap = std::unordered_map<String, ValuePtr>;
-    using Action = std::function<void(const String &, const ValuePtr &)>;
-
-    class InnerMap
-    {
-    public:
-        ValuePtr get(const String & key)
-        {
-            auto i = map.find(key);
-            return (i != map.end()) ? i->second : nullptr;
-        }
-
-        template <typename T>
-        bool emplace(const String & key, T && value)
-        {
-            return map.insert_or_assign(key, value).second;
-        }
-
-        bool erase(const String & key)
-        {
-            return map.erase(key);
-        }
-
-        size_t size() const
-        {
-            return map.size();
-        }
-
-        void clear()
-        {
-            map.clear();
-        }
-
-        void forEach(const Action & fn)
-        {
-            for (const auto & [key, value] : map)
-                fn(key, value);
-        }
-
-        /// This method will destroy InnerMap thread safety property.
-        /// Deprecated, please use forEach instead.
-        NestedMap & getMap() { return map; }
-
-    private:
-        NestedMap map;
-    };
-
-private:
-    inline InnerMap & mapFor(const String & key) { return buckets[hash(key) % NumBuckets]; }
-
-    std::array<InnerMap, NumBuckets> buckets;
-    std::hash<String> hash;
-    std::atomic<size_t> node_count{0};
-
-public:
-    ValuePtr get(const String & key) { return mapFor(key).get(key); }
-    ValuePtr at(const String & key) { return mapFor(key).get(key); }
-
-    template <typename T>
-    bool emplace(const String & key, T && value)
-    {
-        if (mapFor(key).emplace(key, std::forward<T>(value)))
-        {
-            node_count++;
-            return true;
-        }
-        return false;
-    }
-
-    template <typename T>
-    bool emplace(const String & key, T && value, UInt32 bucket_id)
-    {
-        if (buckets[bucket_id].emplace(key, std::forward<T>(value)))
-        {
-            node_count++;
-            return true;
-        }
-        return false;
-    }
-
-    bool erase(String const & key)
-    {
-        if (mapFor(key).erase(key))
-        {
-            node_count--;
-            return true;
-        }
-        return false;
-    }
-
-    size_t count(const String & key) { return get(key) != nullptr ? 1 : 0; }
-
-    UInt32 getBucketIndex(const String & key) { return hash(key) % NumBuckets; }
-    UInt32 getBucketNum() const { return NumBuckets; }
-
-    InnerMap & getMap(const UInt32 & bucket_id) { return buckets[bucket_id]; }
-
-    void clear()
-    {
-        for (auto & bucket : buckets)
-            bucket.clear();
-        node_count.store(0);
-    }
-
-    size_t size() const
-    {
-        return node_count.load();
-    }
-};
-
 /// KeeperStore hold data tree, sessions, watches and auths. It is under state machine.
 class KeeperStore
 {
 public:
-    /// bucket num for KeeperNodeMap
+    /// Default bucket num for data tree, the actual one is decided by data tree engine.
     static constexpr int DATA_TREE_BUCKET_NUM = 16;
-    using DataTree = KeeperNodeMap<KeeperNode, DATA_TREE_BUCKET_NUM>;
+    using DataTree = IDataTree;
 
-    using KeeperResponsesQueue = ThreadSafeQueue<ResponseForSession>;
+    using KeeperResponsesQueue = ResponsesQueue;
 
     using SessionAndAuth = std::unordered_map<int64_t, Coordination::AuthIDs>;
-    using Ephemerals = std::unordered_map<int64_t, std::unordered_set<String>>;
+    using Ephemerals = EphemeralNodes::Ephemerals;
 
     /// Hold Edges in different Buckets based on the parent node's bucket number.
     /// It should be used when load snapshot to built node's childrenSet in parallel without lock.
     using Edge = std::pair<String, String>;
     using Edges = std::vector<Edge>;
-    using BucketEdges = std::array<Edges, DATA_TREE_BUCKET_NUM>;
-    using BucketNodes = std::array<std::vector<std::pair<String, std::shared_ptr<KeeperNode>>>, DATA_TREE_BUCKET_NUM>;
-
-    explicit KeeperStore(int64_t dead_session_check_period_ms, const String & super_digest_ = "");
+    /// Both of them should be sized to getDataTreeBucketNum().
+    using BucketEdges = std::vector<Edges>;
+    using BucketNodes = std::vector<std::vector<std::pair<String, std::shared_ptr<KeeperNode>>>>;
+
+    explicit KeeperStore(
+        int64_t dead_session_check_period_ms,
+        const String & super_digest_ = "",
+        DataTreeEngine data_tree_engine = DataTreeEngine::HASH_MAP,
+        UInt32 data_tree_bucket_num = 0,
+        UInt32 memory_subtree_depth = 3,
+        UInt64 response_cache_size = 0);
 
     /// process request
     void processRequest(
-        ThreadSafeQueue<ResponseForSession> & responses_queue,
+        KeeperResponsesQueue & responses_queue,
         const RequestForSession & request_for_session,
         std::optional<int64_t> new_last_zxid = {}, /// empty when we are converting zookeeper log to raftkeeper data.
         bool check_acl = true,
         bool ignore_response = false);
 
+    /// Process a committed write request with a zxid assigned by caller in commit order, zxid of
+    /// the store is not changed. Used by WriteRequestsApplier to apply requests in parallel.
+    void processWriteRequest(
+        KeeperResponsesQueue & responses_queue, const RequestForSession & request_for_session, int64_t txn_zxid);
+
+    /// Whether write requests are being processed by multiple threads, the data tree is
+    /// protected by a mutex during it.
+    void setConcurrentWrites(bool value) { concurrent_writes = value; }
+
     /// Build children set after loading data from snapshot
     void buildChildrenSet(bool from_zk_snapshot = false);
 
@@ -222,8 +85,9 @@ public:
     /// Clear whole store and set to initial state.
     void reset();
 
-    /// Used when creating snapshot
-    std::shared_ptr<BucketNodes> dumpDataTree();
+    /// Used when creating snapshot, take an immutable view of data tree in O(1).
+    /// Must be invoked when no request is being processed, see RequestProcessor::runExclusively.
+    DataTreeSnapshotPtr freezeDataTree() { return data_tree->freeze(); }
 
     int64_t getZxid() const
     {
@@ -245,9 +109,16 @@ public:
     {
         std::lock_guard lock(auth_mutex);
         session_and_auth[session_id] = std::move(auth);
+        updateSessionPermissions(session_id);
     }
 
-    std::vector<int64_t> getDeadSessions() const
+    /// Recompile permissions of a session after its auth identities are changed, auth_mutex must be held.
+    void updateSessionPermissions(int64_t session_id);
+
+    /// Whether session is granted any bit of permission on nodes with the ACL id.
+    bool checkPermission(int64_t session_id, uint64_t acl_id, int32_t permission) const;
+
+    std::vector<int64_t> getDeadSessions()
     {
         return session_manager.getDeadSessions();
     }
@@ -257,9 +128,9 @@ public:
         return session_manager.sessionToExpirationTime();
     }
 
-    inline void handleRemoteSession(int64_t session_id, int64_t expiration_time)
+    inline void handleRemoteSessions(const std::unordered_map<int64_t, int64_t> & session_to_expiration_time)
     {
-        session_manager.handleRemoteSession(session_id, expiration_time);
+        session_manager.handleRemoteSessions(session_to_expiration_time);
     }
 
     inline bool containsSession(int64_t session_id) const
@@ -267,41 +138,120 @@ public:
         return session_manager.contains(session_id);
     }
 
+    void addLocalSession(int64_t session_id, int64_t session_timeout_ms)
+    {
+        session_manager.addLocalSession(session_id, session_timeout_ms);
+    }
+
+    bool isLocalSession(int64_t session_id) const
+    {
+        return session_manager.isLocalSession(session_id);
+    }
+
+    int64_t startUpgradingLocalSession(int64_t session_id)
+    {
+        return session_manager.startUpgradingLocalSession(session_id);
+    }
+
+    void cancelUpgradingLocalSession(int64_t session_id)
+    {
+        session_manager.cancelUpgradingLocalSession(session_id);
+    }
+
+    void updateLocalSessionExpirationTime(int64_t session_id)
+    {
+        session_manager.updateSessionExpirationTime(session_id);
+    }
+
+    std::vector<int64_t> getDeadLocalSessions()
+    {
+        return session_manager.getDeadLocalSessions();
+    }
+
+    size_t getLocalSessionCount() const
+    {
+        return session_manager.getLocalSessionCount();
+    }
+
     size_t getDataTreeBucketNum() const
     {
-        return data_tree.getBucketNum();
+        return data_tree->getBucketNum();
+    }
+
+    /// Invoked before loading snapshot, may change bucket num of data tree.
+    void reserveDataTree(size_t expected_nodes)
+    {
+        data_tree->reserve(expected_nodes);
+    }
+
+    /// Create an empty node which is allocated from the node arena.
+    inline KeeperNodePtr makeNode(const String & path)
+    {
+        return node_arena.makeNode(path);
     }
 
     inline KeeperNodePtr getNode(const String & path)
     {
-        return data_tree.get(path);
+        auto lock = lockDataTree();
+        return data_tree->get(path);
+    }
+
+    /// Nodes which are going to be modified in place must be got by this method,
+    /// because the node got by getNode may be shared with the snapshot being created.
+    /// Cached responses of the node are invalidated.
+    inline KeeperNodePtr getNodeForUpdate(const String & path)
+    {
+        response_cache.invalidate(path);
+        auto lock = lockDataTree();
+        return data_tree->getForUpdate(path);
     }
 
     inline bool exists(const String & path)
     {
-        return data_tree.count(path);
+        auto lock = lockDataTree();
+        return data_tree->count(path);
     }
 
     inline void addNode(const String & path, KeeperNodePtr node)
     {
-        data_tree.emplace(path, node);
+        response_cache.invalidate(path);
+        auto lock = lockDataTree();
+        if (auto prev_node = data_tree->get(path))
+            memory_tracker.remove(path, *prev_node);
+        memory_tracker.add(path, *node);
+        data_tree->emplace(path, node);
     }
 
     inline void removeNode(const String & path)
     {
-        data_tree.erase(path);
+        response_cache.invalidate(path);
+        auto lock = lockDataTree();
+        if (auto node = data_tree->get(path))
+            memory_tracker.remove(path, *node);
+        data_tree->erase(path);
+    }
+
+    /// Must be invoked after data or children of a node got by getNodeForUpdate are modified.
+    inline void updateNodeMemory(const String & path, KeeperNode & node)
+    {
+        memory_tracker.update(path, node);
+    }
+
+    inline void updateNodeACL(const String & path, KeeperNode & node, uint64_t acl_id)
+    {
+        memory_tracker.updateACL(path, node.acl_id, acl_id);
+        node.acl_id = acl_id;
     }
 
-    inline void addEphemeralNode(int64_t session_id, const String & path)
+    /// Node must be the one which is or will be added into data tree at the path.
+    inline void addEphemeralNode(int64_t session_id, const String & path, KeeperNode & node)
     {
-        std::lock_guard lock(ephemerals_mutex);
-        ephemerals[session_id].insert(path);
+        ephemerals.add(session_id, path, node);
     }
 
-    inline void removeEphemeralNode(int64_t session_id, const String & path)
+    inline void removeEphemeralNode(int64_t session_id, const KeeperNode & node)
     {
-        std::lock_guard lock(ephemerals_mutex);
-        ephemerals[session_id].erase(path);
+        ephemerals.remove(session_id, node);
     }
 
     const String & getSuperDigest() const
@@ -312,16 +262,27 @@ public:
 
     /// Introspection functions mostly used in 4-letter commands ///
 
-    uint64_t getNodesCount() const { return data_tree.size(); }
+    uint64_t getNodesCount() const { return data_tree->size(); }
     uint64_t getApproximateDataSize() const;
+    DataTreeMemoryUsage getDataTreeMemoryUsage() const { return memory_tracker.getTotal(); }
+    DataTreeMemoryTracker::SubtreeUsages getTopSubtreesByMemory(size_t n) const { return memory_tracker.getTopSubtrees(n); }
+    /// Account memory of the whole data tree from scratch, invoked after loading snapshot.
+    void recalculateDataTreeMemory() { memory_tracker.rebuild(*data_tree); }
+    SlabPool::Stats getNodeArenaStats() const { return node_arena.getStats(); }
+    KeeperNodeArena & getNodeArena() { return node_arena; }
+    ResponseCache & getResponseCache() { return response_cache; }
+    const ResponseCache & getResponseCache() const { return response_cache; }
 
     uint64_t getSessionWithEphemeralNodesCount() const
     {
-        std::lock_guard lock(ephemerals_mutex);
-        return ephemerals.size();
+        return ephemerals.getSessionCount();
+    }
+
+    uint64_t getTotalEphemeralNodesCount() const
+    {
+        return ephemerals.getTotalCount();
     }
 
-    uint64_t getTotalEphemeralNodesCount() const;
     void dumpSessionsAndEphemerals(WriteBufferFromOwnString & buf) const;
 
     SessionManager::SessionAndTimeout getSessionAndTimeOut() const
@@ -361,12 +322,12 @@ public:
 
     DataTree & getDataTree()
     {
-        return data_tree;
+        return *data_tree;
     }
 
     inline size_t getBucketIndex(const String & path)
     {
-        return data_tree.getBucketIndex(path);
+        return data_tree->getBucketIndex(path);
     }
 
     ACLMap & getACLMap()
@@ -379,10 +340,9 @@ public:
         acl_map.addMapping(acls_id, acls);
     }
 
-    const Ephemerals & getEphemerals() const
+    Ephemerals getEphemerals() const
     {
-        std::lock_guard lock(ephemerals_mutex);
-        return ephemerals;
+        return ephemerals.getAll();
     }
 
     /// watch related functions
@@ -412,6 +372,21 @@ public:
         watch_manager.dumpWatchesByPath(buf);
     }
 
+    void addWatch(const String & path, int64_t session_id, Coordination::AddWatchMode mode)
+    {
+        watch_manager.addWatch(path, session_id, mode);
+    }
+
+    bool removeWatches(const String & path, int64_t session_id, Coordination::WatcherType type)
+    {
+        return watch_manager.removeWatches(path, session_id, type);
+    }
+
+    bool containsWatches(const String & path, int64_t session_id, Coordination::WatcherType type) const
+    {
+        return watch_manager.containsWatches(path, session_id, type);
+    }
+
     void initializeSystemNodes();
 
     mutable std::shared_mutex auth_mutex;
@@ -422,17 +397,61 @@ public:
 
 private:
     int64_t fetchAndGetZxid() { return zxid++; }
-    void cleanEphemeralNodes(int64_t session_id, ThreadSafeQueue<ResponseForSession> & responses_queue, bool ignore_response);
+
+    void processRequestWithZxid(
+        KeeperResponsesQueue & responses_queue,
+        const RequestForSession & request_for_session,
+        int64_t txn_zxid,
+        bool check_acl,
+        bool ignore_response);
+
+    std::unique_lock<std::mutex> lockDataTree()
+    {
+        return concurrent_writes ? std::unique_lock<std::mutex>(data_tree_mutex) : std::unique_lock<std::mutex>();
+    }
+    /// Remove ephemeral nodes, watches and auth of the sessions and expire them, all sessions are cleaned in one pass.
+    void closeSessions(const std::vector<int64_t> & session_ids, KeeperResponsesQueue & responses_queue, bool ignore_response);
+    /// Remove ephemeral nodes taken from the index from data tree, every parent is updated once.
+    void removeEphemeralNodes(Strings & paths);
+
+    /// Declared before data tree, so that it is destroyed after all nodes are released.
+    KeeperNodeArena node_arena;
 
     /// data tree
-    DataTree data_tree;
+    std::unique_ptr<CopyOnWriteDataTree> data_tree;
+
+    /// Data tree is not thread-safe, it is locked only when write requests are processed by multiple
+    /// threads. Reads are never processed at the same time with writes, so they don't need it.
+    std::atomic<bool> concurrent_writes{false};
+    std::mutex data_tree_mutex;
+
+    DataTreeMemoryTracker memory_tracker;
+
+    /// Serialized bodies of read responses, entries are invalidated when nodes are got for update, added or removed.
+    ResponseCache response_cache;
+
+    using SessionPermissionsMap = std::unordered_map<int64_t, std::shared_ptr<const SessionPermissions>>;
+
+    /// Compiled from session_and_auth and protected by auth_mutex, sessions without auth use anonymous_permissions.
+    SessionPermissionsMap session_permissions;
+    SessionPermissions anonymous_permissions;
+
+    /// Bumped under auth_mutex whenever session_permissions changes, values are unique among all stores.
+    /// checkPermission caches an immutable copy of session_permissions per thread and takes auth_mutex
+    /// only when the version changes, which is rare as auth requests and closing sessions with auth are.
+    std::atomic<UInt64> session_permissions_version;
+    /// Copy of session_permissions of published_permissions_version, protected by auth_mutex.
+    mutable std::shared_ptr<const SessionPermissionsMap> published_permissions;
+    mutable UInt64 published_permissions_version = 0;
+
+    /// Invoked after session_permissions is changed, auth_mutex must be held.
+    void onSessionPermissionsChanged();
 
     SessionManager session_manager;
     WatchManager watch_manager;
 
     /// all ephemeral nodes goes here
-    Ephemerals ephemerals;
-    mutable std::mutex ephemerals_mutex;
+    EphemeralNodes ephemerals;
 
     /// Global transaction id, only write request will consume zxid.
     /// It should be same across all nodes.
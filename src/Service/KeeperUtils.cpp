@@ -7,6 +7,7 @@
 #include <Common/IO/WriteHelpers.h>
 #include <boost/algorithm/string/split.hpp>
 
+#include <Service/NuRaftLogSegment.h>
 #include <Service/formatHex.h>
 #include <Service/ReadBufferFromNuRaftBuffer.h>
 #include <Service/WriteBufferFromNuraftBuffer.h>
@@ -21,6 +22,7 @@ namespace RK
 namespace ErrorCodes
 {
     extern const int INVALID_CONFIG_PARAMETER;
+    extern const int CORRUPTED_LOG;
 }
 
 String checkAndGetSuperDigest(const String & user_and_digest)
@@ -37,42 +39,113 @@ String checkAndGetSuperDigest(const String & user_and_digest)
     return user_and_digest;
 }
 
-ptr<buffer> serializeKeeperRequest(const RequestForSession & request)
+namespace
+{
+
+void writeKeeperRequest(const RequestForSession & request, WriteBuffer & out)
 {
-    WriteBufferFromNuraftBuffer out;
     writeIntBinary(request.session_id, out);
     request.request->write(out);
     Coordination::write(request.process_time, out);
-    return out.getBuffer();
 }
 
-ptr<RequestForSession> deserializeKeeperRequest(nuraft::buffer & data)
+/// Read the rest of a request after its session id.
+ptr<RequestForSession> readKeeperRequest(int64_t session_id, ReadBuffer & in, const MaterializedRequestFinder & find = {})
 {
-    ptr<RequestForSession> request = cs_new<RequestForSession>();
-    ReadBufferFromNuRaftBuffer buffer(data);
-    readIntBinary(request->session_id, buffer);
-
     int32_t length;
-    Coordination::read(length, buffer);
+    Coordination::read(length, in);
 
     int32_t xid;
-    Coordination::read(xid, buffer);
+    Coordination::read(xid, in);
 
     Coordination::OpNum opnum;
-    Coordination::read(opnum, buffer);
+    Coordination::read(opnum, in);
+
+    /// Skip body of the request which is already there, length covers xid, opnum and body.
+    if (find)
+    {
+        if (auto materialized = find(session_id, xid, opnum))
+        {
+            in.ignore(length - sizeof(xid) - sizeof(opnum));
+            Coordination::read(materialized->process_time, in);
+            return materialized;
+        }
+    }
+
+    ptr<RequestForSession> request = cs_new<RequestForSession>();
+    request->session_id = session_id;
 
     //    bool is_internal;
     //    Coordination::read(is_internal, buffer);
 
     request->request = Coordination::ZooKeeperRequestFactory::instance().get(opnum);
     request->request->xid = xid;
-    request->request->readImpl(buffer);
+    request->request->readImpl(in);
 
-    Coordination::read(request->process_time, buffer);
+    Coordination::read(request->process_time, in);
 
     return request;
 }
 
+}
+
+ptr<buffer> serializeKeeperRequest(const RequestForSession & request)
+{
+    WriteBufferFromNuraftBuffer out;
+    writeKeeperRequest(request, out);
+    return out.getBuffer();
+}
+
+ptr<RequestForSession> deserializeKeeperRequest(nuraft::buffer & data)
+{
+    ReadBufferFromNuRaftBuffer buffer(data);
+    int64_t session_id;
+    readIntBinary(session_id, buffer);
+    return readKeeperRequest(session_id, buffer);
+}
+
+ptr<buffer> serializeKeeperRequests(RequestsForSessions::const_iterator begin, RequestsForSessions::const_iterator end)
+{
+    WriteBufferFromNuraftBuffer out;
+    writeIntBinary(MULTI_REQUESTS_ENTRY_MAGIC, out);
+    writeIntBinary(static_cast<UInt8>(LogVersion::V2), out);
+    Coordination::write(static_cast<int32_t>(end - begin), out);
+    for (auto it = begin; it != end; ++it)
+        writeKeeperRequest(*it, out);
+    return out.getBuffer();
+}
+
+std::vector<ptr<RequestForSession>> deserializeKeeperRequests(nuraft::buffer & data, const MaterializedRequestFinder & find)
+{
+    ReadBufferFromNuRaftBuffer buffer(data);
+    int64_t session_id_or_magic;
+    readIntBinary(session_id_or_magic, buffer);
+
+    /// Log entry of a single request
+    if (session_id_or_magic != MULTI_REQUESTS_ENTRY_MAGIC)
+        return {readKeeperRequest(session_id_or_magic, buffer, find)};
+
+    UInt8 version;
+    readIntBinary(version, buffer);
+    if (version != static_cast<UInt8>(LogVersion::V2))
+        throw Exception(ErrorCodes::CORRUPTED_LOG, "Unknown version {} of multi requests log entry", static_cast<UInt32>(version));
+
+    int32_t count;
+    Coordination::read(count, buffer);
+    if (count < 0)
+        throw Exception(ErrorCodes::CORRUPTED_LOG, "Invalid request count {} of multi requests log entry", count);
+
+    std::vector<ptr<RequestForSession>> requests;
+    requests.reserve(count);
+    for (int32_t i = 0; i < count; ++i)
+    {
+        int64_t session_id;
+        readIntBinary(session_id, buffer);
+        requests.push_back(readKeeperRequest(session_id, buffer, find));
+    }
+    return requests;
+}
+
 ptr<log_entry> cloneLogEntry(const ptr<log_entry> & entry)
 {
     ptr<log_entry> cloned = cs_new<log_entry>(
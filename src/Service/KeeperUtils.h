@@ -1,6 +1,7 @@
 #pragma once
 
 #include <fstream>
+#include <functional>
 #include <ZooKeeper/IKeeper.h>
 #include <ZooKeeper/ZooKeeperCommon.h>
 #include <libnuraft/log_entry.hxx>
@@ -30,6 +31,24 @@ inline UInt64 getCurrentWallTimeMilliseconds()
 nuraft::ptr<nuraft::buffer> serializeKeeperRequest(const RequestForSession & request);
 nuraft::ptr<RequestForSession> deserializeKeeperRequest(nuraft::buffer & data);
 
+/// Leads a log entry packing multiple requests, negative "MultiReq" which is never a valid session id.
+static constexpr int64_t MULTI_REQUESTS_ENTRY_MAGIC = -0x4d756c7469526571;
+
+/** Serialize requests into one log entry, since LogVersion::V2
+  *     magic : MULTI_REQUESTS_ENTRY_MAGIC 8 bytes
+  *     version : LogVersion::V2 1 byte
+  *     count : 4 bytes
+  *     requests : count requests serialized as serializeKeeperRequest
+  */
+nuraft::ptr<nuraft::buffer> serializeKeeperRequests(RequestsForSessions::const_iterator begin, RequestsForSessions::const_iterator end);
+/// Returns the request of (session_id, xid, opnum) if it is already in memory, or nullptr.
+using MaterializedRequestFinder
+    = std::function<nuraft::ptr<RequestForSession>(int64_t session_id, Coordination::XID xid, Coordination::OpNum opnum)>;
+
+/// Deserialize requests of a log entry in order, the entry may be also of a single request.
+/// Requests got by find are used as they are, only their process_time is read from the entry.
+std::vector<nuraft::ptr<RequestForSession>> deserializeKeeperRequests(nuraft::buffer & data, const MaterializedRequestFinder & find = {});
+
 nuraft::ptr<nuraft::log_entry> cloneLogEntry(const nuraft::ptr<nuraft::log_entry> & entry);
 
 /// Parent of a path, for example: got '/a/b' from '/a/b/c'
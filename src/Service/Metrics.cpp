@@ -125,6 +125,8 @@ Metrics::Metrics()
 {
     push_request_queue_time_ms = getSummary("push_request_queue_time_ms", SummaryLevel::ADVANCED);
     log_replication_batch_size = getSummary("log_replication_batch_size", SummaryLevel::BASIC);
+    log_replication_batch_size_limit = getSummary("log_replication_batch_size_limit", SummaryLevel::BASIC);
+    log_replication_linger_time_us = getSummary("log_replication_linger_time_us", SummaryLevel::BASIC);
     response_socket_send_size = getSummary("response_socket_send_size", SummaryLevel::BASIC);
     forward_response_socket_send_size = getSummary("forward_response_socket_send_size", SummaryLevel::BASIC);
     apply_write_request_time_ms = getSummary("apply_write_request_time_ms", SummaryLevel::ADVANCED);
@@ -135,6 +137,9 @@ Metrics::Metrics()
     snap_time_ms = getSummary("snap_time_ms", SummaryLevel::SIMPLE);
     snap_blocking_time_ms = getSummary("snap_blocking_time_ms", SummaryLevel::SIMPLE);
     snap_count = getSummary("snap_count", SummaryLevel::SIMPLE);
+
+    dead_session_close_batch_size = getSummary("dead_session_close_batch_size", SummaryLevel::BASIC);
+    dead_session_close_time_ms = getSummary("dead_session_close_time_ms", SummaryLevel::ADVANCED);
 }
 
 SummaryPtr Metrics::getSummary(const RK::String & name, RK::SummaryLevel level)
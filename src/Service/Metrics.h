@@ -190,6 +190,8 @@ public:
 
     SummaryPtr push_request_queue_time_ms;
     SummaryPtr log_replication_batch_size;
+    SummaryPtr log_replication_batch_size_limit;
+    SummaryPtr log_replication_linger_time_us;
     SummaryPtr response_socket_send_size;
     SummaryPtr forward_response_socket_send_size;
     SummaryPtr apply_write_request_time_ms;
@@ -199,6 +201,8 @@ public:
     SummaryPtr snap_time_ms;
     SummaryPtr snap_blocking_time_ms;
     SummaryPtr snap_count;
+    SummaryPtr dead_session_close_batch_size;
+    SummaryPtr dead_session_close_time_ms;
 
 private:
     Metrics();
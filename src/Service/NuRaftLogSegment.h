@@ -25,6 +25,7 @@ enum class LogVersion : uint8_t
 {
     V0 = 0,
     V1 = 1, /// with ctime, mtime, magic and version
+    V2 = 2, /// app log entry may pack multiple requests, see serializeKeeperRequests
 
     UNKNOWN = 255
 };
@@ -36,7 +37,7 @@ struct LogEntryWithVersion
     ptr<log_entry> entry;
 };
 
-static constexpr auto CURRENT_LOG_VERSION = LogVersion::V1;
+static constexpr auto CURRENT_LOG_VERSION = LogVersion::V2;
 
 class NuRaftLogSegment
 {
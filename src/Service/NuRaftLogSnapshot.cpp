@@ -72,7 +72,7 @@ size_t KeeperSnapshotStore::serializeDataTreeAsync(SnapTask & snap_task) const
     std::shared_ptr<WriteBufferFromFile> out;
     ptr<SnapshotBatchBody> batch;
 
-    auto checksum = serializeNodeAsync(out, batch, *snap_task.buckets_nodes);
+    auto checksum = serializeNodeAsync(out, batch, *snap_task.data_tree_snapshot);
     auto [save_size, new_checksum] = saveBatchAndUpdateCheckSumV2(out, batch, checksum);
     checksum = new_checksum;
 
@@ -96,7 +96,7 @@ void KeeperSnapshotStore::serializeNodeV2(
     if (!node)
         return;
 
-    std::shared_ptr<KeeperNode> node_copy = node->clone();
+    std::shared_ptr<KeeperNode> node_copy = node->clone(&store.getNodeArena(), path);
 
     if (processed % max_object_node_size == 0)
     {
@@ -148,66 +148,69 @@ void KeeperSnapshotStore::serializeNodeV2(
         path_with_slash += '/';
 
     for (const auto & child : node->children)
-        serializeNodeV2(out, batch, store, path_with_slash + child, processed, checksum);
+        serializeNodeV2(out, batch, store, path_with_slash + String(child), processed, checksum);
 }
 
 uint32_t KeeperSnapshotStore::serializeNodeAsync(
     ptr<WriteBufferFromFile> & out,
     ptr<SnapshotBatchBody> & batch,
-    BucketNodes & bucket_nodes) const
+    const DataTreeSnapshot & data_tree_snapshot) const
 {
     uint64_t processed = 0;
     uint32_t checksum = 0;
-    for (auto && bucket : bucket_nodes)
+
+    auto serialize_node = [&](const String & path, const KeeperNodePtr & node)
     {
-        for (auto && [path, node] : bucket)
+        if (processed % max_object_node_size == 0)
         {
-            if (processed % max_object_node_size == 0)
+            /// time to create new snapshot object
+            uint64_t obj_id = processed / max_object_node_size;
+
+            if (obj_id != 0)
             {
-                /// time to create new snapshot object
-                uint64_t obj_id = processed / max_object_node_size;
+                /// flush last batch data
+                auto [save_size, new_checksum] = saveBatchAndUpdateCheckSumV2(out, batch, checksum);
+                checksum = new_checksum;
+
+                /// close current object file
+                writeTailAndClose(out, checksum);
+                /// reset checksum
+                checksum = 0;
+            }
+            String new_obj_path;
+            /// for there are 4 objects before data objects
+            getObjectPath(obj_id + 4, new_obj_path);
 
-                if (obj_id != 0)
-                {
-                    /// flush last batch data
-                    auto [save_size, new_checksum] = saveBatchAndUpdateCheckSumV2(out, batch, checksum);
-                    checksum = new_checksum;
-
-                    /// close current object file
-                    writeTailAndClose(out, checksum);
-                    /// reset checksum
-                    checksum = 0;
-                }
-                String new_obj_path;
-                /// for there are 4 objects before data objects
-                getObjectPath(obj_id + 4, new_obj_path);
+            LOG_INFO(log, "Creating new snapshot object {}, path {}", obj_id + 4, new_obj_path);
+            out = openFileAndWriteHeader(new_obj_path, version);
+        }
 
-                LOG_INFO(log, "Creating new snapshot object {}, path {}", obj_id + 4, new_obj_path);
-                out = openFileAndWriteHeader(new_obj_path, version);
+        /// flush and rebuild batch
+        if (processed % save_batch_size == 0)
+        {
+            /// skip flush the first batch
+            if (processed != 0)
+            {
+                /// flush data in batch to file
+                auto [save_size, new_checksum] = saveBatchAndUpdateCheckSumV2(out, batch, checksum);
+                checksum = new_checksum;
             }
-
-            /// flush and rebuild batch
-            if (processed % save_batch_size == 0)
+            else
             {
-                /// skip flush the first batch
-                if (processed != 0)
-                {
-                    /// flush data in batch to file
-                    auto [save_size, new_checksum] = saveBatchAndUpdateCheckSumV2(out, batch, checksum);
-                    checksum = new_checksum;
-                }
-                else
-                {
-                    if (!batch)
-                        batch = cs_new<SnapshotBatchBody>();
-                }
+                if (!batch)
+                    batch = cs_new<SnapshotBatchBody>();
             }
-
-            LOG_TRACE(log, "Append node path {}", path);
-            appendNodeToBatchV2(batch, path, node, version);
-            processed++;
         }
-    }
+
+        LOG_TRACE(log, "Append node path {}", path);
+        appendNodeToBatchV2(batch, path, node, version);
+        processed++;
+    };
+
+    /// Nodes of the snapshot are immutable, so they can be serialized without copying.
+    for (UInt32 bucket_id = 0; bucket_id < data_tree_snapshot.getBucketNum(); ++bucket_id)
+        data_tree_snapshot.forEach(bucket_id, serialize_node);
+
     return checksum;
 }
 
@@ -574,8 +577,12 @@ void KeeperSnapshotStore::loadLatestSnapshot(KeeperStore & store)
 
     ThreadPool thread_pool(SNAPSHOT_THREAD_NUM);
 
-    all_objects_edges = std::vector<BucketEdges>(objects_cnt);
-    all_objects_nodes = std::vector<BucketNodes>(objects_cnt);
+    /// Every object contains at most max_object_node_size nodes, the data tree
+    /// may choose its bucket num by it, so it must be done before parsing objects.
+    store.reserveDataTree(objects_cnt * max_object_node_size);
+
+    all_objects_edges = std::vector<BucketEdges>(objects_cnt, BucketEdges(store.getDataTreeBucketNum()));
+    all_objects_nodes = std::vector<BucketNodes>(objects_cnt, BucketNodes(store.getDataTreeBucketNum()));
 
     LOG_INFO(log, "Parsing snapshot objects from disk");
     Stopwatch watch;
@@ -635,6 +642,8 @@ void KeeperSnapshotStore::loadLatestSnapshot(KeeperStore & store)
     thread_pool.wait();
     LOG_INFO(log, "Building data tree costs {}ms", watch.elapsedMilliseconds());
 
+    store.recalculateDataTreeMemory();
+
     all_objects_edges.clear();
     all_objects_nodes.clear();
 
@@ -23,7 +23,7 @@ struct SnapTask
     SessionAndTimeout session_and_timeout;
     std::unordered_map<uint64_t, Coordination::ACLs> acl_map;
     KeeperStore::SessionAndAuth session_and_auth;
-    std::shared_ptr<KeeperStore::BucketNodes> buckets_nodes;
+    DataTreeSnapshotPtr data_tree_snapshot;
     nuraft::async_result<bool>::handler_type when_done;
 
     SnapTask(const ptr<snapshot> & s_, KeeperStore & store, nuraft::async_result<bool>::handler_type & when_done_)
@@ -36,16 +36,11 @@ struct SnapTask
 
         acl_map = store.getACLMap().getMapping();
         Stopwatch watch;
-        buckets_nodes = store.dumpDataTree();
-        LOG_INFO(log, "Dumping data tree costs {}ms", watch.elapsedMilliseconds());
+        data_tree_snapshot = store.freezeDataTree();
+        LOG_INFO(log, "Freezing data tree costs {}ms", watch.elapsedMilliseconds());
         Metrics::getMetrics().snap_blocking_time_ms->add(watch.elapsedMilliseconds());
 
-        for (auto && bucket : *buckets_nodes)
-        {
-            LOG_DEBUG(log, "Get bucket size {}", bucket.size());
-        }
-
-        nodes_count = store.getNodesCount();
+        nodes_count = data_tree_snapshot->size();
         ephemeral_nodes_count = store.getTotalEphemeralNodesCount();
     }
 };
@@ -232,7 +227,7 @@ private:
     uint32_t serializeNodeAsync(
         ptr<WriteBufferFromFile> & out,
         ptr<SnapshotBatchBody> & batch,
-        BucketNodes & bucket_nodes) const;
+        const DataTreeSnapshot & data_tree_snapshot) const;
 
     /// Append node to batch version v2
     inline static void
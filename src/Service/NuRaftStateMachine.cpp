@@ -26,7 +26,8 @@ struct ReplayLogBatch
     ulong batch_start_index = 0;
     ulong batch_end_index = 0;
     ptr<std::vector<LogEntryWithVersion>> log_entries;
-    ptr<std::vector<ptr<RequestForSession>>> requests;
+    /// Requests of every log entry, empty for non app log
+    ptr<std::vector<std::vector<ptr<RequestForSession>>>> requests;
 };
 
 NuRaftStateMachine::NuRaftStateMachine(
@@ -43,7 +44,13 @@ NuRaftStateMachine::NuRaftStateMachine(
     UInt32 object_node_size,
     std::shared_ptr<RequestProcessor> request_processor_)
     : raft_settings(raft_settings_)
-    , store(raft_settings->dead_session_check_period_ms, super_digest)
+    , store(
+          raft_settings->dead_session_check_period_ms,
+          super_digest,
+          raft_settings->data_tree_engine,
+          raft_settings->data_tree_bucket_num,
+          raft_settings->memory_subtree_depth,
+          raft_settings->response_cache_size)
     , responses_queue(responses_queue_)
     , request_processor(request_processor_)
     , last_committed_idx(0)
@@ -152,13 +159,19 @@ void NuRaftStateMachine::rollback(const ulong log_idx, buffer & data)
 
 ptr<buffer> NuRaftStateMachine::commit(const ulong log_idx, buffer & data, bool ignore_response)
 {
-    auto request_for_session = deserializeKeeperRequest(data);
-    LOG_TRACE(log, "Commit log {}, request {}", log_idx, request_for_session->toSimpleString());
+    /// The log entry may pack multiple requests, they are applied in order.
+    auto find_local_request = [this, log_idx](int64_t session_id, Coordination::XID xid, Coordination::OpNum opnum)
+    { return takeLocalRequest(log_idx, session_id, xid, opnum); };
 
-    if (request_processor)
-        request_processor->commit(*request_for_session);
-    else
-        store.processRequest(responses_queue, *request_for_session, {}, true, ignore_response);
+    for (const auto & request_for_session : deserializeKeeperRequests(data, find_local_request))
+    {
+        LOG_TRACE(log, "Commit log {}, request {}", log_idx, request_for_session->toSimpleString());
+
+        if (request_processor)
+            request_processor->commit(*request_for_session);
+        else
+            store.processRequest(responses_queue, *request_for_session, {}, true, ignore_response);
+    }
 
     last_committed_idx = log_idx;
     committed_log_manager->push(last_committed_idx);
@@ -171,6 +184,53 @@ ptr<buffer> NuRaftStateMachine::commit(const ulong log_idx, buffer & data)
     return commit(log_idx, data, false);
 }
 
+void NuRaftStateMachine::addLocalRequests(const RequestsForSessions & requests, ulong last_log_idx)
+{
+    std::lock_guard lock(local_requests_mutex);
+    if (local_requests_start_idx == 0)
+        local_requests_start_idx = last_log_idx + 1;
+
+    for (const auto & request : requests)
+    {
+        auto local_request = cs_new<RequestForSession>(request.request, request.session_id, request.create_time);
+        local_requests.try_emplace(RequestId{request.session_id, request.request->xid}, std::move(local_request));
+    }
+}
+
+void NuRaftStateMachine::removeLocalRequests(const RequestsForSessions & requests)
+{
+    std::lock_guard lock(local_requests_mutex);
+    for (const auto & request : requests)
+    {
+        auto it = local_requests.find(RequestId{request.session_id, request.request->xid});
+        if (it != local_requests.end() && it->second->request == request.request)
+            local_requests.erase(it);
+    }
+}
+
+void NuRaftStateMachine::clearLocalRequests()
+{
+    std::lock_guard lock(local_requests_mutex);
+    local_requests.clear();
+    local_requests_start_idx = 0;
+}
+
+ptr<RequestForSession>
+NuRaftStateMachine::takeLocalRequest(ulong log_idx, int64_t session_id, Coordination::XID xid, Coordination::OpNum opnum)
+{
+    std::lock_guard lock(local_requests_mutex);
+    if (local_requests_start_idx == 0 || log_idx < local_requests_start_idx)
+        return nullptr;
+
+    auto it = local_requests.find(RequestId{session_id, xid});
+    if (it == local_requests.end())
+        return nullptr;
+
+    auto request = std::move(it->second);
+    local_requests.erase(it);
+    return request->request->getOpNum() == opnum ? request : nullptr;
+}
+
 void NuRaftStateMachine::shutdown()
 {
     if (shutdown_called)
@@ -229,7 +289,12 @@ void NuRaftStateMachine::create_snapshot(snapshot & s, async_result<bool>::handl
         /// Need make a copy of s
         ptr<buffer> snp_buf = s.serialize();
         auto snap_copy = snapshot::deserialize(*snp_buf);
-        snap_task = std::make_shared<SnapTask>(snap_copy, store, when_done);
+        /// Freezing data tree may merge the previous frozen one, readers must not run at the same time.
+        auto make_snap_task = [&] { snap_task = std::make_shared<SnapTask>(snap_copy, store, when_done); };
+        if (request_processor)
+            request_processor->runExclusively(make_snap_task);
+        else
+            make_snap_task();
         snap_task_ready = true;
 
         LOG_INFO(log, "Scheduling asynchronous creating snapshot task, time cost {} ms", getCurrentTimeMilliseconds() - snap_start_time);
@@ -402,20 +467,19 @@ void NuRaftStateMachine::replayLogs(ptr<log_store> log_store_, uint64_t from, ui
 
                 batch.batch_start_index = batch_start_index;
                 batch.batch_end_index = batch_end_index;
-                batch.requests = cs_new<std::vector<ptr<RequestForSession>>>();
+                batch.requests = cs_new<std::vector<std::vector<ptr<RequestForSession>>>>();
 
                 for (auto & entry_with_version : *batch.log_entries)
                 {
                     if (entry_with_version.entry->get_val_type() != nuraft::log_val_type::app_log)
                     {
                         LOG_DEBUG(thread_log, "Found non app nuraft log(type {}), ignore it", toString(entry_with_version.entry->get_val_type()));
-                        batch.requests->push_back(nullptr);
+                        batch.requests->emplace_back();
                     }
                     else
                     {
                         /// user requests
-                        auto request = deserializeKeeperRequest(entry_with_version.entry->get_buf());
-                        batch.requests->push_back(request);
+                        batch.requests->push_back(deserializeKeeperRequests(entry_with_version.entry->get_buf()));
                     }
                 }
 
@@ -451,19 +515,22 @@ void NuRaftStateMachine::replayLogs(ptr<log_store> log_store_, uint64_t from, ui
             if (entry_with_version.entry->get_val_type() != nuraft::log_val_type::app_log)
                 continue;
 
-            auto & request = (*batch.requests)[i];
-            LOG_TRACE(log, "Replaying log {}, request {}", log_index, request->toString());
+            for (auto & request : (*batch.requests)[i])
+            {
+                LOG_TRACE(log, "Replaying log {}, request {}", log_index, request->toString());
 
-            store.processRequest(responses_queue, *request, {}, true, true);
+                store.processRequest(responses_queue, *request, {}, true, true);
 
-            if (!isNewSessionRequest(request->request->getOpNum()) && request->session_id > store.getSessionIDCounter())
-            {
-                /// We may receive an error session id from client, and we just ignore it.
-                LOG_WARNING(
-                    log,
-                    "Storage's session_id_counter {} must bigger than the session id {} of log.",
-                    toHexString(store.getSessionIDCounter()),
-                    toHexString(request->session_id));
+                if (!isNewSessionRequest(request->request->getOpNum()) && !isLocalSessionID(request->session_id)
+                    && request->session_id > store.getSessionIDCounter())
+                {
+                    /// We may receive an error session id from client, and we just ignore it.
+                    LOG_WARNING(
+                        log,
+                        "Storage's session_id_counter {} must bigger than the session id {} of log.",
+                        toHexString(store.getSessionIDCounter()),
+                        toHexString(request->session_id));
+                }
             }
         }
 
@@ -531,7 +598,7 @@ void NuRaftStateMachine::reset()
 }
 
 
-std::vector<int64_t> NuRaftStateMachine::getDeadSessions() const
+std::vector<int64_t> NuRaftStateMachine::getDeadSessions()
 {
     return store.getDeadSessions();
 }
@@ -566,6 +633,11 @@ uint64_t NuRaftStateMachine::getTotalEphemeralNodesCount() const
     return store.getTotalEphemeralNodesCount();
 }
 
+uint64_t NuRaftStateMachine::getLocalSessionCount() const
+{
+    return store.getLocalSessionCount();
+}
+
 uint64_t NuRaftStateMachine::getSessionWithEphemeralNodesCount() const
 {
     return store.getSessionWithEphemeralNodesCount();
@@ -591,6 +663,26 @@ uint64_t NuRaftStateMachine::getApproximateDataSize() const
     return store.getApproximateDataSize();
 }
 
+SlabPool::Stats NuRaftStateMachine::getNodeArenaStats() const
+{
+    return store.getNodeArenaStats();
+}
+
+DataTreeMemoryUsage NuRaftStateMachine::getDataTreeMemoryUsage() const
+{
+    return store.getDataTreeMemoryUsage();
+}
+
+DataTreeMemoryTracker::SubtreeUsages NuRaftStateMachine::getTopSubtreesByMemory(size_t n) const
+{
+    return store.getTopSubtreesByMemory(n);
+}
+
+const ResponseCache & NuRaftStateMachine::getResponseCache() const
+{
+    return store.getResponseCache();
+}
+
 bool NuRaftStateMachine::containsSession(int64_t session_id) const
 {
     return store.containsSession(session_id);
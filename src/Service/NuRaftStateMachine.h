@@ -20,7 +20,7 @@ using nuraft::async_result;
 using nuraft::buffer;
 using nuraft::cs_new;
 
-using KeeperResponsesQueue = ThreadSafeQueue<ResponseForSession>;
+using KeeperResponsesQueue = KeeperStore::KeeperResponsesQueue;
 
 class RequestProcessor;
 
@@ -230,7 +230,7 @@ public:
     KeeperStore & getStore() { return store; }
 
     /// get expired session
-    std::vector<int64_t> getDeadSessions() const;
+    std::vector<int64_t> getDeadSessions();
 
     /// for 4lw commands
     int64_t getLastProcessedZxid() const;
@@ -255,10 +255,22 @@ public:
     uint64_t getSessionWithEphemeralNodesCount() const;
     uint64_t getTotalEphemeralNodesCount() const;
 
-    /// get approximate data size
-    /// TODO need a more accurate value
+    /// Sessions created by this server without Raft, see local_session_enabled.
+    uint64_t getLocalSessionCount() const;
+
+    /// Bytes of data tree, see DataTreeMemoryUsage::totalBytes.
     uint64_t getApproximateDataSize() const;
 
+    /// Memory usage of the slab pools which nodes are allocated from.
+    SlabPool::Stats getNodeArenaStats() const;
+
+    DataTreeMemoryUsage getDataTreeMemoryUsage() const;
+    /// Subtrees of data tree using the most memory.
+    DataTreeMemoryTracker::SubtreeUsages getTopSubtreesByMemory(size_t n) const;
+
+    /// Cache of serialized read responses, used to show its statistics.
+    const ResponseCache & getResponseCache() const;
+
     /// Whether contains a session, note that leader contains all sessions in cluster.
     /// and follower only contains local session.
     bool containsSession(int64_t session_id) const;
@@ -269,6 +281,14 @@ public:
         return in_snapshot;
     }
 
+    /// Requests appended to Raft by this node after log last_log_idx, they are committed as they are instead
+    /// of being deserialized from log entries. Must be called in the order of appending.
+    void addLocalRequests(const RequestsForSessions & requests, ulong last_log_idx);
+    /// The requests are not appended to Raft.
+    void removeLocalRequests(const RequestsForSessions & requests);
+    /// Leadership changed, entries appended by this node may be overwritten.
+    void clearLocalRequests();
+
     void shutdown();
 
 private:
@@ -280,6 +300,8 @@ private:
     /// Now it is not used.
     void snapThread();
 
+    /// Take the local request of (session_id, xid) committed in log log_idx out, nullptr if there is not.
+    ptr<RequestForSession> takeLocalRequest(ulong log_idx, int64_t session_id, Coordination::XID xid, Coordination::OpNum opnum);
 
     /// raft related settings
     RaftSettingsPtr raft_settings;
@@ -324,6 +346,14 @@ private:
     std::mutex & new_session_id_callback_mutex;
     std::unordered_map<int64_t, ptr<std::condition_variable>> & new_session_id_callback;
 
+    /// Requests appended by this node and not committed yet. Only the first of requests with the same id,
+    /// for example auth requests, is kept, the others are deserialized as usual.
+    std::mutex local_requests_mutex;
+    std::unordered_map<RequestId, ptr<RequestForSession>, RequestId::RequestIdHash> local_requests;
+    /// The first log which may be appended by this node since it became leader, logs before it are appended
+    /// by previous leaders and may have the same request ids with local requests. 0 means not set.
+    ulong local_requests_start_idx = 0;
+
     Poco::Logger * log;
 };
 
@@ -0,0 +1,136 @@
+#include <vector>
+
+#include <Service/RecursiveWatches.h>
+
+namespace RK
+{
+
+bool RecursiveWatches::add(const String & path, int64_t session_id)
+{
+    Node * node = &root;
+    forEachComponent(path, [&](const String & component)
+    {
+        auto & child = node->children[component];
+        if (!child)
+            child = std::make_unique<Node>();
+        node = child.get();
+        return true;
+    });
+
+    if (!node->sessions.emplace(session_id).second)
+        return false;
+
+    session_paths[session_id].emplace(path);
+
+    if (node->sessions.size() == 1)
+        ++watched_paths;
+    ++total_watches;
+    return true;
+}
+
+bool RecursiveWatches::remove(const String & path, int64_t session_id)
+{
+    /// Nodes along the path and the components leading to them, to prune nodes without watches.
+    std::vector<std::pair<Node *, String>> nodes_on_path;
+    Node * node = &root;
+    bool found = true;
+    forEachComponent(path, [&](const String & component)
+    {
+        auto it = node->children.find(component);
+        if (it == node->children.end())
+        {
+            found = false;
+            return false;
+        }
+        nodes_on_path.emplace_back(node, component);
+        node = it->second.get();
+        return true;
+    });
+
+    if (!found || !node->sessions.erase(session_id))
+        return false;
+
+    /// Already erased by removeSession
+    auto session_it = session_paths.find(session_id);
+    if (session_it != session_paths.end())
+    {
+        session_it->second.erase(path);
+        if (session_it->second.empty())
+            session_paths.erase(session_it);
+    }
+
+    if (node->sessions.empty())
+        --watched_paths;
+    --total_watches;
+
+    while (!nodes_on_path.empty() && node->sessions.empty() && node->children.empty())
+    {
+        auto & [parent, component] = nodes_on_path.back();
+        parent->children.erase(component);
+        node = parent;
+        nodes_on_path.pop_back();
+    }
+    return true;
+}
+
+bool RecursiveWatches::contains(const String & path, int64_t session_id) const
+{
+    const auto * node = find(path);
+    return node && node->sessions.contains(session_id);
+}
+
+void RecursiveWatches::removeSession(int64_t session_id)
+{
+    auto session_it = session_paths.find(session_id);
+    if (session_it == session_paths.end())
+        return;
+
+    auto paths = std::move(session_it->second);
+    session_paths.erase(session_it);
+    for (const auto & path : paths)
+        remove(path, session_id);
+}
+
+const RecursiveWatches::Node * RecursiveWatches::find(const String & path) const
+{
+    const Node * node = &root;
+    forEachComponent(path, [&](const String & component)
+    {
+        auto it = node->children.find(component);
+        node = it == node->children.end() ? nullptr : it->second.get();
+        return node != nullptr;
+    });
+    return node;
+}
+
+void RecursiveWatches::forEachPath(const std::function<void(const String &, const Sessions &)> & f) const
+{
+    String path;
+    forEachPathImpl(root, path, f);
+}
+
+void RecursiveWatches::forEachPathImpl(const Node & node, String & path, const std::function<void(const String &, const Sessions &)> & f)
+{
+    if (!node.sessions.empty())
+        f(path.empty() ? "/" : path, node.sessions);
+
+    for (const auto & [component, child] : node.children)
+    {
+        size_t size = path.size();
+        path += '/';
+        path += component;
+        forEachPathImpl(*child, path, f);
+        path.resize(size);
+    }
+}
+
+void RecursiveWatches::clear()
+{
+    root.children.clear();
+    root.sessions.clear();
+    session_paths.clear();
+    watched_paths = 0;
+    total_watches = 0;
+}
+
+}
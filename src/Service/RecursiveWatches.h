@@ -0,0 +1,98 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <common/types.h>
+
+namespace RK
+{
+
+/** Sessions of persistent recursive watches, indexed by a trie of path components. A watch of a path
+  * is triggered by events of the path and all its descendants, so that all watches of a changed path
+  * are found by walking from root along the path, in O(depth of path) regardless of the number of watches.
+  *
+  * Not thread-safe, it is protected by WatchManager.
+  */
+class RecursiveWatches
+{
+public:
+    using Sessions = std::unordered_set<int64_t>;
+
+    /// Returns false if the session already watches the path.
+    bool add(const String & path, int64_t session_id);
+    /// Returns false if the session does not watch the path.
+    bool remove(const String & path, int64_t session_id);
+    bool contains(const String & path, int64_t session_id) const;
+    /// Remove all watches of the session, used when the session is closed.
+    void removeSession(int64_t session_id);
+
+    /// Call f(session_id) for each watch of the path and its ancestors.
+    template <typename F>
+    void forEachWatcher(const String & path, F && f) const
+    {
+        const Node * node = &root;
+        for (auto session_id : node->sessions)
+            f(session_id);
+
+        forEachComponent(path, [&](const String & component)
+        {
+            auto it = node->children.find(component);
+            if (it == node->children.end())
+                return false;
+            node = it->second.get();
+            for (auto session_id : node->sessions)
+                f(session_id);
+            return true;
+        });
+    }
+
+    /// Call f(path, sessions) for each watched path, used by dumps.
+    void forEachPath(const std::function<void(const String &, const Sessions &)> & f) const;
+
+    bool empty() const { return total_watches == 0; }
+    size_t getWatchedPathsCount() const { return watched_paths; }
+    size_t getTotalWatchesCount() const { return total_watches; }
+
+    void clear();
+
+private:
+    struct Node
+    {
+        std::unordered_map<String, std::unique_ptr<Node>> children;
+        Sessions sessions;
+    };
+
+    /// Call f(component) for each component of path from root, until f returns false.
+    template <typename F>
+    static void forEachComponent(const String & path, F && f)
+    {
+        size_t begin = 1;
+        while (begin < path.size())
+        {
+            size_t end = path.find('/', begin);
+            if (end == String::npos)
+                end = path.size();
+            if (!f(path.substr(begin, end - begin)))
+                return;
+            begin = end + 1;
+        }
+    }
+
+    const Node * find(const String & path) const;
+
+    static void forEachPathImpl(const Node & node, String & path, const std::function<void(const String &, const Sessions &)> & f);
+
+    /// Root node is never removed, its sessions watch the whole tree.
+    Node root;
+
+    /// Session id -> watched paths, to remove watches of closed sessions.
+    std::unordered_map<int64_t, std::unordered_set<String>> session_paths;
+
+    size_t watched_paths = 0;
+    size_t total_watches = 0;
+};
+
+}
@@ -17,82 +17,129 @@ void RequestAccumulator::run()
 {
     setThreadName("ReqAccumulator");
 
-    NuRaftResult result;
-
     RequestsForSessions to_append_batch;
+    size_t batch_bytes = 0;
+    size_t lingered = 0;
+    UInt64 batch_start_us = 0;
     UInt64 max_wait = std::min(static_cast<uint64_t>(1000), operation_timeout_ms);
 
+    auto flush = [&](bool full)
+    {
+        size_t batch_size = to_append_batch.size();
+        appendBatch(to_append_batch);
+        batch_policy->onBatchFlushed(batch_size, full, lingered, requests_queue->size());
+        batch_bytes = 0;
+        lingered = 0;
+    };
+
     while (!shutdown_called)
     {
+        /// Results of inflight batches may never arrive, for example leader lost quorum, expire them
+        /// here rather than only when the window is full, so that clients get timeout in time.
+        append_window->expire(getCurrentTimeMilliseconds(), operation_timeout_ms);
+
         RequestForSession request_for_session;
 
         bool pop_success;
         if (to_append_batch.empty())
         {
             pop_success = requests_queue->tryPop(request_for_session, max_wait);
+            batch_start_us = getCurrentTimeMicroseconds();
+        }
+        else if (requests_queue->tryPop(request_for_session))
+        {
+            pop_success = true;
         }
         else
         {
-            if (!requests_queue->tryPop(request_for_session))
+            /// Queue is empty, linger for more requests to make the batch larger.
+            UInt64 linger_deadline_us = batch_start_us + batch_policy->getLingerTimeUs();
+            UInt64 now_us = getCurrentTimeMicroseconds();
+            if (now_us >= linger_deadline_us
+                || !requests_queue->tryPop(request_for_session, std::chrono::microseconds(linger_deadline_us - now_us)))
             {
-                Metrics::getMetrics().log_replication_batch_size->add(to_append_batch.size());
-                result = server->pushRequestBatch(to_append_batch);
-                waitResultAndHandleError(result, to_append_batch);
-                result.reset();
-                to_append_batch.clear();
+                flush(false);
                 continue;
             }
             pop_success = true;
+            ++lingered;
         }
 
         if (pop_success)
         {
             request_for_session.process_time = getCurrentWallTimeMilliseconds();
+            batch_bytes += request_for_session.request->bytesSize() + LOG_ENTRY_HEADER_BYTES;
             to_append_batch.emplace_back(request_for_session);
 
-            if (to_append_batch.size() >= max_batch_size)
-            {
-                Metrics::getMetrics().log_replication_batch_size->add(to_append_batch.size());
-                result = server->pushRequestBatch(to_append_batch);
-                waitResultAndHandleError(result, to_append_batch);
-                result.reset();
-                to_append_batch.clear();
-            }
+            if (batch_policy->isFull(to_append_batch.size(), batch_bytes))
+                flush(true);
         }
     }
 }
 
-bool RequestAccumulator::waitResultAndHandleError(NuRaftResult prev_result, const RequestsForSessions & prev_batch)
+void RequestAccumulator::appendBatch(RequestsForSessions & batch)
 {
-    /// Forcefully process all previous pending requests
+    Metrics::getMetrics().log_replication_batch_size->add(batch.size());
+    Metrics::getMetrics().log_replication_batch_size_limit->add(batch_policy->getBatchSizeLimit());
+    Metrics::getMetrics().log_replication_linger_time_us->add(batch_policy->getLingerTimeUs());
+
+    UInt64 max_wait = std::min(static_cast<uint64_t>(1000), operation_timeout_ms);
+    while (!append_window->waitForRoom(max_wait))
+    {
+        append_window->expire(getCurrentTimeMilliseconds(), operation_timeout_ms);
+        if (shutdown_called)
+        {
+            handleAppendResult(batch, false, nuraft::cmd_result_code::CANCELLED);
+            batch.clear();
+            return;
+        }
+    }
 
-    if (!prev_result->has_result())
-        prev_result->get();
+    auto inflight_batch = append_window->add(std::move(batch), getCurrentTimeMilliseconds());
+    batch.clear();
+
+    NuRaftResult result = server->pushRequestBatch(inflight_batch->requests);
+    if (!result->get_accepted())
+    {
+        append_window->finish(inflight_batch, false, result->get_result_code());
+        return;
+    }
 
-    bool result_accepted = prev_result->get_accepted();
+    /// Invoked by Raft thread when the batch is committed or failed, or right now if result is already there.
+    /// The handler is invoked inside cmd_result, so the raw pointer is valid.
+    auto * raw_result = result.get();
+    NuRaftResult::element_type::handler_type handler
+        = [this, inflight_batch, raw_result](nuraft::ptr<nuraft::buffer> &, nuraft::ptr<std::exception> &)
+    {
+        if (raw_result->get_accepted())
+            batch_policy->onBatchCommitted(getCurrentTimeMilliseconds() - inflight_batch->append_time_ms);
+        append_window->finish(inflight_batch, raw_result->get_accepted(), raw_result->get_result_code());
+    };
+    result->when_ready(handler);
+}
 
-    for (const auto & request_session : prev_batch)
+void RequestAccumulator::handleAppendResult(const RequestsForSessions & batch, bool accepted, nuraft::cmd_result_code code)
+{
+    for (const auto & request_session : batch)
     {
         if (request_session.isForwardRequest())
         {
             auto request = ForwardRequestFactory::instance().convertFromRequest(request_session);
             ForwardResponsePtr response = request->makeResponse();
-            response->setAppendEntryResult(result_accepted, prev_result->get_result_code());
+            response->setAppendEntryResult(accepted, code);
 
             keeper_dispatcher->invokeForwardResponseCallBack({request_session.server_id, request_session.client_id}, response);
         }
-        else if (!result_accepted || prev_result->get_result_code() != nuraft::cmd_result_code::OK)
+        else if (!accepted || code != nuraft::cmd_result_code::OK)
         {
             request_processor->onError(
-                result_accepted,
-                prev_result->get_result_code(),
+                accepted,
+                code,
                 request_session.session_id,
                 request_session.request->xid,
                 request_session.request->getOpNum());
         }
     }
-
-    return result_accepted && prev_result->get_result_code() == nuraft::cmd_result_code::OK;
 }
 
 void RequestAccumulator::shutdown()
@@ -103,6 +150,12 @@ void RequestAccumulator::shutdown()
     LOG_INFO(log, "Shutting down request accumulator!");
     shutdown_called = true;
 
+    /// Results of inflight batches may never arrive after Raft is shut down.
+    if (request_thread.joinable())
+        request_thread.join();
+    if (append_window)
+        append_window->cancelAll();
+
     RequestForSession request_for_session;
     while (requests_queue->tryPop(request_for_session))
     {
@@ -119,13 +172,20 @@ void RequestAccumulator::initialize(
     std::shared_ptr<KeeperDispatcher> keeper_dispatcher_,
     std::shared_ptr<KeeperServer> server_,
     UInt64 operation_timeout_ms_,
-    UInt64 max_batch_size_)
+    UInt64 max_batch_size_,
+    UInt64 max_batch_bytes_,
+    UInt64 batch_target_latency_ms_,
+    UInt64 max_inflight_batches_)
 {
     keeper_dispatcher = keeper_dispatcher_;
     operation_timeout_ms = operation_timeout_ms_;
-    max_batch_size = max_batch_size_;
     server = server_;
-    requests_queue = std::make_shared<ConcurrentBoundedQueue<RequestForSession>>(20000);
+    batch_policy = std::make_unique<AdaptiveBatchPolicy>(max_batch_size_, max_batch_bytes_, batch_target_latency_ms_);
+    append_window = std::make_unique<AppendEntriesWindow>(
+        max_inflight_batches_,
+        [this](const RequestsForSessions & batch, bool accepted, nuraft::cmd_result_code code)
+        { handleAppendResult(batch, accepted, code); });
+    requests_queue = std::make_shared<MPSCRingQueue<RequestForSession>>(20000);
     request_thread = ThreadFromGlobalPool([this] { run(); });
 }
 
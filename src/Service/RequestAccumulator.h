@@ -1,5 +1,7 @@
 #pragma once
 
+#include <Service/AdaptiveBatchPolicy.h>
+#include <Service/AppendEntriesWindow.h>
 #include <Service/KeeperCommon.h>
 #include <Service/KeeperServer.h>
 #include <Service/RequestProcessor.h>
@@ -11,7 +13,9 @@ namespace RK
 /** Accumulate requests into a batch to promote performance.
  * Request in a batch must be all write request.
  *
- * The batch is transferred to Raft and goes through log replication flow.
+ * The batch is transferred to Raft and goes through log replication flow. Up to max_inflight_batches
+ * batches are replicated at the same time, results of them are handled when they are committed.
+ * When to flush a batch is decided by AdaptiveBatchPolicy.
  */
 class RequestAccumulator
 {
@@ -26,7 +30,8 @@ public:
 
     void push(const RequestForSession & request_for_session);
 
-    bool waitResultAndHandleError(NuRaftResult prev_result, const RequestsForSessions & prev_batch);
+    /// Send forward responses and report errors of a batch.
+    void handleAppendResult(const RequestsForSessions & batch, bool accepted, nuraft::cmd_result_code code);
 
     void run();
 
@@ -36,12 +41,22 @@ public:
         std::shared_ptr<KeeperDispatcher> keeper_dispatcher_,
         std::shared_ptr<KeeperServer> server_,
         UInt64 operation_timeout_ms_,
-        UInt64 max_batch_size_);
+        UInt64 max_batch_size_,
+        UInt64 max_batch_bytes_,
+        UInt64 batch_target_latency_ms_,
+        UInt64 max_inflight_batches_);
 
 private:
+    /// Session id, length, xid, opnum and process time of a request in log entry
+    static constexpr size_t LOG_ENTRY_HEADER_BYTES = 32;
+
+    /// Append the batch to Raft when there is room in append window, batch is moved.
+    void appendBatch(RequestsForSessions & batch);
+
     Poco::Logger * log;
 
-    ptr<ConcurrentBoundedQueue<RequestForSession>> requests_queue;
+    /// Pushed by request threads of dispatcher, popped by accumulator thread.
+    ptr<MPSCRingQueue<RequestForSession>> requests_queue;
     ThreadFromGlobalPool request_thread;
 
     std::atomic<bool> shutdown_called{false};
@@ -51,7 +66,10 @@ private:
     std::shared_ptr<RequestProcessor> request_processor;
 
     UInt64 operation_timeout_ms;
-    UInt64 max_batch_size;
+
+    std::unique_ptr<AdaptiveBatchPolicy> batch_policy;
+
+    std::unique_ptr<AppendEntriesWindow> append_window;
 };
 
 }
@@ -93,15 +93,13 @@ void RequestForwarder::runSend(RunnerId runner_id)
                     if (connection)
                     {
                         /// TODO if keeper nodes time has large gap something will be wrong.
-                        auto session_to_expiration_time = server->getKeeperStateMachine()->getStore().sessionToExpirationTime();
-                        keeper_dispatcher->filterLocalSessions(session_to_expiration_time);
-
-                        if (!session_to_expiration_time.empty())
-                            LOG_DEBUG(log, "Has {} local sessions to send", session_to_expiration_time.size());
+                        auto session_to_expiration_time = getSessionsToSync(leader);
 
                         if (!session_to_expiration_time.empty())
                         {
-                            ForwardRequestPtr forward_request = std::make_shared<ForwardSyncSessionsRequest>(std::move(session_to_expiration_time));
+                            auto sync_request = std::make_shared<ForwardSyncSessionsRequest>(std::move(session_to_expiration_time));
+                            sync_request->leader = leader;
+                            ForwardRequestPtr forward_request = sync_request;
                             forward_request->send_time = clock::now();
                             forward_request_queue[runner_id]->push(forward_request);
                             connection->send(forward_request);
@@ -116,8 +114,14 @@ void RequestForwarder::runSend(RunnerId runner_id)
                 catch (...)
                 {
                     tryLogCurrentException(log, "error forward session to leader for runner " + std::to_string(runner_id));
+                    resyncSessions();
                 }
             }
+            /// Sessions synced before may be stale in leader after leader switch.
+            else
+            {
+                resyncSessions();
+            }
 
             session_sync_time_watch.restart();
             ++session_sync_idx;
@@ -218,6 +222,25 @@ void RequestForwarder::runReceive(RunnerId runner_id)
     }
 }
 
+SessionsSyncState::Sessions RequestForwarder::getSessionsToSync(int32_t leader)
+{
+    auto session_to_expiration_time = server->getKeeperStateMachine()->getStore().sessionToExpirationTime();
+    keeper_dispatcher->filterLocalSessions(session_to_expiration_time);
+
+    bool full_sync;
+    auto sessions_to_sync = sessions_sync_state.getSessionsToSync(leader, session_to_expiration_time, full_sync);
+
+    if (!sessions_to_sync.empty())
+        LOG_DEBUG(
+            log,
+            "Has {} local sessions, {} of them to send, full sync {}",
+            session_to_expiration_time.size(),
+            sessions_to_sync.size(),
+            full_sync);
+
+    return sessions_to_sync;
+}
+
 bool RequestForwarder::processTimeoutRequest(RunnerId runner_id, ForwardRequestPtr newFront)
 {
     LOG_INFO(log, "Process timeout request for runner {} queue size {}", runner_id, forward_request_queue[runner_id]->size());
@@ -247,21 +270,26 @@ bool RequestForwarder::processTimeoutRequest(RunnerId runner_id, ForwardRequestP
 }
 
 
-bool RequestForwarder::removeFromQueue(RunnerId runner_id, ForwardResponsePtr forward_response_ptr)
+ForwardRequestPtr RequestForwarder::removeFromQueue(RunnerId runner_id, ForwardResponsePtr forward_response_ptr)
 {
-    return forward_request_queue[runner_id]->findAndRemove([forward_response_ptr](const ForwardRequestPtr & request) -> bool
-    {
-        if (request->forwardType() != forward_response_ptr->forwardType())
-            return false;
+    ForwardRequestPtr removed;
+    forward_request_queue[runner_id]->findAndRemove(
+        [forward_response_ptr](const ForwardRequestPtr & request) -> bool
+        {
+            if (request->forwardType() != forward_response_ptr->forwardType())
+                return false;
 
-        return forward_response_ptr->match(request);
-    });
+            return forward_response_ptr->match(request);
+        },
+        removed);
+    return removed;
 }
 
 
 void RequestForwarder::processResponse(RunnerId runner_id, ForwardResponsePtr forward_response_ptr)
 {
-    if (!removeFromQueue(runner_id, forward_response_ptr))
+    auto forward_request = removeFromQueue(runner_id, forward_response_ptr);
+    if (!forward_request)
     {
         LOG_WARNING(log, "Not found request in runner {} for forward response {}", runner_id, forward_response_ptr->toString());
         return;
@@ -270,6 +298,7 @@ void RequestForwarder::processResponse(RunnerId runner_id, ForwardResponsePtr fo
     if (forward_response_ptr->accepted)
     {
         LOG_DEBUG(log, "Receive a forward response {} for runner {}", forward_response_ptr->toString(), runner_id);
+        forward_response_ptr->onSuccess(*this, *forward_request);
         return;
     }
 
@@ -11,6 +11,7 @@
 #include <Service/KeeperServer.h>
 #include <Service/RequestProcessor.h>
 #include <Service/RequestsQueue.h>
+#include <Service/SessionsSyncState.h>
 
 
 namespace RK
@@ -40,6 +41,12 @@ public:
 
     void shutdown();
 
+    /// Sessions synced to leader may be lost, send all sessions in next sync.
+    void resyncSessions() { sessions_sync_state.resync(); }
+
+    /// Leader acknowledged a sync of sessions.
+    void onSessionsSynced(int32_t leader, const SessionsSyncState::Sessions & sessions) { sessions_sync_state.onSynced(leader, sessions); }
+
     std::shared_ptr<RequestProcessor> request_processor;
     std::shared_ptr<KeeperDispatcher> keeper_dispatcher;
 
@@ -50,10 +57,14 @@ private:
     /// void runSessionSyncReceive(RunnerId runner_id);
 
     void processResponse(RunnerId runner_id, ForwardResponsePtr forward_response_ptr);
-    bool removeFromQueue(RunnerId runner_id, ForwardResponsePtr forward_response_ptr);
+    /// Remove the request of the response from queue, return nullptr if not found.
+    ForwardRequestPtr removeFromQueue(RunnerId runner_id, ForwardResponsePtr forward_response_ptr);
 
     bool processTimeoutRequest(RunnerId runner_id, ForwardRequestPtr newFront);
 
+    /// Local sessions whose expiration time changed since last sync, or all local sessions in a full sync.
+    SessionsSyncState::Sessions getSessionsToSync(int32_t leader);
+
     size_t parallel;
     ptr<RequestsQueue> requests_queue;
 
@@ -72,6 +83,9 @@ private:
     std::atomic<UInt64> session_sync_idx{0};
     Stopwatch session_sync_time_watch;
 
+    /// Local sessions leader knows, shared by syncs of all runners.
+    SessionsSyncState sessions_sync_state;
+
     using ForwardRequestQueue = ThreadSafeQueue<ForwardRequestPtr, std::list<ForwardRequestPtr>>;
     using ForwardRequestQueuePtr = std::unique_ptr<ForwardRequestQueue>;
     std::vector<ForwardRequestQueuePtr> forward_request_queue;
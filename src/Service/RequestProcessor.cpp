@@ -13,10 +13,7 @@ void RequestProcessor::push(const RequestForSession & request_for_session)
     if (!shutdown_called)
     {
         requests_queue->push(request_for_session);
-        {
-            std::unique_lock lk(mutex);
-            cv.notify_all();
-        }
+        notifyMainThread();
     }
 }
 
@@ -25,6 +22,17 @@ void RequestProcessor::systemExist()
     ::abort();
 }
 
+void RequestProcessor::notifyMainThread()
+{
+    /// RMW rather than load, it is ordered with the one in run, so either main thread sees the pushed
+    /// request or we see it waiting.
+    if (!main_thread_waiting.fetch_add(0, std::memory_order_acq_rel))
+        return;
+
+    std::lock_guard lk(mutex);
+    cv.notify_all();
+}
+
 void RequestProcessor::run()
 {
     setThreadName("ReqProcessor");
@@ -51,13 +59,17 @@ void RequestProcessor::run()
                             break;
                         }
                 }
-                return error_request_ids.empty() && requests_queue->empty() && committed_queue.empty() && pending_requests_empty;
+                return error_request_ids.empty() && exclusive_tasks.empty() && requests_queue->empty() && committed_queue.empty()
+                    && pending_requests_empty;
             };
 
             {
                 using namespace std::chrono_literals;
                 std::unique_lock lk(mutex);
-                if (!cv.wait_for(lk, operation_timeout_ms * 1ms, [&] { return !need_wait() || shutdown_called; }))
+                main_thread_waiting.fetch_add(1, std::memory_order_acq_rel);
+                bool woken = cv.wait_for(lk, operation_timeout_ms * 1ms, [&] { return !need_wait() || shutdown_called; });
+                main_thread_waiting.fetch_sub(1, std::memory_order_relaxed);
+                if (!woken)
                     LOG_DEBUG(
                         log,
                         "Waiting timeout errors size {}, requests_queue size {}, committed_queue size {}",
@@ -76,15 +88,16 @@ void RequestProcessor::run()
                 error_request_size = error_request_ids.size();
             }
 
-            /// 1. process read request
+            /// 1. process read request, in parallel
             watch.restart();
-            for (RunnerId runner_id = 0; runner_id < parallel; runner_id++)
-            {
-                moveRequestToPendingQueue(runner_id);
-                processReadRequests(runner_id);
-            }
+            processReadRequests();
+            if (shutdown_called)
+                return;
             Metrics::getMetrics().apply_read_request_time_ms->add(watch.elapsedMilliseconds());
 
+            /// Readers are waiting for next round and committed requests are not applied yet.
+            processExclusiveTasks();
+
             /// 2. process committed request, single thread
             watch.restart();
             processCommittedRequest(committed_request_size);
@@ -100,6 +113,80 @@ void RequestProcessor::run()
     }
 }
 
+void RequestProcessor::processReadRequests()
+{
+    std::unique_lock lock(read_mutex);
+    ++read_round;
+    running_readers = parallel;
+    read_cv.notify_all();
+
+    /// Requests are only moved to pending queue and processed by reader threads, and pending queue
+    /// of runners are accessed by the main thread after all readers finishing the round.
+    read_done_cv.wait(lock, [this] { return running_readers == 0 || shutdown_called; });
+}
+
+void RequestProcessor::runExclusively(std::function<void()> task)
+{
+    std::packaged_task<void()> packaged_task(std::move(task));
+    auto future = packaged_task.get_future();
+    {
+        std::lock_guard lk(mutex);
+        if (main_thread_started && !shutdown_called)
+        {
+            exclusive_tasks.push_back(std::move(packaged_task));
+            cv.notify_all();
+        }
+    }
+
+    /// Not taken by main thread, nobody else is accessing store.
+    if (packaged_task.valid())
+        packaged_task();
+    future.get();
+}
+
+void RequestProcessor::processExclusiveTasks()
+{
+    std::vector<std::packaged_task<void()>> tasks;
+    {
+        std::lock_guard lk(mutex);
+        tasks.swap(exclusive_tasks);
+    }
+
+    for (auto & task : tasks)
+        task();
+}
+
+void RequestProcessor::runReader(RunnerId runner_id)
+{
+    setThreadName(("ReqReader#" + toString(runner_id)).c_str());
+    UInt64 processed_round = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock lock(read_mutex);
+            read_cv.wait(lock, [&] { return read_round != processed_round || shutdown_called; });
+            if (shutdown_called)
+                return;
+            processed_round = read_round;
+        }
+
+        try
+        {
+            moveRequestToPendingQueue(runner_id);
+            processReadRequests(runner_id);
+        }
+        catch (...)
+        {
+            tryLogCurrentException(__PRETTY_FUNCTION__);
+        }
+
+        std::lock_guard lock(read_mutex);
+        if (--running_readers == 0)
+            read_done_cv.notify_all();
+    }
+}
+
 void RequestProcessor::moveRequestToPendingQueue(RunnerId runner_id)
 {
     auto & thread_requests = pending_requests.find(runner_id)->second;
@@ -108,17 +195,17 @@ void RequestProcessor::moveRequestToPendingQueue(RunnerId runner_id)
     if (request_size)
         LOG_TRACE(log, "Prepare to move {} requests to pending queue of runner {}", request_size, runner_id);
 
-    for (size_t i = 0; i < request_size; ++i)
+    RequestForSessions requests;
+    requests.reserve(request_size);
+    requests_queue->tryPopBatch(runner_id, requests, request_size);
+
+    for (auto & request : requests)
     {
-        RequestForSession request;
-        if (requests_queue->tryPop(runner_id, request))
+        auto op_num = request.request->getOpNum();
+        if (op_num != Coordination::OpNum::Auth)
         {
-            auto op_num = request.request->getOpNum();
-            if (op_num != Coordination::OpNum::Auth)
-            {
-                LOG_TRACE(log, "Move {} to pending queue", request.toSimpleString());
-                thread_requests[request.session_id].push_back(request);
-            }
+            LOG_TRACE(log, "Move {} to pending queue", request.toSimpleString());
+            thread_requests[request.session_id].push_back(std::move(request));
         }
     }
 }
@@ -209,11 +296,22 @@ void RequestProcessor::processCommittedRequest(size_t count)
         /// New session and update session requests are not put into pending queue
         if (unlikely(isSessionRequest(committed_request.request)))
         {
-            applyRequest(committed_request);
-            committed_queue.pop();
+            applyCommittedRequest(committed_request);
+        }
+        /// Dead sessions closed in batch, it is not put into pending queue either. Pending requests
+        /// of the sessions will never get responses as their connections are closed.
+        else if (unlikely(committed_request.request->getOpNum() == Coordination::OpNum::CloseSessions))
+        {
+            const auto & close_request = dynamic_cast<const ZooKeeperCloseSessionsRequest &>(*committed_request.request);
+            for (auto session_id : close_request.session_ids)
+                pending_requests.find(getRunnerId(session_id))->second.erase(session_id);
+
+            Stopwatch close_watch;
+            applyCommittedRequest(committed_request);
+            Metrics::getMetrics().dead_session_close_time_ms->add(close_watch.elapsedMilliseconds());
         }
         /// Remote requests
-        else if (!keeper_dispatcher->isLocalSession(committed_request.session_id))
+        else if (!isLocalSession(committed_request.session_id))
         {
             if (my_pending_requests.contains(committed_request.session_id))
             {
@@ -225,8 +323,7 @@ void RequestProcessor::processCommittedRequest(size_t count)
                 my_pending_requests.erase(committed_request.session_id);
             }
 
-            applyRequest(committed_request);
-            committed_queue.pop();
+            applyCommittedRequest(committed_request);
         }
         /// Local requests
         else
@@ -234,8 +331,7 @@ void RequestProcessor::processCommittedRequest(size_t count)
             if (unlikely(committed_request.request->getOpNum() == Coordination::OpNum::Auth))
             {
                 LOG_DEBUG(log, "Apply auth request {}", toHexString(committed_request.session_id));
-                applyRequest(committed_request);
-                committed_queue.pop();
+                applyCommittedRequest(committed_request);
             }
             else
             {
@@ -244,9 +340,8 @@ void RequestProcessor::processCommittedRequest(size_t count)
                     break;
 
                 /// apply request
-                applyRequest(committed_request);
-                committed_queue.pop();
-                Metrics::getMetrics().update_latency->add(getCurrentTimeMilliseconds() - committed_request.create_time);
+                if (applyCommittedRequest(committed_request))
+                    Metrics::getMetrics().update_latency->add(getCurrentTimeMilliseconds() - committed_request.create_time);
 
                 /// remove request from pending queue
                 auto & pending_requests_for_session = my_pending_requests[committed_request.session_id];
@@ -258,6 +353,51 @@ void RequestProcessor::processCommittedRequest(size_t count)
             }
         }
     }
+
+    /// Read requests or error requests are processed after all committed requests before them are applied.
+    applyWriteBatch();
+}
+
+bool RequestProcessor::applyCommittedRequest(const RequestForSession & request)
+{
+    if (write_applier && write_applier->canApplyInBatch(request))
+    {
+        write_batch.push_back(request);
+        ++write_batch_size;
+        committed_queue.pop();
+        return false;
+    }
+
+    applyWriteBatch();
+    applyRequest(request);
+    committed_queue.pop();
+    return true;
+}
+
+void RequestProcessor::applyWriteBatch()
+{
+    if (write_batch.empty())
+        return;
+
+    LOG_TRACE(log, "Apply {} committed(write) requests in batch", write_batch.size());
+    try
+    {
+        write_applier->apply(write_batch, responses_queue);
+    }
+    catch (...)
+    {
+        tryLogCurrentException(log, "Fail to apply committed(write) requests in batch.");
+        LOG_FATAL(log, "Fail to apply committed(write) request which will lead state machine inconsistency, system will exist.");
+        systemExist();
+    }
+
+    auto current_time = getCurrentTimeMilliseconds();
+    for (const auto & request : write_batch)
+        if (isLocalSession(request.session_id))
+            Metrics::getMetrics().update_latency->add(current_time - request.create_time);
+
+    write_batch.clear();
+    write_batch_size = 0;
 }
 
 void RequestProcessor::processErrorRequest(size_t count)
@@ -277,7 +417,16 @@ void RequestProcessor::processErrorRequest(size_t count)
 
         auto & my_pending_requests = pending_requests.find(getRunnerId(session_id))->second;
 
-        if (unlikely(isSessionRequest(error_request.opnum)))
+        /// Nobody waits for the response, just let the next write request upgrade the session again.
+        if (unlikely(error_request.opnum == Coordination::OpNum::UpgradeSession))
+        {
+            LOG_WARNING(log, "Fail to upgrade local session {}, {}", toHexString(session_id), error_request.toString());
+            getStore().cancelUpgradingLocalSession(session_id);
+
+            error_request_ids.erase(error_request.getRequestId());
+            error_requests.erase(error_requests.begin());
+        }
+        else if (unlikely(isSessionRequest(error_request.opnum)))
         {
             ZooKeeperResponsePtr response;
             if (isNewSessionRequest(error_request.opnum))
@@ -308,7 +457,7 @@ void RequestProcessor::processErrorRequest(size_t count)
             error_requests.erase(error_requests.begin());
         }
         /// Remote request
-        else if (!keeper_dispatcher->isLocalSession(session_id))
+        else if (!isLocalSession(session_id))
         {
             if (my_pending_requests.contains(session_id))
             {
@@ -414,6 +563,11 @@ std::optional<RequestForSession> RequestProcessor::findErrorRequest(const ErrorR
     return request;
 }
 
+bool RequestProcessor::isCloseLocalSession(const RequestForSession & request) const
+{
+    return request.request->getOpNum() == Coordination::OpNum::Close && getStore().isLocalSession(request.session_id);
+}
+
 void RequestProcessor::processReadRequests(RunnerId runner_id)
 {
     auto & thread_requests = pending_requests.find(runner_id)->second;
@@ -432,6 +586,12 @@ void RequestProcessor::processReadRequests(RunnerId runner_id)
                 Metrics::getMetrics().read_latency->add(current_time - session_request->create_time);
                 session_request = session_requests.erase(session_request);
             }
+            /// Local session is closed without Raft, just like a read request.
+            else if (isCloseLocalSession(*session_request))
+            {
+                applyRequest(*session_request);
+                session_request = session_requests.erase(session_request);
+            }
             else
             {
                 break;
@@ -452,9 +612,9 @@ void RequestProcessor::applyRequest(const RequestForSession & request) const
     {
         if (request.request->isReadRequest())
         {
-            if (server->isLeaderAlive())
+            if (isLeaderAlive())
             {
-                server->getKeeperStateMachine()->getStore().processRequest(responses_queue, request);
+                getStore().processRequest(responses_queue, request);
             }
             else
             {
@@ -470,9 +630,9 @@ void RequestProcessor::applyRequest(const RequestForSession & request) const
         }
         else
         {
-            if (!server->isLeaderAlive())
+            if (!isLeaderAlive() && !isCloseLocalSession(request))
                 LOG_WARNING(log, "Write request is committed, when try to apply it to store the leader is not alive.");
-            server->getKeeperStateMachine()->getStore().processRequest(responses_queue, request);
+            getStore().processRequest(responses_queue, request);
         }
     }
     catch (...)
@@ -486,6 +646,21 @@ void RequestProcessor::applyRequest(const RequestForSession & request) const
     }
 }
 
+KeeperStore & RequestProcessor::getStore() const
+{
+    return server->getKeeperStateMachine()->getStore();
+}
+
+bool RequestProcessor::isLeaderAlive() const
+{
+    return server->isLeaderAlive();
+}
+
+bool RequestProcessor::isLocalSession(int64_t session_id) const
+{
+    return keeper_dispatcher->isLocalSession(session_id);
+}
+
 void RequestProcessor::shutdown()
 {
     if (shutdown_called)
@@ -499,9 +674,22 @@ void RequestProcessor::shutdown()
         cv.notify_all();
     }
 
+    {
+        std::lock_guard lock(read_mutex);
+        read_cv.notify_all();
+        read_done_cv.notify_all();
+    }
+
     if (main_thread.joinable())
         main_thread.join();
 
+    for (auto & reader_thread : reader_threads)
+        if (reader_thread.joinable())
+            reader_thread.join();
+
+    /// Tasks pushed before shutdown but not taken by main thread.
+    processExclusiveTasks();
+
     RequestForSession request_for_session;
     while (requests_queue->tryPopAny(request_for_session))
     {
@@ -520,10 +708,7 @@ void RequestProcessor::commit(const RequestForSession & request)
     if (!shutdown_called)
     {
         committed_queue.push(request);
-        {
-            std::unique_lock lk(mutex);
-            cv.notify_all();
-        }
+        notifyMainThread();
         LOG_DEBUG(log, "Commit {}, now committed queue size is {}", request.toSimpleString(), committed_queue.size());
     }
 }
@@ -550,16 +735,31 @@ void RequestProcessor::initialize(
     size_t parallel_,
     std::shared_ptr<KeeperServer> server_,
     std::shared_ptr<KeeperDispatcher> keeper_dispatcher_,
-    UInt64 operation_timeout_ms_)
+    UInt64 operation_timeout_ms_,
+    size_t apply_thread_num)
 {
-    operation_timeout_ms = operation_timeout_ms_;
-    parallel = parallel_;
     server = server_;
     keeper_dispatcher = keeper_dispatcher_;
+    startup(parallel_, operation_timeout_ms_, apply_thread_num);
+}
+
+void RequestProcessor::startup(size_t parallel_, UInt64 operation_timeout_ms_, size_t apply_thread_num)
+{
+    operation_timeout_ms = operation_timeout_ms_;
+    parallel = parallel_;
     requests_queue = std::make_shared<RequestsQueue>(parallel, 20000);
+    if (apply_thread_num > 0)
+        write_applier = std::make_unique<WriteRequestsApplier>(getStore(), apply_thread_num);
     for (size_t runner_id = 0; runner_id < parallel; runner_id++)
         pending_requests.emplace(runner_id, std::unordered_map<int64_t, std::vector<RequestForSession>>());
+
+    reader_threads.reserve(parallel);
+    for (size_t runner_id = 0; runner_id < parallel; runner_id++)
+        reader_threads.emplace_back([this, runner_id] { runReader(runner_id); });
     main_thread = ThreadFromGlobalPool([this] { run(); });
+
+    std::lock_guard lk(mutex);
+    main_thread_started = true;
 }
 
 }
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <future>
+
 #include <Service/KeeperCommon.h>
 #include <Service/KeeperServer.h>
 #include <Service/RequestsQueue.h>
+#include <Service/WriteRequestsApplier.h>
 #include <ZooKeeper/ZooKeeperConstants.h>
 
 namespace RK
@@ -11,7 +14,13 @@ namespace RK
 class KeeperDispatcher;
 
 /** Handle user read request and Raft committed write request.
- */
+  *
+  * Read requests are executed by `parallel` reader threads, one for every runner, and
+  * committed write requests are applied by the main thread. The main thread starts a
+  * read round and waits all readers to finish it before applying writes, so reads and
+  * writes are never executed at the same time and requests of a session are processed
+  * in order.
+  */
 class RequestProcessor
 {
 public:
@@ -20,6 +29,8 @@ public:
     {
     }
 
+    virtual ~RequestProcessor() = default;
+
     void push(const RequestForSession & request_for_session);
 
     void shutdown();
@@ -33,23 +44,56 @@ public:
         size_t parallel_,
         std::shared_ptr<KeeperServer> server_,
         std::shared_ptr<KeeperDispatcher> keeper_dispatcher_,
-        UInt64 operation_timeout_ms_);
+        UInt64 operation_timeout_ms_,
+        size_t apply_thread_num = 0);
+
+    /// Committed requests which are not applied yet.
+    size_t commitQueueSize() const { return committed_queue.size() + write_batch_size; }
+
+    /// Run task by the main thread between a read round and applying committed requests, when the
+    /// store is accessed by neither reader nor writer, and wait it to finish. Exception of the task
+    /// is rethrown. The task is run in place if the processor is not started or is shut down.
+    void runExclusively(std::function<void()> task);
+
+protected:
+    /// Start reader threads and main thread, the hooks below should be ready to use.
+    void startup(size_t parallel_, UInt64 operation_timeout_ms_, size_t apply_thread_num);
 
-    size_t commitQueueSize() const { return committed_queue.size(); }
+    /// Hooks to Raft server and dispatcher, overridden in tests which run without them.
+    virtual KeeperStore & getStore() const;
+    virtual bool isLeaderAlive() const;
+    /// Whether the session is connected to this node.
+    virtual bool isLocalSession(int64_t session_id) const;
 
 private:
     void run();
+    /// Reader thread of a runner, process read requests in every read round.
+    void runReader(RunnerId runner_id);
+    /// Start a read round in all reader threads and wait them to finish.
+    void processReadRequests();
     /// Exist system for fatal error.
     [[noreturn]] static void systemExist();
+    /// Wake up main thread after pushing into a queue, takes the mutex only if main thread is waiting.
+    void notifyMainThread();
 
     void moveRequestToPendingQueue(RunnerId runner_id);
 
     void processReadRequests(RunnerId runner_id);
     void processErrorRequest(size_t count);
     void processCommittedRequest(size_t count);
+    /// Run tasks of runExclusively, invoked by main thread or after it exits.
+    void processExclusiveTasks();
 
     /// Apply request to state machine
     void applyRequest(const RequestForSession & request) const;
+
+    /// Close request of a local session, it is applied without Raft.
+    bool isCloseLocalSession(const RequestForSession & request) const;
+
+    /// Apply committed request and pop it from committed queue. If parallel apply is enabled, the
+    /// request may be put into write batch which is applied later by applyWriteBatch, then return false.
+    bool applyCommittedRequest(const RequestForSession & request);
+    void applyWriteBatch();
     size_t getRunnerId(int64_t session_id) const { return session_id % parallel; }
 
     /// Find error request in pending request queue
@@ -63,6 +107,14 @@ private:
     using RequestForSessions = std::vector<RequestForSession>;
 
     ThreadFromGlobalPool main_thread;
+    std::vector<ThreadFromGlobalPool> reader_threads;
+
+    /// Barrier between read rounds and committed requests processing.
+    std::mutex read_mutex;
+    std::condition_variable read_cv;
+    std::condition_variable read_done_cv;
+    UInt64 read_round = 0;
+    size_t running_readers = 0;
 
     std::atomic<bool> shutdown_called{false};
 
@@ -78,7 +130,14 @@ private:
     std::unordered_map<size_t, std::unordered_map<int64_t, RequestForSessions>> pending_requests;
 
     /// Raft committed write requests which can be local or from other nodes.
-    ConcurrentBoundedQueue<RequestForSession> committed_queue{1000};
+    /// Pushed by Raft commit thread only and popped by main thread only.
+    SPSCRingQueue<RequestForSession> committed_queue{1024};
+
+    /// Apply committed write requests in parallel, null if it is disabled.
+    std::unique_ptr<WriteRequestsApplier> write_applier;
+    /// Committed requests popped from committed queue but not applied yet.
+    std::vector<RequestForSession> write_batch;
+    std::atomic<size_t> write_batch_size{0};
 
     size_t parallel;
 
@@ -86,6 +145,12 @@ private:
 
     mutable std::mutex mutex;
     std::condition_variable cv;
+    /// Non-zero when main thread is waiting on cv, producers of queues skip notifying if not.
+    std::atomic<UInt32> main_thread_waiting{0};
+
+    /// Tasks of runExclusively, guarded by mutex.
+    std::vector<std::packaged_task<void()>> exclusive_tasks;
+    bool main_thread_started = false;
 
     /// Error requests when append entry or forward to leader.
     ErrorRequests error_requests;
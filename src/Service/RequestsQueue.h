@@ -1,8 +1,7 @@
 #pragma once
 
 #include <Service/NuRaftStateMachine.h>
-#include <boost/lockfree/queue.hpp>
-#include <Common/ConcurrentBoundedQueue.h>
+#include <Common/BoundedRingQueue.h>
 
 namespace RK
 {
@@ -32,10 +31,13 @@ namespace RK
  * 3 RequestAccumulator: accumulate request and send to Raft in batch.
  * 4 Raft log replication
  * 5 RequestProcessor: process user requests.
+ *
+ * Child queues are lock-free ring queues, every child queue is popped by one runner,
+ * but remaining requests are drained by another thread when shutting down.
  */
 struct RequestsQueue
 {
-    using Queue = ConcurrentBoundedQueue<RequestForSession>;
+    using Queue = MPMCRingQueue<RequestForSession>;
 
     std::vector<ptr<Queue>> queues;
 
@@ -75,6 +77,13 @@ struct RequestsQueue
         return queues[queue_id]->tryPop(request, wait_ms);
     }
 
+    /// Pop up to max_count requests, waiting wait_ms for the first one, return count of popped requests.
+    size_t tryPopBatch(size_t queue_id, std::vector<RequestForSession> & requests, size_t max_count, UInt64 wait_ms = 0)
+    {
+        assert(queue_id < queues.size());
+        return queues[queue_id]->tryPopBatch(requests, max_count, wait_ms);
+    }
+
     bool tryPopAny(RequestForSession & request, UInt64 wait_ms = 0)
     {
         for (const auto & queue : queues)
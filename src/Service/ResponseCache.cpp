@@ -0,0 +1,121 @@
+#include <Service/ResponseCache.h>
+
+namespace RK
+{
+
+ResponseCache::ResponseCache(UInt64 max_size_) : max_size(max_size_)
+{
+}
+
+SharedString ResponseCache::get(const String & path, Kind kind, int64_t mzxid, int64_t pzxid)
+{
+    auto & shard = getShard(path);
+    {
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.entries.find(path);
+        if (it != shard.entries.end() && it->second.mzxid == mzxid && it->second.pzxid == pzxid)
+        {
+            const auto & body = it->second.bodies[static_cast<size_t>(kind)];
+            if (!body.empty())
+            {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru_it);
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return body;
+            }
+        }
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return {};
+}
+
+void ResponseCache::set(const String & path, Kind kind, int64_t mzxid, int64_t pzxid, SharedString body)
+{
+    const UInt64 max_shard_size = max_size / SHARD_NUM;
+    if (body.empty() || entrySize(path) + body.size() > max_shard_size)
+        return;
+
+    auto & shard = getShard(path);
+    std::lock_guard lock(shard.mutex);
+
+    auto it = shard.entries.find(path);
+    if (it != shard.entries.end() && (it->second.mzxid != mzxid || it->second.pzxid != pzxid))
+    {
+        erase(shard, it);
+        it = shard.entries.end();
+    }
+
+    if (it == shard.entries.end())
+    {
+        shard.lru.push_front(path);
+        it = shard.entries.emplace(path, Entry{mzxid, pzxid, {}, entrySize(path), shard.lru.begin()}).first;
+        shard.size += it->second.size;
+    }
+    else
+    {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru_it);
+    }
+
+    auto & entry = it->second;
+    auto & cached_body = entry.bodies[static_cast<size_t>(kind)];
+    entry.size -= cached_body.size();
+    shard.size -= cached_body.size();
+    cached_body = std::move(body);
+    entry.size += cached_body.size();
+    shard.size += cached_body.size();
+
+    /// The entry just set is the most recently used one, so it is never evicted.
+    while (shard.size > max_shard_size)
+        erase(shard, shard.entries.find(shard.lru.back()));
+}
+
+void ResponseCache::invalidate(const String & path)
+{
+    auto & shard = getShard(path);
+    std::lock_guard lock(shard.mutex);
+    auto it = shard.entries.find(path);
+    if (it != shard.entries.end())
+        erase(shard, it);
+}
+
+void ResponseCache::clear()
+{
+    for (auto & shard : shards)
+    {
+        std::lock_guard lock(shard.mutex);
+        shard.entries.clear();
+        shard.lru.clear();
+        shard.size = 0;
+    }
+}
+
+void ResponseCache::erase(Shard & shard, std::unordered_map<String, Entry>::iterator it)
+{
+    shard.size -= it->second.size;
+    shard.lru.erase(it->second.lru_it);
+    shard.entries.erase(it);
+}
+
+UInt64 ResponseCache::getSize() const
+{
+    UInt64 size = 0;
+    for (const auto & shard : shards)
+    {
+        std::lock_guard lock(shard.mutex);
+        size += shard.size;
+    }
+    return size;
+}
+
+UInt64 ResponseCache::getEntriesCount() const
+{
+    UInt64 count = 0;
+    for (const auto & shard : shards)
+    {
+        std::lock_guard lock(shard.mutex);
+        count += shard.entries.size();
+    }
+    return count;
+}
+
+}
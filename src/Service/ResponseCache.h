@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include <Common/SharedString.h>
+#include <common/types.h>
+
+namespace RK
+{
+
+/** Cache of serialized bodies of get, list and exists responses, so that reading hot nodes does not
+  * serialize the same data, stat and children again and again. Only the header of xid, zxid and error
+  * is written per response, see ZooKeeperResponse::serialized_body.
+  *
+  * Entries are keyed by path, and every entry remembers mzxid and pzxid of the node it is built from,
+  * a lookup misses if the node has changed since then. Besides, KeeperStore invalidates the entry of
+  * every node it modifies, because some modifications like SetACL don't change mzxid or pzxid.
+  *
+  * Sharded by path, the least recently used entries of a shard are evicted when the shard exceeds
+  * its part of max_size. Disabled if max_size is 0.
+  *
+  * Thread-safe.
+  */
+class ResponseCache
+{
+public:
+    enum class Kind : UInt8
+    {
+        Get = 0,
+        List,
+        SimpleList,
+        Exists,
+    };
+
+    static constexpr size_t KIND_NUM = 4;
+    static constexpr size_t SHARD_NUM = 16;
+
+    explicit ResponseCache(UInt64 max_size_);
+
+    bool enabled() const { return max_size != 0; }
+
+    /// Returns empty string if there is no body cached for the version of node.
+    SharedString get(const String & path, Kind kind, int64_t mzxid, int64_t pzxid);
+    void set(const String & path, Kind kind, int64_t mzxid, int64_t pzxid, SharedString body);
+
+    void invalidate(const String & path);
+    void clear();
+
+    UInt64 getHits() const { return hits.load(std::memory_order_relaxed); }
+    UInt64 getMisses() const { return misses.load(std::memory_order_relaxed); }
+    /// Bytes of paths and bodies plus bookkeeping of entries.
+    UInt64 getSize() const;
+    UInt64 getEntriesCount() const;
+
+private:
+    struct Entry
+    {
+        int64_t mzxid;
+        int64_t pzxid;
+        std::array<SharedString, KIND_NUM> bodies;
+        size_t size;
+        std::list<String>::iterator lru_it;
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<String, Entry> entries;
+        /// Paths in the order of access, the most recently used first.
+        std::list<String> lru;
+        UInt64 size = 0;
+    };
+
+    static size_t entrySize(const String & path) { return sizeof(Entry) + 2 * (path.size() + sizeof(String)); }
+
+    Shard & getShard(const String & path) { return shards[std::hash<String>()(path) % SHARD_NUM]; }
+    static void erase(Shard & shard, std::unordered_map<String, Entry>::iterator it);
+
+    const UInt64 max_size;
+    std::array<Shard, SHARD_NUM> shards;
+
+    std::atomic<UInt64> hits{0};
+    std::atomic<UInt64> misses{0};
+};
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Service/KeeperCommon.h>
+#include <Service/ThreadSafeQueue.h>
+
+namespace RK
+{
+
+/**
+ * User responses queue who is a compound queue, responses are sharded by session id
+ * into child queues, and every child queue is consumed by one response thread of
+ * KeeperDispatcher.
+ *
+ * Responses and watch events of a session always go to the same child queue, so
+ * they are sent to client in the order they are pushed.
+ */
+struct ResponsesQueue
+{
+    using Queue = ThreadSafeQueue<ResponseForSession>;
+
+    std::vector<std::shared_ptr<Queue>> queues;
+
+    explicit ResponsesQueue(size_t child_queue_size = 1) { resize(child_queue_size); }
+
+    /// Not thread safe, should be called before any response is pushed.
+    void resize(size_t child_queue_size)
+    {
+        assert(child_queue_size > 0);
+
+        queues.resize(child_queue_size);
+        for (auto & queue : queues)
+            if (!queue)
+                queue = std::make_shared<Queue>();
+    }
+
+    size_t getQueueId(int64_t session_id) const { return static_cast<UInt64>(session_id) % queues.size(); }
+
+    void push(const ResponseForSession & response) { queues[getQueueId(response.session_id)]->push(response); }
+
+    void push(ResponseForSession && response) { queues[getQueueId(response.session_id)]->push(std::move(response)); }
+
+    bool tryPop(size_t queue_id, ResponseForSession & response, int64_t wait_ms = 0)
+    {
+        assert(queue_id < queues.size());
+        return queues[queue_id]->tryPop(response, wait_ms);
+    }
+
+    /// Pop from any child queue, used when responses are consumed by one thread, for example in tests.
+    bool tryPop(ResponseForSession & response, int64_t wait_ms = 0)
+    {
+        for (const auto & queue : queues)
+        {
+            if (queue->tryPop(response, wait_ms))
+                return true;
+        }
+        return false;
+    }
+
+    /// Iterate child queues one by one, responses of different sessions may be out of push order.
+    void forEach(const Queue::Func & func)
+    {
+        for (const auto & queue : queues)
+            queue->forEach(func);
+    }
+
+    size_t size() const
+    {
+        size_t size{};
+        for (const auto & queue : queues)
+            size += queue->size();
+        return size;
+    }
+
+    size_t size(size_t queue_id) const
+    {
+        assert(queue_id < queues.size());
+        return queues[queue_id]->size();
+    }
+
+    size_t childQueueSize() const { return queues.size(); }
+
+    bool empty() const { return size() == 0; }
+};
+
+}
@@ -4,105 +4,201 @@
 namespace RK
 {
 
-bool SessionExpiryQueue::remove(int64_t session_id)
+SessionExpiryQueue::SessionExpiryQueue(int64_t expiration_interval_) : expiration_interval(expiration_interval_)
 {
-    auto session_it = session_to_expiration_time.find(session_id);
-    if (session_it != session_to_expiration_time.end())
-    {
-        auto set_it = expiry_to_sessions.find(session_it->second);
-        if (set_it != expiry_to_sessions.end())
-            set_it->second.erase(session_id);
+    clear();
+}
 
-        /// No more sessions in this bucket
-        if (set_it->second.empty())
-            expiry_to_sessions.erase(set_it);
+void SessionExpiryQueue::pushBack(Link & head, Link & node)
+{
+    node.prev = head.prev;
+    node.next = &head;
+    head.prev->next = &node;
+    head.prev = &node;
+}
 
-        session_to_expiration_time.erase(session_it);
-        return true;
-    }
+void SessionExpiryQueue::unlink(Link & node)
+{
+    node.prev->next = node.next;
+    node.next->prev = node.prev;
+    node.prev = node.next = nullptr;
+}
 
-    return false;
+void SessionExpiryQueue::splice(Link & from, Link & to)
+{
+    if (isEmpty(from))
+        return;
+
+    Link * first = from.next;
+    Link * last = from.prev;
+    first->prev = to.prev;
+    to.prev->next = first;
+    last->next = &to;
+    to.prev = last;
+    initList(from);
 }
 
-void SessionExpiryQueue::addNewSessionOrUpdate(int64_t session_id, int64_t timeout_ms)
+void SessionExpiryQueue::place(Entry & entry)
 {
-    int64_t now = getNowMilliseconds();
-    /// round up to next interval
-    int64_t new_expiry_time = roundToNextInterval(now + timeout_ms);
+    if (entry.tick < cursor)
+    {
+        pushBack(expired, entry);
+        return;
+    }
 
-    setSessionExpirationTime(session_id, new_expiry_time);
+    auto span = static_cast<size_t>(entry.tick - cursor + 1);
+    if (span > wheel.size())
+    {
+        if (span > MAX_SLOTS)
+        {
+            pushBack(overflow, entry);
+            return;
+        }
+        grow(span);
+    }
+    pushBack(getSlot(entry.tick), entry);
 }
 
-void SessionExpiryQueue::setSessionExpirationTime(int64_t session_id, int64_t expiration_time)
+void SessionExpiryQueue::advance(int64_t now)
 {
-    int64_t new_expiry_time = expiration_time;
+    /// Sessions in ticks not after now_tick are expired.
+    int64_t now_tick = now / expiration_interval;
+    if (now_tick < cursor)
+        return;
 
-    auto session_it = session_to_expiration_time.find(session_id);
-    /// We already registered this session
-    if (session_it != session_to_expiration_time.end())
+    /// Clock jumped over the whole wheel, or the first call.
+    if (static_cast<size_t>(now_tick - cursor) >= wheel.size())
     {
-        int64_t prev_expiry_time = session_it->second;
-        session_it->second = new_expiry_time;
-        /// Nothing changed, session stay in the some bucket
-        if (new_expiry_time == prev_expiry_time)
-            return;
+        for (auto & slot : wheel)
+            splice(slot, expired);
+        cursor = now_tick + 1;
+        placeOverflow();
+        return;
+    }
 
-        /// This bucket doesn't exist, let's create it
-        auto set_it = expiry_to_sessions.find(new_expiry_time);
-        if (set_it == expiry_to_sessions.end())
-            std::tie(set_it, std::ignore) = expiry_to_sessions.emplace(new_expiry_time, std::unordered_set<int64_t>());
+    while (cursor <= now_tick)
+    {
+        splice(getSlot(cursor), expired);
+        ++cursor;
+        /// Sessions in overflow are at least a turn away, so checking them once per turn is enough.
+        if ((static_cast<size_t>(cursor) & (wheel.size() - 1)) == 0)
+            placeOverflow();
+    }
+}
 
-        /// Add session to the next bucket
-        set_it->second.insert(session_id);
+void SessionExpiryQueue::grow(size_t span)
+{
+    size_t new_size = wheel.size();
+    while (new_size < span)
+        new_size *= 2;
 
-        auto prev_set_it = expiry_to_sessions.find(prev_expiry_time);
-        /// Remove session from previous bucket
-        if (prev_set_it != expiry_to_sessions.end())
-            prev_set_it->second.erase(session_id);
+    Link pending;
+    initList(pending);
+    for (auto & slot : wheel)
+        splice(slot, pending);
+    splice(overflow, pending);
 
-        /// No more sessions in this bucket
-        if (prev_set_it->second.empty())
-            expiry_to_sessions.erase(prev_set_it);
-    }
-    else
+    wheel.assign(new_size, Link{});
+    for (auto & slot : wheel)
+        initList(slot);
+
+    while (!isEmpty(pending))
     {
-        /// Just add sessions to the new bucket
-        session_to_expiration_time[session_id] = new_expiry_time;
+        auto & entry = static_cast<Entry &>(*pending.next);
+        unlink(entry);
+        place(entry);
+    }
+}
 
-        auto set_it = expiry_to_sessions.find(new_expiry_time);
-        if (set_it == expiry_to_sessions.end())
-            std::tie(set_it, std::ignore) = expiry_to_sessions.emplace(new_expiry_time, std::unordered_set<int64_t>());
+void SessionExpiryQueue::placeOverflow()
+{
+    if (isEmpty(overflow))
+        return;
 
-        set_it->second.insert(session_id);
+    Link pending;
+    initList(pending);
+    splice(overflow, pending);
+    while (!isEmpty(pending))
+    {
+        auto & entry = static_cast<Entry &>(*pending.next);
+        unlink(entry);
+        place(entry);
     }
 }
 
-std::vector<int64_t> SessionExpiryQueue::getExpiredSessions() const
+bool SessionExpiryQueue::remove(int64_t session_id)
 {
-    int64_t now = getNowMilliseconds();
-    std::vector<int64_t> result;
+    auto session_it = sessions.find(session_id);
+    if (session_it == sessions.end())
+        return false;
+
+    unlink(session_it->second);
+    sessions.erase(session_it);
+    return true;
+}
+
+void SessionExpiryQueue::addNewSessionOrUpdate(int64_t session_id, int64_t timeout_ms, int64_t now)
+{
+    /// round up to next interval
+    int64_t new_expiry_time = roundToNextInterval(now + timeout_ms);
+    setSessionExpirationTime(session_id, new_expiry_time, now);
+}
+
+void SessionExpiryQueue::setSessionExpirationTime(int64_t session_id, int64_t expiration_time, int64_t now)
+{
+    advance(now);
 
-    /// Check all buckets
-    for (const auto & [expire_time, expired_sessions] : expiry_to_sessions)
+    int64_t new_tick = toTick(expiration_time);
+    auto [session_it, inserted] = sessions.try_emplace(session_id);
+    auto & entry = session_it->second;
+
+    entry.expiration_time = expiration_time;
+    if (inserted)
     {
-        if (expire_time <= now)
-            result.insert(result.end(), expired_sessions.begin(), expired_sessions.end());
-        else
-            break;
+        entry.session_id = session_id;
     }
+    else
+    {
+        /// Nothing changed, session stay in the same slot
+        if (entry.tick == new_tick)
+            return;
+        unlink(entry);
+    }
+
+    entry.tick = new_tick;
+    place(entry);
+}
 
+std::vector<int64_t> SessionExpiryQueue::getExpiredSessions(int64_t now)
+{
+    advance(now);
+
+    std::vector<int64_t> result;
+    for (const Link * node = expired.next; node != &expired; node = node->next)
+        result.push_back(static_cast<const Entry *>(node)->session_id);
     return result;
 }
 
-const std::unordered_map<int64_t, int64_t> & SessionExpiryQueue::sessionToExpirationTime() const
+std::unordered_map<int64_t, int64_t> SessionExpiryQueue::sessionToExpirationTime() const
 {
-    return session_to_expiration_time;
+    std::unordered_map<int64_t, int64_t> result;
+    result.reserve(sessions.size());
+    for (const auto & [session_id, entry] : sessions)
+        result.emplace(session_id, entry.expiration_time);
+    return result;
 }
 
 void SessionExpiryQueue::clear()
 {
-    session_to_expiration_time.clear();
-    expiry_to_sessions.clear();
+    sessions.clear();
+
+    wheel.assign(INITIAL_SLOTS, Link{});
+    for (auto & slot : wheel)
+        initList(slot);
+    initList(expired);
+    initList(overflow);
+
+    cursor = 0;
 }
 
 }
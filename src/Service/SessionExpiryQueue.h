@@ -1,30 +1,54 @@
 #pragma once
 
 #include <chrono>
-#include <map>
 #include <unordered_map>
-#include <unordered_set>
+#include <vector>
 
 namespace RK
 {
 
-/// Simple class for checking expired sessions. Main idea -- to round sessions
-/// timeouts and place all sessions into buckets rounded by their expired time.
-/// So we will have not too many different buckets and can check expired
-/// sessions quite fast.
-/// So buckets looks like this:
-/// [1630580418000] -> {1, 5, 6}
-/// [1630580418500] -> {2, 3}
-/// ...
-/// When new session appear it's added to the existing bucket or create new bucket.
+/// Hashed timing wheel for checking expired sessions. Time is divided into ticks of expiration_interval
+/// and session expiration times are rounded up to ticks. Every slot of the wheel is an intrusive list of
+/// sessions expiring at one tick, so:
+///  - updating expiration time on heartbeat unlinks the session from its slot and links it into another
+///    one, without allocation, and nothing is done if it stays in the same tick;
+///  - sessions of elapsed ticks are spliced into the expired list as the wheel turns, getting expired
+///    sessions costs O(number of expired sessions).
+///
+/// The wheel grows to cover the largest session timeout, sessions beyond MAX_SLOTS ticks wait in an
+/// overflow list which is moved into the wheel once per turn.
 class SessionExpiryQueue
 {
 private:
-    /// Session -> timeout ms
-    std::unordered_map<int64_t, int64_t> session_to_expiration_time;
+    static constexpr size_t INITIAL_SLOTS = 64;
+    static constexpr size_t MAX_SLOTS = 1 << 16;
 
-    /// Expire time -> session expire near this time
-    std::map<int64_t, std::unordered_set<int64_t>> expiry_to_sessions;
+    struct Link
+    {
+        Link * prev = nullptr;
+        Link * next = nullptr;
+    };
+
+    struct Entry : Link
+    {
+        int64_t session_id;
+        int64_t expiration_time;
+        /// Tick in which the session expires, rounded up from expiration_time
+        int64_t tick;
+    };
+
+    /// Session -> its entry, pointers to entries are stable.
+    std::unordered_map<int64_t, Entry> sessions;
+
+    /// Slot i holds sessions whose tick is equal to i modulo slot count, all of them in [cursor, cursor + wheel.size()).
+    std::vector<Link> wheel;
+    /// Sessions whose tick is before cursor.
+    Link expired;
+    /// Sessions whose tick is beyond the wheel.
+    Link overflow;
+
+    /// The first tick not elapsed yet.
+    int64_t cursor = 0;
 
     int64_t expiration_interval;
 
@@ -34,28 +58,58 @@ private:
         return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
     }
 
-    /// Round time to the next expiration interval. The result used as a key for
-    /// expiry_to_sessions map.
+    /// Round time to the next expiration interval.
     int64_t roundToNextInterval(int64_t time) const { return (time / expiration_interval + 1) * expiration_interval; }
 
+    int64_t toTick(int64_t time) const { return (time + expiration_interval - 1) / expiration_interval; }
+
+    static void initList(Link & head) { head.prev = head.next = &head; }
+    static bool isEmpty(const Link & head) { return head.next == &head; }
+    static void pushBack(Link & head, Link & node);
+    static void unlink(Link & node);
+    /// Move all nodes of from to the end of to.
+    static void splice(Link & from, Link & to);
+
+    Link & getSlot(int64_t tick) { return wheel[static_cast<size_t>(tick) & (wheel.size() - 1)]; }
+
+    /// Link entry into the expired list, a slot or the overflow list according to its tick.
+    void place(Entry & entry);
+    /// Turn the wheel to now, moving sessions of elapsed ticks into the expired list.
+    void advance(int64_t now);
+    /// Resize the wheel to at least span slots and relink sessions in it.
+    void grow(size_t span);
+    void placeOverflow();
+
 public:
-    /// expiration_interval -- how often we will check new sessions and how small
-    /// buckets we will have. In ZooKeeper normal session timeout is around 30 seconds
+    /// expiration_interval -- how often we will check new sessions and how large
+    /// ticks we will have. In ZooKeeper normal session timeout is around 30 seconds
     /// and expiration_interval is about 500ms.
-    explicit SessionExpiryQueue(int64_t expiration_interval_) : expiration_interval(expiration_interval_) { }
+    explicit SessionExpiryQueue(int64_t expiration_interval_);
+
+    /// Lists link to the sentinels inside the object.
+    SessionExpiryQueue(const SessionExpiryQueue &) = delete;
+    SessionExpiryQueue & operator=(const SessionExpiryQueue &) = delete;
 
     /// Session was actually removed
     bool remove(int64_t session_id);
 
     /// Update session expiry time (must be called on heartbeats)
-    void addNewSessionOrUpdate(int64_t session_id, int64_t timeout_ms);
+    void addNewSessionOrUpdate(int64_t session_id, int64_t timeout_ms) { addNewSessionOrUpdate(session_id, timeout_ms, getNowMilliseconds()); }
+    void addNewSessionOrUpdate(int64_t session_id, int64_t timeout_ms, int64_t now);
 
     /// Get all expired sessions
-    std::vector<int64_t> getExpiredSessions() const;
+    std::vector<int64_t> getExpiredSessions() { return getExpiredSessions(getNowMilliseconds()); }
+    std::vector<int64_t> getExpiredSessions(int64_t now);
 
-    const std::unordered_map<int64_t, int64_t> & sessionToExpirationTime() const;
+    std::unordered_map<int64_t, int64_t> sessionToExpirationTime() const;
+
+    void setSessionExpirationTime(int64_t session_id, int64_t expiration_time)
+    {
+        setSessionExpirationTime(session_id, expiration_time, getNowMilliseconds());
+    }
+    void setSessionExpirationTime(int64_t session_id, int64_t expiration_time, int64_t now);
 
-    void setSessionExpirationTime(int64_t session_id, int64_t expiration_time);
+    size_t size() const { return sessions.size(); }
 
     void clear();
 };
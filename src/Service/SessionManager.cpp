@@ -32,12 +32,32 @@ bool SessionManager::updateSessionTimeout(int64_t session_id, int64_t /*session_
     return true;
 }
 
+void SessionManager::upgradeSession(int64_t session_id, int64_t session_timeout_ms)
+{
+    std::lock_guard lock(session_mutex);
+    /// Local session is known only by its owner, for others this just creates the global session.
+    upgrading_local_sessions.erase(session_id);
+    local_session_expiry_queue.remove(session_id);
+    local_session_and_timeout.erase(session_id);
+
+    if (!session_and_timeout.emplace(session_id, session_timeout_ms).second)
+    {
+        LOG_DEBUG(log, "Session {} already upgraded, must applying a fuzzy log.", toHexString(session_id));
+        return;
+    }
+    session_expiry_queue.addNewSessionOrUpdate(session_id, session_timeout_ms);
+    LOG_DEBUG(log, "Local session {} upgraded to global session.", toHexString(session_id));
+}
+
 void SessionManager::reset()
 {
     std::lock_guard lock(session_mutex);
     session_id_counter = 1;
     session_and_timeout.clear();
     session_expiry_queue.clear();
+    local_session_and_timeout.clear();
+    upgrading_local_sessions.clear();
+    local_session_expiry_queue.clear();
 }
 
 }
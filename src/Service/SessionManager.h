@@ -22,7 +22,9 @@ public:
     using SessionIDs = std::vector<int64_t>;
 
     explicit SessionManager(int64_t dead_session_check_period_ms)
-        : session_expiry_queue(dead_session_check_period_ms), log(&Poco::Logger::get("SessionManager"))
+        : session_expiry_queue(dead_session_check_period_ms)
+        , local_session_expiry_queue(dead_session_check_period_ms)
+        , log(&Poco::Logger::get("SessionManager"))
     {
     }
 
@@ -36,8 +38,15 @@ public:
     void updateSessionExpirationTime(int64_t session_id)
     {
         std::lock_guard lock(session_mutex);
-        if (session_and_timeout.contains(session_id))
-            session_expiry_queue.addNewSessionOrUpdate(session_id, session_and_timeout[session_id]);
+        auto it = session_and_timeout.find(session_id);
+        if (it != session_and_timeout.end())
+        {
+            session_expiry_queue.addNewSessionOrUpdate(session_id, it->second);
+            return;
+        }
+        auto local_it = local_session_and_timeout.find(session_id);
+        if (local_it != local_session_and_timeout.end())
+            local_session_expiry_queue.addNewSessionOrUpdate(session_id, local_it->second);
     }
 
     bool contains(int64_t session_id) const
@@ -53,6 +62,16 @@ public:
         session_and_timeout.erase(session_id);
     }
 
+    void expireSessions(const std::vector<int64_t> & session_ids)
+    {
+        std::lock_guard lock(session_mutex);
+        for (auto session_id : session_ids)
+        {
+            session_expiry_queue.remove(session_id);
+            session_and_timeout.erase(session_id);
+        }
+    }
+
     int64_t getSessionIDCounter() const
     {
         std::lock_guard lock(session_mutex);
@@ -85,24 +104,25 @@ public:
         session_expiry_queue.addNewSessionOrUpdate(session_id, session_timeout_ms);
     }
 
-    std::vector<int64_t> getDeadSessions() const
+    /// Also turns the expiry queue to now.
+    std::vector<int64_t> getDeadSessions()
     {
         std::lock_guard lock(session_mutex);
-        auto ret = session_expiry_queue.getExpiredSessions();
-        return ret;
+        return session_expiry_queue.getExpiredSessions();
     }
 
     std::unordered_map<int64_t, int64_t> sessionToExpirationTime() const
     {
         std::lock_guard lock(session_mutex);
-        const auto & ret = session_expiry_queue.sessionToExpirationTime();
-        return ret;
+        return session_expiry_queue.sessionToExpirationTime();
     }
 
-    void handleRemoteSession(int64_t session_id, int64_t expiration_time)
+    /// Apply sessions synced from a follower in one batch.
+    void handleRemoteSessions(const std::unordered_map<int64_t, int64_t> & session_to_expiration_time)
     {
         std::lock_guard lock(session_mutex);
-        session_expiry_queue.setSessionExpirationTime(session_id, expiration_time);
+        for (const auto & [session_id, expiration_time] : session_to_expiration_time)
+            session_expiry_queue.setSessionExpirationTime(session_id, expiration_time);
     }
 
     void dumpSessionIDs(WriteBuffer & buf, const String & delimiter = "\n") const
@@ -115,6 +135,71 @@ public:
         }
     }
 
+    /// Local sessions only live in the server which creates them, they are not replicated by Raft.
+
+    void addLocalSession(int64_t session_id, int64_t session_timeout_ms)
+    {
+        std::lock_guard lock(session_mutex);
+        local_session_and_timeout.emplace(session_id, session_timeout_ms);
+        local_session_expiry_queue.addNewSessionOrUpdate(session_id, session_timeout_ms);
+    }
+
+    /// Local session including the upgrading ones.
+    bool containsLocalSession(int64_t session_id) const
+    {
+        std::lock_guard lock(session_mutex);
+        return local_session_and_timeout.contains(session_id);
+    }
+
+    /// Local session which is not upgrading, its requests never go through Raft.
+    bool isLocalSession(int64_t session_id) const
+    {
+        std::lock_guard lock(session_mutex);
+        return local_session_and_timeout.contains(session_id) && !upgrading_local_sessions.contains(session_id);
+    }
+
+    /// Mark a local session as upgrading, return its timeout if the caller should upgrade it,
+    /// return -1 if it is not a local session or is already upgrading.
+    int64_t startUpgradingLocalSession(int64_t session_id)
+    {
+        std::lock_guard lock(session_mutex);
+        auto it = local_session_and_timeout.find(session_id);
+        if (it == local_session_and_timeout.end() || !upgrading_local_sessions.emplace(session_id).second)
+            return -1;
+        return it->second;
+    }
+
+    /// The UpgradeSession request failed, the next write request will upgrade the session again.
+    void cancelUpgradingLocalSession(int64_t session_id)
+    {
+        std::lock_guard lock(session_mutex);
+        upgrading_local_sessions.erase(session_id);
+    }
+
+    /// Turn a session to global session, applied by all servers when the UpgradeSession request is committed.
+    void upgradeSession(int64_t session_id, int64_t session_timeout_ms);
+
+    bool removeLocalSession(int64_t session_id)
+    {
+        std::lock_guard lock(session_mutex);
+        upgrading_local_sessions.erase(session_id);
+        local_session_expiry_queue.remove(session_id);
+        return local_session_and_timeout.erase(session_id);
+    }
+
+    /// Also turns the local expiry queue to now.
+    std::vector<int64_t> getDeadLocalSessions()
+    {
+        std::lock_guard lock(session_mutex);
+        return local_session_expiry_queue.getExpiredSessions();
+    }
+
+    size_t getLocalSessionCount() const
+    {
+        std::lock_guard lock(session_mutex);
+        return local_session_and_timeout.size();
+    }
+
     void reset();
 
 private:
@@ -126,6 +211,12 @@ private:
     /// For follower/leaner, holds only local sessions
     SessionExpiryQueue session_expiry_queue;
 
+    /// Local sessions and their initialized expiry timeout, never in snapshot.
+    SessionAndTimeout local_session_and_timeout;
+    /// Local sessions whose UpgradeSession request is sent but not committed.
+    std::unordered_set<int64_t> upgrading_local_sessions;
+    SessionExpiryQueue local_session_expiry_queue;
+
     mutable std::mutex session_mutex;
 
     int64_t session_id_counter{1};
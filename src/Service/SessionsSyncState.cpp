@@ -0,0 +1,46 @@
+#include <Service/SessionsSyncState.h>
+
+namespace RK
+{
+
+SessionsSyncState::Sessions SessionsSyncState::getSessionsToSync(int32_t leader, const Sessions & local_sessions, bool & full_sync)
+{
+    std::lock_guard lock(mutex);
+
+    /// New leader knows nothing about sessions synced to the previous one.
+    full_sync = need_full_sync.exchange(false) || leader != synced_leader || ++rounds_since_full_sync >= FULL_SYNC_ROUNDS;
+
+    if (full_sync)
+    {
+        synced_leader = leader;
+        rounds_since_full_sync = 0;
+        synced_sessions.clear();
+        return local_sessions;
+    }
+
+    /// Sessions not local any more are closed or disconnected, leader expires them by itself.
+    std::erase_if(synced_sessions, [&](const auto & session) { return !local_sessions.contains(session.first); });
+
+    Sessions sessions_to_sync;
+    for (const auto & [session_id, expiration_time] : local_sessions)
+    {
+        auto it = synced_sessions.find(session_id);
+        if (it == synced_sessions.end() || it->second != expiration_time)
+            sessions_to_sync.emplace(session_id, expiration_time);
+    }
+    return sessions_to_sync;
+}
+
+void SessionsSyncState::onSynced(int32_t leader, const Sessions & sessions)
+{
+    std::lock_guard lock(mutex);
+    if (leader != synced_leader)
+        return;
+
+    /// Acknowledgements of different runners may be out of order, a stale expiration time
+    /// only makes the session be sent again.
+    for (const auto & [session_id, expiration_time] : sessions)
+        synced_sessions[session_id] = expiration_time;
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+namespace RK
+{
+
+/** Local sessions of a follower which leader knows, used to sync only changed sessions to leader.
+  *
+  * Follower sends sessions which are new or whose expiration time changed since the syncs leader
+  * acknowledged. All sessions are sent when leader changes, after a resync is requested, for example
+  * a sync failed or timed out, and every FULL_SYNC_ROUNDS syncs in case that leader missed some of
+  * them silently.
+  *
+  * Thread safe, syncs are sent by all forwarder runners and acknowledged by their receiving threads.
+  */
+class SessionsSyncState
+{
+public:
+    /// Session id -> expiration time
+    using Sessions = std::unordered_map<int64_t, int64_t>;
+
+    static constexpr size_t FULL_SYNC_ROUNDS = 30;
+
+    /// Sessions to send to leader, local_sessions are all local sessions now.
+    Sessions getSessionsToSync(int32_t leader, const Sessions & local_sessions, bool & full_sync);
+
+    /// Leader acknowledged the sessions, acknowledgements from a previous leader are ignored.
+    void onSynced(int32_t leader, const Sessions & sessions);
+
+    /// Send all sessions in next sync.
+    void resync() { need_full_sync = true; }
+
+private:
+    std::mutex mutex;
+
+    /// Sessions and expiration time acknowledged by synced_leader.
+    Sessions synced_sessions;
+    int32_t synced_leader{-1};
+    size_t rounds_since_full_sync{0};
+
+    std::atomic<bool> need_full_sync{true};
+};
+
+}
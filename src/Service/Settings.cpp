@@ -41,6 +41,29 @@ namespace FsyncModeNS
 
 }
 
+namespace DataTreeEngineNS
+{
+    DataTreeEngine parseDataTreeEngine(const String & in)
+    {
+        if (in == "hash_map")
+            return DataTreeEngine::HASH_MAP;
+        else if (in == "flat_hash_map")
+            return DataTreeEngine::FLAT_HASH_MAP;
+        else
+            throw Exception("Unknown config 'data_tree_engine'.", ErrorCodes::UNKNOWN_SETTING);
+    }
+
+    String toString(DataTreeEngine engine)
+    {
+        if (engine == DataTreeEngine::HASH_MAP)
+            return "hash_map";
+        else if (engine == DataTreeEngine::FLAT_HASH_MAP)
+            return "flat_hash_map";
+        else
+            throw Exception("Unknown config 'data_tree_engine'.", ErrorCodes::UNKNOWN_SETTING);
+    }
+}
+
 void RaftSettings::loadFromConfig(const String & config_elem, const Poco::Util::AbstractConfiguration & config)
 {
     if (!config.has(config_elem))
@@ -70,6 +93,7 @@ void RaftSettings::loadFromConfig(const String & config_elem, const Poco::Util::
             min_session_timeout_ms = Coordination::DEFAULT_MIN_SESSION_TIMEOUT_MS;
         }
         dead_session_check_period_ms = config.getUInt(get_key("dead_session_check_period_ms"), 500);
+        local_session_enabled = config.getBool(get_key("local_session_enabled"), false);
         heart_beat_interval_ms = config.getUInt(get_key("heart_beat_interval_ms"), 500);
         client_req_timeout_ms = config.getUInt(get_key("client_req_timeout_ms"), operation_timeout_ms);
         election_timeout_lower_bound_ms = config.getUInt(get_key("election_timeout_lower_bound_ms"), Coordination::ELECTION_TIMEOUT_LOWER_BOUND_MS);
@@ -86,10 +110,19 @@ void RaftSettings::loadFromConfig(const String & config_elem, const Poco::Util::
         fresh_log_gap = config.getUInt(get_key("fresh_log_gap"), 200);
         configuration_change_tries_count = config.getUInt(get_key("configuration_change_tries_count"), 30);
         max_batch_size = config.getUInt(get_key("max_batch_size"), 1000);
+        max_requests_per_log_entry = config.getUInt(get_key("max_requests_per_log_entry"), 1);
+        max_batch_bytes = config.getUInt(get_key("max_batch_bytes"), 4194304);
+        batch_target_latency_ms = config.getUInt(get_key("batch_target_latency_ms"), 10);
+        max_inflight_batches = config.getUInt(get_key("max_inflight_batches"), 4);
         log_fsync_mode = FsyncModeNS::parseFsyncMode(config.getString(get_key("log_fsync_mode"), "fsync_parallel"));
         log_fsync_interval = config.getUInt(get_key("log_fsync_interval"), 1000);
         max_log_segment_file_size = config.getUInt(get_key("max_log_segment_file_size"), 1073741824);
         async_snapshot = config.getBool(get_key("async_snapshot"), true);
+        data_tree_engine = DataTreeEngineNS::parseDataTreeEngine(config.getString(get_key("data_tree_engine"), "hash_map"));
+        data_tree_bucket_num = config.getUInt(get_key("data_tree_bucket_num"), 0);
+        apply_thread_num = config.getUInt(get_key("apply_thread_num"), 0);
+        memory_subtree_depth = config.getUInt(get_key("memory_subtree_depth"), 3);
+        response_cache_size = config.getUInt(get_key("response_cache_size"), 0);
     }
     catch (Exception & e)
     {
@@ -106,6 +139,7 @@ RaftSettingsPtr RaftSettings::getDefault()
     settings->min_session_timeout_ms = Coordination::DEFAULT_MIN_SESSION_TIMEOUT_MS;
     settings->operation_timeout_ms = Coordination::DEFAULT_OPERATION_TIMEOUT_MS;
     settings->dead_session_check_period_ms = 500;
+    settings->local_session_enabled = false;
     settings->heart_beat_interval_ms = 500;
     settings->client_req_timeout_ms = settings->operation_timeout_ms;
     settings->election_timeout_lower_bound_ms = Coordination::ELECTION_TIMEOUT_LOWER_BOUND_MS;
@@ -121,10 +155,19 @@ RaftSettingsPtr RaftSettings::getDefault()
     settings->fresh_log_gap = 200;
     settings->configuration_change_tries_count = 30;
     settings->max_batch_size = 1000;
+    settings->max_requests_per_log_entry = 1;
+    settings->max_batch_bytes = 4194304;
+    settings->batch_target_latency_ms = 10;
+    settings->max_inflight_batches = 4;
     settings->log_fsync_interval = 1000;
     settings->max_log_segment_file_size = 1073741824;
     settings->log_fsync_mode = FsyncMode::FSYNC_PARALLEL;
     settings->async_snapshot = true;
+    settings->data_tree_engine = DataTreeEngine::HASH_MAP;
+    settings->data_tree_bucket_num = 0;
+    settings->apply_thread_num = 0;
+    settings->memory_subtree_depth = 3;
+    settings->response_cache_size = 0;
 
     return settings;
 }
@@ -133,9 +176,9 @@ const String Settings::DEFAULT_FOUR_LETTER_WORD_CMD =
 #if USE_JEMALLOC
 "jmst,jmpg,jmep,jmfp,jmdp,"
 #endif
-"conf,cons,crst,envi,ruok,srst,srvr,stat,wchs,dirs,mntr,isro,lgif,rqld,uptm,csnp";
+"conf,cons,crst,envi,ruok,srst,srvr,stat,wchs,dirs,mntr,isro,lgif,rqld,uptm,csnp,mems";
 
-Settings::Settings() : my_id(NOT_EXIST), port(NOT_EXIST), standalone_keeper(false), raft_settings(RaftSettings::getDefault())
+Settings::Settings() : my_id(NOT_EXIST), port(NOT_EXIST), response_thread_num(1), standalone_keeper(false), raft_settings(RaftSettings::getDefault())
 {
 }
 
@@ -166,6 +209,9 @@ void Settings::dump(WriteBufferFromOwnString & buf) const
     writeText("parallel=", buf);
     write_int(parallel);
 
+    writeText("response_thread_num=", buf);
+    write_int(response_thread_num);
+
     writeText("snapshot_create_interval=", buf);
     write_int(snapshot_create_interval);
 
@@ -191,6 +237,8 @@ void Settings::dump(WriteBufferFromOwnString & buf) const
     write_int(raft_settings->operation_timeout_ms);
     writeText("dead_session_check_period_ms=", buf);
     write_int(raft_settings->dead_session_check_period_ms);
+    writeText("local_session_enabled=", buf);
+    write_int(raft_settings->local_session_enabled);
 
     writeText("heart_beat_interval_ms=", buf);
     write_int(raft_settings->heart_beat_interval_ms);
@@ -207,8 +255,27 @@ void Settings::dump(WriteBufferFromOwnString & buf) const
     write_int(raft_settings->snapshot_distance);
     writeText("async_snapshot=", buf);
     write_int(raft_settings->async_snapshot);
+    writeText("max_inflight_batches=", buf);
+    write_int(raft_settings->max_inflight_batches);
+    writeText("max_requests_per_log_entry=", buf);
+    write_int(raft_settings->max_requests_per_log_entry);
+    writeText("max_batch_bytes=", buf);
+    write_int(raft_settings->max_batch_bytes);
+    writeText("batch_target_latency_ms=", buf);
+    write_int(raft_settings->batch_target_latency_ms);
     writeText("max_stored_snapshots=", buf);
     write_int(raft_settings->max_stored_snapshots);
+    writeText("data_tree_engine=", buf);
+    writeText(DataTreeEngineNS::toString(raft_settings->data_tree_engine), buf);
+    buf.write('\n');
+    writeText("data_tree_bucket_num=", buf);
+    write_int(raft_settings->data_tree_bucket_num);
+    writeText("apply_thread_num=", buf);
+    write_int(raft_settings->apply_thread_num);
+    writeText("memory_subtree_depth=", buf);
+    write_int(raft_settings->memory_subtree_depth);
+    writeText("response_cache_size=", buf);
+    write_int(raft_settings->response_cache_size);
 
     writeText("shutdown_timeout=", buf);
     write_int(raft_settings->shutdown_timeout);
@@ -249,6 +316,9 @@ SettingsPtr Settings::loadFromConfig(const Poco::Util::AbstractConfiguration & c
 
     ret->internal_port = config.getInt("keeper.internal_port", 8103);
     ret->parallel = config.getInt("keeper.parallel", std::max(4U, getNumberOfPhysicalCPUCores()));
+    ret->response_thread_num = config.getInt("keeper.response_thread_num", std::max(1, ret->parallel / 2));
+    if (ret->response_thread_num <= 0)
+        throw Exception(ErrorCodes::ILLEGAL_SETTING_VALUE, "response_thread_num must be positive.");
 
     ret->snapshot_create_interval = config.getUInt("keeper.snapshot_create_interval", 3600);
     ret->snapshot_create_interval = std::max(ret->snapshot_create_interval, 1U);
@@ -28,6 +28,21 @@ namespace FsyncModeNS
     String toString(FsyncMode mode);
 }
 
+/// Engine of data tree in KeeperStore.
+enum class DataTreeEngine
+{
+    /// Nodes are keyed by full path in hash maps.
+    HASH_MAP,
+    /// Nodes are keyed by full path in open-addressing hash maps which are resized incrementally.
+    FLAT_HASH_MAP
+};
+
+namespace DataTreeEngineNS
+{
+    DataTreeEngine parseDataTreeEngine(const String & in);
+    String toString(DataTreeEngine engine);
+}
+
 struct RaftSettings;
 using RaftSettingsPtr = std::shared_ptr<RaftSettings>;
 
@@ -50,6 +65,8 @@ struct Settings
 
     uint32_t snapshot_create_interval;
     int32_t parallel;
+    /// Threads to send responses, responses are sharded by session id among them
+    int32_t response_thread_num;
 
     String four_letter_word_white_list;
 
@@ -78,6 +95,8 @@ struct RaftSettings
     UInt64 operation_timeout_ms;
     /// How often leader will check sessions to consider them dead and remove
     UInt64 dead_session_check_period_ms;
+    /// Whether sessions are created and expired by the connected server without Raft, until their first write request
+    bool local_session_enabled;
     /// Heartbeat interval between quorum nodes
     UInt64 heart_beat_interval_ms;
     /// Lower bound of election timer (avoid too often leader elections)
@@ -106,6 +125,15 @@ struct RaftSettings
     UInt64 configuration_change_tries_count;
     /// Max batch size for append_entries
     UInt64 max_batch_size;
+    /// Max requests packed into one Raft log entry, 1 means a log entry for every request. Packed log
+    /// entries can not be read by old versions, so it should be increased after the whole cluster upgraded.
+    UInt64 max_requests_per_log_entry;
+    /// Max bytes of requests in a batch for append_entries
+    UInt64 max_batch_bytes;
+    /// Target p99 latency of appending a batch to commit, batch size and linger time are adjusted by it, 0 means disabled
+    UInt64 batch_target_latency_ms;
+    /// Max batches appended to Raft and not committed yet, 1 means appending a batch after the previous one is committed
+    UInt64 max_inflight_batches;
     /// Raft log fsync mode
     FsyncMode log_fsync_mode;
     /// How many logs do once fsync when async_fsync is false
@@ -114,6 +142,16 @@ struct RaftSettings
     UInt64 max_log_segment_file_size;
     /// Whether async snapshot
     bool async_snapshot;
+    /// Data tree engine, 'hash_map' or 'flat_hash_map'
+    DataTreeEngine data_tree_engine;
+    /// Bucket count of 'flat_hash_map' data tree, 0 means choosing it by node count of snapshot
+    UInt32 data_tree_bucket_num;
+    /// Threads applying committed write requests which do not conflict, 0 means applying them one by one
+    UInt64 apply_thread_num;
+    /// Memory usage of data tree is rolled up by subtrees of the first so many path components
+    UInt32 memory_subtree_depth;
+    /// Max bytes of cached serialized get, list and exists responses, 0 means disabled
+    UInt64 response_cache_size;
 
     Poco::Logger * log = &Poco::Logger::get("RaftSettings");
 
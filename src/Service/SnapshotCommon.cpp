@@ -123,15 +123,16 @@ String serializeKeeperNode(const String & path, const ptr<KeeperNode> & node, Sn
     return std::move(buf.str());
 }
 
-ptr<KeeperNodeWithPath>parseKeeperNode(const String & buf, SnapshotVersion version)
+ptr<KeeperNodeWithPath> parseKeeperNode(const String & buf, SnapshotVersion version, KeeperNodeArena * arena)
 {
     ReadBufferFromMemory in(buf.data(), buf.size());
 
     ptr<KeeperNodeWithPath> node_with_path = cs_new<KeeperNodeWithPath>();
+    Coordination::read(node_with_path->path, in);
+
     auto & node = node_with_path->node;
-    node = std::make_shared<KeeperNode>();
+    node = arena ? arena->makeNode(node_with_path->path) : std::make_shared<KeeperNode>();
 
-    Coordination::read(node_with_path->path, in);
     Coordination::read(node->data, in);
 
     if (version == SnapshotVersion::V0)
@@ -397,7 +398,7 @@ void parseBatchDataV2(KeeperStore & store, SnapshotBatchBody & batch, BucketEdge
 
         try
         {
-            auto node_with_path = parseKeeperNode(data, version);
+            auto node_with_path = parseKeeperNode(data, version, &store.getNodeArena());
             path = std::move(node_with_path->path);
             node = std::move(node_with_path->node);
             assert(node);
@@ -418,7 +419,7 @@ void parseBatchDataV2(KeeperStore & store, SnapshotBatchBody & batch, BucketEdge
 
         auto ephemeral_owner = node->stat.ephemeralOwner;
         if (ephemeral_owner != 0)
-            store.addEphemeralNode(ephemeral_owner, path);
+            store.addEphemeralNode(ephemeral_owner, path, *node);
 
         if (likely(path != "/"))
         {
@@ -102,8 +102,9 @@ void writeTailAndClose(ptr<WriteBufferFromFile> & out, UInt32 checksum);
 UInt32 updateCheckSum(UInt32 checksum, UInt32 data_crc);
 
 /// Serialize and parse keeper node. Please note that children is ignored for we build parent relationship after load all data.
+/// If arena is not null, the parsed node is allocated from it.
 String serializeKeeperNode(const String & path, const ptr<KeeperNode> & node, SnapshotVersion version);
-ptr<KeeperNodeWithPath> parseKeeperNode(const String & buf, SnapshotVersion version);
+ptr<KeeperNodeWithPath> parseKeeperNode(const String & buf, SnapshotVersion version, KeeperNodeArena * arena = nullptr);
 
 
 /// save batch data in snapshot object
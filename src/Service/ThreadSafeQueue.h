@@ -14,6 +14,8 @@ private:
     mutable std::mutex queue_mutex;
     std::condition_variable cv;
     Queue queue;
+    /// Threads waiting in tryPop, guarded by queue_mutex. Push skips notifying if there is none.
+    size_t waiters = 0;
 public:
 
     using Func = std::function<bool(const T & e)>;
@@ -22,14 +24,16 @@ public:
     {
         std::lock_guard lock(queue_mutex);
         queue.push_back(response);
-        cv.notify_one();
+        if (waiters)
+            cv.notify_one();
     }
 
     void push(T && response)
     {
         std::lock_guard lock(queue_mutex);
         queue.emplace_back(std::move(response));
-        cv.notify_one();
+        if (waiters)
+            cv.notify_one();
     }
 
     void pop()
@@ -41,8 +45,14 @@ public:
     bool tryPop(T & response, int64_t timeout_ms = 0)
     {
         std::unique_lock lock(queue_mutex);
-        if (!cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return !queue.empty(); }))
-            return false;
+        if (queue.empty())
+        {
+            ++waiters;
+            bool ready = cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return !queue.empty(); });
+            --waiters;
+            if (!ready)
+                return false;
+        }
 
         response = queue.front();
         queue.pop_front();
@@ -94,6 +104,23 @@ public:
         return false;
     }
 
+    /// The same as above, and the removed element is moved to removed.
+    bool findAndRemove(Func func, T & removed)
+    {
+        std::unique_lock lock(queue_mutex);
+
+        for (auto it = queue.begin(); it != queue.end(); ++it)
+        {
+            if (func(*it))
+            {
+                removed = std::move(*it);
+                queue.erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+
     void removeFrontIf(Func func)
     {
         std::unique_lock lock(queue_mutex);
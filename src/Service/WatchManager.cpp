@@ -1,3 +1,5 @@
+#include <bit>
+
 #include <Common/IO/Operators.h>
 #include <Common/IO/WriteBufferFromString.h>
 #include <common/logger_useful.h>
@@ -8,26 +10,62 @@
 namespace RK
 {
 
+namespace
+{
+
+std::shared_ptr<Coordination::ZooKeeperWatchResponse> makeWatchResponse(const String & path, Coordination::Event event_type)
+{
+    auto watch_response = std::make_shared<Coordination::ZooKeeperWatchResponse>();
+    watch_response->path = path;
+    watch_response->xid = Coordination::WATCH_XID;
+    watch_response->zxid = -1;
+    watch_response->type = event_type;
+    watch_response->state = Coordination::State::CONNECTED;
+    return watch_response;
+}
+
+constexpr UInt8 ONE_TIME_WATCH_TYPES = static_cast<UInt8>(WatchType::List) | static_cast<UInt8>(WatchType::Data);
+
+UInt8 toWatchTypes(Coordination::WatcherType type)
+{
+    switch (type)
+    {
+        case Coordination::WatcherType::Children:
+            return static_cast<UInt8>(WatchType::List);
+        case Coordination::WatcherType::Data:
+            return static_cast<UInt8>(WatchType::Data);
+        case Coordination::WatcherType::Persistent:
+            return static_cast<UInt8>(WatchType::Persistent);
+        case Coordination::WatcherType::PersistentRecursive:
+            return static_cast<UInt8>(WatchType::PersistentRecursive);
+        case Coordination::WatcherType::Any:
+            return ONE_TIME_WATCH_TYPES | static_cast<UInt8>(WatchType::Persistent) | static_cast<UInt8>(WatchType::PersistentRecursive);
+    }
+    __builtin_unreachable();
+}
+
+}
+
 void WatchManager::registerWatches(const String & path, int64_t session_id, Coordination::OpNum opnum)
 {
-    std::lock_guard lock(watch_mutex);
     auto watches_type = opnum == Coordination::OpNum::List
             || opnum == Coordination::OpNum::SimpleList
             || opnum == Coordination::OpNum::FilteredList ? WatchType::List : WatchType::Data;
+    registerWatch(path, session_id, watches_type);
+}
 
-    switch (watches_type)
-    {
-        case WatchType::Data:
-            watches[path].emplace(session_id);
-            break;
-        case WatchType::List:
-            list_watches[path].emplace(session_id);
-            break;
-    }
+void WatchManager::registerWatch(const String & path, int64_t session_id, WatchType type)
+{
+    auto & shard = getShard(path);
+    std::lock_guard lock(shard.mutex);
 
-    sessions_and_watchers[session_id][path] |= static_cast<uint8_t>(watches_type);
+    auto path_it = shard.paths.try_emplace(path).first;
+    auto & types = path_it->second[session_id];
+    if (types == 0)
+        shard.sessions[session_id].emplace(&*path_it);
+    types |= static_cast<UInt8>(type);
 
-    LOG_TRACE(log, "Register watch path={}, session_id={}, data={}", path, toHexString(session_id), toString(sessions_and_watchers[session_id][path]));
+    LOG_TRACE(log, "Register watch path={}, session_id={}, data={}", path, toHexString(session_id), toString(types));
 }
 
 ResponsesForSessions WatchManager::processWatches(const String & path, Coordination::OpNum opnum)
@@ -47,79 +85,161 @@ ResponsesForSessions WatchManager::processWatches(const String & path, Coordinat
 
 ResponsesForSessions WatchManager::processWatches(const String & path, Coordination::Event event_type)
 {
-    std::lock_guard lock(watch_mutex);
+    ResponsesForSessions result;
+    processWatches(path, event_type, result, true);
+    return result;
+}
+
+ResponsesForSessions WatchManager::processWatches(const Strings & paths, Coordination::Event event_type)
+{
+    constexpr auto data = static_cast<UInt8>(WatchType::Data);
+    constexpr auto list = static_cast<UInt8>(WatchType::List);
 
     ResponsesForSessions result;
-    auto it = watches.find(path);
-    if (it != watches.end())
+    if (event_type != Coordination::Event::CREATED && event_type != Coordination::Event::DELETED)
     {
-        std::shared_ptr<Coordination::ZooKeeperWatchResponse> watch_response = std::make_shared<Coordination::ZooKeeperWatchResponse>();
-        watch_response->path = path;
-        watch_response->xid = Coordination::WATCH_XID;
-        watch_response->zxid = -1;
-        watch_response->type = event_type;
-        watch_response->state = Coordination::State::CONNECTED;
-        for (auto watcher_session : it->second)
-        {
-            result.push_back(ResponseForSession{watcher_session, watch_response});
-            LOG_TRACE(log, "Unregister watch for path={}, session_id={}, data={}", path, toHexString(watcher_session), toString(sessions_and_watchers[watcher_session][path]));
-            if ((sessions_and_watchers[watcher_session][path] ^= static_cast<uint8_t>(WatchType::Data)) == 0)
-            {
-                sessions_and_watchers[watcher_session].erase(path);
-                LOG_TRACE(log, "Unregister sessions_and_watchers path={}, session_id={}", path, toHexString(watcher_session));
-            }
-        }
-        watches.erase(it);
+        for (const auto & path : paths)
+            processWatches(path, event_type, result, true);
+        return result;
+    }
 
+    /// Paths sharing a parent trigger watches of the parent once.
+    std::unordered_set<String> parent_paths;
+    UInt8 one_time_types = event_type == Coordination::Event::DELETED ? data | list : data;
+    for (const auto & path : paths)
+    {
+        triggerWatches(path, event_type, one_time_types, true, true, result);
+        parent_paths.emplace(getParentPath(path));
     }
 
-    auto parent_path = getParentPath(path);
+    for (const auto & parent_path : parent_paths)
+        triggerWatches(parent_path, Coordination::Event::CHILD, list, true, false, result);
+    return result;
+}
 
-    Strings paths_to_check_for_list_watches;
-    if (event_type == Coordination::Event::CREATED)
+void WatchManager::processWatches(const String & path, Coordination::Event event_type, ResponsesForSessions & result, bool trigger_persistent)
+{
+    constexpr auto data = static_cast<UInt8>(WatchType::Data);
+    constexpr auto list = static_cast<UInt8>(WatchType::List);
+
+    /// Recursive watches are not triggered by CHILD events, their watchers get events of the children instead.
+    switch (event_type)
     {
-        paths_to_check_for_list_watches.push_back(parent_path); /// Trigger list watches for parent
+        case Coordination::Event::CREATED:
+            triggerWatches(path, event_type, data, trigger_persistent, true, result);
+            triggerWatches(getParentPath(path), Coordination::Event::CHILD, list, trigger_persistent, false, result); /// Trigger list watches for parent
+            break;
+        case Coordination::Event::DELETED:
+            triggerWatches(path, event_type, data | list, trigger_persistent, true, result); /// Trigger both list watches for this path
+            triggerWatches(getParentPath(path), Coordination::Event::CHILD, list, trigger_persistent, false, result); /// And for parent path
+            break;
+        case Coordination::Event::CHANGED:
+            triggerWatches(path, event_type, data, trigger_persistent, true, result); /// CHANGED event never trigger list watches
+            break;
+        case Coordination::Event::CHILD:
+            triggerWatches(path, event_type, list, trigger_persistent, false, result); /// Only faked for SetWatches request
+            break;
+        default:
+            break;
     }
-    else if (event_type == Coordination::Event::DELETED)
+}
+
+void WatchManager::triggerWatches(
+    const String & event_path,
+    Coordination::Event event_type,
+    UInt8 one_time_types,
+    bool trigger_persistent,
+    bool trigger_recursive,
+    ResponsesForSessions & result)
+{
+    std::shared_ptr<Coordination::ZooKeeperWatchResponse> watch_response;
+    auto notify = [&](int64_t session_id)
     {
-        paths_to_check_for_list_watches.push_back(path); /// Trigger both list watches for this path
-        paths_to_check_for_list_watches.push_back(parent_path); /// And for parent path
-    }
-    /// CHANGED event never trigger list wathes
+        if (!watch_response)
+            watch_response = makeWatchResponse(event_path, event_type);
+        result.push_back(ResponseForSession{session_id, watch_response});
+    };
+
+    size_t first_notified = result.size();
+    UInt8 triggered_types = one_time_types | (trigger_persistent ? static_cast<UInt8>(WatchType::Persistent) : 0);
 
-    for (const auto & path_to_check : paths_to_check_for_list_watches)
     {
-        it = list_watches.find(path_to_check);
-        if (it != list_watches.end())
+        auto & shard = getShard(event_path);
+        std::lock_guard lock(shard.mutex);
+
+        auto path_it = shard.paths.find(event_path);
+        if (path_it != shard.paths.end())
         {
-            std::shared_ptr<Coordination::ZooKeeperWatchResponse> watch_list_response
-                = std::make_shared<Coordination::ZooKeeperWatchResponse>();
-            watch_list_response->path = path_to_check;
-            watch_list_response->xid = Coordination::WATCH_XID;
-            watch_list_response->zxid = -1;
-            if (path_to_check == parent_path)
-                watch_list_response->type = Coordination::Event::CHILD;
-            else
-                watch_list_response->type = Coordination::Event::DELETED;
-
-            watch_list_response->state = Coordination::State::CONNECTED;
-            for (auto watcher_session : it->second)
+            auto & path_watches = path_it->second;
+            for (auto watch_it = path_watches.begin(); watch_it != path_watches.end();)
             {
-                result.push_back(ResponseForSession{watcher_session, watch_list_response});
-                LOG_TRACE(log, "Unregister watch forlistwatch path={}, session_id={}, data={}", path_to_check, toHexString(watcher_session), toString(sessions_and_watchers[watcher_session][path_to_check]));
-                if ((sessions_and_watchers[watcher_session][path_to_check] ^= static_cast<uint8_t>(WatchType::List)) == 0)
+                auto & [session_id, types] = *watch_it;
+                if (!(types & triggered_types))
+                {
+                    ++watch_it;
+                    continue;
+                }
+
+                notify(session_id);
+                if ((types &= ~one_time_types) != 0)
                 {
-                    sessions_and_watchers[watcher_session].erase(path_to_check);
-                    LOG_TRACE(log, "Unregister sessions_and_watchers path={}, session_id={}", path_to_check, toHexString(watcher_session));
+                    ++watch_it;
+                    continue;
                 }
+
+                LOG_TRACE(log, "Unregister watch for path={}, session_id={}", event_path, toHexString(session_id));
+                auto session_it = shard.sessions.find(session_id);
+                session_it->second.erase(&*path_it);
+                if (session_it->second.empty())
+                    shard.sessions.erase(session_it);
+                watch_it = path_watches.erase(watch_it);
             }
 
-            list_watches.erase(it);
+            if (path_watches.empty())
+                shard.paths.erase(path_it);
         }
     }
-    return result;
+
+    if (!trigger_persistent || !trigger_recursive)
+        return;
+
+    std::shared_lock lock(recursive_watches_mutex);
+    if (recursive_watches.empty())
+        return;
+
+    /// A session may also have watches on the path, or recursive watches on several ancestors.
+    std::unordered_set<int64_t> notified;
+    for (size_t i = first_notified; i < result.size(); ++i)
+        notified.emplace(result[i].session_id);
+
+    recursive_watches.forEachWatcher(event_path, [&](int64_t session_id)
+    {
+        if (notified.emplace(session_id).second)
+            notify(session_id);
+    });
 }
 
+UInt8 WatchManager::removeWatchesLocked(Shard & shard, PathWatchesMap::iterator path_it, int64_t session_id, UInt8 types)
+{
+    auto & path_watches = path_it->second;
+    auto watch_it = path_watches.find(session_id);
+    if (watch_it == path_watches.end())
+        return 0;
+
+    UInt8 removed_types = watch_it->second & types;
+    if ((watch_it->second &= ~types) == 0)
+    {
+        auto session_it = shard.sessions.find(session_id);
+        session_it->second.erase(&*path_it);
+        if (session_it->second.empty())
+            shard.sessions.erase(session_it);
+
+        path_watches.erase(watch_it);
+        if (path_watches.empty())
+            shard.paths.erase(path_it);
+    }
+    return removed_types;
+}
 
 ResponsesForSessions WatchManager::processRequestSetWatch(
     const RequestForSession & request_for_session, std::unordered_map<String, std::pair<int64_t, int64_t>> & watch_nodes_info)
@@ -129,28 +249,24 @@ ResponsesForSessions WatchManager::processRequestSetWatch(
     auto * request = dynamic_cast<Coordination::ZooKeeperSetWatchesRequest *>(request_for_session.request.get());
     auto session_id = request_for_session.session_id;
 
-    std::lock_guard lock(watch_mutex);
     for (String & path : request->data_watches)
     {
         LOG_TRACE(log, "Register data_watches for session {}, path {}, xid", toHexString(session_id), path, request->xid);
         /// register watches
-        watches[path].emplace(session_id);
-        sessions_and_watchers[session_id][path] |= static_cast<uint8_t>(WatchType::Data);
+        registerWatch(path, session_id, WatchType::Data);
 
         /// trigger watches
         if (!watch_nodes_info.contains(path))
         {
             LOG_TRACE(
                 log, "Trigger data_watches when processing SetWatch operation for session {}, path {}", toHexString(session_id), path);
-            auto watch_responses = processWatches(path, Coordination::Event::DELETED);
-            responses.insert(responses.end(), watch_responses.begin(), watch_responses.end());
+            processWatches(path, Coordination::Event::DELETED, responses, false);
         }
         else if (watch_nodes_info[path].first > request->relative_zxid)
         {
             LOG_TRACE(
                 log, "Trigger data_watches when processing SetWatch operation for session {}, path {}", toHexString(session_id), path);
-            auto watch_responses = processWatches(path, Coordination::Event::CHANGED);
-            responses.insert(responses.end(), watch_responses.begin(), watch_responses.end());
+            processWatches(path, Coordination::Event::CHANGED, responses, false);
         }
     }
 
@@ -158,16 +274,14 @@ ResponsesForSessions WatchManager::processRequestSetWatch(
     {
         LOG_TRACE(log, "Register exist_watches for session {}, path {}, xid", toHexString(session_id), path, request->xid);
         /// register watches
-        watches[path].emplace(session_id);
-        sessions_and_watchers[session_id][path] |= static_cast<uint8_t>(WatchType::Data);
+        registerWatch(path, session_id, WatchType::Data);
 
         /// trigger watches
         if (watch_nodes_info.contains(path))
         {
             LOG_TRACE(
                 log, "Trigger exist_watches when processing SetWatch operation for session {}, path {}", toHexString(session_id), path);
-            auto watch_responses = processWatches(path, Coordination::Event::CREATED);
-            responses.insert(responses.end(), watch_responses.begin(), watch_responses.end());
+            processWatches(path, Coordination::Event::CREATED, responses, false);
         }
     }
 
@@ -175,141 +289,232 @@ ResponsesForSessions WatchManager::processRequestSetWatch(
     {
         LOG_TRACE(log, "Register list_watches for session {}, path {}, xid", toHexString(session_id), path, request->xid);
         /// register watches
-        list_watches[path].emplace(session_id);
-        sessions_and_watchers[session_id][path] |= static_cast<uint8_t>(WatchType::List);
+        registerWatch(path, session_id, WatchType::List);
 
         /// trigger watches
         if (!watch_nodes_info.contains(path))
         {
             LOG_TRACE(
                 log, "Trigger list_watches when processing SetWatch operation for session {}, path {}", toHexString(session_id), path);
-            auto watch_responses = processWatches(path, Coordination::Event::DELETED);
-            responses.insert(responses.end(), watch_responses.begin(), watch_responses.end());
+            processWatches(path, Coordination::Event::DELETED, responses, false);
         }
         else if (watch_nodes_info[path].second > request->relative_zxid)
         {
             LOG_TRACE(
                 log, "Trigger list_watches when processing SetWatch operation for session {}, path {}", toHexString(session_id), path);
-            auto watch_responses = processWatches(path, Coordination::Event::CHILD);
-            responses.insert(responses.end(), watch_responses.begin(), watch_responses.end());
+            processWatches(path, Coordination::Event::CHILD, responses, false);
         }
     }
 
     return responses;
 }
 
+void WatchManager::addWatch(const String & path, int64_t session_id, Coordination::AddWatchMode mode)
+{
+    if (mode == Coordination::AddWatchMode::PersistentRecursive)
+    {
+        std::lock_guard lock(recursive_watches_mutex);
+        recursive_watches.add(path, session_id);
+    }
+    else
+    {
+        registerWatch(path, session_id, WatchType::Persistent);
+    }
+
+    LOG_TRACE(log, "Add watch path={}, session_id={}, mode={}", path, toHexString(session_id), static_cast<Int32>(mode));
+}
+
+bool WatchManager::removeWatches(const String & path, int64_t session_id, Coordination::WatcherType type)
+{
+    UInt8 types = toWatchTypes(type);
+    UInt8 removed_types = 0;
+
+    {
+        auto & shard = getShard(path);
+        std::lock_guard lock(shard.mutex);
+        auto path_it = shard.paths.find(path);
+        if (path_it != shard.paths.end())
+            removed_types |= removeWatchesLocked(shard, path_it, session_id, types);
+    }
+
+    if (types & static_cast<UInt8>(WatchType::PersistentRecursive))
+    {
+        std::lock_guard lock(recursive_watches_mutex);
+        if (recursive_watches.remove(path, session_id))
+            removed_types |= static_cast<UInt8>(WatchType::PersistentRecursive);
+    }
+
+    LOG_TRACE(log, "Remove watches path={}, session_id={}, types={}", path, toHexString(session_id), toString(removed_types));
+    return removed_types != 0;
+}
+
+bool WatchManager::containsWatches(const String & path, int64_t session_id, Coordination::WatcherType type) const
+{
+    UInt8 types = toWatchTypes(type);
+
+    {
+        const auto & shard = getShard(path);
+        std::lock_guard lock(shard.mutex);
+        auto path_it = shard.paths.find(path);
+        if (path_it != shard.paths.end())
+        {
+            auto watch_it = path_it->second.find(session_id);
+            if (watch_it != path_it->second.end() && (watch_it->second & types))
+                return true;
+        }
+    }
+
+    if (types & static_cast<UInt8>(WatchType::PersistentRecursive))
+    {
+        std::shared_lock lock(recursive_watches_mutex);
+        return recursive_watches.contains(path, session_id);
+    }
+    return false;
+}
+
 void WatchManager::cleanDeadWatches(int64_t session_id)
 {
-    LOG_DEBUG(log, "Clean dead watches for session {}", toHexString(session_id));
+    cleanDeadWatches(std::vector<int64_t>{session_id});
+}
 
-    std::lock_guard watch_lock(watch_mutex);
-    auto watches_it = sessions_and_watchers.find(session_id);
+void WatchManager::cleanDeadWatches(const std::vector<int64_t> & session_ids)
+{
+    LOG_DEBUG(log, "Clean dead watches for {} sessions", session_ids.size());
 
-    if (watches_it != sessions_and_watchers.end())
+    for (auto & shard : shards)
     {
-        for (const auto & [watch_path, _] : watches_it->second)
+        std::lock_guard lock(shard.mutex);
+        for (auto session_id : session_ids)
         {
-            auto watch = watches.find(watch_path);
-            if (watch != watches.end())
-            {
-                auto & watches_for_path = watch->second;
-                for (auto w_it = watches_for_path.begin(); w_it != watches_for_path.end();)
-                {
-                    if (*w_it == session_id)
-                        w_it = watches_for_path.erase(w_it);
-                    else
-                        ++w_it;
-                }
-                if (watches_for_path.empty())
-                    watches.erase(watch);
-            }
+            auto session_it = shard.sessions.find(session_id);
+            if (session_it == shard.sessions.end())
+                continue;
 
-            auto list_watch = list_watches.find(watch_path);
-            if (list_watch != list_watches.end())
+            for (auto * entry : session_it->second)
             {
-                auto & list_watches_for_path = list_watch->second;
-                for (auto w_it = list_watches_for_path.begin(); w_it != list_watches_for_path.end();)
-                {
-                    if (*w_it == session_id)
-                        w_it = list_watches_for_path.erase(w_it);
-                    else
-                        ++w_it;
-                }
-                if (list_watches_for_path.empty())
-                    list_watches.erase(list_watch);
+                entry->second.erase(session_id);
+                if (entry->second.empty())
+                    shard.paths.erase(shard.paths.find(entry->first));
             }
+            shard.sessions.erase(session_it);
         }
-        sessions_and_watchers.erase(watches_it);
     }
+
+    std::lock_guard lock(recursive_watches_mutex);
+    for (auto session_id : session_ids)
+        recursive_watches.removeSession(session_id);
 }
 
-uint64_t WatchManager::getTotalWatchesCount() const
+uint64_t WatchManager::getWatchedPathsCount() const
 {
-    std::lock_guard lock(watch_mutex);
     uint64_t ret = 0;
-    for (const auto & [path, subscribed_sessions] : watches)
-        ret += subscribed_sessions.size();
+    for (const auto & shard : shards)
+    {
+        std::lock_guard lock(shard.mutex);
+        ret += shard.paths.size();
+    }
 
-    for (const auto & [path, subscribed_sessions] : list_watches)
-        ret += subscribed_sessions.size();
+    std::shared_lock lock(recursive_watches_mutex);
+    return ret + recursive_watches.getWatchedPathsCount();
+}
 
-    return ret;
+uint64_t WatchManager::getTotalWatchesCount() const
+{
+    uint64_t ret = 0;
+    for (const auto & shard : shards)
+    {
+        std::lock_guard lock(shard.mutex);
+        for (const auto & [path, path_watches] : shard.paths)
+            for (const auto & [session_id, types] : path_watches)
+                ret += std::popcount(types);
+    }
+
+    std::shared_lock lock(recursive_watches_mutex);
+    return ret + recursive_watches.getTotalWatchesCount();
 }
 
 uint64_t WatchManager::getSessionsWithWatchesCount() const
 {
-    std::lock_guard lock(watch_mutex);
     std::unordered_set<int64_t> counter;
-    for (const auto & [path, subscribed_sessions] : watches)
-        counter.insert(subscribed_sessions.begin(), subscribed_sessions.end());
-
-    for (const auto & [path, subscribed_sessions] : list_watches)
-        counter.insert(subscribed_sessions.begin(), subscribed_sessions.end());
+    for (const auto & shard : shards)
+    {
+        std::lock_guard lock(shard.mutex);
+        for (const auto & [session_id, _] : shard.sessions)
+            counter.insert(session_id);
+    }
 
+    std::shared_lock lock(recursive_watches_mutex);
+    recursive_watches.forEachPath([&](const String &, const RecursiveWatches::Sessions & sessions)
+    {
+        counter.insert(sessions.begin(), sessions.end());
+    });
     return counter.size();
 }
 
 void WatchManager::dumpWatches(WriteBufferFromOwnString & buf) const
 {
-    std::lock_guard lock(watch_mutex);
-    for (const auto & [session_id, watches_paths] : sessions_and_watchers)
+    std::unordered_map<int64_t, Strings> sessions_and_paths;
+    for (const auto & shard : shards)
+    {
+        std::lock_guard lock(shard.mutex);
+        for (const auto & [session_id, entries] : shard.sessions)
+        {
+            auto & paths = sessions_and_paths[session_id];
+            for (const auto * entry : entries)
+                paths.push_back(entry->first);
+        }
+    }
+
+    {
+        std::shared_lock lock(recursive_watches_mutex);
+        recursive_watches.forEachPath([&](const String & path, const RecursiveWatches::Sessions & sessions)
+        {
+            for (auto session_id : sessions)
+                sessions_and_paths[session_id].push_back(path);
+        });
+    }
+
+    for (const auto & [session_id, paths] : sessions_and_paths)
     {
         buf << toHexString(session_id) << "\n";
-        for (const auto & [path, _] : watches_paths)
+        for (const auto & path : paths)
             buf << "\t" << path << "\n";
     }
 }
 
 void WatchManager::dumpWatchesByPath(WriteBufferFromOwnString & buf) const
 {
-    auto write_int_vec = [&buf](const std::unordered_set<int64_t> & session_ids)
+    for (const auto & shard : shards)
     {
-        for (int64_t session_id : session_ids)
+        std::lock_guard lock(shard.mutex);
+        for (const auto & [watch_path, path_watches] : shard.paths)
         {
-            buf << "\t" << toHexString(session_id) << "\n";
+            buf << watch_path << "\n";
+            for (const auto & [session_id, _] : path_watches)
+                buf << "\t" << toHexString(session_id) << "\n";
         }
-    };
-
-    std::lock_guard lock(watch_mutex);
-    for (const auto & [watch_path, sessions] : watches)
-    {
-        buf << watch_path << "\n";
-        write_int_vec(sessions);
     }
 
-    for (const auto & [watch_path, sessions] : list_watches)
+    std::shared_lock lock(recursive_watches_mutex);
+    recursive_watches.forEachPath([&](const String & watch_path, const RecursiveWatches::Sessions & sessions)
     {
         buf << watch_path << "\n";
-        write_int_vec(sessions);
-    }
+        for (auto session_id : sessions)
+            buf << "\t" << toHexString(session_id) << "\n";
+    });
 }
 
 void WatchManager::reset()
 {
-    std::lock_guard lock(watch_mutex);
-    watches.clear();
-    list_watches.clear();
-    sessions_and_watchers.clear();
+    for (auto & shard : shards)
+    {
+        std::lock_guard lock(shard.mutex);
+        shard.paths.clear();
+        shard.sessions.clear();
+    }
+
+    std::lock_guard lock(recursive_watches_mutex);
+    recursive_watches.clear();
 }
 
 }
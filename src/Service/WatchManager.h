@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -7,6 +10,7 @@
 #include <Poco/Logger.h>
 
 #include <Service/KeeperCommon.h>
+#include <Service/RecursiveWatches.h>
 #include <Service/formatHex.h>
 #include <ZooKeeper/ZooKeeperCommon.h>
 
@@ -18,13 +22,28 @@ enum class WatchType : UInt8
 {
     List = 1,
     Data = 2,
+    /// Added by AddWatch request, they are not removed when triggered.
+    Persistent = 4,
+    PersistentRecursive = 8,
 };
 
+/** Watches of sessions on paths.
+  *
+  * Watches are sharded by path, so that reads registering watches and write apply triggering watches
+  * contend only if their paths fall into the same shard. All kinds of watches of a path except persistent
+  * recursive ones live in one entry of the shard, whose key is the only copy of the path. The reverse index
+  * of a session references the entries, so triggering a path is a single lookup producing one event shared
+  * by all its watchers.
+  *
+  * Persistent recursive watches are triggered by paths of all shards, they are kept in a trie under a
+  * separate lock.
+  *
+  * Thread-safe.
+  */
 class WatchManager
 {
 public:
-    using Watches = std::unordered_map<String, std::unordered_set<int64_t>>;
-    using SessionAndWatcher = std::unordered_map<int64_t, std::unordered_map<String, UInt8>>;
+    static constexpr size_t SHARD_NUM = 32;
 
     explicit WatchManager() : log(&Poco::Logger::get("WatchManager")) { }
 
@@ -32,19 +51,26 @@ public:
 
     ResponsesForSessions processWatches(const String & path, Coordination::OpNum opnum);
     ResponsesForSessions processWatches(const String & path, Coordination::Event event_type);
+    /// Process watches of many paths at once, used when removing ephemeral nodes of closed sessions.
+    /// Watches of a parent shared by the paths are triggered once.
+    ResponsesForSessions processWatches(const Strings & paths, Coordination::Event event_type);
 
     /// Process request SetWatch from client
     ResponsesForSessions processRequestSetWatch(
         const RequestForSession & request_for_session, std::unordered_map<String, std::pair<int64_t, int64_t>> & watch_nodes_info);
 
-    void cleanDeadWatches(int64_t session_id);
+    /// Process request AddWatch from client
+    void addWatch(const String & path, int64_t session_id, Coordination::AddWatchMode mode);
+    /// Process request RemoveWatches from client, returns false if there is no watch of the type.
+    bool removeWatches(const String & path, int64_t session_id, Coordination::WatcherType type);
+    /// Process request CheckWatches from client
+    bool containsWatches(const String & path, int64_t session_id, Coordination::WatcherType type) const;
 
-    uint64_t getWatchedPathsCount() const
-    {
-        std::lock_guard lock(watch_mutex);
-        return watches.size() + list_watches.size();
-    }
+    void cleanDeadWatches(int64_t session_id);
+    /// Remove watches of many closed sessions, every shard is locked once.
+    void cleanDeadWatches(const std::vector<int64_t> & session_ids);
 
+    uint64_t getWatchedPathsCount() const;
     uint64_t getTotalWatchesCount() const;
     uint64_t getSessionsWithWatchesCount() const;
 
@@ -54,14 +80,48 @@ public:
     void reset();
 
 private:
-    /// Session id -> node path
-    SessionAndWatcher sessions_and_watchers;
-    /// Node path -> session id. Watches for 'get' and 'exist' requests
-    Watches watches;
-    /// Node path -> session id. Watches for 'list' request (watches on children).
-    Watches list_watches;
-
-    mutable std::mutex watch_mutex;
+    /// Session id -> bits of WatchType of the session on a path, except PersistentRecursive.
+    using PathWatches = std::unordered_map<int64_t, UInt8>;
+    using PathWatchesMap = std::unordered_map<String, PathWatches>;
+    /// Pointers to elements of unordered_map are stable until they are erased.
+    using PathWatchesEntry = PathWatchesMap::value_type;
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        /// Node path -> watches on it.
+        PathWatchesMap paths;
+        /// Session id -> entries of its watched paths in the shard.
+        std::unordered_map<int64_t, std::unordered_set<PathWatchesEntry *>> sessions;
+    };
+
+    Shard & getShard(const String & path) { return shards[std::hash<String>()(path) % SHARD_NUM]; }
+    const Shard & getShard(const String & path) const { return shards[std::hash<String>()(path) % SHARD_NUM]; }
+
+    void registerWatch(const String & path, int64_t session_id, WatchType type);
+
+    /// Persistent watches are not triggered by events faked for SetWatches request.
+    void processWatches(const String & path, Coordination::Event event_type, ResponsesForSessions & result, bool trigger_persistent);
+
+    /// Trigger watches of one_time_types, persistent watches if trigger_persistent and persistent recursive
+    /// watches if trigger_recursive on event_path. Every watcher gets one event even if it has several kinds of
+    /// watches on the path.
+    void triggerWatches(
+        const String & event_path,
+        Coordination::Event event_type,
+        UInt8 one_time_types,
+        bool trigger_persistent,
+        bool trigger_recursive,
+        ResponsesForSessions & result);
+
+    /// Remove types from watches of session on the path, erase the entry if there is no watches left.
+    /// Returns removed types, shard.mutex must be held.
+    static UInt8 removeWatchesLocked(Shard & shard, PathWatchesMap::iterator path_it, int64_t session_id, UInt8 types);
+
+    std::array<Shard, SHARD_NUM> shards;
+
+    mutable std::shared_mutex recursive_watches_mutex;
+    RecursiveWatches recursive_watches;
 
     Poco::Logger * log;
 };
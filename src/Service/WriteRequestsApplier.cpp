@@ -0,0 +1,193 @@
+#include <Service/WriteRequestsApplier.h>
+
+#include <deque>
+
+#include <Service/KeeperUtils.h>
+#include <ZooKeeper/ZooKeeperCommon.h>
+
+namespace RK
+{
+
+namespace
+{
+    /// Default ACL is not stored in ACL map.
+    bool isDefaultACL(const Coordination::ACLs & acls)
+    {
+        return acls.empty()
+            || (acls.size() == 1 && acls[0].permissions == Coordination::ACL::All && acls[0].scheme == "world"
+                && acls[0].id == "anyone");
+    }
+}
+
+WriteRequestsApplier::WriteRequestsApplier(KeeperStore & store_, size_t thread_num_)
+    : store(store_)
+    , thread_num(std::max<size_t>(thread_num_, 1))
+    , thread_pool(std::max<size_t>(thread_num - 1, 1))
+    , log(&Poco::Logger::get("WriteRequestsApplier"))
+{
+}
+
+bool WriteRequestsApplier::canApplyInBatch(const RequestForSession & request) const
+{
+    switch (request.request->getOpNum())
+    {
+        case Coordination::OpNum::Create:
+        case Coordination::OpNum::Remove:
+        case Coordination::OpNum::Set:
+        case Coordination::OpNum::Check:
+        case Coordination::OpNum::SetACL:
+        case Coordination::OpNum::Multi:
+            /// Requests of expired sessions are ignored and do not consume zxid. Sessions are only
+            /// created and closed by session requests, which are never applied in a batch.
+            return store.containsSession(request.session_id);
+        default:
+            return false;
+    }
+}
+
+void WriteRequestsApplier::collectPaths(
+    const Coordination::ZooKeeperRequest & request, bool acl_changed_in_batch, Strings & paths, bool & change_acl) const
+{
+    switch (request.getOpNum())
+    {
+        case Coordination::OpNum::Create:
+        {
+            const auto & create_request = dynamic_cast<const Coordination::ZooKeeperCreateRequest &>(request);
+            paths.push_back(create_request.path);
+            paths.push_back(getParentPath(create_request.path));
+            change_acl |= !isDefaultACL(create_request.acls);
+            break;
+        }
+        case Coordination::OpNum::Remove:
+        {
+            const auto & path = request.getPath();
+            paths.push_back(path);
+            paths.push_back(getParentPath(path));
+
+            /// Releasing the last usage of an ACL removes it from ACL map. If ACL of the node may be changed
+            /// by a previous request in the batch, we can not know it before applying the batch.
+            if (acl_changed_in_batch || change_acl)
+            {
+                change_acl = true;
+            }
+            else
+            {
+                auto node = store.getNode(path);
+                change_acl = node && node->acl_id != 0;
+            }
+            break;
+        }
+        case Coordination::OpNum::SetACL:
+            paths.push_back(request.getPath());
+            change_acl = true;
+            break;
+        case Coordination::OpNum::Multi:
+        {
+            const auto & multi_request = dynamic_cast<const Coordination::ZooKeeperMultiRequest &>(request);
+            for (const auto & sub_request : multi_request.requests)
+                collectPaths(dynamic_cast<const Coordination::ZooKeeperRequest &>(*sub_request), acl_changed_in_batch, paths, change_acl);
+            break;
+        }
+        default:
+            paths.push_back(request.getPath());
+            break;
+    }
+}
+
+void WriteRequestsApplier::apply(const std::vector<RequestForSession> & requests, KeeperStore::KeeperResponsesQueue & responses_queue)
+{
+    if (requests.empty())
+        return;
+
+    /// Level + 1 of the last request which touches a path, a session or ACL map.
+    std::unordered_map<String, size_t> path_levels;
+    std::unordered_map<int64_t, size_t> session_levels;
+    size_t acl_level = 0;
+
+    std::vector<std::vector<size_t>> levels;
+    bool acl_changed_in_batch = false;
+    Strings paths;
+
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        paths.clear();
+        bool request_change_acl = false;
+        collectPaths(*requests[i].request, acl_changed_in_batch, paths, request_change_acl);
+        acl_changed_in_batch |= request_change_acl;
+
+        size_t level = 0;
+        for (const auto & path : paths)
+            if (auto it = path_levels.find(path); it != path_levels.end())
+                level = std::max(level, it->second);
+        if (auto it = session_levels.find(requests[i].session_id); it != session_levels.end())
+            level = std::max(level, it->second);
+        if (request_change_acl)
+            level = std::max(level, acl_level);
+
+        for (auto & path : paths)
+            path_levels[std::move(path)] = level + 1;
+        session_levels[requests[i].session_id] = level + 1;
+        if (request_change_acl)
+            acl_level = level + 1;
+
+        if (level == levels.size())
+            levels.emplace_back();
+        levels[level].push_back(i);
+    }
+
+    LOG_DEBUG(log, "Apply {} write requests in {} levels", requests.size(), levels.size());
+
+    int64_t first_zxid = store.getZxid();
+    std::deque<KeeperStore::KeeperResponsesQueue> request_responses(requests.size());
+
+    auto apply_requests = [&](const std::vector<size_t> & level, size_t task, size_t task_num)
+    {
+        for (size_t j = task; j < level.size(); j += task_num)
+            store.processWriteRequest(request_responses[level[j]], requests[level[j]], first_zxid + level[j]);
+    };
+
+    store.setConcurrentWrites(true);
+    try
+    {
+        for (const auto & level : levels)
+        {
+            size_t task_num = std::min(thread_num, level.size());
+            for (size_t task = 1; task < task_num; ++task)
+                thread_pool.scheduleOrThrowOnError([&, task, task_num] { apply_requests(level, task, task_num); });
+
+            /// The first task is run by the current thread.
+            std::exception_ptr exception;
+            try
+            {
+                apply_requests(level, 0, task_num);
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
+            }
+
+            thread_pool.wait();
+            if (exception)
+                std::rethrow_exception(exception);
+        }
+    }
+    catch (...)
+    {
+        store.setConcurrentWrites(false);
+        throw;
+    }
+    store.setConcurrentWrites(false);
+
+    store.setZxid(first_zxid + requests.size());
+
+    for (auto & responses : request_responses)
+    {
+        responses.forEach([&responses_queue](const ResponseForSession & response)
+        {
+            responses_queue.push(response);
+            return true;
+        });
+    }
+}
+
+}
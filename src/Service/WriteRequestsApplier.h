@@ -0,0 +1,48 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include <Service/KeeperCommon.h>
+#include <Service/KeeperStore.h>
+#include <Common/ThreadPool.h>
+
+namespace RK
+{
+
+/** Apply Raft committed write requests to store in parallel.
+  *
+  * A batch of requests is divided into levels by what a request touches: the node and its parent
+  * (of all sub requests for multi txn), the session, and the ACL map if the request may change it.
+  * A request is put into the level after the last request it conflicts with, so requests in a level
+  * are independent and can be applied by multiple threads, and conflicting requests are applied in
+  * commit order.
+  *
+  * Zxids are assigned in commit order before applying, and responses of every request are buffered
+  * and sent in commit order after the whole batch is applied, so the store and what clients see are
+  * the same with applying requests one by one.
+  */
+class WriteRequestsApplier
+{
+public:
+    /// thread_num includes the caller thread.
+    WriteRequestsApplier(KeeperStore & store_, size_t thread_num_);
+
+    /// Whether the request can be applied in a batch. Other requests should be applied alone
+    /// by KeeperStore::processRequest after the requests before them are applied.
+    bool canApplyInBatch(const RequestForSession & request) const;
+
+    void apply(const std::vector<RequestForSession> & requests, KeeperStore::KeeperResponsesQueue & responses_queue);
+
+private:
+    /// Collect paths a request touches, and set `change_acl` if it may change ACL map.
+    void collectPaths(const Coordination::ZooKeeperRequest & request, bool acl_changed_in_batch, Strings & paths, bool & change_acl) const;
+
+    KeeperStore & store;
+    size_t thread_num;
+    ThreadPool thread_pool;
+
+    Poco::Logger * log;
+};
+
+}
@@ -105,7 +105,7 @@ int64_t deserializeStorageData(KeeperStore & store, ReadBuffer & in, Poco::Logge
 
     while (path != "/")
     {
-        std::shared_ptr<KeeperNode> node = std::make_shared<KeeperNode>();
+        std::shared_ptr<KeeperNode> node = store.makeNode(path);
         Coordination::read(node->data, in);
 
         size_t acl_id;
@@ -137,7 +137,7 @@ int64_t deserializeStorageData(KeeperStore & store, ReadBuffer & in, Poco::Logge
             if (node->stat.ephemeralOwner != 0)
             {
                 node->is_ephemeral = true;
-                store.addEphemeralNode(node->stat.ephemeralOwner, path);
+                store.addEphemeralNode(node->stat.ephemeralOwner, path, *node);
             }
         }
 
@@ -0,0 +1,161 @@
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Common/Stopwatch.h>
+#include <Service/AppendEntriesWindow.h>
+
+
+/** Measure write throughput of RequestAccumulator's append window against replication round trip time.
+  *
+  * Raft is simulated by a thread which commits appended batches in order, every batch is committed
+  * one round trip time after it is appended. Batches of full max_batch_size are appended as soon as
+  * there is room in the window, so the result is the throughput limit of a window size and an RTT.
+  *
+  * Test this way:
+  *
+  * ./append_window_perf
+  * ./append_window_perf 1000 100 2000
+  *
+  * Arguments are the batch size (default 1000), the batches committed per second by the leader
+  * itself, like being limited by fsync, 0 means no limit (default 0), and running time in
+  * milliseconds of every case (default 2000).
+  */
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+class SimulatedRaft
+{
+public:
+    SimulatedRaft(std::chrono::microseconds rtt_, std::chrono::microseconds commit_interval_)
+        : rtt(rtt_), commit_interval(commit_interval_), thread([this] { run(); })
+    {
+    }
+
+    ~SimulatedRaft()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopped = true;
+        }
+        cv.notify_all();
+        thread.join();
+    }
+
+    void append(RK::AppendEntriesWindow & window, const RK::AppendEntriesWindow::BatchPtr & batch)
+    {
+        {
+            std::lock_guard lock(mutex);
+            pending.push_back({&window, batch, Clock::now() + rtt});
+        }
+        cv.notify_all();
+    }
+
+private:
+    struct Appended
+    {
+        RK::AppendEntriesWindow * window;
+        RK::AppendEntriesWindow::BatchPtr batch;
+        Clock::time_point commit_time;
+    };
+
+    void run()
+    {
+        Clock::time_point last_commit;
+        while (true)
+        {
+            Appended appended;
+            {
+                std::unique_lock lock(mutex);
+                cv.wait(lock, [this] { return stopped || !pending.empty(); });
+                if (stopped)
+                    return;
+                appended = pending.front();
+                pending.pop_front();
+            }
+
+            /// Committed in log order, not earlier than a round trip after appended.
+            auto commit_time = std::max(appended.commit_time, last_commit + commit_interval);
+            std::this_thread::sleep_until(commit_time);
+            last_commit = commit_time;
+            appended.window->finish(appended.batch, true, nuraft::cmd_result_code::OK);
+        }
+    }
+
+    std::chrono::microseconds rtt;
+    std::chrono::microseconds commit_interval;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Appended> pending;
+    bool stopped = false;
+
+    std::thread thread;
+};
+
+double runCase(size_t window_size, std::chrono::microseconds rtt, std::chrono::microseconds commit_interval, size_t batch_size, size_t duration_ms)
+{
+    std::atomic<size_t> committed{0};
+    RK::AppendEntriesWindow window(
+        window_size,
+        [&](const RK::RequestsForSessions & batch, bool, nuraft::cmd_result_code)
+        { committed.fetch_add(batch.size(), std::memory_order_relaxed); });
+
+    auto request = std::make_shared<Coordination::ZooKeeperCreateRequest>();
+    request->path = "/clickhouse/tables/t/log/log-0000000001";
+    RK::RequestsForSessions template_batch(batch_size, RK::RequestForSession(request, 1, 0));
+
+    Stopwatch watch;
+    {
+        SimulatedRaft raft(rtt, commit_interval);
+        while (watch.elapsedMilliseconds() < duration_ms)
+        {
+            if (!window.waitForRoom(100))
+                continue;
+            auto batch = template_batch;
+            raft.append(window, window.add(std::move(batch), 0));
+        }
+    }
+    return committed.load() / watch.elapsedSeconds();
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    size_t batch_size = argc > 1 ? std::stoull(argv[1]) : 1000;
+    size_t commits_per_second = argc > 2 ? std::stoull(argv[2]) : 0;
+    size_t duration_ms = argc > 3 ? std::stoull(argv[3]) : 2000;
+
+    std::chrono::microseconds commit_interval{commits_per_second ? 1000000 / commits_per_second : 0};
+    const std::vector<size_t> rtts_us = {200, 500, 1000, 2000, 5000, 10000};
+    const std::vector<size_t> window_sizes = {1, 2, 4, 8, 16};
+
+    std::cerr << "Write requests per second, batch size " << batch_size << "\n";
+    std::cerr << std::setw(10) << "rtt_us";
+    for (auto window_size : window_sizes)
+        std::cerr << std::setw(12) << ("window=" + std::to_string(window_size));
+    std::cerr << "\n";
+
+    for (auto rtt_us : rtts_us)
+    {
+        std::cerr << std::setw(10) << rtt_us;
+        for (auto window_size : window_sizes)
+        {
+            auto tps = runCase(window_size, std::chrono::microseconds(rtt_us), commit_interval, batch_size, duration_ms);
+            std::cerr << std::setw(12) << static_cast<size_t>(tps);
+        }
+        std::cerr << "\n";
+    }
+
+    return 0;
+}
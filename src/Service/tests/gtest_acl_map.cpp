@@ -0,0 +1,134 @@
+#include <thread>
+
+#include <Service/KeeperStore.h>
+#include <Service/KeeperUtils.h>
+#include <ZooKeeper/ZooKeeperCommon.h>
+#include <gtest/gtest.h>
+
+
+using namespace RK;
+
+namespace
+{
+
+Coordination::Error processRequest(KeeperStore & store, int64_t session_id, const Coordination::ZooKeeperRequestPtr & request)
+{
+    KeeperStore::KeeperResponsesQueue responses;
+    store.processRequest(responses, RequestForSession(request, session_id, 0));
+
+    ResponseForSession response;
+    EXPECT_TRUE(responses.tryPop(response));
+    return response.response->error;
+}
+
+}
+
+TEST(ACLMap, SessionPermissions)
+{
+    ACLMap acl_map;
+    auto read_only = acl_map.convertACLs({{Coordination::ACL::Read, "world", "anyone"}});
+    auto digest = acl_map.convertACLs(
+        {{Coordination::ACL::All, "digest", "user1:password"},
+         {Coordination::ACL::Read | Coordination::ACL::Write, "digest", "user2:password"}});
+
+    SessionPermissions anonymous(acl_map, {});
+    SessionPermissions user1(acl_map, {{"digest", "user1:password"}});
+    SessionPermissions user2(acl_map, {{"digest", "user3:password"}, {"digest", "user2:password"}});
+    SessionPermissions super(acl_map, {{"super", ""}});
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        ASSERT_EQ(anonymous.get(0), Coordination::ACL::All);
+        ASSERT_EQ(anonymous.get(read_only), Coordination::ACL::Read);
+        ASSERT_EQ(anonymous.get(digest), 0);
+        ASSERT_EQ(user1.get(digest), Coordination::ACL::All);
+        ASSERT_EQ(user2.get(digest), Coordination::ACL::Read | Coordination::ACL::Write);
+        ASSERT_TRUE(user2.check(digest, Coordination::ACL::Admin | Coordination::ACL::Read));
+        ASSERT_FALSE(user2.check(digest, Coordination::ACL::Admin));
+        ASSERT_EQ(super.get(digest), Coordination::ACL::All);
+    }
+
+    /// ACL id is mapped to other ACLs when loading snapshot.
+    acl_map.addMapping(digest, {{Coordination::ACL::Read, "digest", "user2:password"}});
+    ASSERT_EQ(user1.get(digest), 0);
+    ASSERT_EQ(user2.get(digest), Coordination::ACL::Read);
+
+    acl_map.reset();
+    ASSERT_THROW(user1.get(digest), Exception);
+}
+
+TEST(ACLMap, CheckPermissionOfSession)
+{
+    KeeperStore store(500);
+    store.addSessionID(1, 30000);
+    store.addSessionID(2, 30000);
+
+    auto auth_request = std::make_shared<Coordination::ZooKeeperAuthRequest>();
+    auth_request->scheme = "digest";
+    auth_request->data = "user:password";
+    ASSERT_EQ(processRequest(store, 1, auth_request), Coordination::Error::ZOK);
+
+    auto create_request = std::make_shared<Coordination::ZooKeeperCreateRequest>();
+    create_request->path = "/secret";
+    create_request->acls = {{Coordination::ACL::All, "auth", ""}};
+    ASSERT_EQ(processRequest(store, 1, create_request), Coordination::Error::ZOK);
+
+    auto acl_id = store.getNode("/secret")->acl_id;
+    ASSERT_NE(acl_id, 0);
+    ASSERT_TRUE(store.checkPermission(1, acl_id, Coordination::ACL::Read));
+    ASSERT_FALSE(store.checkPermission(2, acl_id, Coordination::ACL::Read));
+
+    auto get_request = std::make_shared<Coordination::ZooKeeperGetRequest>();
+    get_request->path = "/secret";
+    ASSERT_EQ(processRequest(store, 1, get_request), Coordination::Error::ZOK);
+    ASSERT_EQ(processRequest(store, 2, get_request), Coordination::Error::ZNOAUTH);
+
+    /// Permissions are recompiled when auth of session changes.
+    ASSERT_EQ(processRequest(store, 2, auth_request), Coordination::Error::ZOK);
+    ASSERT_TRUE(store.checkPermission(2, acl_id, Coordination::ACL::Read));
+    ASSERT_EQ(processRequest(store, 2, get_request), Coordination::Error::ZOK);
+}
+
+TEST(ACLMap, CheckPermissionAfterAuthChanged)
+{
+    KeeperStore store(500);
+    KeeperStore other_store(500);
+    store.addSessionID(1, 30000);
+    other_store.addSessionID(1, 30000);
+
+    auto auth_request = std::make_shared<Coordination::ZooKeeperAuthRequest>();
+    auth_request->scheme = "digest";
+    auth_request->data = "user:password";
+    ASSERT_EQ(processRequest(store, 1, auth_request), Coordination::Error::ZOK);
+
+    Coordination::ACLs digest_acls{{Coordination::ACL::All, "digest", generateDigest("user:password")}};
+    auto acls = store.getACLMap().convertACLs(digest_acls);
+    auto other_acls = other_store.getACLMap().convertACLs(digest_acls);
+
+    /// Permissions cached by this thread for one store are not used for another one.
+    ASSERT_TRUE(store.checkPermission(1, acls, Coordination::ACL::Read));
+    ASSERT_FALSE(other_store.checkPermission(1, other_acls, Coordination::ACL::Read));
+    ASSERT_TRUE(store.checkPermission(1, acls, Coordination::ACL::Read));
+
+    /// Readers see auth of a session once it is processed.
+    std::atomic<bool> authed{false};
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < 3; ++i)
+        readers.emplace_back(
+            [&]
+            {
+                while (!authed)
+                    ASSERT_FALSE(other_store.checkPermission(1, other_acls, Coordination::ACL::Read));
+                ASSERT_TRUE(other_store.checkPermission(1, other_acls, Coordination::ACL::Read));
+            });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(processRequest(other_store, 1, auth_request), Coordination::Error::ZOK);
+    authed = true;
+    for (auto & reader : readers)
+        reader.join();
+
+    /// Closed session loses its auth.
+    auto close_request = std::make_shared<Coordination::ZooKeeperCloseRequest>();
+    processRequest(store, 1, close_request);
+    ASSERT_FALSE(store.checkPermission(1, acls, Coordination::ACL::Read));
+}
@@ -0,0 +1,91 @@
+#include <Service/AdaptiveBatchPolicy.h>
+#include <gtest/gtest.h>
+
+
+using namespace RK;
+
+namespace
+{
+
+void flushBatches(AdaptiveBatchPolicy & policy, size_t batch_size, bool full, size_t lingered, size_t queue_depth)
+{
+    for (size_t i = 0; i < AdaptiveBatchPolicy::ADJUST_INTERVAL; ++i)
+        policy.onBatchFlushed(batch_size, full, lingered, queue_depth);
+}
+
+void commitBatches(AdaptiveBatchPolicy & policy, UInt64 latency_ms)
+{
+    for (size_t i = 0; i < AdaptiveBatchPolicy::LATENCY_SAMPLES; ++i)
+        policy.onBatchCommitted(latency_ms);
+}
+
+}
+
+TEST(AdaptiveBatchPolicy, Disabled)
+{
+    AdaptiveBatchPolicy policy(1000, 1024, 0);
+    commitBatches(policy, 100);
+    flushBatches(policy, 10, false, 5, 0);
+
+    ASSERT_EQ(policy.getBatchSizeLimit(), 1000);
+    ASSERT_EQ(policy.getLingerTimeUs(), 0);
+
+    /// Byte budget is still checked.
+    ASSERT_FALSE(policy.isFull(999, 1023));
+    ASSERT_TRUE(policy.isFull(1000, 0));
+    ASSERT_TRUE(policy.isFull(1, 1024));
+}
+
+TEST(AdaptiveBatchPolicy, BatchSize)
+{
+    AdaptiveBatchPolicy policy(1000, 0, 10);
+    ASSERT_EQ(policy.getBatchSizeLimit(), 1000);
+    ASSERT_FALSE(policy.isFull(999, 1ULL << 40));
+
+    /// Slow commits of batches which are not backlogged shrink batch size.
+    commitBatches(policy, 20);
+    ASSERT_EQ(policy.getLatencyP99(), 20);
+    flushBatches(policy, 100, false, 0, 0);
+    ASSERT_EQ(policy.getBatchSizeLimit(), 750);
+    for (size_t i = 0; i < 20; ++i)
+        flushBatches(policy, 10, false, 0, 0);
+    ASSERT_EQ(policy.getBatchSizeLimit(), AdaptiveBatchPolicy::MIN_BATCH_SIZE);
+    ASSERT_TRUE(policy.isFull(AdaptiveBatchPolicy::MIN_BATCH_SIZE, 0));
+
+    /// Backlog grows batch size even if commits are slow.
+    flushBatches(policy, AdaptiveBatchPolicy::MIN_BATCH_SIZE, true, 0, 5000);
+    ASSERT_EQ(policy.getBatchSizeLimit(), AdaptiveBatchPolicy::MIN_BATCH_SIZE * 2);
+    for (size_t i = 0; i < 10; ++i)
+        flushBatches(policy, 100, true, 0, 5000);
+    ASSERT_EQ(policy.getBatchSizeLimit(), 1000);
+}
+
+TEST(AdaptiveBatchPolicy, LingerTime)
+{
+    AdaptiveBatchPolicy policy(1000, 0, 10);
+    commitBatches(policy, 2);
+
+    /// Start lingering, and keep it up while it collects requests.
+    flushBatches(policy, 1, false, 0, 0);
+    ASSERT_EQ(policy.getLingerTimeUs(), AdaptiveBatchPolicy::LINGER_STEP_US);
+    for (size_t i = 0; i < 3; ++i)
+        flushBatches(policy, 5, false, 4, 0);
+    ASSERT_EQ(policy.getLingerTimeUs(), 4 * AdaptiveBatchPolicy::LINGER_STEP_US);
+
+    /// Lingering takes half of the latency headroom at most.
+    for (size_t i = 0; i < 100; ++i)
+        flushBatches(policy, 5, false, 4, 0);
+    ASSERT_EQ(policy.getLingerTimeUs(), 4000);
+
+    /// Backs off when commits are slow.
+    commitBatches(policy, 11);
+    flushBatches(policy, 5, false, 4, 0);
+    ASSERT_EQ(policy.getLingerTimeUs(), 2000);
+
+    /// Backs off when lingering does not collect requests.
+    commitBatches(policy, 2);
+    for (size_t i = 0; i < 10; ++i)
+        flushBatches(policy, 1, false, 0, 0);
+    ASSERT_LT(policy.getLingerTimeUs(), 2000);
+    ASSERT_LE(policy.getLingerTimeUs(), AdaptiveBatchPolicy::LINGER_STEP_US);
+}
@@ -0,0 +1,140 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <Service/AppendEntriesWindow.h>
+#include <gtest/gtest.h>
+
+
+using namespace RK;
+
+namespace
+{
+
+/// A batch of one request, batches are told apart by session id.
+RequestsForSessions makeBatch(int64_t id)
+{
+    return {RequestForSession(nullptr, id, 0)};
+}
+
+struct Result
+{
+    int64_t id;
+    bool accepted;
+    nuraft::cmd_result_code code;
+};
+
+}
+
+TEST(AppendEntriesWindow, ExpireInOrder)
+{
+    std::vector<Result> results;
+    AppendEntriesWindow window(
+        10, [&](const RequestsForSessions & batch, bool accepted, nuraft::cmd_result_code code)
+        { results.push_back({batch.front().session_id, accepted, code}); });
+
+    window.add(makeBatch(1), 0);
+    auto second = window.add(makeBatch(2), 10);
+    window.add(makeBatch(3), 20);
+    window.add(makeBatch(4), 30);
+
+    /// A batch finished before does not stop expiring of the later ones.
+    window.finish(second, true, nuraft::cmd_result_code::OK);
+    window.expire(35, 10);
+
+    ASSERT_EQ(results.size(), 3);
+    ASSERT_EQ(results[0].id, 2);
+    ASSERT_EQ(results[0].code, nuraft::cmd_result_code::OK);
+    ASSERT_EQ(results[1].id, 1);
+    ASSERT_EQ(results[1].code, nuraft::cmd_result_code::TIMEOUT);
+    ASSERT_EQ(results[2].id, 3);
+    ASSERT_EQ(results[2].code, nuraft::cmd_result_code::TIMEOUT);
+    ASSERT_EQ(window.size(), 1);
+
+    /// Nothing is expired twice.
+    window.expire(35, 10);
+    ASSERT_EQ(results.size(), 3);
+}
+
+TEST(AppendEntriesWindow, CancelAll)
+{
+    std::vector<Result> results;
+    AppendEntriesWindow window(
+        10, [&](const RequestsForSessions & batch, bool accepted, nuraft::cmd_result_code code)
+        { results.push_back({batch.front().session_id, accepted, code}); });
+
+    auto first = window.add(makeBatch(1), 0);
+    window.add(makeBatch(2), 0);
+    window.cancelAll();
+
+    ASSERT_EQ(window.size(), 0);
+    ASSERT_EQ(results.size(), 2);
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        ASSERT_EQ(results[i].id, static_cast<int64_t>(i + 1));
+        ASSERT_FALSE(results[i].accepted);
+        ASSERT_EQ(results[i].code, nuraft::cmd_result_code::CANCELLED);
+    }
+
+    /// Result arriving after cancel is dropped.
+    window.finish(first, true, nuraft::cmd_result_code::OK);
+    ASSERT_EQ(results.size(), 2);
+}
+
+TEST(AppendEntriesWindow, WaitForRoom)
+{
+    AppendEntriesWindow window(2, [](const RequestsForSessions &, bool, nuraft::cmd_result_code) {});
+
+    auto first = window.add(makeBatch(1), 0);
+    ASSERT_TRUE(window.waitForRoom(0));
+    window.add(makeBatch(2), 0);
+    ASSERT_FALSE(window.waitForRoom(10));
+
+    std::thread finisher(
+        [&]
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            window.finish(first, true, nuraft::cmd_result_code::OK);
+        });
+    ASSERT_TRUE(window.waitForRoom(10000));
+    ASSERT_EQ(window.size(), 1);
+    finisher.join();
+}
+
+TEST(AppendEntriesWindow, HandlerInvokedOnceUnderRace)
+{
+    const int64_t batch_count = 2000;
+
+    std::vector<std::atomic<int>> handled(batch_count);
+    AppendEntriesWindow window(
+        batch_count, [&](const RequestsForSessions & batch, bool, nuraft::cmd_result_code)
+        { handled[batch.front().session_id].fetch_add(1); });
+
+    std::vector<AppendEntriesWindow::BatchPtr> batches;
+    for (int64_t id = 0; id < batch_count; ++id)
+        batches.push_back(window.add(makeBatch(id), id));
+
+    /// Results of Raft threads race with expiring by accumulator thread and cancelling on shutdown.
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 2; ++i)
+        threads.emplace_back(
+            [&]
+            {
+                for (const auto & batch : batches)
+                    window.finish(batch, true, nuraft::cmd_result_code::OK);
+            });
+    threads.emplace_back(
+        [&]
+        {
+            for (int64_t now = 0; now <= batch_count; now += 100)
+                window.expire(now, 0);
+        });
+    threads.emplace_back([&] { window.cancelAll(); });
+
+    for (auto & thread : threads)
+        thread.join();
+
+    ASSERT_EQ(window.size(), 0);
+    for (const auto & count : handled)
+        ASSERT_EQ(count.load(), 1);
+}
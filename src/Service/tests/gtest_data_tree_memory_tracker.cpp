@@ -0,0 +1,130 @@
+#include <Service/KeeperStore.h>
+#include <ZooKeeper/ZooKeeperCommon.h>
+#include <gtest/gtest.h>
+
+
+using namespace RK;
+
+namespace
+{
+
+void processRequest(KeeperStore & store, int64_t session_id, const Coordination::ZooKeeperRequestPtr & request)
+{
+    static Coordination::XID xid = 0;
+    request->xid = ++xid;
+
+    RequestForSession request_for_session;
+    request_for_session.session_id = session_id;
+    request_for_session.request = request;
+
+    KeeperStore::KeeperResponsesQueue responses;
+    store.processRequest(responses, request_for_session);
+}
+
+std::shared_ptr<Coordination::ZooKeeperCreateRequest> makeCreate(const String & path, const String & data, bool is_ephemeral = false)
+{
+    auto request = std::make_shared<Coordination::ZooKeeperCreateRequest>();
+    request->path = path;
+    request->data = data;
+    request->is_ephemeral = is_ephemeral;
+    return request;
+}
+
+void assertSameUsage(const DataTreeMemoryUsage & lhs, const DataTreeMemoryUsage & rhs)
+{
+    ASSERT_EQ(lhs.node_count, rhs.node_count);
+    ASSERT_EQ(lhs.key_bytes, rhs.key_bytes);
+    ASSERT_EQ(lhs.data_bytes, rhs.data_bytes);
+    ASSERT_EQ(lhs.children_bytes, rhs.children_bytes);
+    ASSERT_EQ(lhs.acl_references, rhs.acl_references);
+}
+
+/// Incrementally maintained usage should be the same with accounting the data tree from scratch.
+void assertSameWithRebuilt(KeeperStore & store)
+{
+    DataTreeMemoryTracker rebuilt(3);
+    rebuilt.rebuild(store.getDataTree());
+
+    assertSameUsage(store.getDataTreeMemoryUsage(), rebuilt.getTotal());
+
+    auto subtrees = store.getTopSubtreesByMemory(1000);
+    auto rebuilt_subtrees = rebuilt.getTopSubtrees(1000);
+    ASSERT_EQ(subtrees.size(), rebuilt_subtrees.size());
+    for (size_t i = 0; i < subtrees.size(); ++i)
+    {
+        ASSERT_EQ(subtrees[i].first, rebuilt_subtrees[i].first);
+        assertSameUsage(subtrees[i].second, rebuilt_subtrees[i].second);
+    }
+}
+
+}
+
+TEST(DataTreeMemoryTracker, Subtree)
+{
+    DataTreeMemoryTracker tracker(3);
+    ASSERT_EQ(tracker.getSubtree("/"), "/");
+    ASSERT_EQ(tracker.getSubtree("/clickhouse"), "/clickhouse");
+    ASSERT_EQ(tracker.getSubtree("/clickhouse/tables/db1"), "/clickhouse/tables/db1");
+    ASSERT_EQ(tracker.getSubtree("/clickhouse/tables/db1/t1/replicas"), "/clickhouse/tables/db1");
+}
+
+TEST(DataTreeMemoryTracker, SameWithRebuilt)
+{
+    KeeperStore store(500);
+    store.addSessionID(1, 30000);
+    store.addSessionID(2, 30000);
+
+    processRequest(store, 1, makeCreate("/clickhouse", ""));
+    processRequest(store, 1, makeCreate("/clickhouse/tables", ""));
+    for (size_t db = 0; db < 3; ++db)
+    {
+        String db_path = "/clickhouse/tables/db" + std::to_string(db);
+        processRequest(store, 1, makeCreate(db_path, ""));
+        for (size_t i = 0; i < 100 * (db + 1); ++i)
+            processRequest(store, 1 + i % 2, makeCreate(db_path + "/n" + std::to_string(i), String(i, 'x'), i % 3 == 0));
+    }
+    assertSameWithRebuilt(store);
+
+    auto top = store.getTopSubtreesByMemory(1);
+    ASSERT_EQ(top.size(), 1);
+    ASSERT_EQ(top[0].first, "/clickhouse/tables/db2");
+    ASSERT_EQ(top[0].second.node_count, 301);
+
+    for (size_t i = 0; i < 100; i += 2)
+    {
+        auto set_request = std::make_shared<Coordination::ZooKeeperSetRequest>();
+        set_request->path = "/clickhouse/tables/db1/n" + std::to_string(i);
+        set_request->data = String(1000, 'y');
+        set_request->version = -1;
+        processRequest(store, 1, set_request);
+
+        auto remove_request = std::make_shared<Coordination::ZooKeeperRemoveRequest>();
+        remove_request->path = "/clickhouse/tables/db0/n" + std::to_string(i + 1);
+        processRequest(store, 1, remove_request);
+    }
+    assertSameWithRebuilt(store);
+
+    auto set_acl_request = std::make_shared<Coordination::ZooKeeperSetACLRequest>();
+    set_acl_request->path = "/clickhouse/tables/db2";
+    set_acl_request->acls = {{Coordination::ACL::All, "digest", "user:password"}};
+    processRequest(store, 1, set_acl_request);
+    ASSERT_EQ(store.getDataTreeMemoryUsage().acl_references, 1);
+
+    /// Failed multi request is rolled back.
+    auto multi_request = std::make_shared<Coordination::ZooKeeperMultiRequest>();
+    multi_request->requests.push_back(makeCreate("/clickhouse/tables/db0/m", String(100, 'z')));
+    auto remove_request = std::make_shared<Coordination::ZooKeeperRemoveRequest>();
+    remove_request->path = "/clickhouse/tables/db1/n2";
+    multi_request->requests.push_back(remove_request);
+    multi_request->requests.push_back(makeCreate("/not/exist", ""));
+    processRequest(store, 1, multi_request);
+    ASSERT_FALSE(store.exists("/clickhouse/tables/db0/m"));
+    assertSameWithRebuilt(store);
+
+    /// Closing session removes its ephemeral nodes.
+    processRequest(store, 2, std::make_shared<Coordination::ZooKeeperCloseRequest>());
+    assertSameWithRebuilt(store);
+
+    ASSERT_EQ(store.getDataTreeMemoryUsage().node_count, static_cast<Int64>(store.getNodesCount()));
+    ASSERT_EQ(static_cast<Int64>(store.getApproximateDataSize()), store.getDataTreeMemoryUsage().totalBytes());
+}
@@ -0,0 +1,186 @@
+#include <algorithm>
+
+#include <Service/KeeperStore.h>
+#include <ZooKeeper/ZooKeeperCommon.h>
+#include <gtest/gtest.h>
+
+
+using namespace RK;
+
+TEST(EphemeralNodes, AddAndRemove)
+{
+    EphemeralNodes ephemerals;
+    std::vector<KeeperNode> nodes(4);
+
+    ephemerals.add(1, "/a", nodes[0]);
+    ephemerals.add(1, "/b", nodes[1]);
+    ephemerals.add(2, "/c", nodes[2]);
+    ASSERT_EQ(ephemerals.getSessionCount(), 2);
+    ASSERT_EQ(ephemerals.getTotalCount(), 3);
+
+    /// Slot of removed node is reused.
+    ephemerals.remove(1, nodes[0]);
+    ephemerals.add(1, "/d", nodes[3]);
+    ASSERT_EQ(nodes[3].ephemeral_slot, nodes[0].ephemeral_slot);
+    ASSERT_EQ(ephemerals.getAll().at(1), (std::unordered_set<String>{"/b", "/d"}));
+
+    ephemerals.remove(2, nodes[2]);
+    ASSERT_EQ(ephemerals.getSessionCount(), 1);
+
+    auto paths = ephemerals.extract(1);
+    std::sort(paths.begin(), paths.end());
+    ASSERT_EQ(paths, (Strings{"/b", "/d"}));
+    ASSERT_EQ(ephemerals.getTotalCount(), 0);
+    ASSERT_TRUE(ephemerals.extract(1).empty());
+}
+
+TEST(EphemeralNodes, CloseSession)
+{
+    KeeperStore store(500);
+    store.addSessionID(1, 30000);
+    store.addSessionID(2, 30000);
+
+    KeeperStore::KeeperResponsesQueue responses;
+    auto process = [&](int64_t session_id, const Coordination::ZooKeeperRequestPtr & request)
+    {
+        store.processRequest(responses, RequestForSession(request, session_id, 0));
+    };
+
+    auto create = [&](int64_t session_id, const String & path, bool is_ephemeral)
+    {
+        auto request = std::make_shared<Coordination::ZooKeeperCreateRequest>();
+        request->path = path;
+        request->is_ephemeral = is_ephemeral;
+        process(session_id, request);
+    };
+
+    for (size_t i = 0; i < 10; ++i)
+    {
+        String parent = "/p" + std::to_string(i);
+        create(1, parent, false);
+        for (size_t j = 0; j < 1000; ++j)
+            create(1 + j % 2, parent + "/e" + std::to_string(j), true);
+    }
+    ASSERT_EQ(store.getTotalEphemeralNodesCount(), 10000);
+
+    /// Removed ephemeral node is removed from index.
+    auto remove_request = std::make_shared<Coordination::ZooKeeperRemoveRequest>();
+    remove_request->path = "/p0/e0";
+    process(1, remove_request);
+    ASSERT_EQ(store.getTotalEphemeralNodesCount(), 9999);
+
+    /// Removing a node which does not hold the first slot must not free the slot of another node.
+    remove_request = std::make_shared<Coordination::ZooKeeperRemoveRequest>();
+    remove_request->path = "/p3/e4";
+    process(1, remove_request);
+    ASSERT_EQ(store.getTotalEphemeralNodesCount(), 9998);
+
+    auto list_request = std::make_shared<Coordination::ZooKeeperListRequest>();
+    list_request->path = "/p3";
+    list_request->has_watch = true;
+    process(2, list_request);
+
+    auto get_request = std::make_shared<Coordination::ZooKeeperGetRequest>();
+    get_request->path = "/p5/e1";
+    get_request->has_watch = true;
+    process(2, get_request);
+
+    ResponseForSession response;
+    while (responses.tryPop(response))
+    {
+    }
+
+    process(1, std::make_shared<Coordination::ZooKeeperCloseRequest>());
+    ASSERT_EQ(store.getTotalEphemeralNodesCount(), 5000);
+    ASSERT_EQ(store.getSessionWithEphemeralNodesCount(), 1);
+
+    for (size_t i = 0; i < 10; ++i)
+    {
+        auto parent = store.getNode("/p" + std::to_string(i));
+        ASSERT_EQ(parent->children.size(), 500);
+        ASSERT_EQ(parent->stat.numChildren, 500);
+        for (size_t j = 0; j < 1000; ++j)
+            ASSERT_EQ(store.exists("/p" + std::to_string(i) + "/e" + std::to_string(j)), j % 2 == 1);
+    }
+
+    /// Child watch of /p3 is triggered once, data watch of node of the other session is not.
+    size_t watch_responses = 0;
+    while (responses.tryPop(response))
+    {
+        if (response.response->xid == Coordination::WATCH_XID)
+        {
+            ++watch_responses;
+            ASSERT_EQ(dynamic_cast<const Coordination::ZooKeeperWatchResponse &>(*response.response).path, "/p3");
+        }
+    }
+    ASSERT_EQ(watch_responses, 1);
+}
+
+TEST(EphemeralNodes, CloseSessionsInBatch)
+{
+    KeeperStore store(500);
+    for (int64_t session_id = 1; session_id <= 4; ++session_id)
+        store.addSessionID(session_id, 30000);
+
+    KeeperStore::KeeperResponsesQueue responses;
+    auto process = [&](int64_t session_id, const Coordination::ZooKeeperRequestPtr & request)
+    {
+        store.processRequest(responses, RequestForSession(request, session_id, 0));
+        ResponsesForSessions result;
+        ResponseForSession response;
+        while (responses.tryPop(response))
+            result.push_back(response);
+        return result;
+    };
+
+    auto create_request = std::make_shared<Coordination::ZooKeeperCreateRequest>();
+    create_request->path = "/p";
+    process(4, create_request);
+    for (int64_t session_id = 1; session_id <= 3; ++session_id)
+    {
+        for (size_t i = 0; i < 10; ++i)
+        {
+            auto request = std::make_shared<Coordination::ZooKeeperCreateRequest>();
+            request->path = "/p/e" + std::to_string(session_id) + "_" + std::to_string(i);
+            request->is_ephemeral = true;
+            process(session_id, request);
+        }
+    }
+
+    auto add_watch_request = std::make_shared<Coordination::ZooKeeperAddWatchRequest>();
+    add_watch_request->path = "/p";
+    add_watch_request->mode = Coordination::AddWatchMode::Persistent;
+    process(4, add_watch_request);
+
+    auto close_request = std::make_shared<Coordination::ZooKeeperCloseSessionsRequest>();
+    close_request->xid = Coordination::CLOSE_XID;
+    close_request->session_ids = {1, 2};
+    auto result = process(0, close_request);
+
+    ASSERT_EQ(store.getTotalEphemeralNodesCount(), 10);
+    ASSERT_EQ(store.getSessionCount(), 2);
+    ASSERT_FALSE(store.containsSession(1));
+    ASSERT_TRUE(store.containsSession(3));
+    ASSERT_EQ(store.getNode("/p")->stat.numChildren, 10);
+
+    /// Persistent watch of the shared parent is triggered once, every closed session gets a close response.
+    size_t watch_responses = 0;
+    std::vector<int64_t> closed_sessions;
+    for (const auto & response : result)
+    {
+        if (response.response->xid == Coordination::WATCH_XID)
+        {
+            ++watch_responses;
+            ASSERT_EQ(response.session_id, 4);
+            ASSERT_EQ(dynamic_cast<const Coordination::ZooKeeperWatchResponse &>(*response.response).type, Coordination::Event::CHILD);
+        }
+        else
+        {
+            ASSERT_EQ(response.response->getOpNum(), Coordination::OpNum::Close);
+            ASSERT_EQ(response.response->zxid, result.back().response->zxid);
+            closed_sessions.push_back(response.session_id);
+        }
+    }
+    ASSERT_EQ(watch_responses, 1);
+    ASSERT_EQ(closed_sessions, (std::vector<int64_t>{1, 2}));
+}
@@ -0,0 +1,150 @@
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <Service/KeeperDataTree.h>
+#include <Service/KeeperStore.h>
+#include <ZooKeeper/ZooKeeperCommon.h>
+#include <gtest/gtest.h>
+
+
+using namespace RK;
+
+TEST(KeeperDataTree, CompactChildrenSet)
+{
+    CompactChildrenSet children;
+    std::set<String> expected;
+    std::mt19937 rng(42);
+
+    for (size_t i = 0; i < 100000; ++i)
+    {
+        String name = "log-" + std::to_string(rng() % 1000);
+        if (rng() % 3)
+            ASSERT_EQ(children.insert(name), expected.insert(name).second);
+        else
+            ASSERT_EQ(children.erase(name), expected.erase(name) > 0);
+
+        ASSERT_EQ(children.size(), expected.size());
+    }
+
+    for (const auto & name : expected)
+        ASSERT_TRUE(children.contains(name));
+
+    size_t count = 0;
+    for (auto name : children)
+    {
+        ASSERT_TRUE(expected.contains(String(name)));
+        ++count;
+    }
+    ASSERT_EQ(count, expected.size());
+
+    CompactChildrenSet copy = children;
+    ASSERT_EQ(copy, children);
+    copy.erase(*copy.begin());
+    ASSERT_NE(copy, children);
+
+    CompactStrings names;
+    children.appendTo(names);
+    ASSERT_EQ(names.size(), expected.size());
+    for (auto name : names)
+        ASSERT_TRUE(expected.contains(name.toString()));
+}
+
+TEST(KeeperDataTree, CompactChildrenSetSmall)
+{
+    CompactChildrenSet children{"a", "b", "c"};
+    ASSERT_FALSE(children.insert("b"));
+    ASSERT_TRUE(children.erase("b"));
+    ASSERT_FALSE(children.contains("b"));
+    ASSERT_EQ(children, CompactChildrenSet({"c", "a"}));
+
+    ASSERT_TRUE(children.erase("a"));
+    ASSERT_TRUE(children.erase("c"));
+    ASSERT_TRUE(children.empty());
+    ASSERT_EQ(children.begin(), children.end());
+}
+
+TEST(KeeperDataTree, CopyOnWriteSnapshot)
+{
+    CopyOnWriteDataTree tree(DataTreeEngine::HASH_MAP, 0);
+
+    auto make_node = [](const String & data)
+    {
+        auto node = std::make_shared<KeeperNode>();
+        node->data = data;
+        return node;
+    };
+
+    tree.emplace("/", make_node(""));
+    tree.emplace("/a", make_node("a"));
+    tree.emplace("/b", make_node("b"));
+
+    auto snapshot = tree.freeze();
+    ASSERT_TRUE(tree.isFrozen());
+
+    /// Writes after freezing are not visible to the snapshot.
+    tree.getForUpdate("/a")->data = "a1";
+    tree.erase("/b");
+    tree.emplace("/c", make_node("c"));
+
+    ASSERT_EQ(tree.size(), 3);
+    ASSERT_EQ(tree.get("/a")->data, "a1");
+    ASSERT_EQ(tree.get("/b"), nullptr);
+    ASSERT_EQ(tree.get("/c")->data, "c");
+
+    std::unordered_map<String, String> snapshot_nodes;
+    for (UInt32 bucket_id = 0; bucket_id < snapshot->getBucketNum(); ++bucket_id)
+        snapshot->forEach(bucket_id, [&](const String & path, const KeeperNodePtr & node) { snapshot_nodes[path] = node->data.str(); });
+
+    ASSERT_EQ(snapshot->size(), 3);
+    ASSERT_EQ(snapshot_nodes, (std::unordered_map<String, String>{{"/", ""}, {"/a", "a"}, {"/b", "b"}}));
+
+    /// The next write merges the delta after the snapshot is released.
+    snapshot.reset();
+    tree.emplace("/d", make_node("d"));
+    ASSERT_FALSE(tree.isFrozen());
+
+    std::unordered_map<String, String> nodes;
+    for (UInt32 bucket_id = 0; bucket_id < tree.getBucketNum(); ++bucket_id)
+        tree.forEach(bucket_id, [&](const String & path, const KeeperNodePtr & node) { nodes[path] = node->data.str(); });
+
+    ASSERT_EQ(tree.size(), 4);
+    ASSERT_EQ(nodes, (std::unordered_map<String, String>{{"/", ""}, {"/a", "a1"}, {"/c", "c"}, {"/d", "d"}}));
+}
+
+TEST(KeeperDataTree, GetResponseReferencesNodeData)
+{
+    KeeperStore store(500);
+    store.addSessionID(1, 30000);
+
+    String data(100000, 'x');
+    auto create_request = std::make_shared<Coordination::ZooKeeperCreateRequest>();
+    create_request->path = "/config";
+    create_request->data = data;
+    create_request->xid = 1;
+
+    auto get_request = std::make_shared<Coordination::ZooKeeperGetRequest>();
+    get_request->path = "/config";
+    get_request->xid = 2;
+
+    KeeperStore::KeeperResponsesQueue responses;
+    store.processRequest(responses, RequestForSession(create_request, 1, 0));
+    store.processRequest(responses, RequestForSession(get_request, 1, 0));
+
+    ResponseForSession response;
+    ASSERT_TRUE(responses.tryPop(response));
+    ASSERT_TRUE(responses.tryPop(response));
+    const auto & get_response = dynamic_cast<const Coordination::ZooKeeperGetResponse &>(*response.response);
+
+    /// The response shares data with the node.
+    ASSERT_EQ(get_response.node_data.data(), store.getNode("/config")->data.data());
+
+    /// Scattered buffers are the same with contiguous serialization.
+    Coordination::ZooKeeperResponseBuffers buffers;
+    get_response.writeNoCopy(buffers);
+    ASSERT_EQ(buffers.payload.data(), get_response.node_data.data());
+
+    WriteBufferFromOwnString buf;
+    get_response.writeNoCopy(buf);
+    ASSERT_EQ(buffers.head + buffers.payload.str() + buffers.tail, buf.str());
+}
@@ -0,0 +1,111 @@
+#include <Service/KeeperStore.h>
+#include <ZooKeeper/ZooKeeperCommon.h>
+#include <gtest/gtest.h>
+
+
+using namespace RK;
+
+namespace
+{
+
+struct LocalSessionsTest : ::testing::Test
+{
+    KeeperStore store{500};
+    KeeperStore::KeeperResponsesQueue responses;
+
+    ResponsesForSessions process(int64_t session_id, const Coordination::ZooKeeperRequestPtr & request)
+    {
+        store.processRequest(responses, RequestForSession(request, session_id, 0));
+        ResponsesForSessions result;
+        ResponseForSession response;
+        while (responses.tryPop(response))
+            result.push_back(response);
+        return result;
+    }
+
+    ResponsesForSessions create(int64_t session_id, const String & path, bool is_ephemeral = false)
+    {
+        auto request = std::make_shared<Coordination::ZooKeeperCreateRequest>();
+        request->path = path;
+        request->is_ephemeral = is_ephemeral;
+        return process(session_id, request);
+    }
+
+    ResponsesForSessions get(int64_t session_id, const String & path)
+    {
+        auto request = std::make_shared<Coordination::ZooKeeperGetRequest>();
+        request->path = path;
+        request->has_watch = true;
+        return process(session_id, request);
+    }
+};
+
+}
+
+TEST_F(LocalSessionsTest, ReadAndUpgrade)
+{
+    const int64_t local_session = initLocalSessionID(1);
+    ASSERT_TRUE(isLocalSessionID(local_session));
+    ASSERT_FALSE(isLocalSessionID(1));
+
+    store.addSessionID(1, 30000);
+    store.addLocalSession(local_session, 30000);
+    create(1, "/a");
+
+    /// Local session can read but not write before upgraded.
+    auto result = get(local_session, "/a");
+    ASSERT_EQ(result.size(), 1);
+    ASSERT_EQ(result[0].response->error, Coordination::Error::ZOK);
+    ASSERT_TRUE(create(local_session, "/b", true).empty());
+    ASSERT_FALSE(store.getNode("/b"));
+
+    /// Only the first write request upgrades the session.
+    ASSERT_TRUE(store.isLocalSession(local_session));
+    ASSERT_EQ(store.startUpgradingLocalSession(local_session), 30000);
+    ASSERT_EQ(store.startUpgradingLocalSession(local_session), -1);
+    ASSERT_FALSE(store.isLocalSession(local_session));
+
+    auto upgrade_request = std::make_shared<Coordination::ZooKeeperUpgradeSessionRequest>();
+    upgrade_request->xid = Coordination::UPGRADE_SESSION_XID;
+    upgrade_request->session_id = local_session;
+    upgrade_request->session_timeout_ms = 30000;
+    upgrade_request->server_id = 1;
+    auto zxid = store.getZxid();
+    process(local_session, upgrade_request);
+
+    ASSERT_EQ(store.getZxid(), zxid + 1);
+    ASSERT_TRUE(store.containsSession(local_session));
+    ASSERT_EQ(store.getLocalSessionCount(), 0);
+    ASSERT_EQ(store.getSessionCount(), 2);
+
+    create(local_session, "/b", true);
+    ASSERT_TRUE(store.getNode("/b"));
+    ASSERT_EQ(store.getTotalEphemeralNodesCount(), 1);
+}
+
+TEST_F(LocalSessionsTest, CloseLocalSession)
+{
+    const int64_t local_session = initLocalSessionID(1);
+
+    store.addSessionID(1, 30000);
+    store.addLocalSession(local_session, 30000);
+    create(1, "/a");
+    get(local_session, "/a");
+    ASSERT_EQ(store.getTotalWatchesCount(), 1);
+
+    /// Closing a local session neither replicates nor consumes zxid.
+    auto close_request = std::make_shared<Coordination::ZooKeeperCloseRequest>();
+    close_request->xid = Coordination::CLOSE_XID;
+    auto zxid = store.getZxid();
+    auto result = process(local_session, close_request);
+
+    ASSERT_EQ(result.size(), 1);
+    ASSERT_EQ(result[0].response->getOpNum(), Coordination::OpNum::Close);
+    ASSERT_EQ(store.getZxid(), zxid);
+    ASSERT_EQ(store.getLocalSessionCount(), 0);
+    ASSERT_EQ(store.getTotalWatchesCount(), 0);
+    ASSERT_EQ(store.getSessionCount(), 1);
+
+    /// Closed local session is unknown.
+    ASSERT_TRUE(get(local_session, "/a").empty());
+}
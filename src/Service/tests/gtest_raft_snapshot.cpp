@@ -261,15 +261,12 @@ void assertStateMachineEquals(KeeperStore & storage, KeeperStore & ano_storage)
 
 
     /// assert data tree
-    for (uint32_t i = 0; i < KeeperStore::DATA_TREE_BUCKET_NUM; i++)
+    for (uint32_t i = 0; i < storage.getDataTreeBucketNum(); i++)
     {
-        auto & map = storage.getDataTree().getMap(i);
-        auto & ano_map = ano_storage.getDataTree().getMap(i);
-
-        map.forEach([&ano_map](const auto & key, const auto & value)
+        storage.getDataTree().forEach(i, [&ano_storage](const auto & key, const auto & value)
         {
             const auto * l = dynamic_cast<const KeeperNode *>(value.get());
-            const auto * r = dynamic_cast<const KeeperNode *>(ano_map.get(key).get());
+            const auto * r = dynamic_cast<const KeeperNode *>(ano_storage.getNode(key).get());
             ASSERT_EQ(l->data, r->data);
             //            ASSERT_EQ(*l, *r);
         });
@@ -452,22 +449,21 @@ void compareKeeperStore(KeeperStore & store, KeeperStore & new_store, bool compa
     ASSERT_EQ(new_store.getNodesCount(), store.getNodesCount());
     for (UInt32 i = 0; i < store.getDataTreeBucketNum(); i++)
     {
-        auto & inner_map = store.getDataTree().getMap(i);
-        for (auto it = inner_map.getMap().begin(); it != inner_map.getMap().end(); it++)
+        store.getDataTree().forEach(i, [&new_store, compare_acl](const String & path, const KeeperNodePtr & node)
         {
-            auto new_node = new_store.getNode(it->first);
+            auto new_node = new_store.getNode(path);
             ASSERT_TRUE(new_node != nullptr);
-            ASSERT_EQ(new_node->data, it->second->data);
+            ASSERT_EQ(new_node->data, node->data);
             if (compare_acl)
             {
-                ASSERT_EQ(new_node->acl_id, it->second->acl_id);
+                ASSERT_EQ(new_node->acl_id, node->acl_id);
             }
 
-            ASSERT_EQ(new_node->is_ephemeral, it->second->is_ephemeral) << "Ephemeral not equals for path " << it->first;
-            ASSERT_EQ(new_node->is_sequential, it->second->is_sequential);
-            ASSERT_EQ(new_node->stat, it->second->stat);
-            ASSERT_EQ(new_node->children, it->second->children);
-        }
+            ASSERT_EQ(new_node->is_ephemeral, node->is_ephemeral) << "Ephemeral not equals for path " << path;
+            ASSERT_EQ(new_node->is_sequential, node->is_sequential);
+            ASSERT_EQ(new_node->stat, node->stat);
+            ASSERT_EQ(new_node->children, node->children);
+        });
     }
     ASSERT_EQ(new_store.getNode("/1020/test112")->data, "test211");
 
@@ -546,7 +542,7 @@ void compareKeeperStore(KeeperStore & store, KeeperStore & new_store, bool compa
     ASSERT_TRUE(true) << "compare ACLs.";
 }
 
-void parseSnapshot(const SnapshotVersion version1, const SnapshotVersion version2)
+void parseSnapshot(const SnapshotVersion version1, const SnapshotVersion version2, DataTreeEngine engine = DataTreeEngine::HASH_MAP)
 {
     String snap_dir(SNAP_DIR + "/5");
     cleanDirectory(snap_dir);
@@ -637,7 +633,7 @@ void parseSnapshot(const SnapshotVersion version1, const SnapshotVersion version
     ASSERT_EQ(object_size, 21 + 3);
 
     /// 3. load the snapshot into new_store
-    KeeperStore new_store(raft_settings->dead_session_check_period_ms);
+    KeeperStore new_store(raft_settings->dead_session_check_period_ms, "", engine);
     ASSERT_TRUE(snap_mgr.parseSnapshot(meta, new_store));
 
     /// 4. compare store and new_store
@@ -650,7 +646,7 @@ void parseSnapshot(const SnapshotVersion version1, const SnapshotVersion version
     ASSERT_EQ(new_object_size, 21 + 3);
 
     /// 6. load the snapshot into new_store1
-    KeeperStore new_store1(raft_settings->dead_session_check_period_ms);
+    KeeperStore new_store1(raft_settings->dead_session_check_period_ms, "", engine);
     ASSERT_TRUE(snap_mgr.parseSnapshot(new_meta, new_store1));
 
     /// 7. compare new_store and new_store1
@@ -678,6 +674,12 @@ TEST(RaftSnapshot, parseSnapshot)
     sleep(1);
 }
 
+TEST(RaftSnapshot, parseSnapshotWithFlatHashMap)
+{
+    parseSnapshot(SnapshotVersion::V2, SnapshotVersion::V2, DataTreeEngine::FLAT_HASH_MAP);
+    sleep(1);
+}
+
 TEST(RaftSnapshot, parseIncompleteSnapshot)
 {
     String snap_dir(SNAP_DIR + "/5");
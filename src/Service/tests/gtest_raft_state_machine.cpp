@@ -299,3 +299,159 @@ TEST(RaftStateMachine, initStateMachine)
     cleanDirectory(snap_dir);
     cleanDirectory(log_dir);
 }
+
+TEST(RaftStateMachine, multiRequestsLogEntry)
+{
+    String snap_dir(SNAP_DIR + "/7");
+    String log_dir(LOG_DIR + "/7");
+
+    cleanDirectory(snap_dir, true);
+    cleanDirectory(log_dir, true);
+
+    auto make_create = [](int64_t session_id, const String & path)
+    {
+        auto request = cs_new<ZooKeeperCreateRequest>();
+        request->path = path;
+        request->data = "data_" + path;
+        request->xid = 1;
+        RequestForSession request_for_session(request, session_id, getCurrentTimeMilliseconds());
+        request_for_session.process_time = getCurrentWallTimeMilliseconds();
+        return request_for_session;
+    };
+
+    {
+        KeeperResponsesQueue queue;
+        RaftSettingsPtr setting_ptr = RaftSettings::getDefault();
+        ptr<NuRaftFileLogStore> log_store = cs_new<NuRaftFileLogStore>(log_dir);
+
+        std::mutex new_session_id_callback_mutex;
+        std::unordered_map<int64_t, ptr<std::condition_variable>> new_session_id_callback;
+
+        NuRaftStateMachine machine(
+            queue, setting_ptr, snap_dir, log_dir, 10, 3, new_session_id_callback_mutex, new_session_id_callback, log_store);
+        int64_t session_id = machine.getStore().getSessionID(30000);
+
+        /// Log entry of a single request is still parsed.
+        ptr<buffer> single = serializeKeeperRequest(make_create(session_id, "/single"));
+        auto single_requests = deserializeKeeperRequests(*single);
+        ASSERT_EQ(single_requests.size(), 1);
+        ASSERT_EQ(single_requests[0]->session_id, session_id);
+        ASSERT_EQ(single_requests[0]->request->getPath(), "/single");
+
+        RequestsForSessions batch{make_create(session_id, "/m1"), make_create(session_id, "/m1/m2"), make_create(session_id, "/m3")};
+        ptr<buffer> multi = serializeKeeperRequests(batch.begin(), batch.end());
+        auto multi_requests = deserializeKeeperRequests(*multi);
+        ASSERT_EQ(multi_requests.size(), 3);
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            ASSERT_EQ(multi_requests[i]->session_id, session_id);
+            ASSERT_EQ(multi_requests[i]->request->getPath(), batch[i].request->getPath());
+            ASSERT_EQ(multi_requests[i]->process_time, batch[i].process_time);
+        }
+
+        UInt64 index = 1;
+        for (const auto & buf : {single, multi})
+        {
+            log_store->append(cs_new<log_entry>(1, buf));
+            machine.commit(index++, *buf, true);
+        }
+
+        /// Requests of a log entry are applied in order.
+        ASSERT_EQ(machine.getNode("/m1/m2").data, "data_/m1/m2");
+        ASSERT_EQ(machine.getNode("/m3").data, "data_/m3");
+        ASSERT_EQ(machine.last_commit_index(), 2);
+        machine.shutdown();
+    }
+
+    /// Replay log of both formats
+    {
+        KeeperResponsesQueue queue;
+        RaftSettingsPtr setting_ptr = RaftSettings::getDefault();
+        ptr<NuRaftFileLogStore> log_store = cs_new<NuRaftFileLogStore>(log_dir);
+
+        std::mutex new_session_id_callback_mutex;
+        std::unordered_map<int64_t, ptr<std::condition_variable>> new_session_id_callback;
+
+        NuRaftStateMachine machine(
+            queue, setting_ptr, snap_dir, log_dir, 10, 3, new_session_id_callback_mutex, new_session_id_callback, log_store);
+        ASSERT_EQ(machine.last_commit_index(), 2);
+        machine.shutdown();
+    }
+
+    cleanDirectory(snap_dir);
+    cleanDirectory(log_dir);
+}
+
+TEST(RaftStateMachine, commitLocalRequests)
+{
+    String snap_dir(SNAP_DIR + "/8");
+    String log_dir(LOG_DIR + "/8");
+
+    cleanDirectory(snap_dir, true);
+    cleanDirectory(log_dir, true);
+
+    KeeperResponsesQueue queue;
+    RaftSettingsPtr setting_ptr = RaftSettings::getDefault();
+
+    std::mutex new_session_id_callback_mutex;
+    std::unordered_map<int64_t, ptr<std::condition_variable>> new_session_id_callback;
+
+    NuRaftStateMachine machine(queue, setting_ptr, snap_dir, log_dir, 10, 3, new_session_id_callback_mutex, new_session_id_callback);
+    int64_t session_id = machine.getStore().getSessionID(30000);
+
+    auto make_create = [session_id](const String & path, Coordination::XID xid)
+    {
+        auto request = cs_new<ZooKeeperCreateRequest>();
+        request->path = path;
+        request->data = "log";
+        request->xid = xid;
+        RequestForSession request_for_session(request, session_id, getCurrentTimeMilliseconds());
+        request_for_session.process_time = getCurrentWallTimeMilliseconds();
+        return request_for_session;
+    };
+
+    /// Data of local requests is changed after they are serialized to tell whether they are deserialized.
+    auto append = [](const RequestsForSessions & batch)
+    {
+        auto buf = serializeKeeperRequests(batch.begin(), batch.end());
+        for (const auto & request : batch)
+            std::dynamic_pointer_cast<ZooKeeperCreateRequest>(request.request)->data = "local";
+        return buf;
+    };
+
+    /// Logs before the local ones are appended by previous leader, even if they have the same request id.
+    RequestForSession previous = make_create("/previous", 1);
+    auto previous_buf = serializeKeeperRequest(previous);
+
+    RequestsForSessions batch{make_create("/a", 1), make_create("/b", 2)};
+    auto buf = append(batch);
+    machine.addLocalRequests(batch, 1);
+
+    machine.commit(1, *previous_buf, true);
+    ASSERT_EQ(machine.getNode("/previous").data, "log");
+    ASSERT_FALSE(machine.exists("/a"));
+
+    machine.commit(2, *buf, true);
+    ASSERT_EQ(machine.getNode("/a").data, "local");
+    ASSERT_EQ(machine.getNode("/b").data, "local");
+
+    /// Requests are not appended.
+    batch = {make_create("/c", 3), make_create("/d", 4)};
+    buf = append(batch);
+    machine.addLocalRequests(batch, 2);
+    machine.removeLocalRequests(batch);
+    machine.commit(3, *buf, true);
+    ASSERT_EQ(machine.getNode("/c").data, "log");
+
+    /// Leadership changed.
+    batch = {make_create("/e", 5), make_create("/f", 6)};
+    buf = append(batch);
+    machine.addLocalRequests(batch, 3);
+    machine.clearLocalRequests();
+    machine.commit(4, *buf, true);
+    ASSERT_EQ(machine.getNode("/e").data, "log");
+
+    machine.shutdown();
+    cleanDirectory(snap_dir);
+    cleanDirectory(log_dir);
+}
@@ -0,0 +1,243 @@
+#include <atomic>
+#include <map>
+#include <thread>
+
+#include <Service/RequestProcessor.h>
+#include <ZooKeeper/ZooKeeperCommon.h>
+#include <gtest/gtest.h>
+
+
+using namespace RK;
+
+namespace
+{
+
+/// Request processor on a store without Raft, committed requests are fed by test.
+class TestRequestProcessor : public RequestProcessor
+{
+public:
+    TestRequestProcessor(KeeperStore & store_, KeeperResponsesQueue & responses_queue_)
+        : RequestProcessor(responses_queue_), store(store_)
+    {
+    }
+
+    void startup(size_t parallel) { RequestProcessor::startup(parallel, 10000, 0); }
+
+protected:
+    KeeperStore & getStore() const override { return store; }
+    bool isLeaderAlive() const override { return true; }
+    bool isLocalSession(int64_t) const override { return true; }
+
+private:
+    KeeperStore & store;
+};
+
+struct RequestProcessorTest : ::testing::Test
+{
+    KeeperStore store{500};
+    KeeperStore::KeeperResponsesQueue responses;
+    TestRequestProcessor processor{store, responses};
+
+    void TearDown() override { processor.shutdown(); }
+
+    void create(int64_t session_id, const String & path)
+    {
+        auto request = std::make_shared<Coordination::ZooKeeperCreateRequest>();
+        request->path = path;
+        store.processRequest(responses, RequestForSession(request, session_id, 0));
+        ResponseForSession response;
+        while (responses.tryPop(response))
+        {
+        }
+    }
+
+    ResponsesForSessions popResponses(size_t count)
+    {
+        ResponsesForSessions result;
+        ResponseForSession response;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+        while (result.size() < count && std::chrono::steady_clock::now() < deadline)
+        {
+            if (responses.tryPop(response, 10))
+                result.push_back(response);
+        }
+        return result;
+    }
+};
+
+RequestForSession makeSet(int64_t session_id, Coordination::XID xid, const String & path, const String & data)
+{
+    auto request = std::make_shared<Coordination::ZooKeeperSetRequest>();
+    request->xid = xid;
+    request->path = path;
+    request->data = data;
+    request->version = -1;
+    return RequestForSession(request, session_id, 0);
+}
+
+RequestForSession makeGet(int64_t session_id, Coordination::XID xid, const String & path)
+{
+    auto request = std::make_shared<Coordination::ZooKeeperGetRequest>();
+    request->xid = xid;
+    request->path = path;
+    return RequestForSession(request, session_id, 0);
+}
+
+}
+
+TEST_F(RequestProcessorTest, ReadsSeeWritesCommittedBefore)
+{
+    const size_t parallel = 3;
+    const int64_t session_count = 6;
+    const int rounds = 200;
+
+    for (int64_t session_id = 1; session_id <= session_count; ++session_id)
+    {
+        store.addSessionID(session_id, 30000);
+        create(session_id, "/s" + std::to_string(session_id));
+    }
+    processor.startup(parallel);
+
+    /// Every session sets its node and reads it twice in every round, sessions are spread over all runners.
+    /// Writes are pushed before committed, as a request is pushed before it is forwarded or appended to Raft.
+    std::vector<RequestForSession> writes;
+    for (int round = 1; round <= rounds; ++round)
+    {
+        for (int64_t session_id = 1; session_id <= session_count; ++session_id)
+        {
+            String path = "/s" + std::to_string(session_id);
+            auto write = makeSet(session_id, round * 3, path, std::to_string(round));
+            processor.push(write);
+            processor.push(makeGet(session_id, round * 3 + 1, path));
+            processor.push(makeGet(session_id, round * 3 + 2, path));
+            writes.push_back(write);
+        }
+    }
+
+    /// Commits of different sessions interleave with read rounds of the main thread.
+    std::thread committer(
+        [&]
+        {
+            for (size_t i = 0; i < writes.size(); ++i)
+            {
+                processor.commit(writes[i]);
+                if (i % 50 == 0)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+
+    auto result = popResponses(writes.size() * 3);
+    committer.join();
+    ASSERT_EQ(result.size(), writes.size() * 3);
+
+    std::map<int64_t, Coordination::XID> last_xids;
+    for (const auto & response : result)
+    {
+        const auto & zk_response = *response.response;
+        ASSERT_EQ(zk_response.error, Coordination::Error::ZOK);
+
+        /// Responses of a session are in request order.
+        auto & last_xid = last_xids[response.session_id];
+        ASSERT_EQ(zk_response.xid, last_xid == 0 ? 3 : last_xid + 1);
+        last_xid = zk_response.xid;
+
+        /// A read sees exactly the writes of its session committed before it.
+        if (zk_response.xid % 3 != 0)
+        {
+            const auto & get_response = dynamic_cast<const Coordination::ZooKeeperGetResponse &>(zk_response);
+            ASSERT_EQ(get_response.node_data.str(), std::to_string(zk_response.xid / 3));
+        }
+    }
+    ASSERT_EQ(last_xids.size(), session_count);
+}
+
+TEST_F(RequestProcessorTest, CloseLocalSessionOnReader)
+{
+    const int64_t local_session = initLocalSessionID(1);
+
+    store.addSessionID(1, 30000);
+    store.addLocalSession(local_session, 30000);
+    create(1, "/a");
+    processor.startup(2);
+
+    /// Close of a local session is neither replicated nor committed, a reader thread applies it
+    /// after the reads before it.
+    processor.push(makeGet(local_session, 1, "/a"));
+    auto close_request = std::make_shared<Coordination::ZooKeeperCloseRequest>();
+    close_request->xid = Coordination::CLOSE_XID;
+    processor.push(RequestForSession(close_request, local_session, 0));
+
+    auto result = popResponses(2);
+    ASSERT_EQ(result.size(), 2);
+    ASSERT_EQ(result[0].response->xid, 1);
+    ASSERT_EQ(result[0].response->error, Coordination::Error::ZOK);
+    ASSERT_EQ(result[1].response->getOpNum(), Coordination::OpNum::Close);
+    ASSERT_EQ(store.getLocalSessionCount(), 0);
+    ASSERT_EQ(store.getSessionCount(), 1);
+}
+
+TEST_F(RequestProcessorTest, FreezeDataTreeWhileReading)
+{
+    const int64_t session_count = 4;
+    const int rounds = 200;
+
+    for (int64_t session_id = 1; session_id <= session_count; ++session_id)
+    {
+        store.addSessionID(session_id, 30000);
+        create(session_id, "/s" + std::to_string(session_id));
+    }
+    const auto nodes_count = store.getNodesCount();
+    processor.startup(2);
+
+    /// Snapshots are taken and released while reads and writes are processed, every freezing
+    /// after a released snapshot merges it into data tree.
+    std::atomic<bool> done{false};
+    std::thread snapshotter(
+        [&]
+        {
+            while (!done)
+            {
+                DataTreeSnapshotPtr snapshot;
+                processor.runExclusively([&] { snapshot = store.freezeDataTree(); });
+                ASSERT_EQ(snapshot->size(), nodes_count);
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        });
+
+    size_t request_count = 0;
+    for (int round = 1; round <= rounds; ++round)
+    {
+        for (int64_t session_id = 1; session_id <= session_count; ++session_id)
+        {
+            String path = "/s" + std::to_string(session_id);
+            auto write = makeSet(session_id, round * 2, path, std::to_string(round));
+            processor.push(write);
+            processor.push(makeGet(session_id, round * 2 + 1, path));
+            processor.commit(write);
+            request_count += 2;
+        }
+    }
+
+    auto result = popResponses(request_count);
+    done = true;
+    snapshotter.join();
+    ASSERT_EQ(result.size(), request_count);
+
+    for (const auto & response : result)
+    {
+        const auto & zk_response = *response.response;
+        ASSERT_EQ(zk_response.error, Coordination::Error::ZOK);
+        if (zk_response.xid % 2 == 1)
+        {
+            const auto & get_response = dynamic_cast<const Coordination::ZooKeeperGetResponse &>(zk_response);
+            ASSERT_EQ(get_response.node_data.str(), std::to_string(zk_response.xid / 2));
+        }
+    }
+
+    /// Run in place after shutdown.
+    processor.shutdown();
+    DataTreeSnapshotPtr snapshot;
+    processor.runExclusively([&] { snapshot = store.freezeDataTree(); });
+    ASSERT_EQ(snapshot->size(), nodes_count);
+    ASSERT_EQ(store.getNode("/s1")->data.str(), std::to_string(rounds));
+}
@@ -0,0 +1,207 @@
+#include <Service/KeeperStore.h>
+#include <ZooKeeper/ZooKeeperCommon.h>
+#include <gtest/gtest.h>
+
+
+using namespace RK;
+
+namespace
+{
+
+/// Process request and return the serialized response of it.
+String processRequest(KeeperStore & store, int64_t session_id, const Coordination::ZooKeeperRequestPtr & request)
+{
+    KeeperStore::KeeperResponsesQueue responses;
+    store.processRequest(responses, RequestForSession(request, session_id, 0));
+
+    ResponseForSession response;
+    String result;
+    while (responses.tryPop(response))
+    {
+        WriteBufferFromOwnString buf;
+        response.response->writeNoCopy(buf);
+        result += buf.str();
+    }
+    return result;
+}
+
+Coordination::ZooKeeperRequestPtr makeRequest(size_t i, const String & path)
+{
+    Coordination::ZooKeeperRequestPtr request;
+    switch (i % 8)
+    {
+        case 0:
+        {
+            auto create_request = std::make_shared<Coordination::ZooKeeperCreateRequest>();
+            create_request->path = path;
+            create_request->data = String(i % 100, 'x');
+            create_request->is_ephemeral = i % 3 == 0;
+            request = create_request;
+            break;
+        }
+        case 1:
+        {
+            auto set_request = std::make_shared<Coordination::ZooKeeperSetRequest>();
+            set_request->path = path;
+            set_request->data = String(i % 200, 'y');
+            request = set_request;
+            break;
+        }
+        case 2:
+        {
+            auto set_acl_request = std::make_shared<Coordination::ZooKeeperSetACLRequest>();
+            set_acl_request->path = path;
+            set_acl_request->acls = {{Coordination::ACL::All, "world", "anyone"}};
+            request = set_acl_request;
+            break;
+        }
+        case 3:
+        {
+            auto remove_request = std::make_shared<Coordination::ZooKeeperRemoveRequest>();
+            remove_request->path = path;
+            request = remove_request;
+            break;
+        }
+        case 4:
+        {
+            auto list_request = std::make_shared<Coordination::ZooKeeperListRequest>();
+            list_request->path = path;
+            request = list_request;
+            break;
+        }
+        case 5:
+        {
+            auto list_request = std::make_shared<Coordination::ZooKeeperSimpleListRequest>();
+            list_request->path = path;
+            request = list_request;
+            break;
+        }
+        case 6:
+        {
+            auto exists_request = std::make_shared<Coordination::ZooKeeperExistsRequest>();
+            exists_request->path = path;
+            request = exists_request;
+            break;
+        }
+        default:
+        {
+            auto get_request = std::make_shared<Coordination::ZooKeeperGetRequest>();
+            get_request->path = path;
+            request = get_request;
+            break;
+        }
+    }
+    request->xid = static_cast<Coordination::XID>(i);
+    return request;
+}
+
+}
+
+TEST(ResponseCache, GetAndInvalidate)
+{
+    ResponseCache cache(1 << 20);
+    ASSERT_TRUE(cache.enabled());
+    ASSERT_FALSE(ResponseCache(0).enabled());
+
+    ASSERT_TRUE(cache.get("/a", ResponseCache::Kind::Get, 1, 1).empty());
+    cache.set("/a", ResponseCache::Kind::Get, 1, 1, "body");
+    ASSERT_EQ(cache.get("/a", ResponseCache::Kind::Get, 1, 1), "body");
+    ASSERT_TRUE(cache.get("/a", ResponseCache::Kind::List, 1, 1).empty());
+    ASSERT_TRUE(cache.get("/a", ResponseCache::Kind::Get, 2, 1).empty());
+    ASSERT_EQ(cache.getHits(), 1);
+    ASSERT_EQ(cache.getMisses(), 3);
+
+    /// Body of a newer version replaces the entry.
+    cache.set("/a", ResponseCache::Kind::List, 1, 2, "children");
+    ASSERT_TRUE(cache.get("/a", ResponseCache::Kind::Get, 1, 1).empty());
+    ASSERT_EQ(cache.get("/a", ResponseCache::Kind::List, 1, 2), "children");
+    ASSERT_EQ(cache.getEntriesCount(), 1);
+
+    cache.invalidate("/a");
+    ASSERT_TRUE(cache.get("/a", ResponseCache::Kind::List, 1, 2).empty());
+    ASSERT_EQ(cache.getEntriesCount(), 0);
+    ASSERT_EQ(cache.getSize(), 0);
+}
+
+TEST(ResponseCache, EvictLeastRecentlyUsed)
+{
+    constexpr size_t body_size = 1000;
+    ResponseCache cache(ResponseCache::SHARD_NUM * 10 * body_size);
+
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        String path = "/n" + std::to_string(i);
+        cache.set(path, ResponseCache::Kind::Get, 1, 1, String(body_size, 'x'));
+        /// The first node is hot.
+        ASSERT_FALSE(cache.get("/n0", ResponseCache::Kind::Get, 1, 1).empty());
+    }
+
+    ASSERT_LE(cache.getSize(), ResponseCache::SHARD_NUM * 10 * body_size);
+    ASSERT_LT(cache.getEntriesCount(), 1000);
+    ASSERT_GT(cache.getEntriesCount(), 0);
+
+    /// Too large to be cached.
+    cache.set("/large", ResponseCache::Kind::Get, 1, 1, String(100 * body_size, 'x'));
+    ASSERT_TRUE(cache.get("/large", ResponseCache::Kind::Get, 1, 1).empty());
+}
+
+/// Responses are the same with those of a store without response cache.
+TEST(ResponseCache, SameWithoutCache)
+{
+    KeeperStore store(500);
+    KeeperStore cached_store(500, "", DataTreeEngine::HASH_MAP, 0, 3, 1 << 20);
+
+    for (int64_t session_id = 1; session_id <= 2; ++session_id)
+    {
+        store.addSessionID(session_id, 30000);
+        cached_store.addSessionID(session_id, 30000);
+    }
+
+    for (size_t i = 0; i < 5000; ++i)
+    {
+        String path = i % 5 == 0 ? "/" : "/n" + std::to_string(i % 7);
+        if (i % 11 == 0)
+            path += "/m" + std::to_string(i % 3);
+
+        auto request = makeRequest(i * 7 / 5, path);
+        int64_t session_id = 1 + i % 2;
+        ASSERT_EQ(processRequest(cached_store, session_id, request), processRequest(store, session_id, request)) << request->toString();
+
+        /// Ephemeral nodes are removed when session is closed.
+        if (i % 1000 == 999)
+        {
+            auto close_request = std::make_shared<Coordination::ZooKeeperCloseRequest>();
+            ASSERT_EQ(processRequest(cached_store, 2, close_request), processRequest(store, 2, close_request));
+            store.addSessionID(2, 30000);
+            cached_store.addSessionID(2, 30000);
+        }
+    }
+
+    ASSERT_GT(cached_store.getResponseCache().getHits(), 0);
+    ASSERT_EQ(store.getResponseCache().getHits(), 0);
+}
+
+TEST(ResponseCache, LargeBodyIsReferenced)
+{
+    Coordination::ZooKeeperListResponse response;
+    response.xid = 1;
+    response.zxid = 2;
+    for (size_t i = 0; i < 1000; ++i)
+        response.names.push_back("child" + std::to_string(i));
+
+    WriteBufferFromOwnString body;
+    response.writeImpl(body);
+
+    Coordination::ZooKeeperListResponse cached_response;
+    cached_response.xid = 1;
+    cached_response.zxid = 2;
+    cached_response.serialized_body = body.str();
+
+    Coordination::ZooKeeperResponseBuffers buffers;
+    cached_response.writeNoCopy(buffers);
+    ASSERT_EQ(buffers.payload.data(), cached_response.serialized_body.data());
+
+    WriteBufferFromOwnString buf;
+    response.writeNoCopy(buf);
+    ASSERT_EQ(buffers.head + buffers.payload.str() + buffers.tail, buf.str());
+}
@@ -0,0 +1,97 @@
+#include <thread>
+#include <vector>
+
+#include <Service/ResponsesQueue.h>
+#include <ZooKeeper/ZooKeeperCommon.h>
+#include <gtest/gtest.h>
+
+
+using namespace RK;
+
+namespace
+{
+
+ResponseForSession makeResponse(int64_t session_id, Coordination::XID xid)
+{
+    auto response = std::make_shared<Coordination::ZooKeeperCreateResponse>();
+    response->xid = xid;
+    return ResponseForSession{session_id, response};
+}
+
+}
+
+TEST(ResponsesQueue, Sharding)
+{
+    ResponsesQueue queue(3);
+    ASSERT_EQ(queue.childQueueSize(), 3);
+
+    for (int64_t session_id = 0; session_id < 9; ++session_id)
+        queue.push(makeResponse(session_id, 1));
+    queue.push(makeResponse(-1, 1));
+
+    ASSERT_EQ(queue.size(), 10);
+    for (size_t i = 0; i < queue.childQueueSize(); ++i)
+    {
+        ResponseForSession response;
+        while (queue.tryPop(i, response))
+            ASSERT_EQ(queue.getQueueId(response.session_id), i);
+    }
+    ASSERT_TRUE(queue.empty());
+
+    /// Resizing keeps child queues.
+    queue.push(makeResponse(1, 1));
+    queue.resize(4);
+    ASSERT_EQ(queue.size(1), 1);
+}
+
+TEST(ResponsesQueue, SessionOrder)
+{
+    const size_t shard_count = 4;
+    const int64_t session_count = 16;
+    const Coordination::XID xid_count = 10000;
+
+    ResponsesQueue queue(shard_count);
+
+    std::vector<std::thread> producers;
+    for (int64_t session_id = 0; session_id < session_count; ++session_id)
+        producers.emplace_back(
+            [&, session_id]
+            {
+                for (Coordination::XID xid = 0; xid < xid_count; ++xid)
+                    queue.push(makeResponse(session_id, xid));
+            });
+
+    std::vector<std::vector<Coordination::XID>> last_xids(shard_count, std::vector<Coordination::XID>(session_count, -1));
+    std::vector<std::thread> consumers;
+    for (size_t i = 0; i < shard_count; ++i)
+        consumers.emplace_back(
+            [&, i]
+            {
+                auto & last_xid = last_xids[i];
+                size_t expected = session_count / shard_count * xid_count;
+                ResponseForSession response;
+                for (size_t popped = 0; popped < expected;)
+                {
+                    if (!queue.tryPop(i, response, 100))
+                        continue;
+                    ASSERT_EQ(response.response->xid, last_xid[response.session_id] + 1);
+                    last_xid[response.session_id] = response.response->xid;
+                    ++popped;
+                }
+            });
+
+    for (auto & thread : producers)
+        thread.join();
+    for (auto & thread : consumers)
+        thread.join();
+
+    for (size_t i = 0; i < shard_count; ++i)
+        for (int64_t session_id = 0; session_id < session_count; ++session_id)
+        {
+            if (queue.getQueueId(session_id) == i)
+            {
+                ASSERT_EQ(last_xids[i][session_id], xid_count - 1);
+            }
+        }
+    ASSERT_TRUE(queue.empty());
+}
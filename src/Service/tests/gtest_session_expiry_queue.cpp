@@ -0,0 +1,88 @@
+#include <algorithm>
+
+#include <Service/SessionExpiryQueue.h>
+#include <gtest/gtest.h>
+
+
+using namespace RK;
+
+namespace
+{
+
+std::vector<int64_t> sorted(std::vector<int64_t> sessions)
+{
+    std::sort(sessions.begin(), sessions.end());
+    return sessions;
+}
+
+}
+
+TEST(SessionExpiryQueue, ExpireAndHeartbeat)
+{
+    SessionExpiryQueue queue(500);
+    int64_t now = 1630580418000;
+
+    queue.addNewSessionOrUpdate(1, 1000, now);
+    queue.addNewSessionOrUpdate(2, 2000, now);
+    queue.addNewSessionOrUpdate(3, 30000, now);
+    ASSERT_EQ(queue.size(), 3);
+
+    /// Expiration time is rounded up to the next tick.
+    ASSERT_EQ(queue.sessionToExpirationTime().at(1), now + 1500);
+    ASSERT_TRUE(queue.getExpiredSessions(now + 1499).empty());
+    ASSERT_EQ(queue.getExpiredSessions(now + 1500), (std::vector<int64_t>{1}));
+
+    /// Heartbeat moves session to a later tick.
+    queue.addNewSessionOrUpdate(2, 2000, now + 1000);
+    ASSERT_EQ(queue.getExpiredSessions(now + 2500), (std::vector<int64_t>{1}));
+
+    /// Expired sessions are reported until they are removed.
+    ASSERT_EQ(sorted(queue.getExpiredSessions(now + 3500)), (std::vector<int64_t>{1, 2}));
+    ASSERT_TRUE(queue.remove(1));
+    ASSERT_FALSE(queue.remove(1));
+
+    /// Heartbeat of an expired session revives it.
+    queue.addNewSessionOrUpdate(2, 2000, now + 3500);
+    ASSERT_TRUE(queue.getExpiredSessions(now + 3600).empty());
+    ASSERT_EQ(sorted(queue.getExpiredSessions(now + 31000)), (std::vector<int64_t>{2, 3}));
+}
+
+TEST(SessionExpiryQueue, RemoteAndLongSessions)
+{
+    SessionExpiryQueue queue(500);
+    int64_t now = 1630580418000;
+
+    /// Remote sessions may expire out of the tick boundary or be already expired.
+    queue.setSessionExpirationTime(1, now + 1200, now);
+    queue.setSessionExpirationTime(2, now - 1000, now);
+    ASSERT_EQ(queue.getExpiredSessions(now), (std::vector<int64_t>{2}));
+    ASSERT_EQ(queue.getExpiredSessions(now + 1499), (std::vector<int64_t>{2}));
+    ASSERT_EQ(sorted(queue.getExpiredSessions(now + 1500)), (std::vector<int64_t>{1, 2}));
+
+    /// Wheel grows for long timeouts and keeps sessions beyond its largest size aside.
+    queue.clear();
+    constexpr int64_t day = 24 * 3600 * 1000;
+    queue.addNewSessionOrUpdate(1, 60000, now);
+    queue.addNewSessionOrUpdate(2, day, now);
+    queue.addNewSessionOrUpdate(3, 3600 * 1000, now);
+
+    for (int64_t time = now; time < now + 2 * day; time += 250)
+    {
+        auto expired = sorted(queue.getExpiredSessions(time));
+        std::vector<int64_t> expected;
+        if (time >= now + 60500)
+            expected.push_back(1);
+        if (time >= now + day + 500)
+            expected.push_back(2);
+        if (time >= now + 3600 * 1000 + 500)
+            expected.push_back(3);
+        ASSERT_EQ(expired, expected) << "at " << time - now;
+    }
+
+    /// Clock jumps over the whole wheel.
+    queue.clear();
+    queue.addNewSessionOrUpdate(1, 1000, now);
+    queue.addNewSessionOrUpdate(2, 2 * day, now);
+    ASSERT_EQ(queue.getExpiredSessions(now + day), (std::vector<int64_t>{1}));
+    ASSERT_EQ(sorted(queue.getExpiredSessions(now + 3 * day)), (std::vector<int64_t>{1, 2}));
+}
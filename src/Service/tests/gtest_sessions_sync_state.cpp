@@ -0,0 +1,83 @@
+#include <Service/SessionsSyncState.h>
+#include <gtest/gtest.h>
+
+
+using namespace RK;
+
+using Sessions = SessionsSyncState::Sessions;
+
+TEST(SessionsSyncState, Delta)
+{
+    SessionsSyncState state;
+    bool full_sync;
+
+    Sessions local{{1, 100}, {2, 100}};
+    ASSERT_EQ(state.getSessionsToSync(1, local, full_sync), local);
+    ASSERT_TRUE(full_sync);
+
+    /// Sessions are not acknowledged yet, so they are sent again.
+    ASSERT_EQ(state.getSessionsToSync(1, local, full_sync), local);
+    ASSERT_FALSE(full_sync);
+
+    state.onSynced(1, local);
+    ASSERT_TRUE(state.getSessionsToSync(1, local, full_sync).empty());
+
+    /// New and changed sessions are sent, closed sessions are not.
+    local = {{2, 200}, {3, 100}};
+    auto sessions_to_sync = state.getSessionsToSync(1, local, full_sync);
+    ASSERT_EQ(sessions_to_sync, local);
+    state.onSynced(1, sessions_to_sync);
+    ASSERT_TRUE(state.getSessionsToSync(1, local, full_sync).empty());
+
+    /// A session closed and acknowledged before is sent again once it is local.
+    local = {{1, 300}};
+    ASSERT_EQ(state.getSessionsToSync(1, local, full_sync), local);
+}
+
+TEST(SessionsSyncState, LeaderSwitch)
+{
+    SessionsSyncState state;
+    bool full_sync;
+
+    Sessions local{{1, 100}, {2, 100}};
+    state.getSessionsToSync(1, local, full_sync);
+    state.onSynced(1, local);
+    ASSERT_TRUE(state.getSessionsToSync(1, local, full_sync).empty());
+
+    /// New leader gets all sessions.
+    ASSERT_EQ(state.getSessionsToSync(2, local, full_sync), local);
+    ASSERT_TRUE(full_sync);
+
+    /// Acknowledgement from the previous leader does not count.
+    state.onSynced(1, local);
+    ASSERT_EQ(state.getSessionsToSync(2, local, full_sync), local);
+    ASSERT_FALSE(full_sync);
+
+    state.onSynced(2, local);
+    ASSERT_TRUE(state.getSessionsToSync(2, local, full_sync).empty());
+}
+
+TEST(SessionsSyncState, Resync)
+{
+    SessionsSyncState state;
+    bool full_sync;
+
+    Sessions local{{1, 100}, {2, 100}};
+    state.getSessionsToSync(1, local, full_sync);
+    state.onSynced(1, local);
+    ASSERT_TRUE(state.getSessionsToSync(1, local, full_sync).empty());
+
+    /// For example a sync failed, all sessions are sent in next sync only.
+    state.resync();
+    ASSERT_EQ(state.getSessionsToSync(1, local, full_sync), local);
+    ASSERT_TRUE(full_sync);
+    state.onSynced(1, local);
+    ASSERT_TRUE(state.getSessionsToSync(1, local, full_sync).empty());
+    ASSERT_FALSE(full_sync);
+
+    /// Periodic full sync.
+    for (size_t i = 1; i < SessionsSyncState::FULL_SYNC_ROUNDS - 1; ++i)
+        ASSERT_TRUE(state.getSessionsToSync(1, local, full_sync).empty());
+    ASSERT_EQ(state.getSessionsToSync(1, local, full_sync), local);
+    ASSERT_TRUE(full_sync);
+}
@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include <Common/IO/ReadBufferFromString.h>
+#include <Service/KeeperStore.h>
+#include <Service/RecursiveWatches.h>
+#include <Service/WatchManager.h>
+#include <ZooKeeper/ZooKeeperCommon.h>
+#include <ZooKeeper/ZooKeeperIO.h>
+#include <gtest/gtest.h>
+
+
+using namespace RK;
+
+namespace
+{
+
+/// Triggered events as (session, path, type), sorted.
+using Events = std::vector<std::tuple<int64_t, String, int32_t>>;
+
+Events toEvents(const ResponsesForSessions & responses)
+{
+    Events events;
+    for (const auto & response : responses)
+    {
+        const auto & watch_response = dynamic_cast<const Coordination::ZooKeeperWatchResponse &>(*response.response);
+        events.emplace_back(response.session_id, watch_response.path, watch_response.type);
+    }
+    std::sort(events.begin(), events.end());
+    return events;
+}
+
+}
+
+TEST(WatchManager, RecursiveWatchesTrie)
+{
+    RecursiveWatches trie;
+    ASSERT_TRUE(trie.add("/", 1));
+    ASSERT_TRUE(trie.add("/a/b", 2));
+    ASSERT_TRUE(trie.add("/a/b", 3));
+    ASSERT_FALSE(trie.add("/a/b", 3));
+    ASSERT_TRUE(trie.add("/a/bc", 4));
+    ASSERT_EQ(trie.getWatchedPathsCount(), 3);
+    ASSERT_EQ(trie.getTotalWatchesCount(), 4);
+
+    auto watchers = [&](const String & path)
+    {
+        std::vector<int64_t> result;
+        trie.forEachWatcher(path, [&](int64_t session_id) { result.push_back(session_id); });
+        std::sort(result.begin(), result.end());
+        return result;
+    };
+
+    ASSERT_EQ(watchers("/a"), (std::vector<int64_t>{1}));
+    ASSERT_EQ(watchers("/a/b"), (std::vector<int64_t>{1, 2, 3}));
+    ASSERT_EQ(watchers("/a/b/c/d"), (std::vector<int64_t>{1, 2, 3}));
+    ASSERT_EQ(watchers("/a/bc"), (std::vector<int64_t>{1, 4}));
+    ASSERT_TRUE(trie.contains("/a/b", 2));
+    ASSERT_FALSE(trie.contains("/a", 2));
+
+    std::vector<String> paths;
+    trie.forEachPath([&](const String & path, const RecursiveWatches::Sessions &) { paths.push_back(path); });
+    std::sort(paths.begin(), paths.end());
+    ASSERT_EQ(paths, (std::vector<String>{"/", "/a/b", "/a/bc"}));
+
+    ASSERT_FALSE(trie.remove("/a", 2));
+    ASSERT_TRUE(trie.remove("/a/b", 2));
+    ASSERT_TRUE(trie.remove("/a/b", 3));
+    ASSERT_TRUE(trie.remove("/", 1));
+    ASSERT_EQ(watchers("/a/b"), (std::vector<int64_t>{}));
+    ASSERT_EQ(watchers("/a/bc/d"), (std::vector<int64_t>{4}));
+    ASSERT_EQ(trie.getWatchedPathsCount(), 1);
+    ASSERT_TRUE(trie.remove("/a/bc", 4));
+    ASSERT_TRUE(trie.empty());
+}
+
+TEST(WatchManager, PersistentWatches)
+{
+    using Coordination::Event;
+
+    WatchManager watch_manager;
+    watch_manager.addWatch("/a", 1, Coordination::AddWatchMode::Persistent);
+    watch_manager.addWatch("/a", 2, Coordination::AddWatchMode::PersistentRecursive);
+    watch_manager.registerWatches("/a/b", 3, Coordination::OpNum::Get);
+    watch_manager.registerWatches("/a/b", 2, Coordination::OpNum::Exists);
+
+    /// Persistent watches are not removed when triggered, session 2 gets one event for its two watches.
+    for (size_t i = 0; i < 2; ++i)
+    {
+        ASSERT_EQ(toEvents(watch_manager.processWatches("/a", Event::CHANGED)), (Events{{1, "/a", Event::CHANGED}, {2, "/a", Event::CHANGED}}));
+        ASSERT_EQ(
+            toEvents(watch_manager.processWatches("/a/b", Event::CREATED)),
+            i == 0 ? Events{{1, "/a", Event::CHILD}, {2, "/a/b", Event::CREATED}, {3, "/a/b", Event::CREATED}}
+                   : Events{{1, "/a", Event::CHILD}, {2, "/a/b", Event::CREATED}});
+    }
+
+    /// Recursive watch is triggered by descendants but not by CHILD events.
+    ASSERT_EQ(toEvents(watch_manager.processWatches("/a/b/c", Event::DELETED)), (Events{{2, "/a/b/c", Event::DELETED}}));
+    ASSERT_TRUE(watch_manager.processWatches("/b", Event::CREATED).empty());
+
+    ASSERT_EQ(watch_manager.getTotalWatchesCount(), 2);
+    ASSERT_EQ(watch_manager.getWatchedPathsCount(), 2);
+    ASSERT_EQ(watch_manager.getSessionsWithWatchesCount(), 2);
+
+    WriteBufferFromOwnString buf;
+    watch_manager.dumpWatchesByPath(buf);
+    ASSERT_EQ(buf.str(), "/a\n\t0x1\n/a\n\t0x2\n");
+}
+
+TEST(WatchManager, CheckAndRemoveWatches)
+{
+    using Coordination::WatcherType;
+
+    WatchManager watch_manager;
+    watch_manager.addWatch("/a", 1, Coordination::AddWatchMode::PersistentRecursive);
+    watch_manager.registerWatches("/a", 1, Coordination::OpNum::List);
+
+    ASSERT_TRUE(watch_manager.containsWatches("/a", 1, WatcherType::Any));
+    ASSERT_TRUE(watch_manager.containsWatches("/a", 1, WatcherType::Children));
+    ASSERT_FALSE(watch_manager.containsWatches("/a", 1, WatcherType::Data));
+    ASSERT_FALSE(watch_manager.containsWatches("/a", 2, WatcherType::Any));
+
+    ASSERT_FALSE(watch_manager.removeWatches("/a", 1, WatcherType::Persistent));
+    ASSERT_TRUE(watch_manager.removeWatches("/a", 1, WatcherType::PersistentRecursive));
+    ASSERT_TRUE(watch_manager.processWatches("/a/b", Coordination::Event::CHANGED).empty());
+    ASSERT_TRUE(watch_manager.removeWatches("/a", 1, WatcherType::Any));
+    ASSERT_FALSE(watch_manager.containsWatches("/a", 1, WatcherType::Any));
+    ASSERT_EQ(watch_manager.getSessionsWithWatchesCount(), 0);
+
+    /// Watches of all kinds are removed when session is closed.
+    watch_manager.addWatch("/", 1, Coordination::AddWatchMode::PersistentRecursive);
+    watch_manager.addWatch("/a", 1, Coordination::AddWatchMode::Persistent);
+    watch_manager.registerWatches("/a", 1, Coordination::OpNum::Get);
+    watch_manager.cleanDeadWatches(1);
+    ASSERT_EQ(watch_manager.getTotalWatchesCount(), 0);
+    ASSERT_EQ(watch_manager.getWatchedPathsCount(), 0);
+    ASSERT_TRUE(watch_manager.processWatches("/a", Coordination::Event::DELETED).empty());
+}
+
+TEST(WatchManager, ConcurrentRegisterAndTrigger)
+{
+    WatchManager watch_manager;
+    constexpr size_t threads = 4;
+    constexpr size_t paths = 1000;
+
+    /// Every session watches every path once.
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]
+        {
+            for (size_t i = 0; i < paths; ++i)
+                watch_manager.registerWatches("/n" + std::to_string(i), static_cast<int64_t>(t + 1), Coordination::OpNum::Get);
+        });
+    }
+    for (auto & worker : workers)
+        worker.join();
+
+    ASSERT_EQ(watch_manager.getTotalWatchesCount(), threads * paths);
+    ASSERT_EQ(watch_manager.getWatchedPathsCount(), paths);
+    ASSERT_EQ(watch_manager.getSessionsWithWatchesCount(), threads);
+
+    /// One event object is shared by all watchers of a path.
+    auto responses = watch_manager.processWatches("/n0", Coordination::Event::CHANGED);
+    ASSERT_EQ(responses.size(), threads);
+    for (const auto & response : responses)
+        ASSERT_EQ(response.response.get(), responses[0].response.get());
+
+    workers.clear();
+    std::atomic<size_t> events = 0;
+    for (size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]
+        {
+            for (size_t i = 1 + t; i < paths; i += threads)
+                events += watch_manager.processWatches("/n" + std::to_string(i), Coordination::Event::CHANGED).size();
+        });
+    }
+    for (auto & worker : workers)
+        worker.join();
+
+    ASSERT_EQ(events, threads * (paths - 1));
+    ASSERT_EQ(watch_manager.getTotalWatchesCount(), 0);
+    ASSERT_EQ(watch_manager.getSessionsWithWatchesCount(), 0);
+}
+
+TEST(WatchManager, AddWatchRequest)
+{
+    KeeperStore store(500);
+    store.addSessionID(1, 30000);
+    store.addSessionID(2, 30000);
+
+    KeeperStore::KeeperResponsesQueue responses;
+    auto process = [&](int64_t session_id, const Coordination::ZooKeeperRequestPtr & request)
+    {
+        store.processRequest(responses, RequestForSession(request, session_id, 0));
+        ResponsesForSessions result;
+        ResponseForSession response;
+        while (responses.tryPop(response))
+            result.push_back(response);
+        return result;
+    };
+
+    auto add_watch_request = std::make_shared<Coordination::ZooKeeperAddWatchRequest>();
+    add_watch_request->path = "/config";
+    add_watch_request->mode = Coordination::AddWatchMode::PersistentRecursive;
+    auto result = process(1, add_watch_request);
+    ASSERT_EQ(result.size(), 1);
+    ASSERT_EQ(result[0].response->error, Coordination::Error::ZOK);
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        auto create_request = std::make_shared<Coordination::ZooKeeperCreateRequest>();
+        create_request->path = i == 0 ? "/config" : "/config/" + std::to_string(i);
+        result = process(2, create_request);
+        ASSERT_EQ(result.size(), 2);
+        ASSERT_EQ(result[0].session_id, 1);
+        ASSERT_EQ(dynamic_cast<const Coordination::ZooKeeperWatchResponse &>(*result[0].response).path, create_request->path);
+    }
+
+    auto check_watches_request = std::make_shared<Coordination::ZooKeeperCheckWatchesRequest>();
+    check_watches_request->path = "/config";
+    check_watches_request->type = Coordination::WatcherType::Any;
+    ASSERT_EQ(process(1, check_watches_request)[0].response->error, Coordination::Error::ZOK);
+    ASSERT_EQ(process(2, check_watches_request)[0].response->error, Coordination::Error::ZNOWATCHER);
+
+    auto remove_watches_request = std::make_shared<Coordination::ZooKeeperRemoveWatchesRequest>();
+    remove_watches_request->path = "/config";
+    remove_watches_request->type = Coordination::WatcherType::PersistentRecursive;
+    ASSERT_EQ(process(1, remove_watches_request)[0].response->error, Coordination::Error::ZOK);
+    ASSERT_EQ(process(1, check_watches_request)[0].response->error, Coordination::Error::ZNOWATCHER);
+
+    auto set_request = std::make_shared<Coordination::ZooKeeperSetRequest>();
+    set_request->path = "/config/1";
+    ASSERT_EQ(process(2, set_request).size(), 1);
+}
+
+TEST(WatchManager, SerializeAddWatchRequest)
+{
+    Coordination::ZooKeeperAddWatchRequest request;
+    request.xid = 7;
+    request.path = "/a";
+    request.mode = Coordination::AddWatchMode::PersistentRecursive;
+
+    WriteBufferFromOwnString buf;
+    request.write(buf);
+
+    ReadBufferFromString in(buf.str());
+    int32_t length;
+    Coordination::read(length, in);
+    auto read_request = Coordination::ZooKeeperRequest::read(in);
+    ASSERT_EQ(read_request->getOpNum(), Coordination::OpNum::AddWatch);
+    const auto & typed_request = dynamic_cast<const Coordination::ZooKeeperAddWatchRequest &>(*read_request);
+    ASSERT_EQ(typed_request.path, "/a");
+    ASSERT_EQ(typed_request.mode, Coordination::AddWatchMode::PersistentRecursive);
+}
+
+TEST(WatchManager, GroupWatchResponsesOfSession)
+{
+    KeeperStore store(500);
+    store.addSessionID(1, 30000);
+    store.addSessionID(2, 30000);
+
+    KeeperStore::KeeperResponsesQueue responses;
+    auto process = [&](int64_t session_id, const Coordination::ZooKeeperRequestPtr & request)
+    {
+        store.processRequest(responses, RequestForSession(request, session_id, 0));
+        ResponsesForSessions result;
+        ResponseForSession response;
+        while (responses.tryPop(response))
+            result.push_back(response);
+        return result;
+    };
+
+    constexpr size_t nodes = 3;
+    auto multi_request = std::make_shared<Coordination::ZooKeeperMultiRequest>();
+    for (size_t i = 0; i < nodes; ++i)
+    {
+        auto create_request = std::make_shared<Coordination::ZooKeeperCreateRequest>();
+        create_request->path = "/n" + std::to_string(i);
+        process(2, create_request);
+
+        auto get_request = std::make_shared<Coordination::ZooKeeperGetRequest>();
+        get_request->path = create_request->path;
+        get_request->has_watch = true;
+        process(1, get_request);
+
+        auto remove_request = std::make_shared<Coordination::ZooKeeperRemoveRequest>();
+        remove_request->path = create_request->path;
+        multi_request->requests.push_back(remove_request);
+    }
+
+    /// Events of the multi request are delivered to session 1 by one response, before the response of the multi.
+    auto result = process(2, multi_request);
+    ASSERT_EQ(result.size(), 2);
+    ASSERT_EQ(result[0].session_id, 1);
+    ASSERT_EQ(result[1].session_id, 2);
+
+    const auto & batch = dynamic_cast<const Coordination::ZooKeeperWatchResponses &>(*result[0].response);
+    ASSERT_EQ(batch.responses.size(), nodes);
+
+    /// The batch is written as consecutive watch events.
+    WriteBufferFromOwnString expected;
+    for (size_t i = 0; i < nodes; ++i)
+    {
+        const auto & watch_response = dynamic_cast<const Coordination::ZooKeeperWatchResponse &>(*batch.responses[i]);
+        ASSERT_EQ(watch_response.path, "/n" + std::to_string(i));
+        ASSERT_EQ(watch_response.type, Coordination::Event::DELETED);
+        watch_response.write(expected);
+    }
+
+    Coordination::ZooKeeperResponseBuffers buffers;
+    batch.writeNoCopy(buffers);
+    String written = buffers.head + String(buffers.payload.data(), buffers.payload.size()) + buffers.tail;
+    ASSERT_EQ(written, expected.str());
+}
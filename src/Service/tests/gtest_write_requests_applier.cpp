@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <map>
+#include <random>
+#include <tuple>
+
+#include <Service/SnapshotCommon.h>
+#include <Service/WriteRequestsApplier.h>
+#include <ZooKeeper/ZooKeeperCommon.h>
+#include <gtest/gtest.h>
+
+
+using namespace RK;
+
+namespace
+{
+
+const Coordination::ACLs DEFAULT_ACLS{{Coordination::ACL::All, "world", "anyone"}};
+const Coordination::ACLs DIGEST_ACLS{{Coordination::ACL::All, "digest", "user:password"}};
+
+class RequestGenerator
+{
+public:
+    explicit RequestGenerator(UInt64 seed) : rng(seed) { }
+
+    RequestForSession generate(int64_t session_id)
+    {
+        RequestForSession request;
+        request.session_id = session_id;
+        request.process_time = 1000 + next_xid;
+
+        switch (rng() % 8)
+        {
+            case 0:
+            case 1:
+                request.request = makeCreate(randomPath());
+                break;
+            case 2:
+                request.request = makeRemove(randomPath());
+                break;
+            case 3:
+            {
+                auto set_request = std::make_shared<Coordination::ZooKeeperSetRequest>();
+                set_request->path = randomPath();
+                set_request->data = "data-" + std::to_string(rng() % 100);
+                set_request->version = rng() % 4 == 0 ? 0 : -1;
+                request.request = set_request;
+                break;
+            }
+            case 4:
+            {
+                auto check_request = std::make_shared<Coordination::ZooKeeperCheckRequest>();
+                check_request->path = randomPath();
+                check_request->version = rng() % 2;
+                request.request = check_request;
+                break;
+            }
+            case 5:
+            {
+                auto set_acl_request = std::make_shared<Coordination::ZooKeeperSetACLRequest>();
+                set_acl_request->path = randomPath();
+                set_acl_request->acls = rng() % 2 ? DEFAULT_ACLS : DIGEST_ACLS;
+                request.request = set_acl_request;
+                break;
+            }
+            default:
+            {
+                auto multi_request = std::make_shared<Coordination::ZooKeeperMultiRequest>();
+                String path = randomPath();
+                multi_request->requests.push_back(makeCreate(path));
+                multi_request->requests.push_back(makeCreate(path + "/m"));
+                if (rng() % 2)
+                    multi_request->requests.push_back(makeRemove(randomPath()));
+                request.request = multi_request;
+                break;
+            }
+        }
+
+        request.request->xid = next_xid++;
+        return request;
+    }
+
+private:
+    String randomPath()
+    {
+        String path;
+        size_t depth = 1 + rng() % 3;
+        for (size_t i = 0; i < depth; ++i)
+            path += "/n" + std::to_string(rng() % 6);
+        return path;
+    }
+
+    std::shared_ptr<Coordination::ZooKeeperCreateRequest> makeCreate(const String & path)
+    {
+        auto create_request = std::make_shared<Coordination::ZooKeeperCreateRequest>();
+        create_request->path = path;
+        create_request->data = "data-" + std::to_string(rng() % 100);
+        create_request->is_sequential = rng() % 5 == 0;
+        create_request->is_ephemeral = rng() % 5 == 0;
+        create_request->acls = rng() % 10 == 0 ? DIGEST_ACLS : DEFAULT_ACLS;
+        return create_request;
+    }
+
+    std::shared_ptr<Coordination::ZooKeeperRemoveRequest> makeRemove(const String & path)
+    {
+        auto remove_request = std::make_shared<Coordination::ZooKeeperRemoveRequest>();
+        remove_request->path = path;
+        return remove_request;
+    }
+
+    std::mt19937_64 rng;
+    Coordination::XID next_xid = 1;
+};
+
+/// Serialized nodes with children in their order, sorted by path.
+String dumpDataTree(KeeperStore & store)
+{
+    std::map<String, String> nodes;
+    auto & data_tree = store.getDataTree();
+    for (UInt32 bucket_id = 0; bucket_id < data_tree.getBucketNum(); ++bucket_id)
+    {
+        data_tree.forEach(bucket_id, [&](const String & path, const KeeperNodePtr & node)
+        {
+            String serialized = serializeKeeperNode(path, node, CURRENT_SNAPSHOT_VERSION);
+            for (auto child : node->children)
+                serialized.append(child).push_back('\0');
+            nodes.emplace(path, std::move(serialized));
+        });
+    }
+
+    String result;
+    for (const auto & [_, serialized] : nodes)
+        result += serialized;
+    return result;
+}
+
+std::vector<std::tuple<int64_t, Coordination::XID, int64_t, Coordination::Error>> dumpResponses(KeeperStore::KeeperResponsesQueue & queue)
+{
+    std::vector<std::tuple<int64_t, Coordination::XID, int64_t, Coordination::Error>> result;
+    queue.forEach([&](const ResponseForSession & response)
+    {
+        result.emplace_back(response.session_id, response.response->xid, response.response->zxid, response.response->error);
+        return true;
+    });
+    return result;
+}
+
+}
+
+TEST(WriteRequestsApplier, SameWithSerialApply)
+{
+    KeeperStore serial_store(500);
+    KeeperStore parallel_store(500);
+    WriteRequestsApplier applier(parallel_store, 8);
+
+    constexpr int64_t session_num = 16;
+    for (int64_t session_id = 1; session_id <= session_num; ++session_id)
+    {
+        serial_store.addSessionID(session_id, 30000);
+        parallel_store.addSessionID(session_id, 30000);
+    }
+
+    RequestGenerator generator(42);
+    std::mt19937 rng(7);
+
+    KeeperStore::KeeperResponsesQueue serial_responses;
+    KeeperStore::KeeperResponsesQueue parallel_responses;
+
+    for (size_t round = 0; round < 200; ++round)
+    {
+        std::vector<RequestForSession> batch;
+        size_t batch_size = 1 + rng() % 100;
+        for (size_t i = 0; i < batch_size; ++i)
+            batch.push_back(generator.generate(1 + rng() % session_num));
+
+        for (const auto & request : batch)
+        {
+            ASSERT_TRUE(applier.canApplyInBatch(request));
+            serial_store.processRequest(serial_responses, request);
+        }
+        applier.apply(batch, parallel_responses);
+
+        ASSERT_EQ(parallel_store.getZxid(), serial_store.getZxid());
+    }
+
+    ASSERT_GT(serial_store.getNodesCount(), 1);
+    ASSERT_EQ(dumpDataTree(parallel_store), dumpDataTree(serial_store));
+    ASSERT_TRUE(parallel_store.getACLMap() == serial_store.getACLMap());
+    ASSERT_EQ(parallel_store.getTotalEphemeralNodesCount(), serial_store.getTotalEphemeralNodesCount());
+    ASSERT_EQ(dumpResponses(parallel_responses), dumpResponses(serial_responses));
+}
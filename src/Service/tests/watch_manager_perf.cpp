@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Common/Stopwatch.h>
+#include <Service/WatchManager.h>
+
+
+/** Register many watches from concurrent threads like read requests do, then measure the latency of
+  * triggering watches of a path like applying a write request does, alone and while other threads keep
+  * registering watches.
+  *
+  * Test this way:
+  *
+  * ./watch_manager_perf
+  * ./watch_manager_perf 5000000 10000 16
+  *
+  * Arguments are the number of watches (default 5000000), the number of sessions (default 10000) and
+  * the number of registering threads (default 8). Every path is watched by WATCHES_PER_PATH sessions.
+  */
+
+namespace
+{
+
+constexpr size_t WATCHES_PER_PATH = 5;
+constexpr size_t TRIGGER_COUNT = 100000;
+
+String makePath(size_t i)
+{
+    return "/clickhouse/tables/db_" + std::to_string(i % 97) + "/table_" + std::to_string(i % 1031) + "/replicas/r_"
+        + std::to_string(i) + "/log_pointer";
+}
+
+int64_t makeSession(size_t path_index, size_t watch_index, size_t sessions)
+{
+    return static_cast<int64_t>((path_index + watch_index * 2003) % sessions + 1);
+}
+
+void registerPaths(RK::WatchManager & watch_manager, size_t begin, size_t end, size_t step, size_t sessions)
+{
+    for (size_t i = begin; i < end; i += step)
+    {
+        auto path = makePath(i);
+        for (size_t j = 0; j < WATCHES_PER_PATH; ++j)
+            watch_manager.registerWatches(path, makeSession(i, j, sessions), Coordination::OpNum::Get);
+    }
+}
+
+/// Trigger watches of paths and report latency percentiles.
+void trigger(RK::WatchManager & watch_manager, const char * name, size_t begin, size_t paths_count)
+{
+    std::vector<UInt64> latencies;
+    latencies.reserve(TRIGGER_COUNT);
+    size_t events = 0;
+
+    Stopwatch watch;
+    Stopwatch op_watch;
+    for (size_t i = 0; i < TRIGGER_COUNT; ++i)
+    {
+        auto path = makePath((begin + i * 7919) % paths_count);
+        op_watch.restart();
+        events += watch_manager.processWatches(path, Coordination::OpNum::Set).size();
+        latencies.push_back(op_watch.elapsedNanoseconds());
+    }
+    double seconds = watch.elapsedSeconds();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))] / 1000.0; };
+    std::cerr << std::setw(24) << name << ": " << TRIGGER_COUNT << " triggers in " << seconds << " sec., " << events
+              << " events, latency us p50 " << percentile(0.5) << ", p99 " << percentile(0.99) << ", p999 " << percentile(0.999)
+              << ", max " << percentile(1.0) << "\n";
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    size_t watches = argc > 1 ? std::stoull(argv[1]) : 5000000;
+    size_t sessions = argc > 2 ? std::stoull(argv[2]) : 10000;
+    size_t threads = argc > 3 ? std::stoull(argv[3]) : 8;
+    size_t paths_count = watches / WATCHES_PER_PATH;
+
+    std::cerr << std::fixed << std::setprecision(3);
+
+    RK::WatchManager watch_manager;
+
+    {
+        Stopwatch watch;
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t)
+            workers.emplace_back([&, t] { registerPaths(watch_manager, t, paths_count, threads, sessions); });
+        for (auto & worker : workers)
+            worker.join();
+
+        double seconds = watch.elapsedSeconds();
+        std::cerr << "Registered " << watch_manager.getTotalWatchesCount() << " watches on " << watch_manager.getWatchedPathsCount()
+                  << " paths by " << threads << " threads in " << seconds << " sec., " << (watches / seconds) << " watches/sec.\n";
+    }
+
+    trigger(watch_manager, "trigger", 0, paths_count);
+
+    {
+        /// Readers register watches again on the paths just triggered while the writer triggers others.
+        std::atomic<bool> stop{false};
+        std::atomic<size_t> registered{0};
+        std::vector<std::thread> readers;
+        for (size_t t = 0; t < threads; ++t)
+        {
+            readers.emplace_back([&, t]
+            {
+                for (size_t i = t; !stop.load(std::memory_order_relaxed); i += threads)
+                {
+                    auto path = makePath((i * 7919) % paths_count);
+                    watch_manager.registerWatches(path, makeSession(i, 0, sessions), Coordination::OpNum::Get);
+                    registered.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        }
+
+        trigger(watch_manager, "trigger with readers", TRIGGER_COUNT, paths_count);
+        stop = true;
+        for (auto & reader : readers)
+            reader.join();
+        std::cerr << "Readers registered " << registered.load() << " watches meanwhile\n";
+    }
+
+    {
+        Stopwatch watch;
+        for (size_t session_id = 1; session_id <= sessions; ++session_id)
+            watch_manager.cleanDeadWatches(static_cast<int64_t>(session_id));
+        std::cerr << "Cleaned watches of " << sessions << " sessions in " << watch.elapsedSeconds() << " sec., "
+                  << watch_manager.getTotalWatchesCount() << " watches left\n";
+    }
+
+    return 0;
+}
@@ -111,6 +111,7 @@ const char * errorMessage(Error code)
         case Error::ZCLOSING:                 return "ZooKeeper is closing";
         case Error::ZNOTHING:                 return "(not error) no server responses to process";
         case Error::ZSESSIONMOVED:            return "Session moved to another server, so operation is ignored";
+        case Error::ZNOWATCHER:               return "No such watcher";
     }
 
     __builtin_unreachable();
@@ -152,6 +153,14 @@ void MultiRequest::addRootPath(const String & root_path)
         request->addRootPath(root_path);
 }
 
+size_t MultiRequest::bytesSize() const
+{
+    size_t size = 0;
+    for (const auto & request : requests)
+        size += request->bytesSize();
+    return size;
+}
+
 void CreateResponse::removeRootPath(const String & root_path) { Coordination::removeRootPath(path_created, root_path); }
 void WatchResponse::removeRootPath(const String & root_path) { Coordination::removeRootPath(path, root_path); }
 
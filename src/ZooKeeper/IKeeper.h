@@ -132,7 +132,8 @@ enum class Error : int32_t
     ZAUTHFAILED = -115,                 /// Client authentication failed
     ZCLOSING = -116,                    /// ZooKeeper is closing
     ZNOTHING = -117,                    /// (not error) no server responses to process
-    ZSESSIONMOVED = -118                /// Session moved to another server, so operation is ignored
+    ZSESSIONMOVED = -118,               /// Session moved to another server, so operation is ignored
+    ZNOWATCHER = -121                   /// No watch to check or remove
 };
 
 /// Network errors and similar. You should reinitialize ZooKeeper session in case of these errors
@@ -157,6 +158,8 @@ struct Request
     virtual String getPath() const = 0;
     virtual void addRootPath(const String & /* root_path */) {}
     virtual String toString() const { return {}; }
+    /// Approximate size of the request payload, used to bound the bytes of a Raft log batch
+    virtual size_t bytesSize() const { return 0; }
 };
 
 struct Response;
@@ -199,6 +202,7 @@ struct SetACLRequest : virtual Request
 
     void addRootPath(const String & root_path) override;
     String getPath() const override { return path; }
+    size_t bytesSize() const override { return path.size() + sizeof(version) + acls.size() * sizeof(ACL); }
 };
 
 struct SetACLResponse : virtual Response
@@ -230,6 +234,7 @@ struct CreateRequest : virtual Request
 
     void addRootPath(const String & root_path) override;
     String getPath() const override { return path; }
+    size_t bytesSize() const override { return path.size() + data.size() + acls.size() * sizeof(ACL) + 2 * sizeof(bool); }
 };
 
 struct CreateResponse : virtual Response
@@ -246,6 +251,7 @@ struct RemoveRequest : virtual Request
 
     void addRootPath(const String & root_path) override;
     String getPath() const override { return path; }
+    size_t bytesSize() const override { return path.size() + sizeof(version); }
 };
 
 struct RemoveResponse : virtual Response
@@ -287,6 +293,7 @@ struct SetRequest : virtual Request
 
     void addRootPath(const String & root_path) override;
     String getPath() const override { return path; }
+    size_t bytesSize() const override { return path.size() + data.size() + sizeof(version); }
 };
 
 struct SetResponse : virtual Response
@@ -320,6 +327,7 @@ struct CheckRequest : virtual Request
 
     void addRootPath(const String & root_path) override;
     String getPath() const override { return path; }
+    size_t bytesSize() const override { return path.size() + sizeof(version); }
 };
 
 struct CheckResponse : virtual Response
@@ -332,6 +340,7 @@ struct MultiRequest : virtual Request
 
     void addRootPath(const String & root_path) override;
     String getPath() const override { return {}; }
+    size_t bytesSize() const override;
 };
 
 struct MultiResponse : virtual Response
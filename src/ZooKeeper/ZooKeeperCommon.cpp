@@ -17,7 +17,7 @@ void ZooKeeperResponse::write(WriteBuffer & out) const
     Coordination::write(zxid, buf);
     Coordination::write(error, buf);
     if (error == Error::ZOK)
-        writeImpl(buf);
+        writeBody(buf);
     Coordination::write(buf.str(), out);
     out.next();
 }
@@ -31,7 +31,7 @@ void ZooKeeperResponse::writeNoCopy(WriteBufferFromOwnString & out) const
     Coordination::write(zxid, out);
     Coordination::write(error, out);
     if (error == Error::ZOK)
-        writeImpl(out);
+        writeBody(out);
     String & result = out.str();
 
     // write data length at begin of string
@@ -39,6 +39,38 @@ void ZooKeeperResponse::writeNoCopy(WriteBufferFromOwnString & out) const
     memcpy(result.data() + pre_size, reinterpret_cast<const char *>(&len), sizeof(int32_t));
 }
 
+void ZooKeeperResponse::writeNoCopy(ZooKeeperResponseBuffers & out) const
+{
+    if (error != Error::ZOK || serialized_body.size() < MIN_REFERENCED_BODY_SIZE)
+    {
+        WriteBufferFromOwnString buf;
+        writeNoCopy(buf);
+        out.head = std::move(buf.str());
+        out.payload = {};
+        out.tail.clear();
+        return;
+    }
+
+    WriteBufferFromOwnString head;
+    /// Prepended length
+    Coordination::write(static_cast<int32_t>(sizeof(xid) + sizeof(zxid) + sizeof(int32_t) + serialized_body.size()), head);
+    Coordination::write(xid, head);
+    Coordination::write(zxid, head);
+    Coordination::write(error, head);
+
+    out.head = std::move(head.str());
+    out.payload = serialized_body;
+    out.tail.clear();
+}
+
+void ZooKeeperResponse::writeBody(WriteBuffer & out) const
+{
+    if (serialized_body.empty())
+        writeImpl(out);
+    else
+        out.write(serialized_body.data(), serialized_body.size());
+}
+
 void ZooKeeperRequest::write(WriteBuffer & out) const
 {
     /// Excessive copy to calculate length.
@@ -70,6 +102,49 @@ void ZooKeeperSyncResponse::writeImpl(WriteBuffer & out) const
     Coordination::write(path, out);
 }
 
+void ZooKeeperAddWatchRequest::writeImpl(WriteBuffer & out) const
+{
+    Coordination::write(path, out);
+    Coordination::write(static_cast<int32_t>(mode), out);
+}
+
+void ZooKeeperAddWatchRequest::readImpl(ReadBuffer & in)
+{
+    Coordination::read(path, in);
+    int32_t raw_mode;
+    Coordination::read(raw_mode, in);
+    if (raw_mode != static_cast<int32_t>(AddWatchMode::Persistent) && raw_mode != static_cast<int32_t>(AddWatchMode::PersistentRecursive))
+        throw Exception("Unknown mode " + std::to_string(raw_mode) + " of AddWatch request", Error::ZBADARGUMENTS);
+    mode = static_cast<AddWatchMode>(raw_mode);
+}
+
+void ZooKeeperAddWatchResponse::readImpl(ReadBuffer & in)
+{
+    int32_t body_error;
+    Coordination::read(body_error, in);
+}
+
+void ZooKeeperAddWatchResponse::writeImpl(WriteBuffer & out) const
+{
+    Coordination::write(static_cast<int32_t>(Error::ZOK), out);
+}
+
+void ZooKeeperWatchesRequest::writeImpl(WriteBuffer & out) const
+{
+    Coordination::write(path, out);
+    Coordination::write(static_cast<int32_t>(type), out);
+}
+
+void ZooKeeperWatchesRequest::readImpl(ReadBuffer & in)
+{
+    Coordination::read(path, in);
+    int32_t raw_type;
+    Coordination::read(raw_type, in);
+    if (raw_type < static_cast<int32_t>(WatcherType::Children) || raw_type > static_cast<int32_t>(WatcherType::PersistentRecursive))
+        throw Exception("Unknown watcher type " + std::to_string(raw_type) + " of " + Coordination::toString(getOpNum()) + " request", Error::ZBADARGUMENTS);
+    type = static_cast<WatcherType>(raw_type);
+}
+
 void ZooKeeperWatchResponse::readImpl(ReadBuffer & in)
 {
     Coordination::read(type, in);
@@ -91,6 +166,43 @@ void ZooKeeperWatchResponse::write(WriteBuffer & out) const
     /// skip bad responses for watches
 }
 
+void ZooKeeperWatchResponses::write(WriteBuffer & out) const
+{
+    for (const auto & response : responses)
+        response->write(out);
+}
+
+void ZooKeeperWatchResponses::writeNoCopy(WriteBufferFromOwnString & out) const
+{
+    /// writeNoCopy finalizes the buffer, so every response is written into its own one.
+    for (const auto & response : responses)
+    {
+        WriteBufferFromOwnString buf;
+        response->writeNoCopy(buf);
+        const auto & packet = buf.str();
+        out.write(packet.data(), packet.size());
+    }
+}
+
+void ZooKeeperWatchResponses::writeNoCopy(ZooKeeperResponseBuffers & out) const
+{
+    WriteBufferFromOwnString buf;
+    writeNoCopy(buf);
+    out.tail.clear();
+
+    /// Large batch is sent as payload, together with the send buffer by one write without copying.
+    if (buf.str().size() < MIN_REFERENCED_BODY_SIZE)
+    {
+        out.head = std::move(buf.str());
+        out.payload = {};
+    }
+    else
+    {
+        out.head.clear();
+        out.payload = std::move(buf.str());
+    }
+}
+
 void ZooKeeperAuthRequest::writeImpl(WriteBuffer & out) const
 {
     Coordination::write(type, out);
@@ -200,10 +312,37 @@ void ZooKeeperGetResponse::readImpl(ReadBuffer & in)
 
 void ZooKeeperGetResponse::writeImpl(WriteBuffer & out) const
 {
-    Coordination::write(data, out);
+    Coordination::write(getData(), out);
     Coordination::write(stat, out);
 }
 
+void ZooKeeperGetResponse::writeNoCopy(ZooKeeperResponseBuffers & out) const
+{
+    if (error != Error::ZOK || !serialized_body.empty() || node_data.size() < MIN_REFERENCED_DATA_SIZE)
+    {
+        ZooKeeperResponse::writeNoCopy(out);
+        return;
+    }
+
+    WriteBufferFromOwnString head;
+    /// Prepended length
+    Coordination::write(static_cast<int32_t>(0), head);
+    Coordination::write(xid, head);
+    Coordination::write(zxid, head);
+    Coordination::write(error, head);
+    Coordination::write(static_cast<int32_t>(node_data.size()), head);
+
+    WriteBufferFromOwnString tail;
+    Coordination::write(stat, tail);
+
+    out.head = std::move(head.str());
+    out.payload = node_data;
+    out.tail = std::move(tail.str());
+
+    int32_t len = std::byteswap(static_cast<int32_t>(out.size() - sizeof(int32_t)));
+    memcpy(out.head.data(), reinterpret_cast<const char *>(&len), sizeof(int32_t));
+}
+
 void ZooKeeperSetRequest::writeImpl(WriteBuffer & out) const
 {
     Coordination::write(path, out);
@@ -543,7 +682,7 @@ void ZooKeeperMultiResponse::writeImpl(WriteBuffer & out) const
         Coordination::write(done, out);
         Coordination::write(op_error, out);
         if (op_error == Error::ZOK || op_num == OpNum::Error)
-            zk_response.writeImpl(out);
+            zk_response.writeBody(out);
     }
 
     /// Footer.
@@ -578,6 +717,9 @@ void ZooKeeperSetWatchesRequest::readImpl(ReadBuffer & in)
 ZooKeeperResponsePtr ZooKeeperHeartbeatRequest::makeResponse() const { return std::make_shared<ZooKeeperHeartbeatResponse>(); }
 ZooKeeperResponsePtr ZooKeeperSetWatchesRequest::makeResponse() const { return std::make_shared<ZooKeeperSetWatchesResponse>(); }
 ZooKeeperResponsePtr ZooKeeperSyncRequest::makeResponse() const { return std::make_shared<ZooKeeperSyncResponse>(); }
+ZooKeeperResponsePtr ZooKeeperAddWatchRequest::makeResponse() const { return std::make_shared<ZooKeeperAddWatchResponse>(); }
+ZooKeeperResponsePtr ZooKeeperCheckWatchesRequest::makeResponse() const { return std::make_shared<ZooKeeperCheckWatchesResponse>(); }
+ZooKeeperResponsePtr ZooKeeperRemoveWatchesRequest::makeResponse() const { return std::make_shared<ZooKeeperRemoveWatchesResponse>(); }
 ZooKeeperResponsePtr ZooKeeperAuthRequest::makeResponse() const { return std::make_shared<ZooKeeperAuthResponse>(); }
 ZooKeeperResponsePtr ZooKeeperCreateRequest::makeResponse() const { return std::make_shared<ZooKeeperCreateResponse>(); }
 ZooKeeperResponsePtr ZooKeeperRemoveRequest::makeResponse() const { return std::make_shared<ZooKeeperRemoveResponse>(); }
@@ -678,6 +820,57 @@ void ZooKeeperUpdateSessionResponse::writeImpl(WriteBuffer & out) const
     Coordination::write(success, out);
 }
 
+void ZooKeeperUpgradeSessionRequest::writeImpl(WriteBuffer & out) const
+{
+    Coordination::write(session_id, out);
+    Coordination::write(session_timeout_ms, out);
+    Coordination::write(server_id, out);
+}
+
+void ZooKeeperUpgradeSessionRequest::readImpl(ReadBuffer & in)
+{
+    Coordination::read(session_id, in);
+    Coordination::read(session_timeout_ms, in);
+    Coordination::read(server_id, in);
+}
+
+Coordination::ZooKeeperResponsePtr ZooKeeperUpgradeSessionRequest::makeResponse() const
+{
+    auto response = std::make_shared<ZooKeeperUpgradeSessionResponse>();
+    response->session_id = session_id;
+    response->xid = xid;
+    return response;
+}
+
+void ZooKeeperUpgradeSessionResponse::readImpl(ReadBuffer & in)
+{
+    Coordination::read(session_id, in);
+    Coordination::read(success, in);
+}
+
+void ZooKeeperUpgradeSessionResponse::writeImpl(WriteBuffer & out) const
+{
+    Coordination::write(session_id, out);
+    Coordination::write(success, out);
+}
+
+void ZooKeeperCloseSessionsRequest::writeImpl(WriteBuffer & out) const
+{
+    Coordination::write(session_ids, out);
+}
+
+void ZooKeeperCloseSessionsRequest::readImpl(ReadBuffer & in)
+{
+    Coordination::read(session_ids, in);
+}
+
+Coordination::ZooKeeperResponsePtr ZooKeeperCloseSessionsRequest::makeResponse() const
+{
+    auto response = std::make_shared<ZooKeeperCloseResponse>();
+    response->xid = xid;
+    return response;
+}
+
 void ZooKeeperRequestFactory::registerRequest(OpNum op_num, Creator creator)
 {
     if (!op_num_to_request.try_emplace(op_num, creator).second)
@@ -746,7 +939,12 @@ ZooKeeperRequestFactory::ZooKeeperRequestFactory()
     registerZooKeeperRequest<OpNum::MultiRead, ZooKeeperMultiRequest>(*this);
     registerZooKeeperRequest<OpNum::NewSession, ZooKeeperNewSessionRequest>(*this);
     registerZooKeeperRequest<OpNum::UpdateSession, ZooKeeperUpdateSessionRequest>(*this);
+    registerZooKeeperRequest<OpNum::CloseSessions, ZooKeeperCloseSessionsRequest>(*this);
+    registerZooKeeperRequest<OpNum::UpgradeSession, ZooKeeperUpgradeSessionRequest>(*this);
     registerZooKeeperRequest<OpNum::SetWatches, ZooKeeperSetWatchesRequest>(*this);
+    registerZooKeeperRequest<OpNum::AddWatch, ZooKeeperAddWatchRequest>(*this);
+    registerZooKeeperRequest<OpNum::CheckWatches, ZooKeeperCheckWatchesRequest>(*this);
+    registerZooKeeperRequest<OpNum::RemoveWatches, ZooKeeperRemoveWatchesRequest>(*this);
     registerZooKeeperRequest<OpNum::GetACL, ZooKeeperGetACLRequest>(*this);
     registerZooKeeperRequest<OpNum::SetACL, ZooKeeperSetACLRequest>(*this);
 }
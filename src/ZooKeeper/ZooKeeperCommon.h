@@ -10,6 +10,7 @@
 #include <Common/IO/ReadBuffer.h>
 #include <Common/IO/WriteBuffer.h>
 #include <Common/IO/WriteHelpers.h>
+#include <Common/SharedString.h>
 #include <boost/noncopyable.hpp>
 
 #include <ZooKeeper/IKeeper.h>
@@ -19,6 +20,17 @@
 namespace Coordination
 {
 
+/// Serialized response with prepended length, whose large payload is referenced instead of copied.
+/// The bytes on the wire are head, payload and tail in order.
+struct ZooKeeperResponseBuffers
+{
+    String head;
+    SharedString payload;
+    String tail;
+
+    size_t size() const { return head.size() + payload.size() + tail.size(); }
+};
+
 struct ZooKeeperResponse : virtual Response
 {
     XID xid = 0;
@@ -27,13 +39,23 @@ struct ZooKeeperResponse : virtual Response
     /// used to calculate request latency
     UInt64 request_created_time_ms = 0;
 
+    /// Body already serialized by writeImpl, server sets it from response cache and it is written
+    /// instead of the fields. Body not smaller than MIN_REFERENCED_BODY_SIZE is not copied when sending.
+    SharedString serialized_body;
+    static constexpr size_t MIN_REFERENCED_BODY_SIZE = 4096;
+
     virtual ~ZooKeeperResponse() override = default;
     virtual void readImpl(ReadBuffer &) = 0;
     virtual void writeImpl(WriteBuffer &) const = 0;
     virtual void write(WriteBuffer & out) const;
 
+    /// Write serialized_body if there is, otherwise writeImpl.
+    void writeBody(WriteBuffer & out) const;
+
     /// Prepended length to avoid copy
     virtual void writeNoCopy(WriteBufferFromOwnString & out) const;
+    /// Like writeNoCopy, but the response may reference its payload, so that it can be sent by scatter-gather IO.
+    virtual void writeNoCopy(ZooKeeperResponseBuffers & out) const;
     virtual OpNum getOpNum() const = 0;
 
     virtual bool operator==(const ZooKeeperResponse & response) const
@@ -127,6 +149,94 @@ struct ZooKeeperSetWatchesResponse final : ZooKeeperResponse
     OpNum getOpNum() const override { return OpNum::SetWatches; }
 };
 
+/// Mode of watch added by AddWatch request, since ZooKeeper 3.6.
+enum class AddWatchMode : int32_t
+{
+    /// Triggered by changes of the node and its children like data and list watches, but not removed when triggered.
+    Persistent = 0,
+    /// Triggered by creation, deletion and change of the node and all its descendants, not removed when triggered.
+    PersistentRecursive = 1,
+};
+
+struct ZooKeeperAddWatchRequest final : ZooKeeperRequest
+{
+    String path;
+    AddWatchMode mode = AddWatchMode::Persistent;
+
+    String getPath() const override { return path; }
+    OpNum getOpNum() const override { return OpNum::AddWatch; }
+    void writeImpl(WriteBuffer & out) const override;
+    void readImpl(ReadBuffer & in) override;
+    ZooKeeperResponsePtr makeResponse() const override;
+    bool isReadRequest() const override { return true; }
+    String toString() const override
+    {
+        return Coordination::toString(getOpNum()) + ", xid " + std::to_string(xid) + ", path " + path + ", mode "
+            + std::to_string(static_cast<int32_t>(mode));
+    }
+};
+
+struct ZooKeeperAddWatchResponse final : ZooKeeperResponse
+{
+    /// Body is an error code, which is always ZOK, as the error of response is in the header.
+    void readImpl(ReadBuffer & in) override;
+    void writeImpl(WriteBuffer & out) const override;
+    OpNum getOpNum() const override { return OpNum::AddWatch; }
+};
+
+/// Type of watches to check or remove, the same with WatcherType of ZooKeeper.
+enum class WatcherType : int32_t
+{
+    Children = 1,
+    Data = 2,
+    Any = 3,
+    Persistent = 4,
+    PersistentRecursive = 5,
+};
+
+/// Base of CheckWatches and RemoveWatches requests, which have the same format.
+struct ZooKeeperWatchesRequest : ZooKeeperRequest
+{
+    String path;
+    WatcherType type = WatcherType::Any;
+
+    String getPath() const override { return path; }
+    void writeImpl(WriteBuffer & out) const override;
+    void readImpl(ReadBuffer & in) override;
+    bool isReadRequest() const override { return true; }
+    String toString() const override
+    {
+        return Coordination::toString(getOpNum()) + ", xid " + std::to_string(xid) + ", path " + path + ", type "
+            + std::to_string(static_cast<int32_t>(type));
+    }
+};
+
+struct ZooKeeperCheckWatchesRequest final : ZooKeeperWatchesRequest
+{
+    OpNum getOpNum() const override { return OpNum::CheckWatches; }
+    ZooKeeperResponsePtr makeResponse() const override;
+};
+
+struct ZooKeeperCheckWatchesResponse final : ZooKeeperResponse
+{
+    void readImpl(ReadBuffer &) override { }
+    void writeImpl(WriteBuffer &) const override { }
+    OpNum getOpNum() const override { return OpNum::CheckWatches; }
+};
+
+struct ZooKeeperRemoveWatchesRequest final : ZooKeeperWatchesRequest
+{
+    OpNum getOpNum() const override { return OpNum::RemoveWatches; }
+    ZooKeeperResponsePtr makeResponse() const override;
+};
+
+struct ZooKeeperRemoveWatchesResponse final : ZooKeeperResponse
+{
+    void readImpl(ReadBuffer &) override { }
+    void writeImpl(WriteBuffer &) const override { }
+    OpNum getOpNum() const override { return OpNum::RemoveWatches; }
+};
+
 struct ZooKeeperSyncRequest final : ZooKeeperRequest
 {
     String path;
@@ -158,6 +268,28 @@ struct ZooKeeperWatchResponse final : WatchResponse, ZooKeeperResponse
     OpNum getOpNum() const override { return OpNum::Unspecified; }
 };
 
+/// Triggered watch responses of a session delivered together, only used in server. They are written
+/// as consecutive packets, which are the same bytes as if they were written one by one.
+struct ZooKeeperWatchResponses final : ZooKeeperResponse
+{
+    std::vector<ZooKeeperResponsePtr> responses;
+
+    ZooKeeperWatchResponses()
+    {
+        xid = WATCH_XID;
+        zxid = -1;
+    }
+
+    void readImpl(ReadBuffer &) override { throw Exception("Batched watch responses can not be read", Error::ZRUNTIMEINCONSISTENCY); }
+    void writeImpl(WriteBuffer &) const override { throw Exception("Batched watch responses have no body", Error::ZRUNTIMEINCONSISTENCY); }
+
+    void write(WriteBuffer & out) const override;
+    void writeNoCopy(WriteBufferFromOwnString & out) const override;
+    void writeNoCopy(ZooKeeperResponseBuffers & out) const override;
+
+    OpNum getOpNum() const override { return OpNum::Unspecified; }
+};
+
 struct ZooKeeperAuthRequest final : ZooKeeperRequest
 {
     int32_t type = 0; /// ignored by the server
@@ -335,22 +467,32 @@ struct ZooKeeperGetRequest final : GetRequest, ZooKeeperRequest
 
 struct ZooKeeperGetResponse final : GetResponse, ZooKeeperResponse
 {
+    /// Data not smaller than it is not copied when sending the response.
+    static constexpr size_t MIN_REFERENCED_DATA_SIZE = 4096;
+
+    /// Data of the node shared with the data tree, server sets it instead of `data` to avoid copying.
+    SharedString node_data;
+
     void readImpl(ReadBuffer & in) override;
     void writeImpl(WriteBuffer & out) const override;
+    using ZooKeeperResponse::writeNoCopy;
+    void writeNoCopy(ZooKeeperResponseBuffers & out) const override;
     OpNum getOpNum() const override { return OpNum::Get; }
 
+    std::string_view getData() const { return node_data.empty() ? std::string_view(data) : node_data.view(); }
+
     bool operator==(const ZooKeeperResponse & response) const override
     {
         if (const ZooKeeperGetResponse * get_response = dynamic_cast<const ZooKeeperGetResponse *>(&response))
         {
-            return ZooKeeperResponse::operator==(response) && get_response->stat == stat && get_response->data == data;
+            return ZooKeeperResponse::operator==(response) && get_response->stat == stat && get_response->getData() == getData();
         }
         return false;
     }
 
     String toString() const override
     {
-        return "GetResponse " + ZooKeeperResponse::toString() + ", stat " + stat.toString() + ", data " + data;
+        return "GetResponse " + ZooKeeperResponse::toString() + ", stat " + stat.toString() + ", data " + String(getData());
     }
 };
 
@@ -760,6 +902,58 @@ struct ZooKeeperUpdateSessionResponse final : ZooKeeperResponse
     }
 };
 
+/// Fake internal RaftKeeper request. Never received from client
+/// and never send to client. Used to upgrade a local session which is only
+/// known by the server creating it to a global session before its first write.
+struct ZooKeeperUpgradeSessionRequest final : ZooKeeperRequest
+{
+    int64_t session_id;
+    int64_t session_timeout_ms;
+    /// Who owns this session
+    int32_t server_id;
+
+    Coordination::OpNum getOpNum() const override { return OpNum::UpgradeSession; }
+    String getPath() const override { return {}; }
+    void writeImpl(WriteBuffer & out) const override;
+    void readImpl(ReadBuffer & in) override;
+
+    Coordination::ZooKeeperResponsePtr makeResponse() const override;
+    bool isReadRequest() const override { return false; }
+};
+
+/// Fake internal RaftKeeper response. Never received from client
+/// and never send to client.
+struct ZooKeeperUpgradeSessionResponse final : ZooKeeperResponse
+{
+    int64_t session_id;
+    bool success;
+
+    void readImpl(ReadBuffer & in) override;
+    void writeImpl(WriteBuffer & out) const override;
+
+    Coordination::OpNum getOpNum() const override { return OpNum::UpgradeSession; }
+};
+
+/// Fake internal RaftKeeper request. Never received from client
+/// and never send to client. Used to close expired sessions in one log entry,
+/// every closed session gets a close response.
+struct ZooKeeperCloseSessionsRequest final : ZooKeeperRequest
+{
+    std::vector<int64_t> session_ids;
+
+    Coordination::OpNum getOpNum() const override { return OpNum::CloseSessions; }
+    String getPath() const override { return {}; }
+    void writeImpl(WriteBuffer & out) const override;
+    void readImpl(ReadBuffer & in) override;
+
+    Coordination::ZooKeeperResponsePtr makeResponse() const override;
+    bool isReadRequest() const override { return false; }
+    String toString() const override
+    {
+        return Coordination::toString(getOpNum()) + ", xid " + std::to_string(xid) + ", sessions " + std::to_string(session_ids.size());
+    }
+};
+
 class ZooKeeperRequestFactory final : private boost::noncopyable
 {
 public:
@@ -25,10 +25,15 @@ static const std::unordered_set<int32_t> VALID_OPERATIONS =
     static_cast<int32_t>(OpNum::NewSession),
     static_cast<int32_t>(OpNum::OldNewSession),
     static_cast<int32_t>(OpNum::SetWatches),
+    static_cast<int32_t>(OpNum::AddWatch),
+    static_cast<int32_t>(OpNum::CheckWatches),
+    static_cast<int32_t>(OpNum::RemoveWatches),
     static_cast<int32_t>(OpNum::SetACL),
     static_cast<int32_t>(OpNum::GetACL),
     static_cast<int32_t>(OpNum::FilteredList),
     static_cast<int32_t>(OpNum::UpdateSession),
+    static_cast<int32_t>(OpNum::CloseSessions),
+    static_cast<int32_t>(OpNum::UpgradeSession),
 };
 
 std::string toString(OpNum op_num)
@@ -73,12 +78,22 @@ std::string toString(OpNum op_num)
             return "OldNewSession";
         case OpNum::SetWatches:
             return "SetWatches";
+        case OpNum::AddWatch:
+            return "AddWatch";
+        case OpNum::CheckWatches:
+            return "CheckWatches";
+        case OpNum::RemoveWatches:
+            return "RemoveWatches";
         case OpNum::SetACL:
             return "SetACL";
         case OpNum::GetACL:
             return "GetACL";
         case OpNum::UpdateSession:
             return "UpdateSession";
+        case OpNum::CloseSessions:
+            return "CloseSessions";
+        case OpNum::UpgradeSession:
+            return "UpgradeSession";
         case OpNum::FilteredList:
             return "FilteredList";
     }
@@ -14,6 +14,7 @@ static constexpr XID PING_XID = -2;
 static constexpr XID AUTH_XID = -4;
 static constexpr XID NEW_SESSION_XID = -256;
 static constexpr XID UPDATE_SESSION_XID = -512;
+static constexpr XID UPGRADE_SESSION_XID = -768;
 /// Used when RaftKeeper server close a session.
 /// But when client send a close request xid can be any digit.
 static constexpr XID CLOSE_XID = 0x7FFFFFFF;
@@ -36,14 +37,19 @@ enum class OpNum : int32_t
     List = 12,
     Check = 13,
     Multi = 14,
+    CheckWatches = 17,
+    RemoveWatches = 18,
     MultiRead = 22,
     Auth = 100,
     SetWatches = 101,
+    AddWatch = 106,
     NewSession = -10, /// Used to create new session.
     OldNewSession = 997, /// Same with NewSession, just for backward compatibility
 
     FilteredList = 500, /// Special operation only used in ClickHouse.
     UpdateSession = 998, /// Special internal request. Used to session reconnect.
+    CloseSessions = 999, /// Special internal request. Used to close expired sessions in batch.
+    UpgradeSession = 1000, /// Special internal request. Used to upgrade a local session to global session.
 };
 
 std::string toString(OpNum op_num);
@@ -56,6 +56,17 @@ void write(const std::string & s, WriteBuffer & out)
     out.write(s.data(), s.size());
 }
 
+void write(std::string_view s, WriteBuffer & out)
+{
+    write(int32_t(s.size()), out);
+    out.write(s.data(), s.size());
+}
+
+void write(const SharedString & s, WriteBuffer & out)
+{
+    write(s.view(), out);
+}
+
 void write(const ACL & acl, WriteBuffer & out)
 {
     write(acl.permissions, out);
@@ -93,7 +104,10 @@ void write(const CompactStrings & strings, WriteBuffer & out)
 {
     write(static_cast<int32_t>(strings.size()), out);
     for (auto elem : strings)
-        write(elem.toString(), out);
+    {
+        write(static_cast<int32_t>(elem.size), out);
+        out.write(elem.data, elem.size);
+    }
 }
 
 void read(size_t & x, ReadBuffer & in)
@@ -170,6 +184,13 @@ void read(std::string & s, ReadBuffer & in)
     in.read(s.data(), size);
 }
 
+void read(SharedString & s, ReadBuffer & in)
+{
+    String str;
+    read(str, in);
+    s = std::move(str);
+}
+
 void read(ACL & acl, ReadBuffer & in)
 {
     read(acl.permissions, in);
@@ -4,6 +4,7 @@
 #include <vector>
 
 #include <Common/CompactStrings.h>
+#include <Common/SharedString.h>
 #include <Common/IO/Operators.h>
 #include <Common/IO/ReadHelpers.h>
 #include <Common/IO/WriteHelpers.h>
@@ -28,6 +29,8 @@ void write(uint8_t x, WriteBuffer & out);
 void write(OpNum x, WriteBuffer & out);
 void write(bool x, WriteBuffer & out);
 void write(const std::string & s, WriteBuffer & out);
+void write(std::string_view s, WriteBuffer & out);
+void write(const SharedString & s, WriteBuffer & out);
 void write(const ACL & acl, WriteBuffer & out);
 void write(const AuthID & auth_id, WriteBuffer & out);
 void write(const Stat & stat, WriteBuffer & out);
@@ -62,6 +65,7 @@ void read(bool & x, ReadBuffer & in);
 void read(int8_t & x, ReadBuffer & in);
 void read(uint8_t & x, ReadBuffer & in);
 void read(std::string & s, ReadBuffer & in);
+void read(SharedString & s, ReadBuffer & in);
 void read(ACL & acl, ReadBuffer & in);
 void read(AuthID & auth_id, ReadBuffer & in);
 void read(Stat & stat, ReadBuffer & in);